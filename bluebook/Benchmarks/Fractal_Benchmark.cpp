@@ -0,0 +1,120 @@
+#include "Defines.h"
+#ifdef FRACTAL_BENCHMARK
+#include "System.h"
+#include "Fractal.h"
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <omp.h>
+#include <vector>
+
+//Mpixel/s of the PMB_Fractal renderers without a window or GL context. The old per-pixel loop
+//over rows is timed first, then each FractalRenderer kernel with and without threads. Every
+//frame uses the sample's animated parameters at a few points in time, and each renderer's
+//image is compared against the old loop's.
+
+#define FRAMES 8
+
+static const int sizes[] = { 512, 1024, 2048 };
+
+static FractalParams FrameParams(int frame)
+{
+	float now_time = (float)frame * 7.0f * 0.01f;
+	FractalParams params;
+	params.m_cx = (1.5f - cosf(now_time * 0.4f) * 0.5f) * 0.3f;
+	params.m_cy = (1.5f + cosf(now_time * 0.5f) * 0.5f) * 0.3f;
+	params.m_offset_x = cosf(now_time * 0.14f) * 0.25f;
+	params.m_offset_y = cosf(now_time * 0.25f) * 0.25f;
+	params.m_zoom = (sinf(now_time) + 1.3f) * 0.7f;
+	return params;
+}
+
+//update_fractal as the sample had it, whole rows scheduled dynamically
+static void LegacyRender(const FractalParams& params, int width, int height, unsigned char* out)
+{
+	const float thresh_squared = 256.0f;
+
+#pragma omp parallel for schedule (dynamic)
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			float Z[2];
+			Z[0] = params.m_zoom * (float(x) / float(width) - 0.5f) + params.m_offset_x;
+			Z[1] = params.m_zoom * (float(y) / float(height) - 0.5f) + params.m_offset_y;
+
+			int it;
+			for (it = 0; it < params.m_max_iterations; it++) {
+				float Z_squared[2];
+				Z_squared[0] = Z[0] * Z[0] - Z[1] * Z[1];
+				Z_squared[1] = 2.0f * Z[0] * Z[1];
+				Z[0] = Z_squared[0] + params.m_cx;
+				Z[1] = Z_squared[1] + params.m_cy;
+
+				if ((Z[0] * Z[0] + Z[1] * Z[1]) > thresh_squared)
+					break;
+			}
+			out[y * width + x] = (unsigned char)it;
+		}
+	}
+}
+
+template <typename F>
+static f64 TimeFrames(F render)
+{
+	//Warm up on a frame outside the timed ones, so the progressive renderer sees a change on each
+	render(FRAMES);
+	auto start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < FRAMES; ++frame) {
+		render(frame);
+	}
+	return std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count() / FRAMES;
+}
+
+static int RunBenchmark()
+{
+	std::cout << "threads: " << omp_get_max_threads() << ", kernel: " << (CPU_HasAVX2() ? "AVX2" : "SSE") << std::endl;
+	std::cout << "size, renderer, ms/frame, Mpixel/s, pixels differing from legacy" << std::endl;
+
+	for (int size : sizes) {
+		const f64 megapixels = (f64)size * size / 1.0e6;
+		std::vector<unsigned char> reference((usize)size * size);
+		std::vector<unsigned char> image((usize)size * size);
+
+		f64 legacy = TimeFrames([&](int frame) { LegacyRender(FrameParams(frame), size, size, reference.data()); });
+		std::cout << size << ", legacy rows, " << legacy * 1000.0 << ", " << megapixels / legacy << ", 0" << std::endl;
+
+		struct Variant {
+			const char* name;
+			FractalKernel kernel;
+			bool threads;
+		};
+		const Variant variants[] = {
+			{ "scalar tiles", FractalKernel::Scalar, false },
+			{ "simd tiles", FractalKernel::SIMD, false },
+			{ "scalar tiles + threads", FractalKernel::Scalar, true },
+			{ "simd tiles + threads", FractalKernel::SIMD, true },
+		};
+
+		for (const Variant& variant : variants) {
+			FractalRenderer renderer;
+			renderer.Init(size, size);
+			renderer.m_kernel = variant.kernel;
+			renderer.m_threads = variant.threads;
+			f64 seconds = TimeFrames([&](int frame) { renderer.Render(FrameParams(frame), image.data()); });
+
+			//Last frame of both is the same, compare what they left behind
+			usize differing = 0;
+			for (usize i = 0; i < image.size(); ++i) differing += image[i] != reference[i];
+			std::cout << size << ", " << variant.name << ", " << seconds * 1000.0 << ", " << megapixels / seconds << ", " << differing << std::endl;
+		}
+
+		//Time until the first coarse image, what the progressive mode shows right after a change
+		FractalRenderer progressive;
+		progressive.Init(size, size);
+		f64 first_level = TimeFrames([&](int frame) { progressive.Refine(FrameParams(frame), image.data(), 0.0); });
+		std::cout << size << ", progressive first level, " << first_level * 1000.0 << ", " << megapixels / first_level << ", -" << std::endl;
+	}
+	return 0;
+}
+
+HEADLESS_MAIN(RunBenchmark)
+#endif //FRACTAL_BENCHMARK
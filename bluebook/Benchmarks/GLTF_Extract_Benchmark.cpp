@@ -0,0 +1,228 @@
+#include "Defines.h"
+#ifdef GLTF_EXTRACT_BENCHMARK
+#include "System.h"
+#include "Model.h"
+#include <chrono>
+
+//Times primitive extraction only, each file is parsed once up front. Compares the old
+//per-attribute push_back + re-interleave path against ExtractPrimitive into one staging
+//allocation, and UploadPrimitive writing straight into mapped buffer storage.
+
+#define ITERATIONS 20
+
+static const char* files[] = {
+	"./resources/ABeautifulGame.glb",
+	"./resources/sphere_light.glb",
+	"./resources/cube.glb",
+};
+
+#define FILE_COUNT (sizeof(files) / sizeof(files[0]))
+
+//The extraction as SB::Mesh did it before the shared engine, CPU side only
+static usize Legacy_Extract(const tinygltf::Model& model, const tinygltf::Primitive& primitive)
+{
+	vector<float> positions;
+	vector<float> normals;
+	vector<float> texcoords;
+	vector<unsigned int> indices;
+
+	const auto& positionAccessor = model.accessors[primitive.attributes.at("POSITION")];
+	const auto& positionView = model.bufferViews[positionAccessor.bufferView];
+	const float* positionData = reinterpret_cast<const float*>(model.buffers[positionView.buffer].data.data() + positionView.byteOffset + positionAccessor.byteOffset);
+	for (size_t i = 0; i < positionAccessor.count * 3; i++) {
+		positions.push_back(positionData[i]);
+	}
+
+	if (primitive.attributes.count("NORMAL") > 0) {
+		const auto& normalAccessor = model.accessors[primitive.attributes.at("NORMAL")];
+		const auto& normalView = model.bufferViews[normalAccessor.bufferView];
+		const float* normalData = reinterpret_cast<const float*>(model.buffers[normalView.buffer].data.data() + normalView.byteOffset + normalAccessor.byteOffset);
+		for (size_t i = 0; i < normalAccessor.count * 3; i++) {
+			normals.push_back(normalData[i]);
+		}
+	}
+
+	if (primitive.attributes.count("TEXCOORD_0") > 0) {
+		const auto& texAccessor = model.accessors[primitive.attributes.at("TEXCOORD_0")];
+		const auto& texView = model.bufferViews[texAccessor.bufferView];
+		const float* texCoordData = reinterpret_cast<const float*>(model.buffers[texView.buffer].data.data() + texView.byteOffset + texAccessor.byteOffset);
+		for (size_t i = 0; i < texAccessor.count * 2; i++) {
+			texcoords.push_back(texCoordData[i]);
+		}
+	}
+
+	const auto& indexAccessor = model.accessors[primitive.indices];
+	const auto& indexView = model.bufferViews[indexAccessor.bufferView];
+	if (indexAccessor.componentType == GL_UNSIGNED_INT) {
+		const unsigned int* indexData = reinterpret_cast<const unsigned int*>(model.buffers[indexView.buffer].data.data() + indexView.byteOffset + indexAccessor.byteOffset);
+		for (size_t i = 0; i < indexAccessor.count; i++) {
+			indices.push_back(indexData[i]);
+		}
+	}
+	else {
+		const unsigned short* indexData = reinterpret_cast<const unsigned short*>(model.buffers[indexView.buffer].data.data() + indexView.byteOffset + indexAccessor.byteOffset);
+		for (size_t i = 0; i < indexAccessor.count; i++) {
+			indices.push_back(indexData[i]);
+		}
+	}
+
+	vector<float> vertex;
+	for (size_t i = 0; i < positions.size() / 3; ++i) {
+		vertex.push_back(positions[3 * i + 0]);
+		vertex.push_back(positions[3 * i + 1]);
+		vertex.push_back(positions[3 * i + 2]);
+		vertex.push_back(normals.empty() ? 0.0f : normals[3 * i + 0]);
+		vertex.push_back(normals.empty() ? 0.0f : normals[3 * i + 1]);
+		vertex.push_back(normals.empty() ? 0.0f : normals[3 * i + 2]);
+		vertex.push_back(texcoords.empty() ? 0.0f : texcoords[2 * i + 0]);
+		vertex.push_back(texcoords.empty() ? 0.0f : texcoords[2 * i + 1]);
+	}
+	return vertex.size() + indices.size();
+}
+
+//Everything ExtractPrimitive handles that the legacy path can't read correctly is skipped there
+static bool Legacy_Supported(const tinygltf::Model& model, const tinygltf::Primitive& primitive)
+{
+	if (primitive.indices < 0 || primitive.attributes.count("POSITION") == 0) return false;
+	for (const auto& attribute : primitive.attributes) {
+		const auto& accessor = model.accessors[attribute.second];
+		if (accessor.componentType != GL_FLOAT || accessor.sparse.isSparse) return false;
+		if (model.bufferViews[accessor.bufferView].byteStride != 0) return false;
+	}
+	return true;
+}
+
+struct BenchResult {
+	bool loaded;
+	usize primitives;
+	usize vertices;
+	f64 legacy_ms;
+	f64 staging_ms;
+	f64 mapped_ms;
+};
+
+template <typename F>
+static f64 TimeRun(F run)
+{
+	run();
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < ITERATIONS; ++i) {
+		run();
+	}
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<f64, std::milli>(end - start).count() / ITERATIONS;
+}
+
+struct Application : public Program {
+	float m_clear_color[4];
+	u64 m_fps;
+	f64 m_time;
+
+	BenchResult m_results[FILE_COUNT];
+
+	Application()
+		:m_clear_color{ 0.1f, 0.1f, 0.1f, 1.0f },
+		m_fps(0),
+		m_time(0)
+	{}
+
+	void OnInit(Input& input, Audio& audio, Window& window) {
+		for (int i = 0; i < FILE_COUNT; ++i) {
+			BenchResult& result = m_results[i];
+			result = {};
+
+			tinygltf::Model model;
+			if (!std::filesystem::exists(files[i]) || !SB::Model::Parse(files[i], model)) continue;
+			result.loaded = true;
+
+			vector<const tinygltf::Primitive*> primitives;
+			for (const auto& mesh : model.meshes) {
+				for (const auto& primitive : mesh.primitives) {
+					primitives.push_back(&primitive);
+					result.vertices += SB::MeasurePrimitive(model, primitive, 0).m_vertex_count;
+				}
+			}
+			result.primitives = primitives.size();
+
+			volatile usize sink = 0;
+			result.legacy_ms = TimeRun([&]() {
+				usize total = 0;
+				for (const auto* primitive : primitives) {
+					if (Legacy_Supported(model, *primitive)) total += Legacy_Extract(model, *primitive);
+				}
+				sink = total;
+			});
+
+			result.staging_ms = TimeRun([&]() {
+				usize total = 0;
+				for (const auto* primitive : primitives) {
+					SB::PrimitiveLayout layout = SB::MeasurePrimitive(model, *primitive, 0);
+					vector<float> vertices((usize)layout.m_vertex_count * layout.m_stride);
+					vector<u32> indices(layout.m_index_count);
+					if (layout.m_vertex_count) SB::ExtractPrimitive(model, *primitive, layout, vertices.data(), indices.data());
+					total += vertices.size() + indices.size();
+				}
+				sink = total;
+			});
+
+			result.mapped_ms = TimeRun([&]() {
+				for (const auto* primitive : primitives) {
+					SB::MeshData mesh = SB::UploadPrimitive(model, *primitive, 0);
+					if (mesh.m_vao == 0) continue;
+					GLuint buffers[2] = { mesh.m_vertex_buffer, mesh.m_index_buffer };
+					glDeleteBuffers(2, buffers);
+					glDeleteVertexArrays(1, &mesh.m_vao);
+				}
+				glFinish();
+			});
+		}
+
+		std::cout << "file, primitives, vertices, legacy ms, staging ms, mapped ms" << std::endl;
+		for (int i = 0; i < FILE_COUNT; ++i) {
+			const BenchResult& r = m_results[i];
+			if (!r.loaded) {
+				std::cout << files[i] << ", missing" << std::endl;
+				continue;
+			}
+			std::cout << files[i] << ", " << r.primitives << ", " << r.vertices << ", " << r.legacy_ms << ", " << r.staging_ms << ", " << r.mapped_ms << std::endl;
+		}
+	}
+	void OnUpdate(Input& input, Audio& audio, Window& window, f64 dt) {
+		m_fps = window.GetFPS();
+		m_time = window.GetTime();
+	}
+	void OnDraw() {
+		glClearBufferfv(GL_COLOR, 0, m_clear_color);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+	void OnGui() {
+		ImGui::Begin("glTF Extract Benchmark");
+		ImGui::Text("FPS: %d", m_fps);
+		for (int i = 0; i < FILE_COUNT; ++i) {
+			const BenchResult& r = m_results[i];
+			ImGui::Text("%s", files[i]);
+			if (!r.loaded) {
+				ImGui::Text("\tmissing");
+				continue;
+			}
+			ImGui::Text("\t%llu primitives, %llu vertices", r.primitives, r.vertices);
+			ImGui::Text("\tlegacy %.3f ms  staging %.3f ms  mapped %.3f ms", r.legacy_ms, r.staging_ms, r.mapped_ms);
+		}
+		ImGui::End();
+	}
+};
+
+SystemConf config = {
+		1600,						//width
+		900,						//height
+		300,						//Position x
+		200,						//Position y
+		"glTF Extract Benchmark",	//window title
+		false,						//windowed fullscreen
+		false,						//vsync
+		144,						//framelimit
+		"resources/Icon.bmp"		//icon path
+};
+
+MAIN(config)
+#endif //GLTF_EXTRACT_BENCHMARK
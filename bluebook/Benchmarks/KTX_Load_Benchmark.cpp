@@ -0,0 +1,191 @@
+#include "Defines.h"
+#ifdef KTX_LOAD_BENCHMARK
+#include "System.h"
+#include "Texture.h"
+#include <chrono>
+#include <fstream>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif //_WIN32
+
+//Compares the memory mapped Load_KTX against the previous ifstream + vector + new[] path.
+//The mapped path runs first so the growth in peak working set can be attributed to each.
+
+#define ITERATIONS 20
+
+static const char* files[] = {
+	"./resources/displacement.ktx",
+	"./resources/Skull/Skull.ktx",
+	"./resources/mountains3d.ktx",
+	"./resources/trees.ktx",
+	"./resources/face1.ktx",
+};
+
+static usize PeakMemory()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+	return counters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return (usize)usage.ru_maxrss * 1024;
+#endif //_WIN32
+}
+
+struct Legacy_KTX_Header {
+	unsigned char	identifier[12];
+	unsigned int	endianness;
+	unsigned int	gltype;
+	unsigned int	gltypesize;
+	unsigned int	glformat;
+	unsigned int	glinternalformat;
+	unsigned int	glbaseinternalformat;
+	unsigned int	pixelwidth;
+	unsigned int	pixelheight;
+	unsigned int	pixeldepth;
+	unsigned int	arrayelements;
+	unsigned int	faces;
+	unsigned int	miplevels;
+	unsigned int	keypairbytes;
+};
+
+//The loader as it was before the mapped path: whole file read into a vector, payload copied again
+static GLuint Legacy_Load_KTX(const char* filename)
+{
+	std::ifstream ifs(filename, std::ios_base::binary);
+	if (!ifs.is_open()) return 0;
+
+	ifs.seekg(0, ifs.end);
+	usize length = ifs.tellg();
+	ifs.seekg(0, ifs.beg);
+	if (length <= sizeof(Legacy_KTX_Header)) return 0;
+
+	std::vector<char> buffer(length);
+	ifs.read(&buffer[0], length);
+	Legacy_KTX_Header* header = (Legacy_KTX_Header*)&buffer[0];
+
+	usize data_start = sizeof(Legacy_KTX_Header) + header->keypairbytes;
+	usize data_end = buffer.size();
+	unsigned char* data = new unsigned char[data_end - data_start];
+	memcpy(data, &buffer[data_start + 4], data_end - data_start - 4);
+
+	GLuint tex = 0;
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	if (header->pixeldepth == 0) {
+		glCreateTextures(GL_TEXTURE_2D, 1, &tex);
+		glTextureStorage2D(tex, 1, header->glinternalformat, header->pixelwidth, header->pixelheight);
+		glTextureSubImage2D(tex, 0, 0, 0, header->pixelwidth, header->pixelheight, header->glformat, header->gltype, data);
+	}
+	else {
+		glCreateTextures(GL_TEXTURE_3D, 1, &tex);
+		glTextureStorage3D(tex, 1, header->glinternalformat, header->pixelwidth, header->pixelheight, header->pixeldepth);
+		glTextureSubImage3D(tex, 0, 0, 0, 0, header->pixelwidth, header->pixelheight, header->pixeldepth, header->glformat, header->gltype, data);
+	}
+
+	delete[] data;
+	return tex;
+}
+
+struct BenchResult {
+	f64 legacy_ms;
+	f64 mapped_ms;
+};
+
+template <typename F>
+static f64 TimeLoad(const char* filename, F load)
+{
+	//Warm the page cache so both paths are measured against the same disk state
+	GLuint warm = load(filename);
+	glDeleteTextures(1, &warm);
+	glFinish();
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < ITERATIONS; ++i) {
+		GLuint tex = load(filename);
+		glFinish();
+		glDeleteTextures(1, &tex);
+	}
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<f64, std::milli>(end - start).count() / ITERATIONS;
+}
+
+struct Application : public Program {
+	float m_clear_color[4];
+	u64 m_fps;
+	f64 m_time;
+
+	BenchResult m_results[sizeof(files) / sizeof(files[0])];
+	usize m_peak_start;
+	usize m_peak_mapped;
+	usize m_peak_legacy;
+
+	Application()
+		:m_clear_color{ 0.1f, 0.1f, 0.1f, 1.0f },
+		m_fps(0),
+		m_time(0)
+	{}
+
+	void OnInit(Input& input, Audio& audio, Window& window) {
+		const int count = sizeof(files) / sizeof(files[0]);
+		m_peak_start = PeakMemory();
+
+		for (int i = 0; i < count; ++i) {
+			m_results[i].mapped_ms = TimeLoad(files[i], [](const char* f) { return Load_KTX(f); });
+		}
+		m_peak_mapped = PeakMemory();
+
+		for (int i = 0; i < count; ++i) {
+			m_results[i].legacy_ms = TimeLoad(files[i], Legacy_Load_KTX);
+		}
+		m_peak_legacy = PeakMemory();
+
+		std::cout << "file, legacy ms, mapped ms" << std::endl;
+		for (int i = 0; i < count; ++i) {
+			std::cout << files[i] << ", " << m_results[i].legacy_ms << ", " << m_results[i].mapped_ms << std::endl;
+		}
+		std::cout << "peak growth mapped: " << (m_peak_mapped - m_peak_start) / 1024 << " KB" << std::endl;
+		std::cout << "peak growth legacy: " << (m_peak_legacy - m_peak_mapped) / 1024 << " KB" << std::endl;
+	}
+	void OnUpdate(Input& input, Audio& audio, Window& window, f64 dt) {
+		m_fps = window.GetFPS();
+		m_time = window.GetTime();
+	}
+	void OnDraw() {
+		glClearBufferfv(GL_COLOR, 0, m_clear_color);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+	void OnGui() {
+		ImGui::Begin("KTX Load Benchmark");
+		ImGui::Text("FPS: %d", m_fps);
+		for (int i = 0; i < sizeof(files) / sizeof(files[0]); ++i) {
+			ImGui::Text("%s", files[i]);
+			ImGui::Text("\tlegacy %.3f ms  mapped %.3f ms", m_results[i].legacy_ms, m_results[i].mapped_ms);
+		}
+		ImGui::Text("Peak growth mapped: %llu KB", (m_peak_mapped - m_peak_start) / 1024);
+		ImGui::Text("Peak growth legacy: %llu KB", (m_peak_legacy - m_peak_mapped) / 1024);
+		ImGui::End();
+	}
+};
+
+SystemConf config = {
+		1600,					//width
+		900,					//height
+		300,					//Position x
+		200,					//Position y
+		"KTX Load Benchmark",	//window title
+		false,					//windowed fullscreen
+		false,					//vsync
+		144,					//framelimit
+		"resources/Icon.bmp"	//icon path
+};
+
+MAIN(config)
+#endif //KTX_LOAD_BENCHMARK
@@ -0,0 +1,151 @@
+#include "Defines.h"
+#ifdef NBODY_BENCHMARK
+#include "System.h"
+#include "NBody.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <omp.h>
+#include <random>
+
+//Interactions per second of each N-body solver from 2K to 64K particles, and Barnes-Hut on up
+//to 1M. Every solver starts from the same seeded particles and its first step is checked against
+//the scalar result, or the SIMD one above SCALAR_MAX_COUNT. For Barnes-Hut the figure is the
+//N^2 interactions the all pairs solvers would do in the same time.
+
+#define MIN_SECONDS 0.25
+#define SCALAR_MAX_COUNT 16384
+#define BRUTE_FORCE_MAX_COUNT 65536
+
+static const int particle_counts[] = { 2048, 4096, 8192, 16384, 32768, 65536, 131072, 262144, 524288, 1048576 };
+static const NBodySolver solvers[] = { NBodySolver::Scalar, NBodySolver::SIMD, NBodySolver::SIMD_OMP, NBodySolver::BarnesHut };
+
+#define COUNT_COUNT (sizeof(particle_counts) / sizeof(particle_counts[0]))
+#define SOLVER_COUNT (sizeof(solvers) / sizeof(solvers[0]))
+
+struct BenchResult {
+	f64 step_ms;
+	f64 interactions;	//Per second
+	f64 max_error;		//Largest velocity change difference to the reference solver, relative. -1 if unchecked
+};
+
+static void Seed(ParticleStore& store, int count)
+{
+	std::mt19937 engine(count);
+	std::uniform_real_distribution<float> position(-3.0f, 3.0f);
+	store.Resize(count);
+	for (int i = 0; i < count; ++i) {
+		store.m_px[i] = position(engine);
+		store.m_py[i] = position(engine);
+		store.m_pz[i] = position(engine);
+		store.m_vx[i] = store.m_px[i] * 0.001f;
+		store.m_vy[i] = store.m_py[i] * 0.001f;
+		store.m_vz[i] = store.m_pz[i] * 0.001f;
+	}
+}
+
+static f64 MaxError(const ParticleStore& reference, const ParticleStore& store)
+{
+	f64 error = 0.0;
+	for (usize i = 0; i < reference.Count(); ++i) {
+		f64 dx = reference.m_ax[i] - store.m_ax[i];
+		f64 dy = reference.m_ay[i] - store.m_ay[i];
+		f64 dz = reference.m_az[i] - store.m_az[i];
+		f64 magnitude = std::sqrt((f64)reference.m_ax[i] * reference.m_ax[i] + (f64)reference.m_ay[i] * reference.m_ay[i] + (f64)reference.m_az[i] * reference.m_az[i]);
+		f64 difference = std::sqrt(dx * dx + dy * dy + dz * dz);
+		error = std::max(error, difference / (magnitude + 1.0));
+	}
+	return error;
+}
+
+struct Application : public Program {
+	float m_clear_color[4];
+	u64 m_fps;
+	f64 m_time;
+
+	BenchResult m_results[COUNT_COUNT][SOLVER_COUNT];
+
+	Application()
+		:m_clear_color{ 0.1f, 0.1f, 0.1f, 1.0f },
+		m_fps(0),
+		m_time(0),
+		m_results{}
+	{}
+
+	void OnInit(Input& input, Audio& audio, Window& window) {
+		std::cout << "threads: " << omp_get_max_threads() << ", kernel: " << (CPU_HasAVX2() ? "AVX2" : "SSE") << std::endl;
+		std::cout << "particles, solver, step ms, interactions/s, max error" << std::endl;
+
+		for (int c = 0; c < COUNT_COUNT; ++c) {
+			const int count = particle_counts[c];
+			const bool checked = count <= BRUTE_FORCE_MAX_COUNT;
+			ParticleStore reference;
+			if (checked) {
+				Seed(reference, count);
+				NBody_Accumulate(reference, count <= SCALAR_MAX_COUNT ? NBodySolver::Scalar : NBodySolver::SIMD_OMP);
+			}
+
+			for (int s = 0; s < SOLVER_COUNT; ++s) {
+				BenchResult& result = m_results[c][s];
+				if (solvers[s] == NBodySolver::Scalar && count > SCALAR_MAX_COUNT) continue;
+				if (solvers[s] != NBodySolver::BarnesHut && count > BRUTE_FORCE_MAX_COUNT) continue;
+
+				ParticleStore store;
+				Seed(store, count);
+				NBody_Accumulate(store, solvers[s]);
+				result.max_error = checked ? MaxError(reference, store) : -1.0;
+
+				//Step until enough time has passed for a stable figure
+				int steps = 0;
+				f64 elapsed = 0.0;
+				auto start = std::chrono::steady_clock::now();
+				while (elapsed < MIN_SECONDS) {
+					NBody_Step(store, 1.0 / 60.0, solvers[s]);
+					steps++;
+					elapsed = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+				}
+				result.step_ms = elapsed * 1000.0 / steps;
+				result.interactions = (f64)count * count * steps / elapsed;
+
+				std::cout << count << ", " << NBody_SolverName(solvers[s]) << ", " << result.step_ms << ", " << result.interactions << ", " << result.max_error << std::endl;
+			}
+		}
+	}
+	void OnUpdate(Input& input, Audio& audio, Window& window, f64 dt) {
+		m_fps = window.GetFPS();
+		m_time = window.GetTime();
+	}
+	void OnDraw() {
+		glClearBufferfv(GL_COLOR, 0, m_clear_color);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+	void OnGui() {
+		ImGui::Begin("N-Body Benchmark");
+		ImGui::Text("FPS: %d", m_fps);
+		ImGui::Text("Kernel: %s, threads: %d", CPU_HasAVX2() ? "AVX2" : "SSE", omp_get_max_threads());
+		for (int c = 0; c < COUNT_COUNT; ++c) {
+			ImGui::Text("%d particles", particle_counts[c]);
+			for (int s = 0; s < SOLVER_COUNT; ++s) {
+				const BenchResult& result = m_results[c][s];
+				if (result.step_ms == 0.0) continue;
+				ImGui::Text("\t%-14s %9.3f ms  %.3g interactions/s  error %.2e", NBody_SolverName(solvers[s]), result.step_ms, result.interactions, result.max_error);
+			}
+		}
+		ImGui::End();
+	}
+};
+
+SystemConf config = {
+		1600,					//width
+		900,					//height
+		300,					//Position x
+		200,					//Position y
+		"N-Body Benchmark",		//window title
+		false,					//windowed fullscreen
+		false,					//vsync
+		144,					//framelimit
+		"resources/Icon.bmp"	//icon path
+};
+
+MAIN(config)
+#endif //NBODY_BENCHMARK
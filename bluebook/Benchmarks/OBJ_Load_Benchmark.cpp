@@ -0,0 +1,125 @@
+#include "Defines.h"
+#ifdef OBJ_LOAD_BENCHMARK
+#include "System.h"
+#include "MappedFile.h"
+#include "ObjParser.h"
+#include "OBJ_Loader.h"
+#include <chrono>
+
+//Compares objl::Loader against Parse_OBJ_Buffer, single threaded and with parallel chunks.
+//Times cover reading the file, so the mapped path pays for its page faults as well.
+
+#define ITERATIONS 10
+
+static const char* files[] = {
+	"./resources/rook2/rook.obj",
+	"./resources/basic_scene.obj",
+	"./resources/monkey.obj",
+	"./resources/smooth_sphere.obj",
+	"./resources/spot_light/spotlight.obj",
+};
+
+#define FILE_COUNT (sizeof(files) / sizeof(files[0]))
+
+struct BenchResult {
+	f64 objl_ms;
+	f64 serial_ms;
+	f64 parallel_ms;
+	usize objl_vertices;
+	usize vertices;
+	usize indices;
+};
+
+template <typename F>
+static f64 TimeLoad(F load)
+{
+	//Warm the page cache so every path is measured against the same disk state
+	load();
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < ITERATIONS; ++i) {
+		load();
+	}
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<f64, std::milli>(end - start).count() / ITERATIONS;
+}
+
+struct Application : public Program {
+	float m_clear_color[4];
+	u64 m_fps;
+	f64 m_time;
+
+	BenchResult m_results[FILE_COUNT];
+
+	Application()
+		:m_clear_color{ 0.1f, 0.1f, 0.1f, 1.0f },
+		m_fps(0),
+		m_time(0)
+	{}
+
+	void OnInit(Input& input, Audio& audio, Window& window) {
+		for (int i = 0; i < FILE_COUNT; ++i) {
+			BenchResult& result = m_results[i];
+			const char* filename = files[i];
+
+			result.objl_ms = TimeLoad([&]() {
+				objl::Loader loader;
+				loader.LoadFile(filename);
+				result.objl_vertices = loader.LoadedVertices.size();
+			});
+
+			ObjMeshData data;
+			result.serial_ms = TimeLoad([&]() {
+				MappedFile file(filename);
+				Parse_OBJ_Buffer((const char*)file.Data(), file.Size(), data, false);
+			});
+			result.parallel_ms = TimeLoad([&]() {
+				MappedFile file(filename);
+				Parse_OBJ_Buffer((const char*)file.Data(), file.Size(), data, true);
+			});
+			result.vertices = data.m_vertices.size() / 8;
+			result.indices = data.m_indices.size();
+		}
+
+		std::cout << "file, objl ms, serial ms, parallel ms, objl vertices, vertices, indices" << std::endl;
+		for (int i = 0; i < FILE_COUNT; ++i) {
+			const BenchResult& r = m_results[i];
+			std::cout << files[i] << ", " << r.objl_ms << ", " << r.serial_ms << ", " << r.parallel_ms << ", "
+				<< r.objl_vertices << ", " << r.vertices << ", " << r.indices << std::endl;
+		}
+	}
+	void OnUpdate(Input& input, Audio& audio, Window& window, f64 dt) {
+		m_fps = window.GetFPS();
+		m_time = window.GetTime();
+	}
+	void OnDraw() {
+		glClearBufferfv(GL_COLOR, 0, m_clear_color);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+	void OnGui() {
+		ImGui::Begin("OBJ Load Benchmark");
+		ImGui::Text("FPS: %d", m_fps);
+		for (int i = 0; i < FILE_COUNT; ++i) {
+			const BenchResult& r = m_results[i];
+			ImGui::Text("%s", files[i]);
+			ImGui::Text("\tobjl %.3f ms  serial %.3f ms  parallel %.3f ms", r.objl_ms, r.serial_ms, r.parallel_ms);
+			ImGui::Text("\tvertices objl %llu  indexed %llu  indices %llu", r.objl_vertices, r.vertices, r.indices);
+		}
+		ImGui::End();
+	}
+};
+
+SystemConf config = {
+		1600,					//width
+		900,					//height
+		300,					//Position x
+		200,					//Position y
+		"OBJ Load Benchmark",	//window title
+		false,					//windowed fullscreen
+		false,					//vsync
+		144,					//framelimit
+		"resources/Icon.bmp"	//icon path
+};
+
+MAIN(config)
+#endif //OBJ_LOAD_BENCHMARK
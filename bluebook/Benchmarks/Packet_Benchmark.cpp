@@ -0,0 +1,248 @@
+#include "Defines.h"
+#ifdef PACKET_BENCHMARK
+#include "System.h"
+#include "PacketStream.h"
+#include "glm/glm.hpp"
+#include <chrono>
+#include <cstring>
+#include <omp.h>
+#include <vector>
+
+//Draw call throughput of command packets recorded on 1 to N threads and replayed on the
+//context thread, against the same draws issued directly. Every draw binds its program, vertex
+//array, material and per draw data like a naive renderer would, the replay drops what's
+//already bound. Record and replay are CPU time, GPU time is what glFinish waits for after.
+
+#define FRAMES 16
+#define MATERIAL_COUNT 4
+#define MATERIAL_RUN 64
+#define MAX_DRAWS 100000
+
+static const int draw_counts[] = { 10000, 25000, 50000, 100000 };
+
+#define COUNT_COUNT (sizeof(draw_counts) / sizeof(draw_counts[0]))
+
+static const GLchar* vs_source = R"(
+#version 450 core
+
+#extension GL_ARB_shader_draw_parameters : require
+
+layout (binding = 0) uniform BLOCK
+{
+	vec4 vtx_color;
+};
+
+layout (std430, binding = 0) readonly buffer DRAWS
+{
+	vec4 draws[];
+};
+
+out vec4 vs_fs_color;
+
+void main()
+{
+	vec4 d = draws[gl_BaseInstanceARB];
+	vec2 corner = vec2((gl_VertexID & 2) - 1.0, (gl_VertexID & 1) * 2.0 - 1.0);
+	vs_fs_color = vtx_color;
+	gl_Position = vec4(d.xy + corner * d.z, 0.5, 1.0);
+}
+)";
+
+static const GLchar* fs_source = R"(
+#version 450 core
+
+layout (location = 0) out vec4 color;
+
+in vec4 vs_fs_color;
+
+void main()
+{
+	color = vs_fs_color;
+}
+)";
+
+static ShaderText shader_text[] = {
+	{GL_VERTEX_SHADER, vs_source, NULL},
+	{GL_FRAGMENT_SHADER, fs_source, NULL},
+	{GL_NONE, NULL, NULL}
+};
+
+struct BenchResult {
+	int threads;		//0 for direct GL calls
+	f64 record_ms;
+	f64 replay_ms;
+	f64 gpu_ms;
+	f64 draws;			//Per second of record and replay
+	u64 skipped;		//Binds the replay dropped per frame
+};
+
+struct Application : public Program {
+	float m_clear_color[4];
+	u64 m_fps;
+	f64 m_time;
+
+	GLuint m_vao;
+	GLuint m_program;
+	GLuint m_materials;
+	usize m_material_stride;
+	GLuint m_draw_buffer;
+
+	std::vector<PacketStream> m_streams;
+	std::vector<BenchResult> m_results[COUNT_COUNT];
+
+	Application()
+		:m_clear_color{ 0.1f, 0.1f, 0.1f, 1.0f },
+		m_fps(0),
+		m_time(0)
+	{}
+
+	void OnInit(Input& input, Audio& audio, Window& window) {
+		InitScene();
+
+		const int max_threads = omp_get_max_threads();
+		m_streams.resize(max_threads);
+
+		std::cout << "threads: " << max_threads << std::endl;
+		std::cout << "draws, recording threads, record ms, replay ms, gpu ms, draws/s, binds dropped" << std::endl;
+
+		for (int c = 0; c < COUNT_COUNT; ++c) {
+			const int count = draw_counts[c];
+			m_results[c].push_back(Measure(count, 0));
+			for (int threads = 1; threads <= max_threads; threads *= 2) {
+				m_results[c].push_back(Measure(count, threads));
+			}
+			if ((max_threads & (max_threads - 1)) != 0) m_results[c].push_back(Measure(count, max_threads));
+
+			for (const BenchResult& result : m_results[c]) {
+				std::cout << count << ", " << result.threads << ", " << result.record_ms << ", " << result.replay_ms << ", " << result.gpu_ms << ", " << result.draws << ", " << result.skipped << std::endl;
+			}
+		}
+	}
+	void OnUpdate(Input& input, Audio& audio, Window& window, f64 dt) {
+		m_fps = window.GetFPS();
+		m_time = window.GetTime();
+	}
+	void OnDraw() {
+		glClearBufferfv(GL_COLOR, 0, m_clear_color);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+	void OnGui() {
+		ImGui::Begin("Packet Benchmark");
+		ImGui::Text("FPS: %d", m_fps);
+		ImGui::Text("Threads: %d", omp_get_max_threads());
+		for (int c = 0; c < COUNT_COUNT; ++c) {
+			ImGui::Text("%d draws", draw_counts[c]);
+			for (const BenchResult& result : m_results[c]) {
+				if (result.threads == 0) ImGui::Text("\tdirect      ");
+				else ImGui::Text("\t%2d threads  ", result.threads);
+				ImGui::SameLine();
+				ImGui::Text("record %7.2f ms  replay %7.2f ms  gpu %7.2f ms  %.3g draws/s", result.record_ms, result.replay_ms, result.gpu_ms, result.draws);
+			}
+		}
+		ImGui::End();
+	}
+	void InitScene() {
+		m_program = LoadShaders(shader_text);
+		glGenVertexArrays(1, &m_vao);
+
+		GLint alignment;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		m_material_stride = ((sizeof(glm::vec4) + alignment - 1) / alignment) * alignment;
+		std::vector<u8> materials(m_material_stride * MATERIAL_COUNT);
+		for (int m = 0; m < MATERIAL_COUNT; ++m) {
+			glm::vec4 color((m & 1) ? 1.0f : 0.2f, (m & 2) ? 1.0f : 0.2f, 0.5f, 1.0f);
+			memcpy(&materials[m * m_material_stride], &color, sizeof(color));
+		}
+		glCreateBuffers(1, &m_materials);
+		glNamedBufferStorage(m_materials, materials.size(), materials.data(), 0);
+
+		//Positions don't change, the benchmark is about the calls
+		const int columns = 400;
+		const int rows = MAX_DRAWS / columns;
+		std::vector<glm::vec4> draws(MAX_DRAWS);
+		for (int i = 0; i < MAX_DRAWS; ++i) {
+			draws[i] = glm::vec4(((float)(i % columns) + 0.5f) / columns * 2.0f - 1.0f, ((float)(i / columns) + 0.5f) / rows * 2.0f - 1.0f, 0.5f / columns, 0.0f);
+		}
+		glCreateBuffers(1, &m_draw_buffer);
+		glNamedBufferStorage(m_draw_buffer, draws.size() * sizeof(glm::vec4), draws.data(), 0);
+	}
+	void RecordDraws(PacketStream& stream, int first, int last) {
+		for (int i = first; i < last; ++i) {
+			const int material = (i / MATERIAL_RUN) % MATERIAL_COUNT;
+			stream.BindProgram(m_program);
+			stream.BindVertexArray(m_vao);
+			stream.BindBufferRange(GL_UNIFORM_BUFFER, 0, m_materials, material * m_material_stride, sizeof(glm::vec4));
+			stream.BindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, m_draw_buffer, 0, MAX_DRAWS * sizeof(glm::vec4));
+			stream.DrawArrays(GL_TRIANGLE_STRIP, 0, 4, 1, i);
+		}
+	}
+	void DirectDraws(int count) {
+		for (int i = 0; i < count; ++i) {
+			const int material = (i / MATERIAL_RUN) % MATERIAL_COUNT;
+			glUseProgram(m_program);
+			glBindVertexArray(m_vao);
+			glBindBufferRange(GL_UNIFORM_BUFFER, 0, m_materials, material * m_material_stride, sizeof(glm::vec4));
+			glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, m_draw_buffer, 0, MAX_DRAWS * sizeof(glm::vec4));
+			glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, 1, i);
+		}
+	}
+	//threads 0 issues the draws directly
+	BenchResult Measure(int count, int threads) {
+		BenchResult result = {};
+		result.threads = threads;
+		PacketReplay replay;
+
+		glFinish();
+		for (int frame = 0; frame <= FRAMES; ++frame) {
+			glClearBufferfv(GL_COLOR, 0, m_clear_color);
+
+			auto start = std::chrono::steady_clock::now();
+			if (threads) {
+#pragma omp parallel num_threads(threads)
+				{
+					const int thread = omp_get_thread_num();
+					const int recording = omp_get_num_threads();
+					m_streams[thread].Reset();
+					RecordDraws(m_streams[thread], count * thread / recording, count * (thread + 1) / recording);
+				}
+			}
+			auto recorded = std::chrono::steady_clock::now();
+
+			if (threads) {
+				replay.Invalidate();
+				replay.m_stats = {};
+				replay.Execute(m_streams.data(), threads);
+			}
+			else {
+				DirectDraws(count);
+			}
+			auto replayed = std::chrono::steady_clock::now();
+			glFinish();
+			auto finished = std::chrono::steady_clock::now();
+
+			//Frame 0 warms up the streams' blocks and the driver
+			if (frame == 0) continue;
+			result.record_ms += std::chrono::duration<f64, std::milli>(recorded - start).count() / FRAMES;
+			result.replay_ms += std::chrono::duration<f64, std::milli>(replayed - recorded).count() / FRAMES;
+			result.gpu_ms += std::chrono::duration<f64, std::milli>(finished - replayed).count() / FRAMES;
+		}
+		result.draws = count / ((result.record_ms + result.replay_ms) * 0.001);
+		result.skipped = replay.m_stats.m_skipped;
+		return result;
+	}
+};
+
+SystemConf config = {
+		1600,					//width
+		900,					//height
+		300,					//Position x
+		200,					//Position y
+		"Packet Benchmark",		//window title
+		false,					//windowed fullscreen
+		false,					//vsync
+		144,					//framelimit
+		"resources/Icon.bmp"	//icon path
+};
+
+MAIN(config)
+#endif //PACKET_BENCHMARK
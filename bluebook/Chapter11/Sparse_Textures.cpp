@@ -1,32 +1,49 @@
 #include "Defines.h"
 #ifdef SPARSE_TEXTURES
 #include "System.h"
+#include "VirtualTexture.h"
+#include "Fractal.h"
 #include "Texture.h"
 #include "Model.h"
 #include "Mesh.h"
 
+#include <cmath>
+#include <string>
+
+//A ground plane far larger than VRAM would like, textured from a baked virtual texture. Only the
+//pages the feedback pass sees are streamed in, the pool holds a fraction of the whole.
+
 static const GLchar* default_vertex_shader_source = R"(
-#version 440 core
+layout (location = 4)
+uniform mat4 u_viewProj;
+
+layout (location = 5)
+uniform float u_extent;
 
 out vec2 uv;
 
 void main(void)
 {
-    vec2 pos = vec2(float(gl_VertexID & 2), float(gl_VertexID * 2 & 2));
-    uv = pos * 0.5;
-    gl_Position = vec4(pos - vec2(1.0), 0.0, 1.0);
+    vec2 pos = vec2(float(gl_VertexID & 1), float((gl_VertexID >> 1) & 1));
+    uv = pos;
+    gl_Position = u_viewProj * vec4((pos.x - 0.5) * u_extent, 0.0, (pos.y - 0.5) * u_extent, 1.0);
 }
 )";
 
-static const GLchar* default_fragment_shader_source = R"(
-#version 440 core
+static const GLchar* feedback_fragment_shader_source = R"(
+in vec2 uv;
 
-layout (binding = 0) uniform sampler2D sparseTex;
+layout (location = 0) out uint o_page;
 
-layout (binding = 0, std140) uniform TEXURE_BLOCK
+void main(void)
 {
-    uint foo;
-};
+    o_page = VT_Feedback(uv);
+}
+)";
+
+static const GLchar* default_fragment_shader_source = R"(
+layout (location = 6)
+uniform bool u_show_levels;
 
 in vec2 uv;
 
@@ -34,77 +51,64 @@ layout (location = 0) out vec4 o_color;
 
 void main(void)
 {
-    // o_color = vec4(0.3, 0.6, 0.0, 1.0);
-    o_color = textureLod(sparseTex, uv, 0.0);
+    o_color = VT_Sample(uv);
+    if (u_show_levels) {
+        float level = VT_ResidentLevel(uv);
+        vec3 tint = vec3(fract(level * 0.37), fract(level * 0.61 + 0.3), fract(level * 0.23 + 0.6));
+        o_color.rgb = mix(o_color.rgb, tint, 0.4);
+    }
 }
 )";
 
-static ShaderText default_shader_text[] = {
-	{GL_VERTEX_SHADER, default_vertex_shader_source, NULL},
-	{GL_FRAGMENT_SHADER, default_fragment_shader_source, NULL},
-	{GL_NONE, NULL, NULL}
-};
-
 void GetSparsePageInfo() {
 	GLint num_page_sizes;
 	GLint page_sizes_x[10];
 	GLint page_sizes_y[10];
 	GLint page_sizes_z[10];
 
-	glGetInternalformativ(GL_TEXTURE_2D, GL_RGBA8, GL_NUM_VIRTUAL_PAGE_SIZES_ARB, sizeof(GLuint), &num_page_sizes);
+	glGetInternalformativ(GL_TEXTURE_2D, GL_RGBA8, GL_NUM_VIRTUAL_PAGE_SIZES_ARB, 1, &num_page_sizes);
 
-	num_page_sizes = min(num_page_sizes, 10);
+	num_page_sizes = std::min(num_page_sizes, 10);
 
-	glGetInternalformativ(GL_TEXTURE_2D, GL_RGBA8, GL_VIRTUAL_PAGE_SIZE_X_ARB, num_page_sizes * sizeof(GLuint), page_sizes_x);
-	glGetInternalformativ(GL_TEXTURE_2D, GL_RGBA8, GL_VIRTUAL_PAGE_SIZE_Y_ARB, num_page_sizes * sizeof(GLuint), page_sizes_y);
-	glGetInternalformativ(GL_TEXTURE_2D, GL_RGBA8, GL_VIRTUAL_PAGE_SIZE_Z_ARB, num_page_sizes * sizeof(GLuint), page_sizes_z);
+	glGetInternalformativ(GL_TEXTURE_2D, GL_RGBA8, GL_VIRTUAL_PAGE_SIZE_X_ARB, num_page_sizes, page_sizes_x);
+	glGetInternalformativ(GL_TEXTURE_2D, GL_RGBA8, GL_VIRTUAL_PAGE_SIZE_Y_ARB, num_page_sizes, page_sizes_y);
+	glGetInternalformativ(GL_TEXTURE_2D, GL_RGBA8, GL_VIRTUAL_PAGE_SIZE_Z_ARB, num_page_sizes, page_sizes_z);
 
 	for (int i = 0; i < num_page_sizes; ++i) {
 		std::cout << i << ". X: " << page_sizes_x[i] << " Y: " << page_sizes_y[i] << " Z: " << page_sizes_z[i] << std::endl;
 	}
 }
 
-const unsigned char bit_reversal_table[256] =
-{
-	0x00, 0x80, 0x40, 0xc0, 0x20, 0xa0, 0x60, 0xe0,
-	0x10, 0x90, 0x50, 0xd0, 0x30, 0xb0, 0x70, 0xf0,
-	0x08, 0x88, 0x48, 0xc8, 0x28, 0xa8, 0x68, 0xe8,
-	0x18, 0x98, 0x58, 0xd8, 0x38, 0xb8, 0x78, 0xf8,
-	0x04, 0x84, 0x44, 0xc4, 0x24, 0xa4, 0x64, 0xe4,
-	0x14, 0x94, 0x54, 0xd4, 0x34, 0xb4, 0x74, 0xf4,
-	0x0c, 0x8c, 0x4c, 0xcc, 0x2c, 0xac, 0x6c, 0xec,
-	0x1c, 0x9c, 0x5c, 0xdc, 0x3c, 0xbc, 0x7c, 0xfc,
-	0x02, 0x82, 0x42, 0xc2, 0x22, 0xa2, 0x62, 0xe2,
-	0x12, 0x92, 0x52, 0xd2, 0x32, 0xb2, 0x72, 0xf2,
-	0x0a, 0x8a, 0x4a, 0xca, 0x2a, 0xaa, 0x6a, 0xea,
-	0x1a, 0x9a, 0x5a, 0xda, 0x3a, 0xba, 0x7a, 0xfa,
-	0x06, 0x86, 0x46, 0xc6, 0x26, 0xa6, 0x66, 0xe6,
-	0x16, 0x96, 0x56, 0xd6, 0x36, 0xb6, 0x76, 0xf6,
-	0x0e, 0x8e, 0x4e, 0xce, 0x2e, 0xae, 0x6e, 0xee,
-	0x1e, 0x9e, 0x5e, 0xde, 0x3e, 0xbe, 0x7e, 0xfe,
-	0x01, 0x81, 0x41, 0xc1, 0x21, 0xa1, 0x61, 0xe1,
-	0x11, 0x91, 0x51, 0xd1, 0x31, 0xb1, 0x71, 0xf1,
-	0x09, 0x89, 0x49, 0xc9, 0x29, 0xa9, 0x69, 0xe9,
-	0x19, 0x99, 0x59, 0xd9, 0x39, 0xb9, 0x79, 0xf9,
-	0x05, 0x85, 0x45, 0xc5, 0x25, 0xa5, 0x65, 0xe5,
-	0x15, 0x95, 0x55, 0xd5, 0x35, 0xb5, 0x75, 0xf5,
-	0x0d, 0x8d, 0x4d, 0xcd, 0x2d, 0xad, 0x6d, 0xed,
-	0x1d, 0x9d, 0x5d, 0xdd, 0x3d, 0xbd, 0x7d, 0xfd,
-	0x03, 0x83, 0x43, 0xc3, 0x23, 0xa3, 0x63, 0xe3,
-	0x13, 0x93, 0x53, 0xd3, 0x33, 0xb3, 0x73, 0xf3,
-	0x0b, 0x8b, 0x4b, 0xcb, 0x2b, 0xab, 0x6b, 0xeb,
-	0x1b, 0x9b, 0x5b, 0xdb, 0x3b, 0xbb, 0x7b, 0xfb,
-	0x07, 0x87, 0x47, 0xc7, 0x27, 0xa7, 0x67, 0xe7,
-	0x17, 0x97, 0x57, 0xd7, 0x37, 0xb7, 0x77, 0xf7,
-	0x0f, 0x8f, 0x4f, 0xcf, 0x2f, 0xaf, 0x6f, 0xef,
-	0x1f, 0x9f, 0x5f, 0xdf, 0x3f, 0xbf, 0x7f, 0xff
-};
+#define VT_FILENAME "./resources/sparse_julia.svt"
+#define TEX_SIZE 4096
+#define POOL_PAGES 256
+#define FEEDBACK_SCALE 8
+#define PLANE_EXTENT 400.0f
 
-enum
+//Escape counts of one Julia set, colored and baked the first time the sample runs
+static bool BakeJulia()
 {
-	PAGE_SIZE = 128,
-	TEX_SIZE = 16 * PAGE_SIZE
-};
+	std::vector<unsigned char> counts((size_t)TEX_SIZE * TEX_SIZE);
+	FractalRenderer renderer;
+	renderer.Init(TEX_SIZE, TEX_SIZE);
+	FractalParams params;
+	params.m_cx = -0.8f;
+	params.m_cy = 0.156f;
+	params.m_offset_x = 0.0f;
+	params.m_offset_y = 0.0f;
+	params.m_zoom = 3.0f;
+	renderer.Render(params, counts.data());
+
+	std::vector<u8> rgba(counts.size() * 4);
+	for (size_t i = 0; i < counts.size(); ++i) {
+		const float t = counts[i] / 255.0f;
+		rgba[i * 4 + 0] = (u8)(255.0f * (0.5f + 0.5f * cosf(6.2831853f * (t * 3.0f + 0.0f))));
+		rgba[i * 4 + 1] = (u8)(255.0f * (0.5f + 0.5f * cosf(6.2831853f * (t * 3.0f + 0.1f))));
+		rgba[i * 4 + 2] = (u8)(255.0f * (0.5f + 0.5f * cosf(6.2831853f * (t * 3.0f + 0.2f))));
+		rgba[i * 4 + 3] = 255;
+	}
+	return VirtualTexture::Bake(VT_FILENAME, rgba.data(), TEX_SIZE, TEX_SIZE, true);
+}
 
 struct Application : public Program {
 	float m_clear_color[4];
@@ -112,11 +116,17 @@ struct Application : public Program {
 	f64 m_time;
 
 	GLuint m_vao;
-	GLuint m_program, m_compute_shader;
+	GLuint m_program, m_feedback_program;
 
-	GLuint m_texture;
+	VirtualTexture m_vt;
+	WindowXY m_resolution;
+	bool m_force_atlas = false;
+	bool m_show_levels = false;
 
-	unsigned char* texture_data;
+	SB::Camera m_camera;
+	bool m_input_mode = false;
+	bool m_fly = true;
+	glm::mat4 m_view_proj;
 
 	Application()
 		:m_clear_color{ 0.1f, 0.1f, 0.1f, 1.0f },
@@ -125,56 +135,87 @@ struct Application : public Program {
 	{}
 
 	void OnInit(Input& input, Audio& audio, Window& window) {
-		FILE* f;
 		GetSparsePageInfo();
 
-		m_program = LoadShaders(default_shader_text);
-
-		glGenTextures(1, &m_texture);
-		glBindTexture(GL_TEXTURE_2D, m_texture);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SPARSE_ARB, GL_TRUE);
-		glTexStorage2D(GL_TEXTURE_2D, 11, GL_RGBA8, TEX_SIZE, TEX_SIZE);
-
+		const std::string vertex = std::string("#version 450 core\n") + default_vertex_shader_source;
+		const std::string fragment = std::string("#version 450 core\n") + virtual_texture_glsl + default_fragment_shader_source;
+		const std::string feedback = std::string("#version 450 core\n") + virtual_texture_glsl + feedback_fragment_shader_source;
+		ShaderText shader_text[] = {
+			{GL_VERTEX_SHADER, vertex.c_str(), NULL},
+			{GL_FRAGMENT_SHADER, fragment.c_str(), NULL},
+			{GL_NONE, NULL, NULL}
+		};
+		ShaderText feedback_shader_text[] = {
+			{GL_VERTEX_SHADER, vertex.c_str(), NULL},
+			{GL_FRAGMENT_SHADER, feedback.c_str(), NULL},
+			{GL_NONE, NULL, NULL}
+		};
+		m_program = LoadShaders(shader_text);
+		m_feedback_program = LoadShaders(feedback_shader_text);
+
+		m_camera = SB::Camera("Camera", glm::vec3(0.0f, 4.0f, 0.0f), glm::vec3(0.0f, 0.0f, 10.0f), SB::CameraType::Perspective, 16.0 / 9.0, 0.9, 0.01, 1000.0);
 		glGenVertexArrays(1, &m_vao);
 
-		texture_data = new unsigned char[PAGE_SIZE * PAGE_SIZE * 4];
-		f = fopen("./resources/smiley.raw", "rb");
-		fread(texture_data, 128 * 128 * 4, 1, f);
-		fclose(f);
+		m_resolution = window.GetWindowDimensions();
+		if (!VirtualTexture::IsBaked(VT_FILENAME) && !BakeJulia()) {
+			std::cerr << "Could not bake " << VT_FILENAME << std::endl;
+			return;
+		}
+		InitVirtualTexture();
 	}
 	void OnUpdate(Input& input, Audio& audio, Window& window, f64 dt) {
 		m_fps = window.GetFPS();
 		m_time = window.GetTime();
-	}
-	void OnDraw() {
-		float f = (float)m_time;
 
-		static const GLfloat one = 1.0f;
-		glClearBufferfv(GL_COLOR, 0, m_clear_color);
-		glClearBufferfv(GL_DEPTH, 0, &one);
+		if (m_input_mode) {
+			m_camera.OnUpdate(input, 3.0f, 0.2f, dt);
+		}
 
-		glBindVertexArray(m_vao);
-		glUseProgram(m_program);
+		//Implement Camera Movement Functions
+		if (input.Pressed(GLFW_KEY_LEFT_CONTROL)) {
+			m_input_mode = !m_input_mode;
+			m_fly = false;
+			input.SetRawMouseMode(window.GetHandle(), m_input_mode);
+		}
 
-		glBindTexture(GL_TEXTURE_2D, m_texture);
+		if (m_fly) {
+			//Low and fast over the plane, dipping so the distant pages change level as well
+			const float t = (float)m_time * 0.05f;
+			const glm::vec3 eye = glm::vec3(sinf(t) * PLANE_EXTENT * 0.35f, 3.0f + 2.0f * sinf(t * 3.0f), cosf(t * 0.7f) * PLANE_EXTENT * 0.35f);
+			const glm::vec3 ahead = glm::vec3(cosf(t), -0.25f, -0.7f * sinf(t * 0.7f));
+			m_view_proj = glm::perspective(0.9f, 16.0f / 9.0f, 0.1f, 2000.0f) * glm::lookAt(eye, eye + ahead, glm::vec3(0.0f, 1.0f, 0.0f));
+		}
+		else {
+			m_view_proj = m_camera.ViewProj();
+		}
 
-		static int t = 0;
-		int r = (t & 0x100);
-		int tile = bit_reversal_table[(t & 0xFF)];
+		if (m_vt.IsValid()) m_vt.Update();
+	}
+	void OnDraw() {
+		static const GLfloat one = 1.0f;
 
-		int x = (tile >> 0) & 0xF;
-		int y = (tile >> 4) & 0xF;
+		glEnable(GL_DEPTH_TEST);
+		glDepthFunc(GL_LEQUAL);
+		glBindVertexArray(m_vao);
 
-		if (r == 0) {
-			glTexPageCommitmentARB(GL_TEXTURE_2D, 0, x * PAGE_SIZE, y * PAGE_SIZE, 0, PAGE_SIZE, PAGE_SIZE, 1, GL_TRUE);
-			glTexSubImage2D(GL_TEXTURE_2D, 0, x * PAGE_SIZE, y * PAGE_SIZE, PAGE_SIZE, PAGE_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, texture_data);
-		}
-		else {
-			glTexPageCommitmentARB(GL_TEXTURE_2D, 0, x * PAGE_SIZE, y * PAGE_SIZE, 0, PAGE_SIZE, PAGE_SIZE, 1, GL_FALSE);
+		if (m_vt.IsValid()) {
+			m_vt.BeginFeedback();
+			glUseProgram(m_feedback_program);
+			glUniformMatrix4fv(4, 1, GL_FALSE, glm::value_ptr(m_view_proj));
+			glUniform1f(5, PLANE_EXTENT);
+			glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+			m_vt.EndFeedback();
 		}
-		t += 17;
 
+		glClearBufferfv(GL_COLOR, 0, m_clear_color);
+		glClearBufferfv(GL_DEPTH, 0, &one);
+		if (!m_vt.IsValid()) return;
+
+		m_vt.Bind();
+		glUseProgram(m_program);
+		glUniformMatrix4fv(4, 1, GL_FALSE, glm::value_ptr(m_view_proj));
+		glUniform1f(5, PLANE_EXTENT);
+		glUniform1i(6, m_show_levels);
 		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 	}
 	void OnGui() {
@@ -182,8 +223,32 @@ struct Application : public Program {
 		ImGui::Text("FPS: %d", m_fps);
 		ImGui::Text("Time: %f", m_time);
 		ImGui::ColorEdit4("Clear Color", m_clear_color);
+		ImGui::Checkbox("Fly through", &m_fly);
+		if (ImGui::Checkbox("Force atlas", &m_force_atlas)) {
+			InitVirtualTexture();
+		}
+		if (!m_vt.IsValid()) {
+			ImGui::Text("Virtual texture unavailable, see the console");
+			ImGui::End();
+			return;
+		}
+		ImGui::Text("Pool: %s", m_vt.IsSparse() ? "sparse texture" : "atlas");
+		ImGui::SliderFloat("LOD bias", &m_vt.m_lod_bias, -2.0f, 4.0f);
+		ImGui::Checkbox("Show levels", &m_show_levels);
+
+		const VirtualTextureStats& stats = m_vt.m_stats;
+		ImGui::Text("Working set: %u pages, %u missing", stats.m_requested, stats.m_missing);
+		ImGui::Text("Resident: %u / %u, %u loading", stats.m_resident, stats.m_capacity, stats.m_in_flight);
+		ImGui::Text("Loaded %llu, evicted %llu, dropped %llu", stats.m_loaded, stats.m_evicted, stats.m_dropped);
+		ImGui::Text("Feedback latency: %u frames", stats.m_feedback_latency);
 		ImGui::End();
 	}
+
+	void InitVirtualTexture() {
+		if (!m_vt.Init(VT_FILENAME, POOL_PAGES, m_resolution.width, m_resolution.height, FEEDBACK_SCALE, m_force_atlas)) {
+			std::cerr << "Could not load " << VT_FILENAME << ", the ground plane isn't drawn" << std::endl;
+		}
+	}
 };
 
 SystemConf config = {
@@ -199,4 +264,4 @@ SystemConf config = {
 };
 
 MAIN(config)
-#endif //SPARSE_TEXTURES
\ No newline at end of file
+#endif //SPARSE_TEXTURES
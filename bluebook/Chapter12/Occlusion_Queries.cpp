@@ -1,13 +1,18 @@
 #include "Defines.h"
 #ifdef OCCLUSION_QUERIES
 #include "System.h"
+#include "OcclusionCuller.h"
 #include "Texture.h"
 #include "Model.h"
 #include "Mesh.h"
+#include <chrono>
+#include <cstring>
 
-static const GLchar* occlusion_vertex_shader_source = R"(
+static const GLchar* default_vertex_shader_source = R"(
 #version 450 core
 
+#extension GL_ARB_shader_draw_parameters : require
+
 layout (location = 0)
 in vec3 position;
 layout (location = 1)
@@ -18,85 +23,31 @@ in vec2 uv;
 layout (location = 4)
 uniform mat4 u_viewProj;
 
-layout (location = 5)
-uniform vec3 u_model;
-
-layout (location = 6)
-uniform vec3 u_color;
-
-
-out VS_OUT
-{
-	vec3 normal;
-	vec2 uv;
-	vec3 color;
-} vs_out;
-
-void main(void)
+//x, z and height of every building
+layout (std430, binding = 0) readonly buffer Objects
 {
-    gl_Position = u_viewProj * vec4(position + u_model, 1.0);
-	vs_out.normal = normal;
-	vs_out.uv = uv;
-	vs_out.color = u_color;
-}
-)";
-
-static const GLchar* occlusion_fragment_shader_source = R"(
-#version 450 core
-
-in VS_OUT
-{
-	vec3 normal;
-	vec2 uv;
-	vec3 color;
-} fs_in;
-
-out vec4 color;
-
-void main()
-{
-	color = vec4(fs_in.color, 1.0);
-}
-)";
-
-static ShaderText occlusion_shader_text[] = {
-	{GL_VERTEX_SHADER, occlusion_vertex_shader_source, NULL},
-	{GL_FRAGMENT_SHADER, occlusion_fragment_shader_source, NULL},
-	{GL_NONE, NULL, NULL}
+	vec4 objects[];
 };
 
-static const GLchar* default_vertex_shader_source = R"(
-#version 450 core
-
-layout (location = 0)
-in vec3 position;
-layout (location = 1)
-in vec3 normal;
-layout (location = 2)
-in vec2 uv;
-
-layout (location = 4)
-uniform mat4 u_viewProj;
-
-layout (location = 5)
-uniform uint u_index;
-
-layout (binding = 0) uniform DefaultUniform
+//Which objects the instances draw
+layout (std430, binding = 1) readonly buffer Indices
 {
-	vec4 cube_pos[64];
+	uint indices[];
 };
 
 out VS_OUT
 {
 	vec3 normal;
-	vec2 uv;
+	vec3 color;
 } vs_out;
 
 void main(void)
 {
-    gl_Position = u_viewProj * (cube_pos[u_index] + vec4(position, 1.0));
+	vec4 o = objects[indices[gl_BaseInstanceARB + gl_InstanceID]];
+	vec3 p = vec3(position.x + o.x, (position.y + 1.0) * o.z, position.z + o.y);
+	gl_Position = u_viewProj * vec4(p, 1.0);
 	vs_out.normal = normal;
-	vs_out.uv = uv;
+	vs_out.color = mix(vec3(0.3, 0.35, 0.4), vec3(0.9, 0.8, 0.6), o.z / 8.0);
 }
 )";
 
@@ -106,14 +57,15 @@ static const GLchar* default_fragment_shader_source = R"(
 in VS_OUT
 {
 	vec3 normal;
-	vec2 uv;
+	vec3 color;
 } fs_in;
 
 out vec4 color;
 
 void main()
 {
-	color = vec4(fs_in.uv.x, fs_in.uv.y, 0.0, 1.0);
+	float light = max(dot(normalize(fs_in.normal), normalize(vec3(0.4, 1.0, 0.2))), 0.0) * 0.7 + 0.3;
+	color = vec4(fs_in.color * light, 1.0);
 }
 )";
 
@@ -123,27 +75,62 @@ static ShaderText default_shader_text[] = {
 	{GL_NONE, NULL, NULL}
 };
 
-#define NUM_CUBES 64
+//Buildings on a grid with streets between them, seen from street level most hide the rest
+#define BUILDING_SPACING 3.0f
+#define MAX_BUILDINGS (256 * 256)
+#define COMPARE_FRAMES 120
+
+static const int grid_sides[] = { 8, 100, 150, 200, 256 };
+static const char* grid_names[] = { "64", "10000", "22500", "40000", "65536" };
+
+enum CullMode {
+	CULL_NONE,			//Draw every building
+	CULL_SYNCHRONOUS,	//Query every building, glFinish, read every result, conditional render
+	CULL_LATENT,		//OcclusionCuller, last available results, never waits
+	CULL_MODE_COUNT
+};
+static const char* cull_mode_names[] = { "None", "Synchronous queries", "Previous frame results" };
+
+struct CompareResult {
+	f64 frame_ms;
+	f64 draw_ms;		//CPU time in OnDraw
+	f64 gpu_ms;			//OnDraw scope of the GPU profiler
+};
 
 struct Application : public Program {
 	float m_clear_color[4];
 	u64 m_fps;
 	f64 m_time;
 
-	GLuint m_program, m_occlusion_program;
-	GLuint m_ubo;
-
-	GLuint m_queries[NUM_CUBES];
+	GLuint m_program;
+	GLuint m_object_buffer = 0;
+	GLuint m_identity_buffer;		//indices[i] = i, for drawing without culling
+	FrameRingBuffer m_visible_indices;
 
 	ObjMesh m_cube;
-	glm::vec4 m_cube_positions[NUM_CUBES];
+	std::vector<GLuint> m_queries;	//One per building for CULL_SYNCHRONOUS
+	OcclusionCuller m_culler;
 
 	SB::Camera m_camera;
 	bool m_input_mode = false;
+	bool m_fly = true;
+	glm::mat4 m_view_proj;
+	glm::vec3 m_eye;
 
 	Random m_random;
 
-	int m_rendered_cube_count;
+	int m_grid_index = 3;
+	int m_building_count = 0;
+	int m_mode = CULL_LATENT;
+	int m_rendered_cube_count = 0;
+	f64 m_draw_ms = 0.0;
+
+	//Compare runs every mode for COMPARE_FRAMES frames on the fly through
+	int m_compare_frame = -1;
+	f64 m_compare_start = 0.0;
+	CompareResult m_compare[CULL_MODE_COUNT] = {};
+	f64 m_compare_draw_ms = 0.0;
+	f64 m_compare_gpu_ms = 0.0;
 
 	Application()
 		:m_clear_color{ 0.1f, 0.1f, 0.1f, 1.0f },
@@ -153,24 +140,18 @@ struct Application : public Program {
 
 	void OnInit(Input& input, Audio& audio, Window& window) {
 		m_program = LoadShaders(default_shader_text);
-		m_occlusion_program = LoadShaders(occlusion_shader_text);
 		m_camera = SB::Camera("Camera", glm::vec3(0.0f, 2.0f, -12.0f), glm::vec3(0.0f), SB::CameraType::Perspective, 16.0 / 9.0, 0.9, 0.01, 1000.0);
 		m_cube.Load_OBJ("./resources/cube.obj");
 		m_random.Init();
+		m_culler.Init();
 
-		glGenQueries(NUM_CUBES, m_queries);
-
-		glGenBuffers(1, &m_ubo);
-		glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
-		glBufferData(GL_UNIFORM_BUFFER, sizeof(m_cube_positions), nullptr, GL_STATIC_DRAW);
-		
-		glm::vec4* positions = (glm::vec4*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, sizeof(m_cube_positions), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
-		for (int i = 0; i < NUM_CUBES; ++i) {
-			positions[i] = glm::vec4(m_random.Float() * 25.0f, m_random.Float() * 25.0f, m_random.Float() * 25.0f, 0.0f);
-		}
+		std::vector<GLuint> identity(MAX_BUILDINGS);
+		for (GLuint i = 0; i < MAX_BUILDINGS; ++i) identity[i] = i;
+		glCreateBuffers(1, &m_identity_buffer);
+		glNamedBufferStorage(m_identity_buffer, identity.size() * sizeof(GLuint), identity.data(), 0);
+		m_visible_indices.Init(MAX_BUILDINGS * sizeof(GLuint));
 
-		glUnmapBuffer(GL_UNIFORM_BUFFER);
-		glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+		BuildCity(grid_sides[m_grid_index]);
 	}
 	void OnUpdate(Input& input, Audio& audio, Window& window, f64 dt) {
 		m_fps = window.GetFPS();
@@ -183,72 +164,179 @@ struct Application : public Program {
 		//Implement Camera Movement Functions
 		if (input.Pressed(GLFW_KEY_LEFT_CONTROL)) {
 			m_input_mode = !m_input_mode;
+			m_fly = false;
 			input.SetRawMouseMode(window.GetHandle(), m_input_mode);
 		}
+
+		if (m_fly || m_compare_frame >= 0) {
+			//Down the street between the first two columns and back
+			const float half = grid_sides[m_grid_index] * BUILDING_SPACING * 0.5f;
+			const f64 t = m_compare_frame >= 0 ? m_compare_frame / (f64)COMPARE_FRAMES : m_time * 0.02;
+			const float z = -half + (half * 2.0f) * (float)(0.5 - 0.5 * cos(t * 6.2831853));
+			m_eye = glm::vec3(BUILDING_SPACING * 0.5f, 2.0f, z);
+			const glm::vec3 target = m_eye + glm::vec3(0.3f * (float)sin(t * 12.0), -0.1f, 1.0f);
+			m_view_proj = glm::perspective(0.9f, 16.0f / 9.0f, 0.1f, 2000.0f) * glm::lookAt(m_eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+		}
+		else {
+			m_eye = m_camera.Eye();
+			m_view_proj = m_camera.ViewProj();
+		}
 	}
 	void OnDraw() {
+		auto start = std::chrono::steady_clock::now();
+
 		static const GLfloat one = 1.0f;
 		glClearBufferfv(GL_COLOR, 0, m_clear_color);
 		glClearBufferfv(GL_DEPTH, 0, &one);
 
-		//First render a cube to the scene that will occlude the other cubes
-		RenderOcclusionCube();
+		glEnable(GL_DEPTH_TEST);
+		glDepthFunc(GL_LEQUAL);
+		glUseProgram(m_program);
+		glUniformMatrix4fv(4, 1, GL_FALSE, glm::value_ptr(m_view_proj));
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_object_buffer);
+		glBindVertexArray(m_cube.m_vao);
+
+		switch (m_mode) {
+		case CULL_NONE:
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_identity_buffer);
+			glDrawElementsInstanced(GL_TRIANGLES, m_cube.m_count, GL_UNSIGNED_INT, nullptr, m_building_count);
+			m_rendered_cube_count = m_building_count;
+			break;
+		case CULL_SYNCHRONOUS:
+			RenderSynchronous();
+			break;
+		case CULL_LATENT:
+			RenderLatent();
+			break;
+		}
+
+		m_draw_ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+		StepCompare();
+	}
+	void OnGui() {
+		ImGui::Begin("User Defined Settings");
+		ImGui::Text("FPS: %d", m_fps);
+		ImGui::Text("Time: %f", m_time);
+		ImGui::ColorEdit4("Clear Color", m_clear_color);
+		ImGui::Combo("Culling", &m_mode, cull_mode_names, IM_ARRAYSIZE(cull_mode_names));
+		if (ImGui::Combo("Buildings", &m_grid_index, grid_names, IM_ARRAYSIZE(grid_names))) {
+			BuildCity(grid_sides[m_grid_index]);
+		}
+		ImGui::Checkbox("Fly through", &m_fly);
+		ImGui::Text("Rendered Cubes: %d / %d", m_rendered_cube_count, m_building_count);
+		ImGui::Text("OnDraw CPU: %.3f ms", m_draw_ms);
+		if (m_mode == CULL_LATENT) {
+			const OcclusionStats& stats = m_culler.m_stats;
+			ImGui::Text("Queries: %u issued, %u still pending", stats.m_queries, stats.m_pending);
+			ImGui::Text("Visible groups: %u", stats.m_visible_groups);
+		}
+
+		ImGui::Separator();
+		if (m_compare_frame < 0 && ImGui::Button("Compare modes")) {
+			m_compare_frame = 0;
+			m_mode = 0;
+			m_compare_start = glfwGetTime();
+			m_compare_draw_ms = m_compare_gpu_ms = 0.0;
+		}
+		if (m_compare_frame >= 0) ImGui::Text("Running %s...", cull_mode_names[m_mode]);
+		for (int mode = 0; mode < CULL_MODE_COUNT; ++mode) {
+			const CompareResult& result = m_compare[mode];
+			if (result.frame_ms == 0.0) continue;
+			ImGui::Text("%-24s frame %7.3f ms  draw %7.3f ms  gpu %7.3f ms", cull_mode_names[mode], result.frame_ms, result.draw_ms, result.gpu_ms);
+		}
+		ImGui::End();
+
+		GpuProfiler::OnGui();
+	}
+	void BuildCity(int side) {
+		m_building_count = side * side;
+
+		std::vector<glm::vec4> objects(m_building_count);
+		std::vector<OcclusionBox> boxes(m_building_count);
+		const float half = side * BUILDING_SPACING * 0.5f;
+		for (int i = 0; i < m_building_count; ++i) {
+			const float x = (i % side) * BUILDING_SPACING - half;
+			const float z = (i / side) * BUILDING_SPACING - half;
+			const float height = 1.0f + m_random.Float() * 7.0f;
+			objects[i] = glm::vec4(x, z, height, 0.0f);
+			boxes[i] = { glm::vec3(x - 1.0f, 0.0f, z - 1.0f), glm::vec3(x + 1.0f, height * 2.0f, z + 1.0f) };
+		}
+
+		if (m_object_buffer) glDeleteBuffers(1, &m_object_buffer);
+		glCreateBuffers(1, &m_object_buffer);
+		glNamedBufferStorage(m_object_buffer, objects.size() * sizeof(glm::vec4), objects.data(), 0);
+
+		if (!m_queries.empty()) glDeleteQueries((GLsizei)m_queries.size(), m_queries.data());
+		m_queries.resize(m_building_count);
+		glGenQueries(m_building_count, m_queries.data());
+
+		m_culler.Build(boxes.data(), m_building_count);
+	}
+	//Every building is drawn depth only inside a query, then the pipeline is drained so all the
+	//results can be read before the color pass
+	void RenderSynchronous() {
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_identity_buffer);
 
-		//Disable color and depth rendering, render our "simple" version of objects and query if they pass
-		//depth and stencil sampling
 		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-		glDepthMask(GL_FALSE);
-		for (unsigned int i = 0; i < NUM_CUBES; ++i) {
+		for (int i = 0; i < m_building_count; ++i) {
 			glBeginQuery(GL_SAMPLES_PASSED, m_queries[i]);
-			RenderBasicScene(i);
+			glDrawElementsInstancedBaseInstance(GL_TRIANGLES, m_cube.m_count, GL_UNSIGNED_INT, nullptr, 1, i);
 			glEndQuery(GL_SAMPLES_PASSED);
 		}
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 
-		//call this so our queries are actually availabe for this example, avoid using glFinish normally
 		glFlush();
 		glFinish();
 
-		//Turn on color and depth rendering, Begin condition rendering based on the result of out previous queries
-		//Our render complex scene function will only make opengl calls if the related query is true
-		//We get the result again in RenderComplexScene so we can count how many cubes passed the query and were rendered
 		m_rendered_cube_count = 0;
-		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-		glDepthMask(GL_TRUE);
-		for (unsigned int i = 0; i < NUM_CUBES; ++i) {
+		for (int i = 0; i < m_building_count; ++i) {
 			GLuint result;
 			glGetQueryObjectuiv(m_queries[i], GL_QUERY_RESULT, &result);
 			if (result) m_rendered_cube_count++;
 			glBeginConditionalRender(m_queries[i], GL_QUERY_NO_WAIT);
-			RenderComplexScene(i);
+			glDrawElementsInstancedBaseInstance(GL_TRIANGLES, m_cube.m_count, GL_UNSIGNED_INT, nullptr, 1, i);
 			glEndConditionalRender();
 		}
 	}
-	void OnGui() {
-		ImGui::Begin("User Defined Settings");
-		ImGui::Text("FPS: %d", m_fps);
-		ImGui::Text("Time: %f", m_time);
-		ImGui::ColorEdit4("Clear Color", m_clear_color);
-		ImGui::Text("Rendered Cubes: %d", m_rendered_cube_count);
-		ImGui::End();
-	}
-	void RenderOcclusionCube() {
-		glEnable(GL_DEPTH_TEST);
-		glUseProgram(m_occlusion_program);
-		glUniformMatrix4fv(4, 1, GL_FALSE, glm::value_ptr(m_camera.ViewProj()));
-		glUniform3fv(5, 1, glm::value_ptr(glm::vec3(0.0f, 2.0f, -8.0f)));
-		glUniform3fv(6, 1, glm::value_ptr(glm::vec3(0.0f)));
-		m_cube.OnDraw();
-	}
-	void RenderBasicScene(unsigned int n) {
-		glEnable(GL_DEPTH_TEST);
-		glUseProgram(m_program);
-		glUniformMatrix4fv(4, 1, GL_FALSE, glm::value_ptr(m_camera.ViewProj()));
-		glUniform1ui(5, n);
-		glBindBufferBase(GL_UNIFORM_BUFFER, 0, m_ubo);
-		m_cube.OnDraw();
+	//Draws what the culler last saw as visible in one instanced draw, then queries against it
+	void RenderLatent() {
+		m_culler.Update(m_eye);
+		const std::vector<u32>& visible = m_culler.Visible();
+		m_rendered_cube_count = (int)visible.size();
+
+		m_visible_indices.BeginFrame();
+		if (!visible.empty()) {
+			usize offset;
+			u32* indices = m_visible_indices.Allocate<u32>(visible.size(), &offset);
+			memcpy(indices, visible.data(), visible.size() * sizeof(u32));
+			m_visible_indices.BindRange(GL_SHADER_STORAGE_BUFFER, 1, offset, visible.size() * sizeof(u32));
+			glDrawElementsInstanced(GL_TRIANGLES, m_cube.m_count, GL_UNSIGNED_INT, nullptr, (GLsizei)visible.size());
+		}
+
+		m_culler.Query(m_view_proj, m_eye);
+		m_visible_indices.EndFrame();
 	}
-	void RenderComplexScene(unsigned int n) {
-		RenderBasicScene(n);
+	void StepCompare() {
+		if (m_compare_frame < 0) return;
+
+		m_compare_draw_ms += m_draw_ms;
+		for (const GpuTiming& scope : GpuProfiler::Latest().scopes) {
+			if (scope.depth == 0 && strcmp(scope.name, "OnDraw") == 0) m_compare_gpu_ms += scope.ms;
+		}
+
+		if (++m_compare_frame < COMPARE_FRAMES) return;
+		const f64 now = glfwGetTime();
+		m_compare[m_mode] = { (now - m_compare_start) * 1000.0 / COMPARE_FRAMES, m_compare_draw_ms / COMPARE_FRAMES, m_compare_gpu_ms / COMPARE_FRAMES };
+
+		m_compare_start = now;
+		m_compare_draw_ms = m_compare_gpu_ms = 0.0;
+		if (++m_mode < CULL_MODE_COUNT) {
+			m_compare_frame = 0;
+		}
+		else {
+			m_mode = CULL_LATENT;
+			m_compare_frame = -1;
+		}
 	}
 };
 
@@ -265,4 +353,4 @@ SystemConf config = {
 };
 
 MAIN(config)
-#endif //OCCLUSION_QUERIES
\ No newline at end of file
+#endif //OCCLUSION_QUERIES
@@ -63,13 +63,6 @@ struct Application : public Program {
 	GLuint m_program, m_occlusion_program;
 	GLuint m_ubo;
 
-	GLuint m_queries[2];
-	GLuint m_times[2];
-
-	GLuint m_draw_time;
-	GLuint m_ui_time;
-	uint m_last;
-
 	ObjMesh m_cube;
 
 	SB::Camera m_camera;
@@ -88,10 +81,6 @@ struct Application : public Program {
 		m_camera = SB::Camera("Camera", glm::vec3(0.0f, 2.0f, -12.0f), glm::vec3(0.0f), SB::CameraType::Perspective, 16.0 / 9.0, 0.9, 0.01, 1000.0);
 		m_cube.Load_OBJ("./resources/cube.obj");
 		m_random.Init();
-
-		glGenQueries(2, m_queries);
-
-		m_last = (uint)floor(m_time);
 	}
 	void OnUpdate(Input& input, Audio& audio, Window& window, f64 dt) {
 		m_fps = window.GetFPS();
@@ -106,42 +95,36 @@ struct Application : public Program {
 			m_input_mode = !m_input_mode;
 			input.SetRawMouseMode(window.GetHandle(), m_input_mode);
 		}
-
-		if (m_last != (uint)floor(m_time)) {
-			m_last = floor(m_time);
-			m_draw_time = m_times[0];
-			m_ui_time = m_times[1];
-		}
 	}
 	void OnDraw() {
-		glBeginQuery(GL_TIME_ELAPSED, m_queries[0]);
-
-		static const GLfloat one = 1.0f;
-		glClearBufferfv(GL_COLOR, 0, m_clear_color);
-		glClearBufferfv(GL_DEPTH, 0, &one);
-
-		glEnable(GL_DEPTH_TEST);
-
-		glUseProgram(m_program);
-		glUniformMatrix4fv(4, 1, GL_FALSE, glm::value_ptr(m_camera.ViewProj()));
-		m_cube.OnDraw();
-
-		glEndQuery(GL_TIME_ELAPSED);
+		//Nested inside the OnDraw scope Event::Run opens
+		{
+			GpuScope scope("Clear");
+			static const GLfloat one = 1.0f;
+			glClearBufferfv(GL_COLOR, 0, m_clear_color);
+			glClearBufferfv(GL_DEPTH, 0, &one);
+		}
+		{
+			GpuScope scope("Scene");
+			glEnable(GL_DEPTH_TEST);
+
+			glUseProgram(m_program);
+			glUniformMatrix4fv(4, 1, GL_FALSE, glm::value_ptr(m_camera.ViewProj()));
+			{
+				GpuScope cube_scope("Cube");
+				m_cube.OnDraw();
+			}
+		}
 	}
 	void OnGui() {
-		glBeginQuery(GL_TIME_ELAPSED, m_queries[1]);
-
 		ImGui::Begin("User Defined Settings");
 		ImGui::Text("FPS: %d", m_fps);
 		ImGui::Text("Time: %f", m_time);
 		ImGui::ColorEdit4("Clear Color", m_clear_color);
-		ImGui::Text("Times - Draw: %d    UI: %d", m_draw_time, m_ui_time);
 		ImGui::End();
 
-		glEndQuery(GL_TIME_ELAPSED);
-
-		glGetQueryObjectuiv(m_queries[0], GL_QUERY_RESULT, &m_times[0]);
-		glGetQueryObjectuiv(m_queries[1], GL_QUERY_RESULT, &m_times[1]);
+		//Results are a few frames old, read back once the GPU had them ready
+		GpuProfiler::OnGui();
 	}
 };
 
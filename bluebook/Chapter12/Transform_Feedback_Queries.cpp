@@ -88,11 +88,9 @@ struct Application : public Program {
 		//Load our shader that will read data into our transform feedback buffer
 		//Declare the names of all the varyings we will copy data into
 		//Let Opengl know what are varyings are and how we want to pack them into buffers
-		//Relink the program
-		m_transform_feedback_program = LoadShaders(transform_feedback_shader_text);
+		//LoadShaders sets them before linking, a program restored from a cached binary can't be relinked
 		static const char* varyings[] = { "vPosition" };
-		glTransformFeedbackVaryings(m_transform_feedback_program, 1, varyings, GL_INTERLEAVED_ATTRIBS);
-		glLinkProgram(m_transform_feedback_program);
+		m_transform_feedback_program = LoadShaders(transform_feedback_shader_text, varyings, 1, GL_INTERLEAVED_ATTRIBS);
 
 		//Generate a buffer to put our transform feedback data into, make it big enough to be able to hold all our data
 		glGenBuffers(1, &m_feedback_buffer);
@@ -364,7 +364,9 @@ struct Application : public Program {
 
 	//Light Data
 	LightData m_light_data[4];
-	GLuint m_light_ubo;
+	FrameRingBuffer m_light_ubo;
+	usize m_light_offset = 0;
+	usize m_light_size = 0;
 	vector<LightData> m_lights;
 	vector<glm::vec3> m_lights_to;
 	vector<glm::vec3> m_lights_from;
@@ -373,6 +375,7 @@ struct Application : public Program {
 	Random m_random;
 
 #define OBJ_ARRAY_SIZE 30
+#define MAX_LIGHT_COUNT 256
 #define OBJ_SCALING 3.0f
 
 	Application()
@@ -430,6 +433,7 @@ struct Application : public Program {
 		else
 			DeferredRender();
 
+		m_light_ubo.EndFrame();
 	}
 	void OnGui() {
 		ImGui::Begin("User Defined Settings");
@@ -465,25 +469,21 @@ struct Application : public Program {
 		}
 	}
 	void CreateUniformLightBuffer() {
-		glGenBuffers(1, &m_light_ubo);
-		glBindBuffer(GL_UNIFORM_BUFFER, m_light_ubo);
-		glBufferData(GL_UNIFORM_BUFFER, sizeof(LightData) * m_lights.size(), nullptr, GL_DYNAMIC_DRAW);
-		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		m_light_ubo.Init(sizeof(LightData) * MAX_LIGHT_COUNT);
 	}
 	void UpdateLightUniform() {
-		glBindBuffer(GL_UNIFORM_BUFFER, m_light_ubo);
-		glBufferData(GL_UNIFORM_BUFFER, sizeof(LightData) * m_lights.size(), nullptr, GL_DYNAMIC_DRAW);
+		m_light_ubo.BeginFrame();
 
-		LightData* data = (LightData*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, sizeof(LightData) * m_lights.size(), GL_MAP_WRITE_BIT);
-		for (int i = 0; i < m_lights.size(); ++i) {
+		//The block always gets at least the size the shader declares
+		const usize count = std::min(m_lights.size(), (usize)MAX_LIGHT_COUNT);
+		m_light_size = sizeof(LightData) * std::max(count, (usize)4);
+		LightData* data = (LightData*)m_light_ubo.Allocate(m_light_size, &m_light_offset);
+		for (int i = 0; i < count; ++i) {
 			data[i].light_pos = m_lights[i].light_pos;
 			data[i].light_intensity = m_lights[i].light_intensity;
 			data[i].light_color = m_lights[i].light_color;
 			data[i].pad0 = 0.0;
 		}
-
-		glUnmapBuffer(GL_UNIFORM_BUFFER);
-		glBindBuffer(GL_UNIFORM_BUFFER, 0);
 	}
 	void CreateWhiteTex() {
 		static const GLubyte white_texture[] = { 0xff, 0xff, 0xff, 0xff };
@@ -579,7 +579,7 @@ struct Application : public Program {
 		glBindTextureUnit(1, m_gbuffer_textures[1]);
 		glUniform3fv(11, 1, glm::value_ptr(m_camera.m_cam_position));
 		glUniform1i(12, m_lights.size());
-		glBindBufferBase(GL_UNIFORM_BUFFER, 0, m_light_ubo);
+		m_light_ubo.BindRange(GL_UNIFORM_BUFFER, 0, m_light_offset, m_light_size);
 		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 
 	}
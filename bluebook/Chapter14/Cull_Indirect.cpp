@@ -183,10 +183,11 @@ struct Application : public Program {
         GLuint m_parameters;
         GLuint m_drawCandidates;
         GLuint m_drawCommands;
-        GLuint m_modelMatrices;
-        GLuint m_transforms;
     } buffers;
 
+    //Model matrices and transforms are rewritten every frame
+    FrameRingBuffer m_frame_data;
+
     ObjMesh m_object;
     GLuint m_tex;
 
@@ -232,13 +233,7 @@ struct Application : public Program {
         glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers.m_drawCommands);
         glBufferStorage(GL_SHADER_STORAGE_BUFFER, CANDIDATE_COUNT * sizeof(DrawArraysIndirectCommand), nullptr, GL_MAP_READ_BIT);
 
-        glGenBuffers(1, &buffers.m_modelMatrices);
-        glBindBuffer(GL_UNIFORM_BUFFER, buffers.m_modelMatrices);
-        glBufferStorage(GL_UNIFORM_BUFFER, 1024 * sizeof(glm::mat4), nullptr, GL_MAP_WRITE_BIT);
-
-        glGenBuffers(1, &buffers.m_transforms);
-        glBindBuffer(GL_UNIFORM_BUFFER, buffers.m_transforms);
-        glBufferStorage(GL_UNIFORM_BUFFER, sizeof(TransformBuffer), nullptr, GL_MAP_WRITE_BIT);
+        m_frame_data.Init(1024 * sizeof(glm::mat4) + sizeof(TransformBuffer) + 1024);
 	}
 	void OnUpdate(Input& input, Audio& audio, Window& window, f64 dt) {
 		m_fps = window.GetFPS();
@@ -255,8 +250,11 @@ struct Application : public Program {
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffers.m_drawCandidates);
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, buffers.m_drawCommands);
 
-        glBindBufferBase(GL_UNIFORM_BUFFER, 0, buffers.m_modelMatrices);
-        glm::mat4* pModelMatrix = (glm::mat4*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, 1024 * sizeof(glm::mat4), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        m_frame_data.BeginFrame();
+
+        usize model_offset, transform_offset;
+        glm::mat4* pModelMatrix = m_frame_data.Allocate<glm::mat4>(1024, &model_offset);
+        TransformBuffer* pTransforms = m_frame_data.Allocate<TransformBuffer>(1, &transform_offset);
 
         for (int i = 0; i < 1024; i++)
         {
@@ -267,11 +265,6 @@ struct Application : public Program {
             pModelMatrix[i] = model_matrix;
         }
 
-        glUnmapBuffer(GL_UNIFORM_BUFFER);
-
-        glBindBufferBase(GL_UNIFORM_BUFFER, 1, buffers.m_transforms);
-        TransformBuffer* pTransforms = (TransformBuffer*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, sizeof(TransformBuffer), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
-
         float t = (float)m_time * 0.1f;
         
         const glm::mat4 view_matrix = glm::lookAt(glm::vec3(150.0f * cosf(t), 0.0f, 150.0f * sinf(t)),
@@ -286,7 +279,8 @@ struct Application : public Program {
         pTransforms->proj_matrix = proj_matrix;
         pTransforms->view_proj_matrix = proj_matrix * view_matrix;
 
-        glUnmapBuffer(GL_UNIFORM_BUFFER);
+        m_frame_data.BindRange(GL_UNIFORM_BUFFER, 0, model_offset, 1024 * sizeof(glm::mat4));
+        m_frame_data.BindRange(GL_UNIFORM_BUFFER, 1, transform_offset, sizeof(TransformBuffer));
 
         glUseProgram(m_compute_program);
         glUniform1f(0, m_cull_zone);
@@ -304,6 +298,8 @@ struct Application : public Program {
 
         glUseProgram(m_program);
         glMultiDrawArraysIndirectCountARB(GL_TRIANGLES, 0, 0, CANDIDATE_COUNT, 0);
+
+        m_frame_data.EndFrame();
 	}
 	void OnGui() {
 		ImGui::Begin("User Defined Settings");
@@ -311,6 +307,7 @@ struct Application : public Program {
 		ImGui::Text("Time: %f", m_time);
 		ImGui::ColorEdit4("Clear Color", m_clear_color);
         ImGui::DragFloat("Cull Range", &m_cull_zone, 0.01f);
+        ImGui::Text("Frame data stalls: %llu (%.2f ms)", m_frame_data.m_stats.m_stalls, m_frame_data.m_stats.m_stall_ms);
 		ImGui::End();
 	}
 };
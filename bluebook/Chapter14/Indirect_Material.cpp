@@ -139,9 +139,8 @@ struct Application : public Program {
 
 	GLuint m_program;
 	GLuint m_indirect_draw_buffer;
-	GLuint m_transform_buffer;
-	GLuint m_frame_uniforms_buffer;
 	GLuint m_material_buffer;
+	FrameRingBuffer m_frame_data;	//Frame uniforms and model matrices
 	
 	ObjMesh m_object;
 
@@ -159,8 +158,7 @@ struct Application : public Program {
 		m_object.Load_OBJ("./resources/cube.obj");
 		m_camera = SB::Camera("Camera", glm::vec3(0.0f, 8.0f, 15.5f), glm::vec3(0.0f, 2.0f, 0.0f), SB::CameraType::Perspective, 16.0 / 9.0, 0.9, 0.01, 1000.0);
 		m_indirect_draw_buffer = CreateIndirectBuffer();
-		m_transform_buffer = CreateTransformBuffer();
-		m_frame_uniforms_buffer = CreateFrameUniformsBuffer();
+		m_frame_data.Init(sizeof(FrameUniforms) + NUM_DRAWS * sizeof(glm::mat4) + 1024);
 		m_material_buffer = CreateMaterialBuffer();
 
 		glEnable(GL_DEPTH_TEST);
@@ -186,18 +184,19 @@ struct Application : public Program {
 		glUseProgram(m_program);
 		glBindVertexArray(m_object.m_vao);
 
+		m_frame_data.BeginFrame();
+
 		//Bind Frame Uniforms Buffer
-		glBindBufferBase(GL_UNIFORM_BUFFER, 0, m_frame_uniforms_buffer);
-		FrameUniforms* pUniforms = (FrameUniforms*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		usize offset;
+		FrameUniforms* pUniforms = m_frame_data.Allocate<FrameUniforms>(1, &offset);
 		pUniforms->proj_matrix = m_camera.m_proj;
 		pUniforms->view_matrix = m_camera.m_view;
 		pUniforms->viewproj_matrix = m_camera.ViewProj();
-		glUnmapBuffer(GL_UNIFORM_BUFFER);
+		m_frame_data.BindRange(GL_UNIFORM_BUFFER, 0, offset, sizeof(FrameUniforms));
 
 		//Bind Model Matrix Buffer
-		glm::mat4* pModelMatrices = (glm::mat4*)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, NUM_DRAWS * sizeof(glm::mat4), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
-
-		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_transform_buffer);
+		glm::mat4* pModelMatrices = m_frame_data.Allocate<glm::mat4>(NUM_DRAWS, &offset);
+		m_frame_data.BindRange(GL_SHADER_STORAGE_BUFFER, 0, offset, NUM_DRAWS * sizeof(glm::mat4));
 
 		float f = m_time * 0.01f;
 		for (int i = 0; i < NUM_DRAWS; i++)
@@ -208,8 +207,6 @@ struct Application : public Program {
 			f += 3.1f;
 		}
 
-		glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
-
 		glUniform3fv(0, 1, glm::value_ptr(glm::vec3(10.0f, 10.0f, 10.0f))); //Light Position
 		glUniform3fv(1, 1, glm::value_ptr(m_camera.Eye())); //Camera Position
 
@@ -218,12 +215,14 @@ struct Application : public Program {
 		
 		glMultiDrawArraysIndirect(GL_TRIANGLES, nullptr, NUM_DRAWS, 0);
 
+		m_frame_data.EndFrame();
 	}
 	void OnGui() {
 		ImGui::Begin("User Defined Settings");
 		ImGui::Text("FPS: %d", m_fps);
 		ImGui::Text("Time: %f", m_time);
 		ImGui::ColorEdit4("Clear Color", m_clear_color);
+		ImGui::Text("Frame data stalls: %llu (%.2f ms)", m_frame_data.m_stats.m_stalls, m_frame_data.m_stats.m_stall_ms);
 		ImGui::End();
 	}
 	GLuint CreateIndirectBuffer() {
@@ -252,22 +251,6 @@ struct Application : public Program {
 		glUnmapBuffer(GL_DRAW_INDIRECT_BUFFER);
 		return indirect_draw_buffer;
 	}
-	GLuint CreateTransformBuffer() {
-		GLuint transform_buffer;
-		glGenBuffers(1, &transform_buffer);
-		glBindBuffer(GL_SHADER_STORAGE_BUFFER, transform_buffer);
-		glBufferStorage(GL_SHADER_STORAGE_BUFFER, NUM_DRAWS * sizeof(glm::mat4), nullptr, GL_MAP_WRITE_BIT);
-
-		return transform_buffer;
-	}
-	GLuint CreateFrameUniformsBuffer() {
-		GLuint frame_uniforms_buffer;
-		glGenBuffers(1, &frame_uniforms_buffer);
-		glBindBuffer(GL_UNIFORM_BUFFER, frame_uniforms_buffer);
-		glBufferStorage(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_MAP_WRITE_BIT);
-
-		return frame_uniforms_buffer;
-	}
 	GLuint CreateMaterialBuffer() {
 		GLuint material_buffer;
 		glGenBuffers(1, &material_buffer);
@@ -4,6 +4,7 @@
 #include "Texture.h"
 #include "Model.h"
 #include "Mesh.h"
+#include "NBody.h"
 #include <chrono>
 #include <omp.h>
 
@@ -40,13 +41,13 @@ static ShaderText shader_text[] = {
 	{GL_NONE, NULL, NULL}
 };
 
-#define PARTICLE_COUNT 2048
+#define MAX_PARTICLE_COUNT 1048576
+//All pairs solvers would take seconds per frame above this, larger counts switch to Barnes-Hut
+#define MAX_BRUTE_FORCE_COUNT 65536
 
-struct Particle
-{
-	glm::vec3 position;
-	glm::vec3 velocity;
-};
+static const int particle_counts[] = { 2048, 4096, 8192, 16384, 32768, 65536, 262144, 1048576 };
+static const char* particle_count_names[] = { "2K", "4K", "8K", "16K", "32K", "64K", "256K", "1M" };
+static const char* solver_names[] = { "Scalar", "SIMD", "SIMD + OpenMP", "Barnes-Hut" };
 
 struct Application : public Program {
 	float m_clear_color[4];
@@ -56,12 +57,15 @@ struct Application : public Program {
 	GLuint m_vao;
 	GLuint m_program;
 
-
 	GLuint m_particle_buffer;
-	Particle* m_mapped_buffer;
-	Particle* m_particles[2];
-	int m_frame;
-	bool m_use_omp = true;
+	float* m_mapped_buffer;
+	ParticleStore m_particles;
+	int m_particle_count;
+	int m_count_index = 0;
+	int m_solver = (int)NBodySolver::SIMD_OMP;
+	f64 m_step_ms = 0.0;
+	f64 m_max_error = -1.0;
+	f64 m_mean_error = -1.0;
 
 	Random m_random;
 	int m_max_threads;
@@ -69,7 +73,8 @@ struct Application : public Program {
 	Application()
 		:m_clear_color{ 0.1f, 0.1f, 0.1f, 1.0f },
 		m_fps(0),
-		m_time(0.0)
+		m_time(0.0),
+		m_particle_count(particle_counts[0])
 	{}
 
 	void OnInit(Input& input, Audio& audio, Window& window) {
@@ -86,36 +91,52 @@ struct Application : public Program {
 		m_fps = window.GetFPS();
 		m_time = window.GetTime();
 
-		if (m_use_omp) UpdateParticlesOMP(dt);
-		else UpdateParticles(dt);
+		auto start = std::chrono::steady_clock::now();
+		NBody_Step(m_particles, dt, (NBodySolver)m_solver, m_mapped_buffer);
+		m_step_ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
 	}
 	void OnDraw() {
 		glViewport(0, 0, 1600, 900);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		glBindVertexArray(m_vao);
-		glFlushMappedBufferRange(GL_ARRAY_BUFFER, 0, PARTICLE_COUNT * sizeof(Particle));
+		glFlushMappedNamedBufferRange(m_particle_buffer, 0, m_particle_count * sizeof(float) * 3);
 		glPointSize(3.0f);
 		glUseProgram(m_program);
-		glDrawArrays(GL_POINTS, 0, PARTICLE_COUNT);
+		glDrawArrays(GL_POINTS, 0, m_particle_count);
 	}
 	void OnGui() {
 		ImGui::Begin("User Defined Settings");
 		ImGui::Text("FPS: %d", m_fps);
 		ImGui::Text("Time: %f", m_time);
 		ImGui::ColorEdit4("Clear Color", m_clear_color);
-		ImGui::Checkbox("Use Threads", &m_use_omp);
+		ImGui::Combo("Solver", &m_solver, solver_names, IM_ARRAYSIZE(solver_names));
+		if (ImGui::Combo("Particles", &m_count_index, particle_count_names, IM_ARRAYSIZE(particle_count_names))) {
+			m_particle_count = particle_counts[m_count_index];
+			InitParticles();
+		}
+		if (m_particle_count > MAX_BRUTE_FORCE_COUNT) m_solver = (int)NBodySolver::BarnesHut;
+		if (m_solver == (int)NBodySolver::BarnesHut) {
+			ImGui::SliderFloat("Theta", &m_particles.m_tree.m_theta, 0.0f, 1.5f);
+			ImGui::Text("Octree nodes: %d", (int)m_particles.m_tree.m_nodes.size());
+			if (m_particle_count <= MAX_BRUTE_FORCE_COUNT && ImGui::Button("Compare with brute force")) {
+				CompareWithBruteForce();
+			}
+			if (m_max_error >= 0.0) {
+				ImGui::Text("Relative error max: %.2e mean: %.2e", m_max_error, m_mean_error);
+			}
+		}
+		ImGui::Text("Kernel: %s", CPU_HasAVX2() ? "AVX2" : "SSE");
+		ImGui::Text("Step: %.2f ms", m_step_ms);
+		ImGui::Text("Interactions/s: %.3g", m_step_ms > 0.0 ? (f64)m_particle_count * m_particle_count / (m_step_ms * 0.001) : 0.0);
 		ImGui::End();
 	}
 	void InitBuffers() {
-		m_particles[0] = new Particle[PARTICLE_COUNT];
-		m_particles[1] = new Particle[PARTICLE_COUNT];
-
-		glGenBuffers(1, &m_particle_buffer);
-		glBindBuffer(GL_ARRAY_BUFFER, m_particle_buffer);
-		glBufferStorage(GL_ARRAY_BUFFER, PARTICLE_COUNT * sizeof(Particle), nullptr, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT);
+		//Sized for the largest count so switching counts only reseeds the particles
+		glCreateBuffers(1, &m_particle_buffer);
+		glNamedBufferStorage(m_particle_buffer, MAX_PARTICLE_COUNT * sizeof(float) * 3, nullptr, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT);
 
-		m_mapped_buffer = (Particle*)glMapBufferRange(GL_ARRAY_BUFFER, 0, PARTICLE_COUNT * sizeof(Particle), GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+		m_mapped_buffer = (float*)glMapNamedBufferRange(m_particle_buffer, 0, MAX_PARTICLE_COUNT * sizeof(float) * 3, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
 
 		InitParticles();
 
@@ -123,65 +144,41 @@ struct Application : public Program {
 		glBindVertexArray(m_vao);
 
 		glVertexAttribFormat(0, 3, GL_FLOAT, GL_FALSE, 0);
-		glBindVertexBuffer(0, m_particle_buffer, 0, sizeof(Particle));
+		glBindVertexBuffer(0, m_particle_buffer, 0, sizeof(float) * 3);
 		glEnableVertexAttribArray(0);
 	}
-	void InitParticles() {
-		for (int i = 0; i < PARTICLE_COUNT; ++i) {
-			m_particles[0][i].position[0] = m_random.Float() * 6.0f - 3.0f;
-			m_particles[0][i].position[1] = m_random.Float() * 6.0f - 3.0f;
-			m_particles[0][i].position[2] = m_random.Float() * 6.0f - 3.0f;
-			m_particles[0][i].velocity = m_particles[0][i].position * 0.001f;
-			m_mapped_buffer[i] = m_particles[0][i];
-		}
-	}
-	void UpdateParticles(f64 dt) {
-		const Particle* const src = m_particles[m_frame & 1];
-		Particle* const dst = m_particles[(m_frame + 1) & 1];
-
-		for (int i = 0; i < PARTICLE_COUNT; ++i) {
-			const Particle& me = src[i];
-			glm::vec3 delta_v(0.0f);
-
-			for (int j = 0; j < PARTICLE_COUNT; ++j) {
-				if (i != j) {
-					glm::vec3 delta_pos = src[j].position - me.position;
-					float distance = glm::length(delta_pos);
-					glm::vec3 delta_dir = delta_pos / distance;
-					distance = distance < 0.005f ? 0.005f : distance;
-					delta_v += (delta_dir / (distance * distance));
-				} 
-			}
-			dst[i].position = me.position + me.velocity;
-			dst[i].velocity = me.velocity + delta_v * (float)dt * 0.0001f;
-			m_mapped_buffer[i].position = dst[i].position;
+	//Runs both solvers on the current positions and compares the velocity changes
+	void CompareWithBruteForce() {
+		ParticleStore reference = m_particles;
+		NBody_Accumulate(reference, NBodySolver::SIMD_OMP);
+		ParticleStore approximate = m_particles;
+		NBody_Accumulate(approximate, NBodySolver::BarnesHut);
+
+		m_max_error = 0.0;
+		m_mean_error = 0.0;
+		for (int i = 0; i < m_particle_count; ++i) {
+			glm::vec3 exact(reference.m_ax[i], reference.m_ay[i], reference.m_az[i]);
+			glm::vec3 estimate(approximate.m_ax[i], approximate.m_ay[i], approximate.m_az[i]);
+			f64 error = glm::length(exact - estimate) / (glm::length(exact) + 1e-9f);
+			m_max_error = glm::max(m_max_error, error);
+			m_mean_error += error;
 		}
-
-		m_frame++;
+		m_mean_error /= m_particle_count;
 	}
-	void UpdateParticlesOMP(f64 dt) {
-		const Particle* const src = m_particles[m_frame & 1];
-		Particle* const dst = m_particles[(m_frame + 1) & 1];
-#pragma omp parallel for schedule (static) num_threads(m_max_threads)
-		for (int i = 0; i < PARTICLE_COUNT; ++i) {
-			const Particle& me = src[i];
-			glm::vec3 delta_v(0.0f);
-
-			for (int j = 0; j < PARTICLE_COUNT; ++j) {
-				if (i != j) {
-					glm::vec3 delta_pos = src[j].position - me.position;
-					float distance = glm::length(delta_pos);
-					glm::vec3 delta_dir = delta_pos / distance;
-					distance = distance < 0.005f ? 0.005f : distance;
-					delta_v += (delta_dir / (distance * distance));
-				}
-			}
-			dst[i].position = me.position + me.velocity;
-			dst[i].velocity = me.velocity + delta_v * (float)dt * 0.0001f;
-			m_mapped_buffer[i].position = dst[i].position;
+	void InitParticles() {
+		m_max_error = -1.0;
+		m_particles.Resize(m_particle_count);
+		for (int i = 0; i < m_particle_count; ++i) {
+			m_particles.m_px[i] = m_random.Float() * 6.0f - 3.0f;
+			m_particles.m_py[i] = m_random.Float() * 6.0f - 3.0f;
+			m_particles.m_pz[i] = m_random.Float() * 6.0f - 3.0f;
+			m_particles.m_vx[i] = m_particles.m_px[i] * 0.001f;
+			m_particles.m_vy[i] = m_particles.m_py[i] * 0.001f;
+			m_particles.m_vz[i] = m_particles.m_pz[i] * 0.001f;
+			m_mapped_buffer[i * 3 + 0] = m_particles.m_px[i];
+			m_mapped_buffer[i * 3 + 1] = m_particles.m_py[i];
+			m_mapped_buffer[i * 3 + 2] = m_particles.m_pz[i];
 		}
-
-		m_frame++;
 	}
 };
 
@@ -1,6 +1,7 @@
 #include "Defines.h"
 #ifdef PMB_FRACTAL
 #include "System.h"
+#include "Fractal.h"
 #include "Texture.h"
 #include "Model.h"
 #include "Mesh.h"
@@ -58,11 +59,12 @@ struct Application : public Program {
 
     int m_max_threads = 0;
 
-    struct {
-        glm::vec2 C;
-        glm::vec2 offset;
-        float zoom;
-    } fractparams;
+    FractalRenderer m_renderer;
+    FractalParams m_params = {};
+    bool m_animate = true;
+    bool m_progressive = false;
+    bool m_simd = true;
+    f64 m_render_ms = 0.0;
 
     Application()
         :m_clear_color{ 0.1f, 0.1f, 0.1f, 1.0f },
@@ -75,6 +77,7 @@ struct Application : public Program {
         omp_set_num_threads(m_max_threads);
 
         m_program = LoadShaders(shader_text);
+        m_renderer.Init(FRACTAL_WIDTH, FRACTAL_HEIGHT);
         
         glGenBuffers(1, &m_buffer);
         glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
@@ -105,13 +108,15 @@ struct Application : public Program {
         glViewport(0, 0, 1600, 900);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        float nowTime = (float)m_time * 0.01f;
+        if (m_animate) {
+            float nowTime = (float)m_time * 0.01f;
 
-        fractparams.C = glm::vec2(1.5f - cosf(nowTime * 0.4f) * 0.5f,
-            1.5f + cosf(nowTime * 0.5f) * 0.5f) * 0.3f;
-        fractparams.offset = glm::vec2(cosf(nowTime * 0.14f),
-            cosf(nowTime * 0.25f)) * 0.25f;
-        fractparams.zoom = (sinf(nowTime) + 1.3f) * 0.7f;
+            m_params.m_cx = (1.5f - cosf(nowTime * 0.4f) * 0.5f) * 0.3f;
+            m_params.m_cy = (1.5f + cosf(nowTime * 0.5f) * 0.5f) * 0.3f;
+            m_params.m_offset_x = cosf(nowTime * 0.14f) * 0.25f;
+            m_params.m_offset_y = cosf(nowTime * 0.25f) * 0.25f;
+            m_params.m_zoom = (sinf(nowTime) + 1.3f) * 0.7f;
+        }
 
         update_fractal();
 
@@ -130,39 +135,31 @@ struct Application : public Program {
         ImGui::Text("FPS: %d", m_fps);
         ImGui::Text("Time: %f", m_time);
         ImGui::ColorEdit4("Clear Color", m_clear_color);
+        ImGui::Checkbox("Animate", &m_animate);
+        if (!m_animate) {
+            ImGui::DragFloat("Zoom", &m_params.m_zoom, 0.005f, 0.0001f, 4.0f, "%.4f");
+            ImGui::DragFloat2("Offset", &m_params.m_offset_x, 0.002f, -2.0f, 2.0f);
+            ImGui::DragFloat2("C", &m_params.m_cx, 0.001f, -1.0f, 1.0f);
+        }
+        ImGui::SliderInt("Max Iterations", &m_params.m_max_iterations, 16, 1024);
+        ImGui::Checkbox("SIMD", &m_simd);
+        ImGui::Checkbox("Use Threads", &m_renderer.m_threads);
+        ImGui::Checkbox("Progressive", &m_progressive);
+        if (m_progressive) ImGui::Text("Step: %d", m_renderer.Step());
+        ImGui::Text("Render: %.2f ms", m_render_ms);
         ImGui::End();
     }
     void update_fractal() {
-        const glm::vec2 C = fractparams.C;
-        const float thresh_squared = 256.0f;
-        const float zoom = fractparams.zoom;
-        const glm::vec2 offset = fractparams.offset;
-
-#pragma omp parallel for schedule (dynamic) num_threads(m_max_threads)
-        for (int y = 0; y < FRACTAL_HEIGHT; y++)
-        {
-            for (int x = 0; x < FRACTAL_WIDTH; x++)
-            {
-                glm::vec2 Z;
-                Z[0] = zoom * (float(x) / float(FRACTAL_WIDTH) - 0.5f) + offset[0];
-                Z[1] = zoom * (float(y) / float(FRACTAL_HEIGHT) - 0.5f) + offset[1];
-                unsigned char* ptr = mapped_buffer + y * FRACTAL_WIDTH + x;
-
-                int it;
-                for (it = 0; it < 256; it++)
-                {
-                    glm::vec2 Z_squared;
-
-                    Z_squared[0] = Z[0] * Z[0] - Z[1] * Z[1];
-                    Z_squared[1] = 2.0f * Z[0] * Z[1];
-                    Z = Z_squared + C;
-
-                    if ((Z[0] * Z[0] + Z[1] * Z[1]) > thresh_squared)
-                        break;
-                }
-                *ptr = it;
-            }
+        auto start = std::chrono::steady_clock::now();
+        m_renderer.m_kernel = m_simd ? FractalKernel::SIMD : FractalKernel::Scalar;
+        if (m_progressive) {
+            //Coarse levels land first after a change, finer ones follow over the next frames
+            m_renderer.Refine(m_params, mapped_buffer, 0.004);
+        }
+        else {
+            m_renderer.Render(m_params, mapped_buffer);
         }
+        m_render_ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
     }
 };
 
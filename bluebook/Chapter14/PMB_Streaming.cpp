@@ -11,21 +11,14 @@
 static const GLchar* vs_source = R"(
 #version 450 core
 
-#extension GL_ARB_shader_draw_parameters : require
-
 layout (location = 0) in vec4 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 uv;
 
-struct MATRICES
-{
-    mat4 modelview;
-    mat4 projection;
-};
-
-layout (std140) uniform constants
+layout (std140, binding = 0) uniform constants
 {
-    MATRICES matrices[16];
+    mat4 mv_matrix;
+    mat4 proj_matrix;
 };
 
 out VS_OUT
@@ -40,9 +33,6 @@ const vec3 light_pos = vec3(100.0, 100.0, 100.0);
 
 void main(void)
 {
-    mat4 mv_matrix = matrices[gl_BaseInstanceARB].modelview;
-    mat4 proj_matrix = matrices[gl_BaseInstanceARB].projection;
-
     vec4 P = mv_matrix * position;
 
     vs_out.N = mat3(mv_matrix) * normal;
@@ -104,12 +94,7 @@ struct MATRICES
     glm::mat4 projection;
 };
 
-enum
-{
-    CHUNK_COUNT = 4,
-    CHUNK_SIZE = 3 * sizeof(glm::mat4),
-    BUFFER_SIZE = (CHUNK_SIZE * CHUNK_COUNT)
-};
+#define CHUNK_COUNT 4
 
 struct Application : public Program {
     float m_clear_color[4];
@@ -117,12 +102,14 @@ struct Application : public Program {
     f64 m_time;
 
     GLuint m_program;
-    GLuint m_buffer;
-    GLsync fence[CHUNK_COUNT];
-    int sync_index = 0;
-    bool stalled;
 
+    //NO_SYNC and FINISH write to one unfenced chunk, ONE_SYNC and RINGED_SYNC go through a
+    //FrameRingBuffer of one and CHUNK_COUNT frames
+    GLuint m_buffer;
     MATRICES* vs_uniforms;
+    FrameRingBuffer m_one_sync;
+    FrameRingBuffer m_ringed_sync;
+    bool stalled = false;
 
     ObjMesh m_object;
     GLuint m_tex;
@@ -154,21 +141,17 @@ struct Application : public Program {
         glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
 
         //Create buffer storage and get a persistant pointer to buffer
-        glBufferStorage(GL_UNIFORM_BUFFER, BUFFER_SIZE, nullptr, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
-        vs_uniforms = (MATRICES*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, BUFFER_SIZE, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
-
-        glBindBufferBase(GL_UNIFORM_BUFFER, 0, m_buffer);
+        glBufferStorage(GL_UNIFORM_BUFFER, sizeof(MATRICES), nullptr, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+        vs_uniforms = (MATRICES*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, sizeof(MATRICES), GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
 
-        for (int i = 0; i < CHUNK_COUNT; ++i) {
-            fence[i] = 0;
-        }
+        m_one_sync.Init(sizeof(MATRICES), 1);
+        m_ringed_sync.Init(sizeof(MATRICES), CHUNK_COUNT);
     }
     void OnUpdate(Input& input, Audio& audio, Window& window, f64 dt) {
         m_fps = window.GetFPS();
         m_time = window.GetTime();
     }
     void OnDraw() {
-        int isSignaled;
         glViewport(0, 0, 1600, 900);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -183,55 +166,37 @@ struct Application : public Program {
         glDepthFunc(GL_LESS);
         glBindTextureUnit(0, m_tex);
 
-        if (mode == ONE_SYNC)
+        if (mode == ONE_SYNC || mode == RINGED_SYNC)
         {
-            if (fence[0] != 0)
-            {
-                glGetSynciv(fence[0], GL_SYNC_STATUS, sizeof(int), nullptr, &isSignaled);
-                stalled = isSignaled == GL_UNSIGNALED;
-                glClientWaitSync(fence[0], 0, GL_TIMEOUT_IGNORED);
-                glDeleteSync(fence[0]);
-            }
-        }
-        else if (mode == RINGED_SYNC)
-        {
-            if (fence[sync_index] != 0)
-            {
-                glGetSynciv(fence[sync_index], GL_SYNC_STATUS, sizeof(int), nullptr, &isSignaled);
-                stalled = isSignaled == GL_UNSIGNALED;
-                glClientWaitSync(fence[sync_index], 0, GL_TIMEOUT_IGNORED);
-                glDeleteSync(fence[sync_index]);
-            }
-        }
-
-        vs_uniforms[sync_index].model_view = mv_matrix;
-        vs_uniforms[sync_index].projection = proj_matrix;
+            //BeginFrame waits for the GPU to finish with the chunk written CHUNK_COUNT frames
+            //ago, or last frame with a single chunk
+            FrameRingBuffer& ring = mode == ONE_SYNC ? m_one_sync : m_ringed_sync;
+            ring.BeginFrame();
+            stalled = ring.m_stats.m_last_stall_ms > 0.0;
+
+            usize offset;
+            MATRICES* uniforms = ring.Allocate<MATRICES>(1, &offset);
+            uniforms->model_view = mv_matrix;
+            uniforms->projection = proj_matrix;
+            ring.BindRange(GL_UNIFORM_BUFFER, 0, offset, sizeof(MATRICES));
 
-        if (mode == RINGED_SYNC)
-        {
-            m_object.OnDraw(sync_index);
+            m_object.OnDraw();
+            ring.EndFrame();
         }
         else
         {
+            vs_uniforms->model_view = mv_matrix;
+            vs_uniforms->projection = proj_matrix;
+            glBindBufferBase(GL_UNIFORM_BUFFER, 0, m_buffer);
+
             m_object.OnDraw();
-        }
 
-        if (mode == FINISH)
-        {
-            glFinish();
-            stalled = true;
-        }
-        else if (mode == ONE_SYNC)
-        {
-            fence[0] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
-        }
-        else if (mode == RINGED_SYNC)
-        {
-            fence[sync_index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            if (mode == FINISH)
+            {
+                glFinish();
+                stalled = true;
+            }
         }
-
-        sync_index = (sync_index + 1) % CHUNK_COUNT;
-        
     }
     void OnGui() {
         ImGui::Begin("User Defined Settings");
@@ -249,6 +214,8 @@ struct Application : public Program {
             ImGui::Text("Current Mode: RINGED_SYNC");
         if (stalled)
             ImGui::Text("STALLED");
+        ImGui::Text("ONE_SYNC stalls: %llu (%.2f ms)", m_one_sync.m_stats.m_stalls, m_one_sync.m_stats.m_stall_ms);
+        ImGui::Text("RINGED_SYNC stalls: %llu (%.2f ms)", m_ringed_sync.m_stats.m_stalls, m_ringed_sync.m_stats.m_stall_ms);
 
         ImGui::End();
 
@@ -1,6 +1,7 @@
 #include "Defines.h"
 #ifdef PACKET_BUFFER
 #include "System.h"
+#include "PacketStream.h"
 #include "Texture.h"
 #include "Model.h"
 #include "Mesh.h"
@@ -10,17 +11,27 @@
 static const GLchar* vs_source = R"(
 #version 450 core
 
+#extension GL_ARB_shader_draw_parameters : require
+
 layout (binding = 0) uniform BLOCK
 {
 	vec4 vtx_color[4];
 };
 
+//Per draw position and size, indexed by the base instance
+layout (std430, binding = 0) readonly buffer DRAWS
+{
+	vec4 draws[];
+};
+
 out vec4 vs_fs_color;
 
 void main()
 {
+	vec4 d = draws[gl_BaseInstanceARB];
+	vec2 corner = vec2((gl_VertexID & 2) - 1.0, (gl_VertexID & 1) * 2.0 - 1.0);
 	vs_fs_color = vtx_color[gl_VertexID & 3];
-	gl_Position = vec4((gl_VertexID & 2) - 1.0, (gl_VertexID & 1) * 2.0 - 1.0, 0.5, 1.0);
+	gl_Position = vec4(d.xy + corner * d.z, 0.5, 1.0);
 }
 )";
 
@@ -50,157 +61,14 @@ static const GLfloat colors[] = {
 	1.0f, 0.0f, 1.0f, 1.0f,
 };
 
-//namespace packet
-//{
-//	struct base;
-//
-//	typedef void (APIENTRY PFN_EXECUTE)(const base* __restrict pParams);
-//
-//	struct base
-//	{
-//		PFN_EXECUTE pfnExecute;
-//	};
-//
-//	struct BIND_PROGRAM : public base
-//	{
-//		GLuint program;
-//
-//		static void APIENTRY execute(const BIND_PROGRAM* __restrict pParams)
-//		{
-//			glUseProgram(pParams->program);
-//		}
-//	};
-//
-//	struct BIND_VERTEX_ARRAY : public base
-//	{
-//		GLuint vao;
-//
-//		static void APIENTRY execute(const BIND_VERTEX_ARRAY* __restrict pParams)
-//		{
-//			glBindVertexArray(pParams->vao);
-//		}
-//	};
-//
-//	struct BIND_BUFFER_RANGE : public base
-//	{
-//		GLenum target;
-//		GLuint index;
-//		GLuint buffer;
-//		GLintptr offset;
-//		GLsizeiptr size;
-//
-//		static void APIENTRY execute(const BIND_BUFFER_RANGE* __restrict pParams)
-//		{
-//			glBindBufferRange(pParams->target, pParams->index, pParams->buffer, pParams->offset, pParams->size);
-//		}
-//	};
-//
-//	struct DRAW_ARRAYS : public base
-//	{
-//		GLenum mode;
-//		GLint first;
-//		GLsizei count;
-//		GLsizei primcount;
-//		GLuint baseinstance;
-//
-//		static void APIENTRY execute(const DRAW_ARRAYS* __restrict pParams)
-//		{
-//			glDrawArraysInstancedBaseInstance(pParams->mode, pParams->first, pParams->count, pParams->primcount, pParams->baseinstance);
-//		}
-//	};
-//
-//	union ALL_PACKETS
-//	{
-//	public:
-//		PFN_EXECUTE execute;
-//	private:
-//		base Base;
-//		BIND_PROGRAM BindProgram;
-//		BIND_VERTEX_ARRAY BindVertexArray;
-//		DRAW_ARRAYS DrawArrays;
-//	};
-//}
-//
-//struct packet_stream
-//{
-//	unsigned int max_packets;
-//	packet::ALL_PACKETS* m_packets;
-//	unsigned int num_packets;
-//
-//	packet_stream() : max_packets(0), m_packets(nullptr), num_packets(0) { }
-//
-//	void Init(int max_packets_);
-//	void Execute();
-//
-//	inline void BindProgram(GLuint program);
-//	inline void BindVertexArray(GLuint vao);
-//	inline void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
-//	inline void DrawArrays(GLenum mode, GLint first, GLsizei count, GLsizei primcount, GLuint baseinstance);
-//
-//	template <typename T>
-//	T* NextPacket() { return reinterpret_cast<T*>(&m_packets[num_packets++]); }
-//};
-//
-//void packet_stream::Init(int max_packets_)
-//{
-//	max_packets = max_packets_;
-//	num_packets = 0;
-//	m_packets = new packet::ALL_PACKETS[max_packets];
-//	memset(m_packets, 0, max_packets * sizeof(packet::ALL_PACKETS));
-//}
-//
-//void packet_stream::Execute()
-//{
-//	const packet::ALL_PACKETS* pPacket;
-//
-//	if (!num_packets)
-//		return;
-//
-//	for (pPacket = m_packets; pPacket->execute != nullptr; pPacket++)
-//	{
-//		pPacket->execute((packet::base*)pPacket);
-//	}
-//}
-
-//void packet_stream::BindProgram(GLuint program)
-//{
-//	packet::BIND_PROGRAM* __restrict pPacket = NextPacket<packet::BIND_PROGRAM>();
-//
-//	pPacket->pfnExecute = packet::PFN_EXECUTE(packet::BIND_PROGRAM::execute);
-//	pPacket->program = program;
-//}
-//
-//void packet_stream::BindVertexArray(GLuint vao)
-//{
-//	packet::BIND_VERTEX_ARRAY* __restrict pPacket = NextPacket<packet::BIND_VERTEX_ARRAY>();
-//
-//	pPacket->pfnExecute = packet::PFN_EXECUTE(packet::BIND_VERTEX_ARRAY::execute);
-//	pPacket->vao = vao;
-//}
-//
-//void packet_stream::BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
-//{
-//	packet::BIND_BUFFER_RANGE* __restrict pPacket = NextPacket<packet::BIND_BUFFER_RANGE>();
-//
-//	pPacket->pfnExecute = packet::PFN_EXECUTE(packet::BIND_BUFFER_RANGE::execute);
-//	pPacket->target = target;
-//	pPacket->index = index;
-//	pPacket->buffer = buffer;
-//	pPacket->offset = offset;
-//	pPacket->size = size;
-//}
-//
-//void packet_stream::DrawArrays(GLenum mode, GLint first, GLsizei count, GLsizei primcount, GLuint baseinstance)
-//{
-//	packet::DRAW_ARRAYS* __restrict pPacket = NextPacket<packet::DRAW_ARRAYS>();
-//
-//	pPacket->pfnExecute = packet::PFN_EXECUTE(packet::DRAW_ARRAYS::execute);
-//	pPacket->mode = mode;
-//	pPacket->first = first;
-//	pPacket->count = count;
-//	pPacket->primcount = primcount;
-//	pPacket->baseinstance = baseinstance;
-//}
+//Every draw picks one of MATERIAL_COUNT rotations of the colors, changing every MATERIAL_RUN
+//draws, and records all of its binds. The replay drops the ones that are already in place.
+#define MATERIAL_COUNT 4
+#define MATERIAL_RUN 64
+#define MAX_DRAWS 100000
+
+static const int draw_counts[] = { 1000, 10000, 25000, 50000, 100000 };
+static const char* draw_count_names[] = { "1K", "10K", "25K", "50K", "100K" };
 
 struct Application : public Program {
 	float m_clear_color[4];
@@ -210,8 +78,17 @@ struct Application : public Program {
 	GLuint m_vao;
 	GLuint m_program;
 	GLuint m_buffer_block;
+	usize m_material_stride;
 
-	//packet_stream stream;
+	FrameRingBuffer m_draw_data;
+	std::vector<PacketStream> m_streams;	//One per recording thread
+	PacketReplay m_replay;
+
+	int m_count_index = 1;
+	int m_threads;
+	int m_max_threads;
+	f64 m_record_ms = 0.0;
+	f64 m_replay_ms = 0.0;
 
 	Application()
 		:m_clear_color{ 0.1f, 0.1f, 0.1f, 1.0f },
@@ -220,23 +97,29 @@ struct Application : public Program {
 	{}
 
 	void OnInit(Input& input, Audio& audio, Window& window) {
-		//Init Stream
-		//stream.Init(256);
-		
+		m_max_threads = omp_get_max_threads();
+		m_threads = m_max_threads;
+		m_streams.resize(m_max_threads);
 
 		m_program = LoadShaders(shader_text);
 		glGenVertexArrays(1, &m_vao);
-		
+
+		//Each material is the colors rotated by one, at uniform buffer offset alignment
+		GLint alignment;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		m_material_stride = ((sizeof(colors) + alignment - 1) / alignment) * alignment;
+		std::vector<u8> materials(m_material_stride * MATERIAL_COUNT);
+		for (int m = 0; m < MATERIAL_COUNT; ++m) {
+			for (int c = 0; c < 4; ++c) {
+				memcpy(&materials[m * m_material_stride + c * 4 * sizeof(GLfloat)], &colors[((c + m) & 3) * 4], 4 * sizeof(GLfloat));
+			}
+		}
 
 		glGenBuffers(1, &m_buffer_block);
 		glBindBuffer(GL_UNIFORM_BUFFER, m_buffer_block);
-		glBufferStorage(GL_UNIFORM_BUFFER, sizeof(colors), colors, 0);
-
+		glBufferStorage(GL_UNIFORM_BUFFER, materials.size(), materials.data(), 0);
 
-		/*stream.BindProgram(m_program);
-		stream.BindBufferRange(GL_UNIFORM_BUFFER, 0, m_buffer_block, 0, sizeof(colors));
-		stream.BindVertexArray(m_vao);
-		stream.DrawArrays(GL_TRIANGLES, 0, 4, 1, 0);*/
+		m_draw_data.Init(MAX_DRAWS * sizeof(glm::vec4));
 	}
 	void OnUpdate(Input& input, Audio& audio, Window& window, f64 dt) {
 		m_fps = window.GetFPS();
@@ -245,21 +128,67 @@ struct Application : public Program {
 	}
 	void OnDraw() {
 		glViewport(0, 0, 1600, 900);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		//stream.Execute();
-
-		glUseProgram(m_program);
-		glBindVertexArray(m_vao);
-		glBindBufferRange(GL_UNIFORM_BUFFER, 0, m_buffer_block, 0, sizeof(colors));
-		glDrawArrays(GL_TRIANGLES, 0, 12);
+		glClearBufferfv(GL_COLOR, 0, m_clear_color);
+
+		const int count = draw_counts[m_count_index];
+		m_draw_data.BeginFrame();
+		usize data_offset;
+		glm::vec4* draw_data = m_draw_data.Allocate<glm::vec4>(count, &data_offset);
+
+		//Each thread records a contiguous slice of the draws into its own stream
+		auto start = std::chrono::steady_clock::now();
+#pragma omp parallel num_threads(m_threads)
+		{
+			const int thread = omp_get_thread_num();
+			const int threads = omp_get_num_threads();
+			PacketStream& stream = m_streams[thread];
+			stream.Reset();
+			RecordDraws(stream, count * thread / threads, count * (thread + 1) / threads, count, draw_data, data_offset);
+		}
+		auto recorded = std::chrono::steady_clock::now();
+
+		//ImGui and the clear above leave bindings the replay doesn't know about
+		m_replay.Invalidate();
+		m_replay.m_stats = {};
+		m_replay.Execute(m_streams.data(), m_threads);
+		m_draw_data.EndFrame();
+		auto replayed = std::chrono::steady_clock::now();
+
+		m_record_ms = std::chrono::duration<f64, std::milli>(recorded - start).count();
+		m_replay_ms = std::chrono::duration<f64, std::milli>(replayed - recorded).count();
 	}
 	void OnGui() {
 		ImGui::Begin("User Defined Settings");
 		ImGui::Text("FPS: %d", m_fps);
 		ImGui::Text("Time: %f", m_time);
 		ImGui::ColorEdit4("Clear Color", m_clear_color);
+		ImGui::Combo("Draws", &m_count_index, draw_count_names, IM_ARRAYSIZE(draw_count_names));
+		ImGui::SliderInt("Recording threads", &m_threads, 1, m_max_threads);
+		ImGui::Checkbox("Drop redundant binds", &m_replay.m_eliminate);
+		ImGui::Text("Record: %.2f ms, replay: %.2f ms", m_record_ms, m_replay_ms);
+		ImGui::Text("Packets: %llu, draws: %llu, binds dropped: %llu", m_replay.m_stats.m_packets, m_replay.m_stats.m_draws, m_replay.m_stats.m_skipped);
 		ImGui::End();
 	}
+	//Records draws [first, last) of count and writes their positions
+	void RecordDraws(PacketStream& stream, int first, int last, int count, glm::vec4* draw_data, usize data_offset) {
+		const int columns = (int)ceilf(sqrtf((float)count * 16.0f / 9.0f));
+		const int rows = (count + columns - 1) / columns;
+		const float size = 1.0f / (float)columns;
+		const float t = (float)m_time;
+
+		for (int i = first; i < last; ++i) {
+			const float x = ((float)(i % columns) + 0.5f) / (float)columns * 2.0f - 1.0f;
+			const float y = ((float)(i / columns) + 0.5f) / (float)rows * 2.0f - 1.0f;
+			draw_data[i] = glm::vec4(x, y, size * (0.6f + 0.4f * sinf(t * 2.0f + (float)i * 0.01f)), 0.0f);
+
+			const int material = (i / MATERIAL_RUN) % MATERIAL_COUNT;
+			stream.BindProgram(m_program);
+			stream.BindVertexArray(m_vao);
+			stream.BindBufferRange(GL_UNIFORM_BUFFER, 0, m_buffer_block, material * m_material_stride, sizeof(colors));
+			stream.BindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, m_draw_data.m_buffer, data_offset, count * sizeof(glm::vec4));
+			stream.DrawArrays(GL_TRIANGLE_STRIP, 0, 4, 1, i);
+		}
+	}
 };
 
 SystemConf config = {
@@ -275,4 +204,4 @@ SystemConf config = {
 };
 
 MAIN(config)
-#endif //PACKET_BUFFER
\ No newline at end of file
+#endif //PACKET_BUFFER
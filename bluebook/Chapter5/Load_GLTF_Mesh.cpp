@@ -133,6 +133,8 @@ struct Application : public Program {
 		ImGui::Text("Time: %f", (double)m_time);
 		ImGui::ColorEdit4("Clear Color", m_clear_color);
 		ImGui::LabelText("Current Camera", "{%d}", m_model.m_current_camera);
+		const GLStateStats& state = GLState::LastFrame();
+		ImGui::Text("State calls: %u issued, %u elided", state.m_issued, state.m_elided);
 		ImGui::End();
 	}
 };
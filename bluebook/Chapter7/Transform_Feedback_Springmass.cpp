@@ -137,11 +137,6 @@ enum
 	CONNECTIONS_TOTAL = (POINTS_X - 1) * POINTS_Y * (POINTS_Y - 1) * POINTS_X
 };
 
-void SetFeedbackVaryings(GLuint program, int count, const char* const* varyings, GLenum mode) {
-	glTransformFeedbackVaryings(program, count, varyings, mode);
-	glLinkProgram(program);
-}
-
 struct Application : public Program {
 	float m_clear_color[4];
 	u64 m_fps;
@@ -175,12 +170,11 @@ struct Application : public Program {
 	void OnInit(Input& input, Audio& audio, Window& window) {
 		glEnable(GL_DEPTH_TEST);
 
-		m_update_program = LoadShaders(update_shader_text);
 		static const char* tf_varyings[] = {
 			"tf_position_mass",
 			"tf_velocity"
 		};
-		SetFeedbackVaryings(m_update_program, 2, tf_varyings, GL_SEPARATE_ATTRIBS);
+		m_update_program = LoadShaders(update_shader_text, tf_varyings, 2, GL_SEPARATE_ATTRIBS);
 		m_render_program = LoadShaders(render_shader_text);
 
 		glm::vec4* initial_positions = new glm::vec4[POINTS_TOTAL];
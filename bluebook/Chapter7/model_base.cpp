@@ -129,6 +129,185 @@ static ShaderText shader_text[] = {
 	{GL_NONE, NULL, NULL}
 };
 
+//Multi-draw indirect variant: transforms and material factors come from the compiled model's
+//storage buffers, indexed by the base instance each indirect command carries
+static const GLchar* indirect_vertex_shader_source = R"(
+#version 450 core
+#extension GL_ARB_shader_draw_parameters : require
+
+layout (location = 0) 
+in vec3 position;
+layout (location = 1) 
+in vec3 normal;
+layout (location = 2) 
+in vec2 uv;
+layout (location = 3)
+in vec3 tangent;
+
+layout (binding = 0, std140)
+uniform DefaultUniform
+{
+	mat4 u_view;
+	mat4 u_projection;
+	vec2 u_resolution;
+	float u_time;
+};
+
+struct DrawData
+{
+	mat4 model;
+	mat4 normal_matrix;
+	int material;
+};
+
+layout (binding = 3, std430)
+readonly buffer DrawBlock
+{
+	DrawData draws[];
+};
+
+out vec3 vs_normal;
+out vec2 vs_uv;
+out vec4 vs_frag_pos;
+flat out int vs_material;
+
+void main() 
+{
+	DrawData draw = draws[gl_BaseInstanceARB];
+	mat4 viewProj = u_projection * u_view;
+	gl_Position = viewProj * draw.model * vec4(position, 1.0);
+	vs_normal = mat3(draw.normal_matrix) * normal;
+	vs_uv = uv;
+	vs_frag_pos = vec4(draw.model[3][0], draw.model[3][1], draw.model[3][2], 1.0) * vec4(position, 1.0);
+	vs_material = draw.material;
+}
+)";
+
+//How the indirect fragment shader reads a material texture, one per SB::MaterialBackend. The
+//reference is the uvec2 the model wrote into the material SSBO for that slot. It arrives through
+//a flat varying, which isn't dynamically uniform across a multi-draw, so it can't index samplers
+//directly: arrays branch to a constant index, bindless relies on Model batching (CompileDraws)
+static const GLchar* bound_material_source = R"(
+#version 450 core
+
+layout (binding = 0)
+uniform sampler2D u_texture;
+
+layout (binding = 2)
+uniform sampler2D u_normal_texture;
+
+vec4 SampleMaterial(int slot, uvec2 reference, vec2 uv)
+{
+	if (slot == 0) return texture(u_texture, uv);
+	return texture(u_normal_texture, uv);
+}
+)";
+
+static const GLchar* bindless_material_source = R"(
+#version 450 core
+
+#extension GL_ARB_bindless_texture : require
+
+vec4 SampleMaterial(int slot, uvec2 reference, vec2 uv)
+{
+	return texture(sampler2D(reference), uv);
+}
+)";
+
+static const GLchar* array_material_source = R"(
+#version 450 core
+
+layout (binding = 8)
+uniform sampler2DArray u_arrays[8];
+
+vec4 SampleMaterial(int slot, uvec2 reference, vec2 uv)
+{
+	//A quad never spans two primitives, so the branch is uniform where the derivatives are taken.
+	//They're taken outside it all the same
+	vec3 coord = vec3(uv, float(reference.y));
+	vec2 dx = dFdx(uv);
+	vec2 dy = dFdy(uv);
+	switch (reference.x) {
+	case 0u: return textureGrad(u_arrays[0], coord, dx, dy);
+	case 1u: return textureGrad(u_arrays[1], coord, dx, dy);
+	case 2u: return textureGrad(u_arrays[2], coord, dx, dy);
+	case 3u: return textureGrad(u_arrays[3], coord, dx, dy);
+	case 4u: return textureGrad(u_arrays[4], coord, dx, dy);
+	case 5u: return textureGrad(u_arrays[5], coord, dx, dy);
+	case 6u: return textureGrad(u_arrays[6], coord, dx, dy);
+	default: return textureGrad(u_arrays[7], coord, dx, dy);
+	}
+}
+)";
+
+static const GLchar* material_sources[] = { bound_material_source, bindless_material_source, array_material_source };
+static const char* material_backend_names[] = { "Bound", "Bindless", "Texture arrays" };
+
+//Appended to one of the material sources above
+static const GLchar* indirect_fragment_shader_source = R"(
+layout (binding = 1, std140)
+uniform LightUniform
+{
+	vec3 u_light_pos;
+	float u_ambient_strength;
+	vec3 u_light_color;
+	float u_specular_strength;
+};
+
+struct MaterialData
+{
+	vec4 base_color_factor;
+	float alpha_cutoff;
+	float pad[3];
+	uvec2 textures[5];
+};
+
+layout (binding = 4, std430)
+readonly buffer MaterialBlock
+{
+	MaterialData materials[];
+};
+
+in vec3 vs_normal;
+in vec2 vs_uv;
+in vec4 vs_frag_pos;
+flat in int vs_material;
+
+out vec4 color;
+
+void main() 
+{
+	MaterialData material = materials[vs_material];
+
+	//Get diffuse color
+	vec4 diffuseColor = SampleMaterial(0, material.textures[0], vs_uv) * material.base_color_factor;
+
+	//Get normal map color
+	vec3 perturbedNormal = normalize(SampleMaterial(2, material.textures[2], vs_uv).rgb * 2.0 - 1.0);
+	vec3 surfaceNormal = normalize(mix(vec3(perturbedNormal.xy, 0.0), vs_normal, 0.5));
+
+	//Calculate the diffuse lighting
+	vec3 lightDirection = normalize(u_light_pos - vs_frag_pos.xyz);
+	float diffuse = max(0.0, dot(surfaceNormal, lightDirection));
+
+	//Calculate Specular
+	vec3 viewDirection = normalize(-vs_frag_pos.xyz);
+	vec3 halfwayDirection = normalize(lightDirection + viewDirection);
+	float specular = pow(max(0.0, dot(surfaceNormal, halfwayDirection)), 16.0);
+
+	//Get final fragment color
+	vec3 ambientLight = u_light_color * diffuseColor.rgb * u_ambient_strength;
+	vec3 diffuseLight = u_light_color * diffuseColor.rgb * diffuse;
+	vec3 specularLight = u_light_color * specular * u_specular_strength;
+	vec3 finalColor = ambientLight + diffuseLight + specularLight;
+
+	color = vec4(finalColor, diffuseColor.a);
+	if (color.a < material.alpha_cutoff) {
+		discard;
+	}
+}
+)";
+
 struct DefaultUniformBlock {		//std140
 	glm::mat4 u_view;				//offset 0
 	glm::mat4 u_proj;				//offset 16
@@ -241,6 +420,8 @@ struct Application : public Program {
 	bool m_input_mode_active = true;
 
 	GLuint m_program;
+	GLuint m_indirect_program[3] = {};	//Per SB::MaterialBackend, built the first time it's used
+	int m_material_backend = (int)SB::MaterialBackend::Bindless;
 	SB::Model m_model;
 	SB::Model m_light_model;
 	glm::vec3 m_cam_pos;
@@ -274,6 +455,9 @@ struct Application : public Program {
 		m_light_program = LoadShaders(light_shader_text);
 		m_light_model = SB::Model("./resources/sphere_light.glb");
 		m_model = SB::Model("./resources/ABeautifulGame.glb");
+		m_model.Compile((SB::MaterialBackend)m_material_backend);
+		m_material_backend = (int)m_model.m_arena.m_backend;
+		LoadIndirectProgram(m_model.m_arena.m_backend);
 
 
 		if (m_model.m_camera.m_cameras.size()) {
@@ -351,7 +535,7 @@ struct Application : public Program {
 
 		
 
-		glUseProgram(m_program);
+		glUseProgram(m_model.m_draw_indirect ? m_indirect_program[(int)m_model.m_arena.m_backend] : m_program);
 		glUniform3fv(5, 1, glm::value_ptr(m_camera.Eye()));
 		m_model.OnDraw();
 	}
@@ -367,8 +551,29 @@ struct Application : public Program {
 		ImGui::LabelText("Camera Pitch", "%f", m_camera.m_pitch);
 		ImGui::LabelText("Forward Vector", "x: %f y: %f z: %f", m_camera.m_forward_vector.x, m_camera.m_forward_vector.y, m_camera.m_forward_vector.z);
 		ImGui::DragFloat3("Light Position", glm::value_ptr(m_light_pos), 0.1f, -2.0f, 2.0f);
+		ImGui::Checkbox("Multi-draw indirect", &m_model.m_draw_indirect);
+		if (ImGui::Combo("Material textures", &m_material_backend, material_backend_names, IM_ARRAYSIZE(material_backend_names))) {
+			m_model.CompileMaterials((SB::MaterialBackend)m_material_backend);
+			m_material_backend = (int)m_model.m_arena.m_backend;
+			LoadIndirectProgram(m_model.m_arena.m_backend);
+		}
+		ImGui::Text("Multi-draw calls: %d for %d draws", (int)m_model.m_arena.m_batches.size(), (int)m_model.m_arena.m_draws.size());
 		ImGui::End();
 	}
+
+	//Only the backend the model settled on is compiled, the bindless source requires
+	//GL_ARB_bindless_texture and CompileMaterials never picks it without
+	void LoadIndirectProgram(SB::MaterialBackend backend) {
+		const int index = (int)backend;
+		if (m_indirect_program[index]) return;
+		const std::string fragment = std::string(material_sources[index]) + indirect_fragment_shader_source;
+		ShaderText text[] = {
+			{GL_VERTEX_SHADER, indirect_vertex_shader_source, NULL},
+			{GL_FRAGMENT_SHADER, fragment.c_str(), NULL},
+			{GL_NONE, NULL, NULL}
+		};
+		m_indirect_program[index] = LoadShaders(text);
+	}
 };
 
 SystemConf config = {
@@ -263,7 +263,8 @@ struct Application : public Program {
     GLuint m_tex_filter[2];
     GLuint m_tex_lut;
 
-    GLuint m_ubo_transform, m_ubo_material;
+    GLuint m_ubo_material;
+    FrameRingBuffer m_ubo_transform;
 
     float       bloom_thresh_min = 0.8f;
     float       bloom_thresh_max = 1.2f;
@@ -335,9 +336,7 @@ struct Application : public Program {
 
         m_cube.Load_OBJ("./resources/cube.obj");
 
-        glGenBuffers(1, &m_ubo_transform);
-        glBindBuffer(GL_UNIFORM_BUFFER, m_ubo_transform);
-        glBufferData(GL_UNIFORM_BUFFER, (2 + SPHERE_COUNT) * sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+        m_ubo_transform.Init((2 + SPHERE_COUNT) * sizeof(glm::mat4));
 
         struct material
         {
@@ -385,13 +384,15 @@ struct Application : public Program {
 
         glUseProgram(m_program);
 
-        glBindBufferBase(GL_UNIFORM_BUFFER, 0, m_ubo_transform);
+        m_ubo_transform.BeginFrame();
         struct transforms_t
         {
             glm::mat4 mat_proj;
             glm::mat4 mat_view;
             glm::mat4 mat_model[SPHERE_COUNT];
-        } *transforms = (transforms_t*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, sizeof(transforms_t), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        };
+        usize transforms_offset;
+        transforms_t* transforms = m_ubo_transform.Allocate<transforms_t>(1, &transforms_offset);
         transforms->mat_proj = glm::perspective(0.9f, (float)window.GetWindowDimensions().width / (float)window.GetWindowDimensions().height, 1.0f, 1000.0f);
         transforms->mat_view = glm::translate(glm::vec3(0.0f, 0.0f, -20.0f));
         for (int i = 0; i < SPHERE_COUNT; i++)
@@ -402,14 +403,15 @@ struct Application : public Program {
             transforms->mat_model[i] = glm::rotate(sinf((float)m_time + fi * 4.0f), glm::vec3(0.0, 1.0, 0.0)) * glm::translate(glm::vec3(cosf((float)m_time + fi) * 5.0f * r, sinf((float)m_time + fi * 4.0f) * 4.0f, sinf((float)m_time + fi) * 5.0f * r)) *
                 glm::rotate(sinf((float)m_time + fi * 2.13f) * 5.0f, glm::vec3(1.0, 0.0, 0.0)) * glm::rotate(cosf((float)m_time + fi * 1.37f), glm::vec3(0.0, 1.0, 0.0)) * glm::scale(glm::vec3(0.5f, 0.5f, 0.5f));
         }
-        
-        glUnmapBuffer(GL_UNIFORM_BUFFER);
+
+        m_ubo_transform.BindRange(GL_UNIFORM_BUFFER, 0, transforms_offset, sizeof(transforms_t));
         glBindBufferBase(GL_UNIFORM_BUFFER, 1, m_ubo_material);
 
         glUniform1f(5, bloom_thresh_min);
         glUniform1f(6, bloom_thresh_max);
 
         m_cube.OnDraw(SPHERE_COUNT);
+        m_ubo_transform.EndFrame();
 
         glDisable(GL_DEPTH_TEST);
 
@@ -70,6 +70,12 @@ struct Application : public Program {
 	PostProcess m_post_process_film_grain;
 	PostProcess m_post_process_chroma_shift;
 
+	//Resolved after every Init, u_time and u_resolution per pass in the order above
+	UniformHandle m_time_uniform[4];
+	UniformHandle m_resolution_uniform[4];
+	UniformHandle m_vhs_rate_uniform;
+	UniformHandle m_film_grain_strength_uniform;
+
 	SB::Camera m_camera;
 	bool m_input_mode = false;
 
@@ -108,6 +114,7 @@ struct Application : public Program {
 		m_post_process_vhs.Init("./shaders/post_process_vhs.frag", m_resolution.x, m_resolution.y);
 		m_post_process_film_grain.Init("./shaders/post_process_film_grain.frag", m_resolution.x, m_resolution.y);
 		m_post_process_chroma_shift.Init("./shaders/post_process_chroma_shift.frag", m_resolution.x, m_resolution.y);
+		ResolveUniforms();
 
 		m_cube.Load_OBJ("./resources/basic_scene.obj");
 
@@ -123,6 +130,7 @@ struct Application : public Program {
 			m_post_process_vhs.Init("./shaders/post_process_vhs.frag", m_resolution.x, m_resolution.y);
 			m_post_process_film_grain.Init("./shaders/post_process_film_grain.frag", m_resolution.x, m_resolution.y);
 			m_post_process_chroma_shift.Init("./shaders/post_process_chroma_shift.frag", m_resolution.x, m_resolution.y);
+			ResolveUniforms();
 			m_recompile = false;
 		}
 
@@ -159,31 +167,31 @@ struct Application : public Program {
 		RenderScene();
 		m_post_process_crt.EndFrame(m_clear_color);
 
-		m_post_process_crt.SetUniform("u_time", &time);
-		m_post_process_crt.SetUniform("u_resolution", &resolution);
+		m_post_process_crt.SetUniform(m_time_uniform[0], time);
+		m_post_process_crt.SetUniform(m_resolution_uniform[0], resolution);
 
 		m_post_process_vhs.StartFrame(m_clear_color);
 		m_post_process_crt.PresentFrame();
 		m_post_process_vhs.EndFrame(m_clear_color);
 
-		m_post_process_vhs.SetUniform("u_time", &time);
-		m_post_process_vhs.SetUniform("u_resolution", &resolution);
-		m_post_process_vhs.SetUniform("u_rate", &m_vhs_rate);
+		m_post_process_vhs.SetUniform(m_time_uniform[1], time);
+		m_post_process_vhs.SetUniform(m_resolution_uniform[1], resolution);
+		m_post_process_vhs.SetUniform(m_vhs_rate_uniform, m_vhs_rate);
 
 		m_post_process_film_grain.StartFrame(m_clear_color);
 		m_post_process_vhs.PresentFrame();
 		m_post_process_film_grain.EndFrame(m_clear_color);
 
-		m_post_process_film_grain.SetUniform("u_time", &time);
-		m_post_process_film_grain.SetUniform("u_resolution", &resolution);
-		m_post_process_film_grain.SetUniform("u_strength", &m_film_grain_strength);
+		m_post_process_film_grain.SetUniform(m_time_uniform[2], time);
+		m_post_process_film_grain.SetUniform(m_resolution_uniform[2], resolution);
+		m_post_process_film_grain.SetUniform(m_film_grain_strength_uniform, m_film_grain_strength);
 
 		m_post_process_chroma_shift.StartFrame(m_clear_color);
 		m_post_process_film_grain.PresentFrame();
 		m_post_process_chroma_shift.EndFrame(m_clear_color);
 
-		m_post_process_chroma_shift.SetUniform("u_time", &time);
-		m_post_process_chroma_shift.SetUniform("u_resolution", &resolution);
+		m_post_process_chroma_shift.SetUniform(m_time_uniform[3], time);
+		m_post_process_chroma_shift.SetUniform(m_resolution_uniform[3], resolution);
 
 		m_post_process_chroma_shift.PresentFrame();
 
@@ -209,6 +217,15 @@ struct Application : public Program {
 		ImGui::End();
 	}
 
+	void ResolveUniforms() {
+		PostProcess* passes[] = { &m_post_process_crt, &m_post_process_vhs, &m_post_process_film_grain, &m_post_process_chroma_shift };
+		for (int i = 0; i < 4; ++i) {
+			m_time_uniform[i] = passes[i]->GetUniform("u_time");
+			m_resolution_uniform[i] = passes[i]->GetUniform("u_resolution");
+		}
+		m_vhs_rate_uniform = m_post_process_vhs.GetUniform("u_rate");
+		m_film_grain_strength_uniform = m_post_process_film_grain.GetUniform("u_strength");
+	}
 	void RenderScene() {
 		if (m_wireframe) {
 			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -4,6 +4,7 @@
 #include "Texture.h"
 #include "Model.h"
 #include "Mesh.h"
+#include "MeshCache.h"
 #include "assimp/Importer.hpp"
 #include "assimp/scene.h"
 #include "assimp/postprocess.h"
@@ -272,8 +273,20 @@ struct Meshy
 };
 
 Meshy ImportMesh(const char* filename) {
+	const unsigned int import_flags = aiProcess_CalcTangentSpace | aiProcess_Triangulate | aiProcess_FlipUVs;
+
+	//Warm start skips Assimp and goes from the bake straight into buffer storage
+	BakedMesh baked;
+	if (baked.OpenSingle(filename, tangent_frame_layout, import_flags)) {
+		BakedBuffers buffers = baked.Upload(0);
+		Meshy result;
+		result.vao = buffers.m_vao;
+		result.count = buffers.m_count;
+		return result;
+	}
+
 	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(filename, aiProcess_CalcTangentSpace | aiProcess_Triangulate | aiProcess_FlipUVs);
+	const aiScene* scene = importer.ReadFile(filename, import_flags);
 
 	if (nullptr == scene) {
 		const char* error = importer.GetErrorString();
@@ -319,6 +332,8 @@ Meshy ImportMesh(const char* filename) {
 		std::cout << index_data[i] << std::endl;
 	}*/
 
+	BakedMesh::WriteSingle(filename, tangent_frame_layout, import_flags, vertex_data, index_data);
+
 	GLuint vao, vertex_buffer, index_buffer;
 	glCreateVertexArrays(1, &vao);
 
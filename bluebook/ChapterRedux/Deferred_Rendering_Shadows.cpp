@@ -4,6 +4,7 @@
 #include "Texture.h"
 #include "Model.h"
 #include "Mesh.h"
+#include "MeshCache.h"
 #include "assimp/Importer.hpp"
 #include "assimp/scene.h"
 #include "assimp/postprocess.h"
@@ -310,28 +311,47 @@ struct LightView {
 };
 
 struct Mesh {
-	GLuint vao;
-	size_t count;
+	GLuint vao = 0;
+	size_t count = 0;
+};
+
+struct MeshData {
+	vector<float> vertex_data;
+	vector<unsigned int> index_data;
 };
 
 static void DrawMesh(const Mesh& mesh) {
+	if (mesh.count == 0) return;
 	glBindVertexArray(mesh.vao);
 	glDrawElements(GL_TRIANGLES, mesh.count, GL_UNSIGNED_INT, (void*)0);
 }
 
 static void DrawMesh(const Mesh& mesh, size_t count) {
+	if (mesh.count == 0) return;
 	glBindVertexArray(mesh.vao);
 	glDrawElementsInstanced(GL_TRIANGLES, mesh.count, GL_UNSIGNED_INT, (void*)0, count);
 }
 
-Mesh ImportMesh(const char* filename) {
+//CPU side of the import, safe to run on an AssetManager worker
+bool DecodeMesh(const char* filename, MeshData& data) {
+	const unsigned int import_flags = aiProcess_CalcTangentSpace | aiProcess_Triangulate | aiProcess_FlipUVs;
+
+	//Warm start skips Assimp and copies the bake out of the mapping
+	BakedMesh baked;
+	if (baked.OpenSingle(filename, tangent_frame_layout, import_flags)) {
+		const BakedPart& part = baked.Part(0);
+		data.vertex_data.assign(baked.Vertices(0), baked.Vertices(0) + part.m_vertex_count * TANGENT_FRAME_FLOATS);
+		data.index_data.assign(baked.Indices(0), baked.Indices(0) + part.m_index_count);
+		return true;
+	}
+
 	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(filename, aiProcess_CalcTangentSpace | aiProcess_Triangulate | aiProcess_FlipUVs);
+	const aiScene* scene = importer.ReadFile(filename, import_flags);
 
 	if (nullptr == scene) {
 		const char* error = importer.GetErrorString();
-		printf(error);
-		assert(false);
+		printf("%s\n", error);
+		return false;
 	}
 
 	aiMesh* mesh = scene->mMeshes[0];
@@ -341,7 +361,8 @@ Mesh ImportMesh(const char* filename) {
 	aiVector3t<float>* bitangents = mesh->mBitangents;
 	aiVector3t<float>* texcoords = mesh->mTextureCoords[0];
 
-	vector<float> vertex_data;
+	vector<float>& vertex_data = data.vertex_data;
+	vertex_data.reserve(mesh->mNumVertices * TANGENT_FRAME_FLOATS);
 	for (int i = 0; i < mesh->mNumVertices; ++i) {
 		vertex_data.push_back(vertices[i].x);
 		vertex_data.push_back(vertices[i].y);
@@ -360,13 +381,23 @@ Mesh ImportMesh(const char* filename) {
 	}
 
 	aiFace* faces = mesh->mFaces;
-	vector<unsigned int> index_data;
+	vector<unsigned int>& index_data = data.index_data;
+	index_data.reserve(mesh->mNumFaces * 3);
 	for (int i = 0; i < mesh->mNumFaces; ++i) {
 		index_data.push_back(faces[i].mIndices[0]);
 		index_data.push_back(faces[i].mIndices[1]);
 		index_data.push_back(faces[i].mIndices[2]);
 	}
 
+	BakedMesh::WriteSingle(filename, tangent_frame_layout, import_flags, vertex_data, index_data);
+
+	return true;
+}
+
+Mesh UploadMesh(const MeshData& data) {
+	const vector<float>& vertex_data = data.vertex_data;
+	const vector<unsigned int>& index_data = data.index_data;
+
 	GLuint vao, vertex_buffer, index_buffer;
 	glCreateVertexArrays(1, &vao);
 
@@ -412,6 +443,25 @@ Mesh ImportMesh(const char* filename) {
 	return result;
 }
 
+Mesh ImportMesh(const char* filename) {
+	MeshData data;
+	if (!DecodeMesh(filename, data)) {
+		assert(false);
+		return Mesh();
+	}
+	return UploadMesh(data);
+}
+
+//Decodes on a worker, *mesh stays empty (and is skipped by DrawMesh) until the upload runs
+void ImportMeshAsync(Mesh* mesh, const char* filename) {
+	auto data = std::make_shared<MeshData>();
+	string name = filename;
+	AssetManager::Submit(
+		[data, name]() { return DecodeMesh(name.c_str(), *data); },
+		[data, mesh]() { *mesh = UploadMesh(*data); }
+	);
+}
+
 struct Application : public Program {
 	float m_clear_color[4];
 	u64 m_fps;
@@ -461,15 +511,16 @@ struct Application : public Program {
 		m_deferred_lighting_program = LoadShaders(deferred_lighting_shader_text);
 		m_shadowmap_program = LoadShaders(shadow_map_shader_text);
 		m_camera = SB::Camera("Camera", glm::vec3(0.0f, 0.2f, -0.5f), glm::vec3(0.0f, 0.0f, 0.0f), SB::CameraType::Perspective, 16.0 / 9.0, 0.9, 0.01, 1000.0);
-		m_mesh[0] = ImportMesh("./resources/rook2/rook.obj");
-		m_mesh[1] = ImportMesh("./resources/chessboard/chessboard.obj");
-		m_mesh[2] = ImportMesh("./resources/spot_light/spotlight.obj");
-
-		m_mesh_diffuse_tex[0] = Load_KTX("./resources/rook2/rook_base.ktx");
-		m_mesh_normal_tex[0] = Load_KTX("./resources/rook2/rook_normal.ktx");
-		m_mesh_diffuse_tex[1] = Load_KTX("./resources/chessboard/chessboard_base_color.ktx");
-		m_mesh_normal_tex[1] = Load_KTX("./resources/chessboard/chessboard_normal.ktx");
-		m_mesh_diffuse_tex[2] = Load_KTX("./resources/spot_light/spotlight.ktx");
+		//Meshes and textures stream in over the first few frames instead of blocking OnInit
+		ImportMeshAsync(&m_mesh[0], "./resources/rook2/rook.obj");
+		ImportMeshAsync(&m_mesh[1], "./resources/chessboard/chessboard.obj");
+		ImportMeshAsync(&m_mesh[2], "./resources/spot_light/spotlight.obj");
+
+		m_mesh_diffuse_tex[0] = AssetManager::LoadKTX("./resources/rook2/rook_base.ktx");
+		m_mesh_normal_tex[0] = AssetManager::LoadKTX("./resources/rook2/rook_normal.ktx");
+		m_mesh_diffuse_tex[1] = AssetManager::LoadKTX("./resources/chessboard/chessboard_base_color.ktx");
+		m_mesh_normal_tex[1] = AssetManager::LoadKTX("./resources/chessboard/chessboard_normal.ktx");
+		m_mesh_diffuse_tex[2] = AssetManager::LoadKTX("./resources/spot_light/spotlight.ktx");
 
 		m_light_proj = glm::perspective(1.0, 1.0 / 1.0, 0.1, 100.0);
 		m_light_view[0] = glm::lookAt(glm::vec3(0.0f, 0.5f, 0.5f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
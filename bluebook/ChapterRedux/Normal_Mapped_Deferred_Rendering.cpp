@@ -4,6 +4,7 @@
 #include "Texture.h"
 #include "Model.h"
 #include "Mesh.h"
+#include "MeshCache.h"
 #include "assimp/Importer.hpp"
 #include "assimp/scene.h"
 #include "assimp/postprocess.h"
@@ -259,8 +260,20 @@ static void DrawMesh(const Mesh& mesh, size_t count) {
 }
 
 Mesh ImportMesh(const char* filename) {
+	const unsigned int import_flags = aiProcess_CalcTangentSpace | aiProcess_Triangulate | aiProcess_FlipUVs;
+
+	//Warm start skips Assimp and goes from the bake straight into buffer storage
+	BakedMesh baked;
+	if (baked.OpenSingle(filename, tangent_frame_layout, import_flags)) {
+		BakedBuffers buffers = baked.Upload(0);
+		Mesh result;
+		result.vao = buffers.m_vao;
+		result.count = buffers.m_count;
+		return result;
+	}
+
 	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(filename, aiProcess_CalcTangentSpace | aiProcess_Triangulate | aiProcess_FlipUVs);
+	const aiScene* scene = importer.ReadFile(filename, import_flags);
 
 	if (nullptr == scene) {
 		const char* error = importer.GetErrorString();
@@ -301,6 +314,8 @@ Mesh ImportMesh(const char* filename) {
 		index_data.push_back(faces[i].mIndices[2]);
 	}
 
+	BakedMesh::WriteSingle(filename, tangent_frame_layout, import_flags, vertex_data, index_data);
+
 	GLuint vao, vertex_buffer, index_buffer;
 	glCreateVertexArrays(1, &vao);
 
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "GL_Helpers.h"
+
+#include <functional>
+
+struct ObjMesh;
+
+//-------------------------------------------------------------------------------------------------
+// ASSET MANAGER
+//-------------------------------------------------------------------------------------------------
+
+//Loads assets on a pool of worker threads. Each load is split in two: a decode step that does
+//file I/O and CPU-side parsing on a worker, and an upload step that creates the GL objects.
+//Decoded assets wait in a bounded queue that Event::Run drains on the render thread for a
+//fixed time budget each frame, so a burst of loads never stalls a single frame for long.
+struct AssetManager {
+	static void Init(u32 thread_count = 0);
+	static void Shutdown();
+
+	//decode runs on a worker; if it returns true, upload is queued for the render thread
+	static void Submit(std::function<bool()> decode, std::function<void()> upload);
+
+	//Runs queued uploads until the budget (in seconds) is spent, always runs at least one
+	static void Pump(f64 budget);
+	//Blocks until every submitted asset has been uploaded or has failed
+	static void WaitIdle();
+
+	static void SetUploadBudget(f64 seconds) { s_upload_budget = seconds; }
+	static f64 GetUploadBudget() { return s_upload_budget; }
+	static u32 Pending();
+
+	//Returns a texture of target immediately, it can be bound right away and reads as incomplete
+	//until the upload fills it in. target has to be the file's, a mismatch is reported and skipped
+	static GLuint LoadKTX(const char* filename, GLenum target = GL_TEXTURE_2D);
+	//Fills in mesh once the upload runs, m_count stays 0 until then. mesh must outlive the load
+	static void LoadOBJ(ObjMesh* mesh, const char* filename, bool tangents = false);
+
+private:
+	static f64 s_upload_budget;
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "GL_Helpers.h"
+
+//-------------------------------------------------------------------------------------------------
+// BLOCK COMPRESSION
+//-------------------------------------------------------------------------------------------------
+
+//Decodes one block into a row-major 4x4 grid of texels, bytes per texel given by the layout
+typedef void (*BlockDecodeFn)(const u8* block, u8* texels);
+
+//Everything needed to size and, where possible, decode a block-compressed format.
+//Images are a grid of ceil(width / block width) * ceil(height / block height) blocks per slice.
+struct BlockFormat {
+	GLenum m_format;			//Compressed internal format
+	u8 m_block_width;
+	u8 m_block_height;
+	u8 m_block_bytes;
+	GLenum m_decoded_format;	//Storage format the CPU fallback decodes to, GL_NONE if there's no decoder
+	GLenum m_decoded_layout;	//GL_RED, GL_RG or GL_RGBA
+	GLenum m_decoded_type;		//GL_UNSIGNED_BYTE, or GL_BYTE for the signed formats
+	BlockDecodeFn m_decode;
+};
+
+//nullptr if internal_format isn't a block-compressed format
+const BlockFormat* FindBlockFormat(GLenum internal_format);
+
+//Bytes of one 2D slice, or of depth slices
+usize CompressedImageSize(const BlockFormat& format, u32 width, u32 height, u32 depth = 1);
+//Bytes of one decoded texel
+u32 DecodedTexelSize(const BlockFormat& format);
+
+//Whether the driver can store the format for target. Compressed formats it doesn't list are
+//rejected by glTextureStorage, those need the CPU fallback
+bool CompressedFormatSupported(GLenum target, GLenum internal_format);
+
+//Decodes depth slices of width x height into tightly packed texels of the decoded layout.
+//dst must hold width * height * depth * DecodedTexelSize bytes
+bool DecodeCompressedImage(const BlockFormat& format, const u8* src, u32 width, u32 height, u32 depth, u8* dst);
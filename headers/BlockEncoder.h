@@ -0,0 +1,48 @@
+#pragma once
+
+#include "GL_Helpers.h"
+
+#include <vector>
+
+//-------------------------------------------------------------------------------------------------
+// BLOCK ENCODER
+//-------------------------------------------------------------------------------------------------
+
+enum struct EncodeFormat {
+	BC1,		//RGB, alpha is dropped
+	BC3,		//RGBA
+	BC5,		//Red and green, for normal maps
+	BC7,		//RGBA, mode 6 only
+};
+
+enum struct EncodeQuality {
+	Fast,		//Bounding box endpoints, indices assigned once
+	Normal,		//Better of the bounding box and principal axis endpoints, refined once by least squares
+	High,		//Refined until it stops improving, then a search around the quantized endpoints
+};
+
+struct EncodeSettings {
+	EncodeFormat m_format = EncodeFormat::BC7;
+	EncodeQuality m_quality = EncodeQuality::Normal;
+	bool m_srgb = false;		//Pick the sRGB variant of the format, BC5 has none
+	bool m_threads = true;		//Blocks rows spread over OpenMP threads
+	bool m_simd = true;			//SSE palette search, scalar otherwise
+};
+
+struct EncodeStats {
+	u64 m_texels;
+	u64 m_block_texels;			//Texels the error covers, edge blocks count their repeated texels
+	f64 m_seconds;
+	f64 m_squared_error;		//Summed over the encoded channels
+	u32 m_channels;				//Channels the error covers
+
+	f64 MTexelsPerSecond() const { return m_seconds > 0.0 ? (f64)m_texels / m_seconds / 1.0e6 : 0.0; }
+	f64 PSNR() const;
+};
+
+//Compressed internal format the settings produce
+GLenum EncodeFormatGL(const EncodeSettings& settings);
+
+//Encodes one RGBA8 image with tightly packed rows. Edge blocks that hang over the image repeat its
+//last row and column. out is resized to the compressed size, stats is added to
+void EncodeImage(const u8* rgba, u32 width, u32 height, const EncodeSettings& settings, std::vector<u8>& out, EncodeStats* stats = nullptr);
@@ -15,5 +15,9 @@
 #define MSAA4X
 //#define MSAA8X
 
+//Run the current project through the offscreen frame time benchmark instead of a window,
+//see ProgramBenchmark.h
+//#define BENCHMARK_PROGRAMS
+
 //Current Project
 #define PER_PIXEL_GLOSS
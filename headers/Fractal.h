@@ -0,0 +1,68 @@
+#pragma once
+
+#include "GL_Helpers.h"
+
+#include <vector>
+
+//-------------------------------------------------------------------------------------------------
+// FRACTAL
+//-------------------------------------------------------------------------------------------------
+
+//Pixel spacing of the first progressive level, tiles are aligned to it
+#define FRACTAL_COARSEST_STEP 8
+
+//Julia set z = z^2 + c, z starting at zoom * (pixel / size - 0.5) + offset
+struct FractalParams {
+	float m_cx, m_cy;
+	float m_offset_x, m_offset_y;
+	float m_zoom;
+	int m_max_iterations = 256;
+
+	bool operator==(const FractalParams& other) const;
+	bool operator!=(const FractalParams& other) const { return !(*this == other); }
+};
+
+enum struct FractalKernel {
+	Scalar,		//One pixel at a time
+	SIMD,		//16 pixels per group with AVX2, 8 with SSE, lanes retire as they escape
+};
+
+//Renders 8-bit escape counts, a pixel that never escapes wraps to 0 as the sample always did.
+//The image is cut into tiles handed out to OpenMP threads one at a time, most expensive first
+//going by the iteration counts of the previous frame, so the slow tiles inside the set don't all
+//end up at the back of the queue. Output goes straight to the caller's buffer, normally the
+//persistent mapped pixel buffer.
+struct FractalRenderer {
+	int m_width = 0;
+	int m_height = 0;
+	FractalKernel m_kernel = FractalKernel::SIMD;
+	bool m_threads = true;
+
+	void Init(int width, int height);
+
+	//Renders the whole image
+	void Render(const FractalParams& params, unsigned char* out);
+
+	//Progressive rendering: the first call after the parameters change fills the image from every
+	//FRACTAL_COARSEST_STEP'th pixel, each later call halves the step and only computes the new
+	//pixels. Levels run until budget (seconds) is spent. Returns true once the image is exact
+	bool Refine(const FractalParams& params, unsigned char* out, f64 budget);
+	int Step() const { return m_step; }
+
+private:
+	struct Tile {
+		int m_x, m_y;
+		int m_width, m_height;
+	};
+
+	//Computes every step'th pixel and fills the step x step block below and right of it. With
+	//refine set the pixels already computed at step * 2 are skipped
+	void RenderLevel(const FractalParams& params, unsigned char* out, int step, bool refine);
+	void RenderTile(const FractalParams& params, unsigned char* out, const Tile& tile, int step, bool refine, u64* iterations);
+
+	std::vector<Tile> m_tiles;
+	std::vector<u64> m_tile_cost;		//Iterations spent in each tile last time it was rendered
+	std::vector<int> m_order;
+	FractalParams m_refine_params = {};
+	int m_step = 0;						//Step of the last finished progressive level, 0 before the first
+};
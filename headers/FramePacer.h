@@ -0,0 +1,77 @@
+#pragma once
+
+#include "GL_Helpers.h"
+
+#include <chrono>
+
+//-------------------------------------------------------------------------------------------------
+// FRAME PACING
+//-------------------------------------------------------------------------------------------------
+
+enum struct PacingPolicy {
+	Uncapped,		//No waiting, dt is whatever the frame took
+	FixedCap,		//Wait until the frame limit interval has elapsed
+	Adaptive,		//Like FixedCap, but drops to a multiple of the interval when frames run long
+	FixedTimestep	//Render capped, update in fixed steps and expose an interpolation alpha
+};
+
+struct PacingStats {
+	f64 target;			//Current target interval in seconds
+	f64 mean;			//Mean measured interval over the history window
+	f64 jitter;			//Standard deviation of the measured interval
+	f64 min;
+	f64 max;
+	f64 work;			//Moving average of time spent between Wait() and the next Wait()
+	f64 sleep_error;	//Worst observed oversleep, used as the spin margin
+	u64 missed;			//Frames that ended later than target + 1ms
+	u64 frames;
+};
+
+struct FramePacer {
+	FramePacer(f64 frame_limit);
+	~FramePacer();
+
+	void SetFrameLimit(f64 limit);
+	void SetPolicy(PacingPolicy policy) { m_policy = policy; Reset(); }
+	void SetFixedTimestep(f64 rate);
+	void Reset();
+
+	//Blocks until the next frame is due and returns the elapsed time since the last call
+	f64 Wait();
+	//Number of fixed updates to run this frame, only meaningful for PacingPolicy::FixedTimestep
+	u32 ConsumeSteps();
+
+	PacingPolicy GetPolicy() { return m_policy; }
+	f64 GetInterval() { return m_interval; }
+	f64 GetTimestep() { return m_timestep; }
+	f64 GetAlpha() { return m_accumulator / m_timestep; }
+	PacingStats GetStats();
+
+private:
+	f64 Now();
+	void SleepUntil(f64 deadline);
+	f64 AdaptiveInterval();
+	void Record(f64 interval);
+
+private:
+	static const u32 HISTORY = 128;
+	static const u32 MAX_STEPS = 8;
+
+	std::chrono::steady_clock::time_point m_epoch;
+	PacingPolicy m_policy;
+	f64 m_interval;
+	f64 m_target;
+	f64 m_timestep;
+	f64 m_accumulator;
+
+	f64 m_last;
+	f64 m_deadline;
+	f64 m_work;
+	f64 m_sleep_error;
+
+	f64 m_history[HISTORY];
+	u32 m_history_count;
+	u32 m_history_head;
+	u64 m_missed;
+	u64 m_frames;
+};
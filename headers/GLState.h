@@ -0,0 +1,47 @@
+#pragma once
+
+#include "GL_Helpers.h"
+
+//-------------------------------------------------------------------------------------------------
+// GL STATE CACHE
+//-------------------------------------------------------------------------------------------------
+
+//Texture and sampler units that are tracked, higher units go straight to GL
+#define GL_STATE_TEXTURE_UNITS 16
+//Indexed uniform and shader storage bindings that are tracked
+#define GL_STATE_BUFFER_BINDINGS 16
+
+struct GLStateStats {
+	u32 m_issued;		//Calls that reached GL
+	u32 m_elided;		//Calls skipped because GL already had that state
+};
+
+//Shadow copy of the state the draw loops change most, calls that wouldn't change anything never
+//reach the driver. GL calls made around the cache leave the copy stale, so every tracked value
+//starts out unknown after Invalidate and the first call always goes through. Event::Run
+//invalidates at the start of each frame, code that mixes in raw calls, like Model::OnDraw
+//running inside a sample, invalidates when it starts drawing.
+struct GLState {
+	//Forgets everything, the next call of each kind is issued
+	static void Invalidate();
+	//Moves this frame's counters to LastFrame and invalidates
+	static void BeginFrame();
+	static const GLStateStats& LastFrame();
+	static const GLStateStats& ThisFrame();
+
+	//GL_BLEND, GL_CULL_FACE and GL_DEPTH_TEST are tracked, other caps are passed through
+	static void Enable(GLenum cap, bool enable);
+	static void BlendFunc(GLenum src, GLenum dst);
+	static void CullFace(GLenum face);
+	static void DepthFunc(GLenum func);
+	static void DepthMask(bool write);
+
+	static void UseProgram(GLuint program);
+	static void BindVertexArray(GLuint vao);
+	static void BindTextureUnit(GLuint unit, GLuint texture);
+	static void BindSampler(GLuint unit, GLuint sampler);
+	//GL_DRAW_INDIRECT_BUFFER, GL_PARAMETER_BUFFER and GL_DISPATCH_INDIRECT_BUFFER are tracked
+	static void BindBuffer(GLenum target, GLuint buffer);
+	//GL_UNIFORM_BUFFER and GL_SHADER_STORAGE_BUFFER are tracked
+	static void BindBufferBase(GLenum target, GLuint index, GLuint buffer);
+};
@@ -35,6 +35,15 @@ typedef unsigned int GLenum;
 typedef unsigned int GLuint;
 typedef int GLsizei;
 typedef char GLchar;
+typedef struct __GLsync* GLsync;
+
+//Defaults of LoadShaders and AssetManager::LoadKTX, same token sequence as glew's so either may come first
+#ifndef GL_INTERLEAVED_ATTRIBS
+#define GL_INTERLEAVED_ATTRIBS 0x8C8C
+#endif
+#ifndef GL_TEXTURE_2D
+#define GL_TEXTURE_2D 0x0DE1
+#endif
 
 
 struct ShaderFiles {
@@ -60,12 +69,96 @@ struct WindowXY {
 };
 
 
-GLuint LoadShaders(ShaderText*);
-GLuint LoadShaders(ShaderFiles*);
+//Builds the program through ShaderCache. In async mode a program that fails to link is still
+//returned, ShaderCache::Resolve says whether it linked. Transform feedback varyings go in here,
+//relinking the returned program doesn't work once it comes from a cached binary
+GLuint LoadShaders(ShaderText* shaders, const char* const* varyings = nullptr, u32 varying_count = 0, GLenum buffer_mode = GL_INTERLEAVED_ATTRIBS);
+GLuint LoadShaders(ShaderFiles* shaders, const char* const* varyings = nullptr, u32 varying_count = 0, GLenum buffer_mode = GL_INTERLEAVED_ATTRIBS);
+void GetShaderCompilationStatus(GLuint shader);
+void GetProgramLinkedStatus(GLuint program);
 size_t GetGLTypeSize(GLenum type);
 GLFWimage rgba_bmp_load(const char* filePath);
 void Debug_Callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* user_param);
 
 
+//Marks a function that uses AVX2/FMA intrinsics in a project built without /arch:AVX2.
+//MSVC emits VEX code for the intrinsics anyway, other compilers need the target attribute.
+//Only call such functions after CPU_HasAVX2 returned true
+#ifdef _MSC_VER
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+#endif //_MSC_VER
+
+//True when the CPU and OS support AVX2 and FMA, checked once
+bool CPU_HasAVX2();
+
 void GetShaderCompilationStatus(GLuint shader);
 void GetProgramLinkedStatus(GLuint program);
+
+
+//-------------------------------------------------------------------------------------------------
+// FRAME RING BUFFER
+//-------------------------------------------------------------------------------------------------
+
+//Frames the CPU may run ahead of the GPU before BeginFrame has to wait
+#define FRAME_RING_FRAMES 3
+#define FRAME_RING_MAX_FRAMES 8
+
+struct FrameRingStats {
+	u64 m_frames;			//BeginFrame calls
+	u64 m_stalls;			//Frames where the region to reuse was still in use by the GPU
+	f64 m_stall_ms;			//Total time spent waiting on those
+	f64 m_last_stall_ms;	//Wait of the latest frame, 0 if it didn't stall
+	u64 m_failed;			//Allocations that didn't fit in their frame's region
+	usize m_peak;			//Most bytes allocated in one frame
+};
+
+//One persistently mapped buffer cut into a region per frame in flight. Per frame data like
+//uniforms, transforms or indirect commands is written straight into the mapping and bound by
+//offset, so there is no orphaning, remapping or implicit sync in the driver. The region of a
+//frame is fenced at EndFrame and only waited on when it comes around again.
+//
+//	ring.BeginFrame();
+//	Transforms* t = ring.Allocate<Transforms>(1, &offset);
+//	...
+//	ring.BindRange(GL_UNIFORM_BUFFER, 0, offset, sizeof(Transforms));
+//	glDraw...
+//	ring.EndFrame();
+struct FrameRingBuffer {
+	GLuint m_buffer = 0;
+	u8* m_mapped = nullptr;
+	usize m_frame_size = 0;		//Bytes per frame region
+	u32 m_frames = 0;
+	FrameRingStats m_stats = {};
+
+	//frame_size is what a single frame may allocate. Alignment defaults to the largest of the
+	//uniform and storage buffer offset alignments
+	bool Init(usize frame_size, u32 frames = FRAME_RING_FRAMES);
+	void Destroy();
+
+	//Waits until the GPU is done with the region this frame reuses
+	void BeginFrame();
+	//Fences the region written this frame
+	void EndFrame();
+
+	//Returns space in the current frame's region or nullptr if it's full. alignment 0 uses
+	//m_alignment, which fits any uniform, storage or indirect binding
+	void* Allocate(usize size, usize* offset, usize alignment = 0);
+	template <typename T>
+	T* Allocate(usize count, usize* offset) { return (T*)Allocate(count * sizeof(T), offset); }
+
+	//Writes data into the ring and binds it, returns false if it didn't fit
+	bool Upload(GLenum target, GLuint index, const void* data, usize size);
+
+	void BindRange(GLenum target, GLuint index, usize offset, usize size) const;
+
+	usize Alignment() const { return m_alignment; }
+
+private:
+	usize m_alignment = 256;
+	u32 m_frame = 0;
+	usize m_head = 0;			//Offset within the current frame's region
+	bool m_in_frame = false;
+	GLsync m_fences[FRAME_RING_MAX_FRAMES] = {};
+};
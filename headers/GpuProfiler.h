@@ -0,0 +1,76 @@
+#pragma once
+
+#include "GL_Helpers.h"
+
+#include <deque>
+#include <vector>
+
+//-------------------------------------------------------------------------------------------------
+// GPU PROFILER
+//-------------------------------------------------------------------------------------------------
+
+//Frames that may be waiting on their results before profiling skips a frame rather than wait
+#define GPU_PROFILER_FRAMES 4
+//Resolved frames kept for Export by default
+#define GPU_PROFILER_HISTORY 120
+
+struct GpuTiming {
+	const char* name;
+	u32 depth;			//0 for top level scopes
+	i32 parent;			//Index of the enclosing scope, -1 at the top
+	f64 start_ms;		//From the frame's first timestamp
+	f64 ms;
+};
+
+struct GpuFrameTimings {
+	u64 frame;						//Frame number the timings were recorded in
+	u64 start_ns;					//GPU clock at the frame's first timestamp
+	f64 ms;							//First to last timestamp of the frame
+	std::vector<GpuTiming> scopes;	//Depth first, parents before their children
+};
+
+//Times nested scopes on the GPU with GL_TIMESTAMP queries taken from a pool. A frame's queries
+//are only read once GL_QUERY_RESULT_AVAILABLE is set on its last one, usually a couple of
+//frames later, so nothing ever waits on the GPU. Event::Run begins and ends the frames and puts
+//OnDraw and OnGui in scopes of their own, samples nest theirs inside with GpuScope.
+//Scope names aren't copied, they have to outlive the history, string literals do.
+struct GpuProfiler {
+	static void BeginFrame();
+	static void EndFrame();
+	static void Shutdown();
+
+	static void Push(const char* name);
+	static void Pop();
+
+	static void SetEnabled(bool enabled) { s_enabled = enabled; }
+	static bool IsEnabled() { return s_enabled; }
+
+	//Most recent frame with results, frame is 0 until the first one resolves
+	static const GpuFrameTimings& Latest();
+	//Frames between recording and reading back the latest results
+	static u64 Latency();
+	//Frames that weren't recorded because GPU_PROFILER_FRAMES frames were still pending
+	static u64 Skipped();
+	//Resolved frames, oldest first. SetHistory changes how many are kept until Shutdown, the
+	//benchmark runner keeps every frame it measures
+	static const std::deque<GpuFrameTimings>& History();
+	static void SetHistory(u32 frames);
+	//Waits for the GPU and reads back every pending frame, for the end of a benchmark
+	static void Flush();
+
+	//Timing tree of the latest frame, for a sample's OnGui
+	static void OnGui();
+	//Writes the history as a Chrome trace (chrome://tracing, Perfetto). Only touches results
+	//that were already read back
+	static bool Export(const char* filename);
+
+private:
+	static bool s_enabled;
+};
+
+struct GpuScope {
+	GpuScope(const char* name) { GpuProfiler::Push(name); }
+	~GpuScope() { GpuProfiler::Pop(); }
+	GpuScope(const GpuScope&) = delete;
+	GpuScope& operator=(const GpuScope&) = delete;
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "GL_Helpers.h"
+
+//Read-only memory mapping of a whole file. Pages are faulted in by the OS on first access,
+//so nothing is copied onto the heap. Move-only, the mapping is released on destruction.
+struct MappedFile {
+	MappedFile();
+	MappedFile(const char* filename);
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile();
+
+	bool Open(const char* filename);
+	void Close();
+
+	bool IsOpen() const { return m_data != nullptr; }
+	const unsigned char* Data() const { return m_data; }
+	usize Size() const { return m_size; }
+
+private:
+	const unsigned char* m_data;
+	usize m_size;
+#ifdef _WIN32
+	void* m_file;
+	void* m_mapping;
+#else
+	int m_file;
+#endif //_WIN32
+};
@@ -2,12 +2,28 @@
 #include "GL_Helpers.h"
 #include "glm/common.hpp"
 #include "glm/glm.hpp"
+#include <vector>
+
+//Interleaved vertex and index data parsed from an OBJ file, ready for ObjMesh::Upload.
+//Vertices are position, normal, texcoord and, when m_tangents is set, a tangent.
+struct ObjMeshData {
+    std::vector<float> m_vertices;
+    std::vector<GLuint> m_indices;
+    bool m_tangents = false;
+};
+
+struct BakedMesh;
+
+//Reads the baked copy when it's current, otherwise parses the source and bakes it
+bool Parse_OBJ(const char* filename, ObjMeshData& data, bool tangents = false);
+//Always parses the source text, never touches the bake
+bool Parse_OBJ_Source(const char* filename, ObjMeshData& data, bool tangents = false);
 
 struct ObjMesh {
-    GLuint m_vao;
-    GLuint m_vertex_buffer;
-    GLuint m_index_buffer;
-    GLsizei m_count;
+    GLuint m_vao = 0;
+    GLuint m_vertex_buffer = 0;
+    GLuint m_index_buffer = 0;
+    GLsizei m_count = 0;
 
     f64 m_time;
     WindowXY m_resolution;
@@ -15,7 +31,9 @@ struct ObjMesh {
 
     void Load_OBJ(const char* filename);
     void Load_OBJ_Tan(const char* filename);
+    void Upload(const ObjMeshData& data);
+    void Upload_Baked(const BakedMesh& baked);
     void OnUpdate(f64 dt);
     void OnDraw();
     void OnDraw(int instances);
-};
\ No newline at end of file
+};
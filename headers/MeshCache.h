@@ -0,0 +1,115 @@
+#pragma once
+
+#include "GL_Helpers.h"
+#include "MappedFile.h"
+
+#include <vector>
+
+//-------------------------------------------------------------------------------------------------
+// BAKED MESH CACHE
+//-------------------------------------------------------------------------------------------------
+
+//Imported meshes are baked to "<source>.<tag>.sbmesh" next to the source asset. A bake holds one
+//or more parts, each an interleaved float vertex buffer with its layout, a u32 index buffer and
+//bounds. The header records the source's size and last write time plus a hash of its contents,
+//and a key over the import flags and the format version. A size change rejects the bake
+//straight away, matching size and time accept it, and only a touched source of the same size
+//is hashed to tell. When the contents still match, the new time is written into the header. A
+//stale or foreign bake is ignored and rewritten on the next cold import.
+
+#define BAKED_MESH_VERSION 2
+#define BAKED_MESH_MAX_ATTRIBUTES 8
+
+//One float vertex attribute inside the interleaved vertex
+struct BakedAttribute {
+	u32 m_location;
+	u32 m_components;
+	u32 m_offset;
+};
+
+struct BakedMeshHeader {
+	char m_magic[4];
+	u32 m_version;
+	u64 m_key;				//Import flags, extra key and format version
+	u64 m_source_hash;		//Contents of the source when baked
+	u64 m_source_size;
+	i64 m_source_time;		//Last write time of the source, in file clock ticks
+	u32 m_part_count;
+	u32 m_reserved;
+};
+
+struct BakedPart {
+	u32 m_stride;
+	u32 m_attribute_count;
+	BakedAttribute m_attributes[BAKED_MESH_MAX_ATTRIBUTES];
+	u32 m_vertex_count;
+	u32 m_index_count;
+	float m_bounds_min[3];
+	float m_bounds_max[3];
+	u64 m_vertex_offset;	//Byte offsets from the start of the file, 16 byte aligned
+	u64 m_index_offset;
+};
+
+//CPU side mesh to be baked, the pointers only need to live until BakedMesh::Write returns
+struct BakedPartDesc {
+	const float* m_vertices;
+	u32 m_vertex_count;
+	u32 m_stride;
+	const BakedAttribute* m_attributes;
+	u32 m_attribute_count;
+	const u32* m_indices;
+	u32 m_index_count;
+};
+
+//Layout of a one part bake, shared by importers that build a single interleaved mesh
+struct BakedLayout {
+	const char* m_tag;
+	u32 m_stride;
+	const BakedAttribute* m_attributes;
+	u32 m_attribute_count;
+};
+
+//Interleaved position, normal, tangent, bitangent and uv, the vertex the ChapterRedux samples
+//build from Assimp
+#define TANGENT_FRAME_FLOATS 14
+extern const BakedLayout tangent_frame_layout;
+
+//GL objects created from a baked part
+struct BakedBuffers {
+	GLuint m_vao;
+	GLuint m_vertex_buffer;
+	GLuint m_index_buffer;
+	GLsizei m_count;
+};
+
+struct BakedMesh {
+	//Maps the bake for source if one exists and its key matches. extra_key folds in anything
+	//the source file alone doesn't cover, such as external glTF buffers
+	bool Open(const char* source, const char* tag, u32 flags, u64 extra_key = 0);
+	static bool Write(const char* source, const char* tag, u32 flags, const BakedPartDesc* parts, u32 part_count, u64 extra_key = 0);
+
+	//The lookup and store of a single mesh importer. OpenSingle only accepts a bake of one part in
+	//the layout's stride, so Vertices(0) can be read with it
+	bool OpenSingle(const char* source, const BakedLayout& layout, u32 flags);
+	static bool WriteSingle(const char* source, const BakedLayout& layout, u32 flags, const std::vector<float>& vertices, const std::vector<u32>& indices);
+
+	u32 PartCount() const { return m_header ? m_header->m_part_count : 0; }
+	const BakedPart& Part(u32 index) const { return m_parts[index]; }
+	const float* Vertices(u32 index) const { return (const float*)(m_file.Data() + m_parts[index].m_vertex_offset); }
+	const u32* Indices(u32 index) const { return (const u32*)(m_file.Data() + m_parts[index].m_index_offset); }
+
+	//Creates the VAO and buffers straight from the mapping
+	BakedBuffers Upload(u32 index) const;
+
+	static u64 Hash(const void* data, usize size, u64 seed);
+	static u64 Key(u32 flags, u64 extra_key);
+	static u64 SourceHash(const char* source);
+
+	MappedFile m_file;
+	const BakedMeshHeader* m_header = nullptr;
+	const BakedPart* m_parts = nullptr;
+};
+
+//Uploads interleaved vertices and u32 indices, laying out the VAO from the attribute list.
+//Shared by the bake and cold import paths so both produce identical VAOs
+BakedBuffers Upload_Interleaved(const float* vertices, u32 vertex_count, u32 stride, const BakedAttribute* attributes, u32 attribute_count, const u32* indices, u32 index_count);
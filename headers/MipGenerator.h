@@ -0,0 +1,44 @@
+#pragma once
+
+#include "GL_Helpers.h"
+
+#include <vector>
+
+//-------------------------------------------------------------------------------------------------
+// MIP GENERATOR
+//-------------------------------------------------------------------------------------------------
+
+enum struct MipFilter {
+	Box,		//2x2 average
+	Kaiser,		//8 tap windowed sinc, sharper, rings a little on hard edges
+};
+
+enum struct MipContent {
+	Linear,		//Channels filtered as they're stored
+	SRGB,		//Color channels filtered in linear light, alpha as it's stored
+	NormalMap,	//XYZ remapped to [-1, 1] and renormalized, two channel maps rebuild Z for the filter
+};
+
+struct MipSettings {
+	MipFilter m_filter = MipFilter::Kaiser;
+	MipContent m_content = MipContent::Linear;
+	bool m_threads = true;		//Several chains spread over OpenMP threads, one chain its rows
+	bool m_simd = true;			//SSE or AVX2 filter, scalar otherwise
+};
+
+//One image and the levels built from it. Levels halve each side down to 1x1, a side already at
+//1 stays there. The source is 1 to 4 8-bit channels, m_levels gets tightly packed rows of the same
+struct MipChain {
+	const u8* m_source = nullptr;
+	u32 m_width = 0;
+	u32 m_height = 0;
+	u32 m_channels = 4;
+	u32 m_pitch = 0;						//Bytes between source rows, 0 if tightly packed
+	std::vector<std::vector<u8>> m_levels;	//Level 1 onwards
+};
+
+//Levels of a full chain, the base level included
+u32 MipLevelCount(u32 width, u32 height, u32 depth = 1);
+
+//Fills m_levels of every chain, replacing what was there
+void GenerateMipChains(MipChain* chains, u32 count, const MipSettings& settings);
@@ -1,10 +1,16 @@
 #pragma once
 
 #include "GL/glew.h" 
+#include "MeshCache.h"
+#include "GLState.h"
 
 #include <iostream>
 
 #include <string>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <tuple>
 #include <vector>
 using std::string;
 using std::vector;
@@ -232,15 +238,82 @@ namespace SB
 		}
 	}
 
+	//What the materials read from an image, decides the format it's stored in
+	enum ImageUsage {
+		IMAGE_COLOR = 1 << 0,			//Base color and emissive, RGBA
+		IMAGE_NORMAL = 1 << 1,			//RGB
+		IMAGE_OCCLUSION = 1 << 2,		//R
+		IMAGE_METAL_ROUGH = 1 << 3,		//G roughness, B metallic
+	};
+
 	struct Images {
 		Images() = default;
-		void Init(vector<tinygltf::Image>& images);
+		//Picks a format per image from how the materials use it and allocates full mip chains
+		void Init(tinygltf::Model& model);
 		GLuint GetTexture(int index) { return m_textures[index]; }
 		vector<GLuint> m_textures;
+		vector<GLenum> m_formats;
 		GLuint m_white_texture;
 		GLuint m_default_texture;
+
+		usize m_bytes = 0;				//All mip levels of every texture
+		usize m_rgba32f_bytes = 0;		//The same textures as single level RGBA32F, how they used to be stored
+
+		//Color images become SRGB8_ALPHA8 when set, for samples rendering with GL_FRAMEBUFFER_SRGB.
+		//Left off they stay RGBA8 so colors look the same as in a linear framebuffer
+		static bool s_srgb;
 	};
 
+	bool Images::s_srgb = false;
+
+	static usize TextureBytes(GLenum format, GLsizei width, GLsizei height, GLsizei levels) {
+		const usize texel = format == GL_R8 ? 1 : format == GL_RG8 ? 2 : 4;
+		usize bytes = 0;
+		for (GLsizei level = 0; level < levels; ++level) {
+			bytes += (usize)std::max(width >> level, 1) * std::max(height >> level, 1) * texel;
+		}
+		return bytes;
+	}
+
+	static GLsizei MipLevels(GLsizei width, GLsizei height) {
+		GLsizei levels = 1;
+		while ((std::max(width, height) >> levels) > 0) levels++;
+		return levels;
+	}
+
+	//Reads from R8 and RG8 textures look like they did from the RGBA original: occlusion
+	//still comes from .r, roughness from .g and metallic from .b
+	static void SetImageSwizzle(GLuint texture, GLenum format) {
+		if (format == GL_R8) {
+			const GLint swizzle[] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+			glTextureParameteriv(texture, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+		}
+		else if (format == GL_RG8) {
+			const GLint swizzle[] = { GL_ZERO, GL_RED, GL_GREEN, GL_ONE };
+			glTextureParameteriv(texture, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+		}
+	}
+
+	//Packs the source channels listed in channels into 8 bit texels. Grey and grey-alpha images
+	//spread their grey over RGB, a missing alpha reads as opaque
+	static vector<u8> PackImage(const tinygltf::Image& image, const int* channels, int count) {
+		const usize pixels = (usize)image.width * image.height;
+		const int component = image.component;
+		const int bytes = image.bits == 16 ? 2 : 1;
+		vector<u8> out(pixels * count);
+		for (usize p = 0; p < pixels; ++p) {
+			const unsigned char* src = &image.image[p * component * bytes];
+			for (int c = 0; c < count; ++c) {
+				int channel = channels[c];
+				if (component <= 2) channel = channel < 3 ? 0 : (component == 2 ? 1 : -1);
+				else if (channel >= component) channel = -1;
+				//16 bit channels are little endian, keep the high byte
+				out[p * count + c] = channel < 0 ? 255 : src[channel * bytes + bytes - 1];
+			}
+		}
+		return out;
+	}
+
 	int* DefaultTexture() {
 		const int grey = 0x5c737c;
 		const int dark_grey = 0x32414d;
@@ -258,31 +331,86 @@ namespace SB
 		return data;
 	}
 
-	void Images::Init(vector<tinygltf::Image>& images) {
+	void Images::Init(tinygltf::Model& model) {
+		vector<tinygltf::Image>& images = model.images;
+
+		//Gather how each image is used by the materials
+		vector<int> usage(images.size(), 0);
+		auto use = [&](int texture, int flags) {
+			if (texture < 0 || texture >= (int)model.textures.size()) return;
+			const int source = model.textures[texture].source;
+			if (source >= 0 && source < (int)usage.size()) usage[source] |= flags;
+		};
+		for (const auto& material : model.materials) {
+			use(material.pbrMetallicRoughness.baseColorTexture.index, IMAGE_COLOR);
+			use(material.emissiveTexture.index, IMAGE_COLOR);
+			use(material.normalTexture.index, IMAGE_NORMAL);
+			use(material.occlusionTexture.index, IMAGE_OCCLUSION);
+			use(material.pbrMetallicRoughness.metallicRoughnessTexture.index, IMAGE_METAL_ROUGH);
+		}
+
+		static const int rgba[] = { 0, 1, 2, 3 };
+		static const int red[] = { 0 };
+		static const int green_blue[] = { 1, 2 };
+
 		m_textures.resize(images.size(), 0);
+		m_formats.resize(images.size(), GL_RGBA8);
 		glCreateTextures(GL_TEXTURE_2D, images.size(), m_textures.data());
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 		for (size_t i = 0; i < images.size(); ++i) {
 			const auto& image = images[i];
-			glTextureStorage2D(m_textures[i], 1, GL_RGBA32F, image.width, image.height);
-			glBindTexture(GL_TEXTURE_2D, m_textures[i]);
-			glTextureSubImage2D(m_textures[i], 0, 0, 0, image.width, image.height, GL_RGBA, image.pixel_type, image.image.data());
-			glGenerateMipmap(GL_TEXTURE_2D);
+
+			//Occlusion alone only needs R, metallic roughness alone G and B. An image that packs
+			//both, normals and anything unused keep all four channels
+			GLenum format = GL_RGBA8;
+			GLenum layout = GL_RGBA;
+			const int* channels = rgba;
+			int count = 4;
+			if (usage[i] & IMAGE_COLOR) {
+				format = s_srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+			}
+			else if (usage[i] == IMAGE_OCCLUSION) {
+				format = GL_R8;
+				layout = GL_RED;
+				channels = red;
+				count = 1;
+			}
+			else if (usage[i] == IMAGE_METAL_ROUGH) {
+				format = GL_RG8;
+				layout = GL_RG;
+				channels = green_blue;
+				count = 2;
+			}
+
+			const GLsizei levels = MipLevels(image.width, image.height);
+			const vector<u8> texels = PackImage(image, channels, count);
+			glTextureStorage2D(m_textures[i], levels, format, image.width, image.height);
+			glTextureSubImage2D(m_textures[i], 0, 0, 0, image.width, image.height, layout, GL_UNSIGNED_BYTE, texels.data());
+			glGenerateTextureMipmap(m_textures[i]);
+			SetImageSwizzle(m_textures[i], format);
+
+			m_formats[i] = format;
+			m_bytes += TextureBytes(format, image.width, image.height, levels);
+			m_rgba32f_bytes += (usize)image.width * image.height * 16;
 		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
 		//Create single white pixel
 		glCreateTextures(GL_TEXTURE_2D, 1, &m_white_texture);
-		glTextureStorage2D(m_white_texture, 1, GL_RGBA32F, 1, 1);
-		glBindTexture(GL_TEXTURE_2D, m_white_texture);
+		glTextureStorage2D(m_white_texture, 1, GL_RGBA8, 1, 1);
 		int data = 0xFFFFFFFF;
 		glTextureSubImage2D(m_white_texture, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, &data);
 
 		//Create default texture
 		glCreateTextures(GL_TEXTURE_2D, 1, &m_default_texture);
-		glTextureStorage2D(m_default_texture, 1, GL_RGBA32F, 32, 32);
-		glBindTexture(GL_TEXTURE_2D, m_default_texture);
+		glTextureStorage2D(m_default_texture, MipLevels(32, 32), GL_RGBA8, 32, 32);
 		const int* default_data = DefaultTexture();
 		glTextureSubImage2D(m_default_texture, 0, 0, 0, 32, 32, GL_RGBA, GL_UNSIGNED_BYTE, default_data);
+		glGenerateTextureMipmap(m_default_texture);
 		delete[] default_data;
+
+		m_bytes += TextureBytes(GL_RGBA8, 1, 1, 1) + TextureBytes(GL_RGBA8, 32, 32, MipLevels(32, 32));
+		m_rgba32f_bytes += (1 + 32 * 32) * 16;
 	}
 
 	struct Sampler {
@@ -357,62 +485,34 @@ namespace SB
 		float m_alpha_cutoff;
 		bool m_double_sided;
 
-		void BindMaterial();
+		//uniforms = false leaves locations 7 and 8 alone, for shaders that read the material SSBO
+		void BindMaterial(bool uniforms = true);
+		//Blend and cull state only, for materials whose textures come from a texture table
+		void BindState();
 	};
 
-	void Material::BindMaterial() {
-		switch (m_alpha_mode) {
-		case AlphaMode::Opaque:
-			glDisable(GL_BLEND);
-			glUniform1f(8, 0.0f);
-			break;
-		case AlphaMode::Mask:
-			glDisable(GL_BLEND);
-			glUniform1f(8, m_alpha_cutoff);
-			break;
-		case AlphaMode::Blend:
-			glEnable(GL_BLEND);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-			glUniform1f(8, 0.0f);
-			break;
-		default:
-			break;
-		}
+	void Material::BindState() {
+		GLState::Enable(GL_BLEND, m_alpha_mode == AlphaMode::Blend);
+		if (m_alpha_mode == AlphaMode::Blend) GLState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		GLState::Enable(GL_CULL_FACE, !m_double_sided);
+	}
 
-		if (m_double_sided) glDisable(GL_CULL_FACE);
-		else glEnable(GL_CULL_FACE);
-
-		if (m_base_color_texture >= 0) {
-			glActiveTexture(GL_TEXTURE0 + 0);
-			//glBindTexture(GL_TEXTURE_2D, m_base_color_texture);
-			glBindTextureUnit(0, m_base_color_texture);
-			glBindSampler(0, m_base_sampler);
-		}
-		if (m_metallic_roughness_texture >= 0) {
-			glActiveTexture(GL_TEXTURE0 + 1);
-			//glBindTexture(GL_TEXTURE_2D, m_metallic_roughness_texture);
-			glBindTextureUnit(1, m_metallic_roughness_texture);
-			glBindSampler(1, m_metallic_sampler);
-		}
-		if (m_normal_texture >= 0) {
-			glActiveTexture(GL_TEXTURE0 + 2);
-			//glBindTexture(GL_TEXTURE_2D, m_normal_texture);
-			glBindTextureUnit(2, m_normal_texture);
-			glBindSampler(2, m_normal_sampler);
-		}
-		if (m_occlusion_texture >= 0) {
-			glActiveTexture(GL_TEXTURE0 + 3);
-			//glBindTexture(GL_TEXTURE_2D, m_occlusion_texture);
-			glBindTextureUnit(3, m_occlusion_texture);
-			glBindSampler(3, m_occlusion_sampler);
-		}
-		if (m_emissive_texture >= 0) {
-			glActiveTexture(GL_TEXTURE0 + 4);
-			//glBindTexture(GL_TEXTURE_2D, m_emissive_texture);
-			glBindTextureUnit(4, m_emissive_texture);
-			glBindSampler(4, m_emissive_sampler);
-		}
-		glUniform4fv(7, 1, m_color_factors);
+	void Material::BindMaterial(bool uniforms) {
+		BindState();
+		if (uniforms) glUniform1f(8, m_alpha_mode == AlphaMode::Mask ? m_alpha_cutoff : 0.0f);
+
+		//Materials::Init fills missing textures with the white one, every unit has a texture
+		GLState::BindTextureUnit(0, m_base_color_texture);
+		GLState::BindSampler(0, m_base_sampler);
+		GLState::BindTextureUnit(1, m_metallic_roughness_texture);
+		GLState::BindSampler(1, m_metallic_sampler);
+		GLState::BindTextureUnit(2, m_normal_texture);
+		GLState::BindSampler(2, m_normal_sampler);
+		GLState::BindTextureUnit(3, m_occlusion_texture);
+		GLState::BindSampler(3, m_occlusion_sampler);
+		GLState::BindTextureUnit(4, m_emissive_texture);
+		GLState::BindSampler(4, m_emissive_sampler);
+		if (uniforms) glUniform4fv(7, 1, m_color_factors);
 	}
 
 	struct Materials {
@@ -510,145 +610,336 @@ namespace SB
 		GLsizei m_count;
 		GLint m_material;
 		GLint m_topology;
+
+		GLuint m_vertex_buffer;
+		GLuint m_index_buffer;
+		GLsizei m_vertex_count;
+		GLsizei m_stride;		//In bytes
+
+		//Offsets into the shared arena once the model is compiled, 0 before
+		GLint m_base_vertex;
+		GLuint m_first_index;
 	};
 
-	struct Mesh {
-		Mesh(const tinygltf::Model& model, int mesh_index);
-		string m_name;
-		vector<MeshData> m_meshes;
+	//-------------------------------------------------------------------------------------------------
+	// PRIMITIVE EXTRACTION
+	//-------------------------------------------------------------------------------------------------
+
+	//Interleaved float layout of an extracted primitive: position, normal, texcoord and then an
+	//optional tangent. Attributes a primitive lacks are zero filled so the layout never changes
+	struct PrimitiveLayout {
+		u32 m_vertex_count;
+		u32 m_index_count;
+		u32 m_tangent_components;	//0 when there is no TANGENT or none was asked for
+		u32 m_stride;				//In floats
+		bool m_complete;			//Every slot is covered by an accessor, no zero fill needed
 	};
 
-	Mesh::Mesh(const tinygltf::Model& model, int mesh_index) 
-		:m_name(model.meshes[mesh_index].name)
-	{
-		const auto& mesh = model.meshes[mesh_index];
-		//Extract the Position, Normal and TextureCoord data for current mesh
-		for (const auto& primitive : mesh.primitives) {
-
-			GLuint m_vao, m_vertex_buffer, m_index_buffer;
-
-			vector<float> positions;
-			vector<float> normals;
-			vector<float> texcoords;
-			vector<float> tangents;
-			vector<unsigned int> indices;
-
-			//Get Positions
-			const auto& positionAccessor = model.accessors[primitive.attributes.at("POSITION")];
-			const auto& positionView = model.bufferViews[positionAccessor.bufferView];
-			const float* positionData = reinterpret_cast<const float*>(model.buffers[positionView.buffer].data.data() + positionView.byteOffset + positionAccessor.byteOffset);
-			for (size_t i = 0; i < positionAccessor.count * 3; i++) {
-				positions.push_back(positionData[i]);
+	template <typename T>
+	static void ConvertAccessor(const unsigned char* src, usize src_stride, usize count, u32 components, float scale, bool clamp, float* dst, usize dst_stride) {
+		for (usize i = 0; i < count; ++i, src += src_stride, dst += dst_stride) {
+			for (u32 c = 0; c < components; ++c) {
+				T value;
+				memcpy(&value, src + c * sizeof(T), sizeof(T));
+				float f = (float)value * scale;
+				dst[c] = clamp && f < -1.0f ? -1.0f : f;
 			}
+		}
+	}
 
-			//Get Normals
-			if (primitive.attributes.count("NORMAL") > 0) {
-				const auto& normalAccessor = model.accessors[primitive.attributes.at("NORMAL")];
-				const auto& normalView = model.bufferViews[normalAccessor.bufferView];
-				const float* normalData = reinterpret_cast<const float*>(model.buffers[normalView.buffer].data.data() + normalView.byteOffset + normalAccessor.byteOffset);
-				for (size_t i = 0; i < normalAccessor.count * 3; i++) {
-					normals.push_back(normalData[i]);
-				}
+	//Reads count elements of any component type as floats into a strided destination, honouring
+	//byteStride and normalized. Only the first components of each element are written
+	static void ConvertElements(const unsigned char* src, usize src_stride, usize count, int component_type, bool normalized, u32 components, float* dst, usize dst_stride) {
+		switch (component_type) {
+		case GL_FLOAT:
+			if (dst_stride == components && src_stride == components * sizeof(float)) {
+				memcpy(dst, src, count * components * sizeof(float));
 			}
-
-			//Get Texture Coords
-			if (primitive.attributes.count("TEXCOORD_0") > 0) {
-				const auto& texAccessor = model.accessors[primitive.attributes.at("TEXCOORD_0")];
-				const auto& texView = model.bufferViews[texAccessor.bufferView];
-				const float* texCoordData = reinterpret_cast<const float*>(model.buffers[texView.buffer].data.data() + texView.byteOffset + texAccessor.byteOffset);
-				for (size_t i = 0; i < texAccessor.count * 2; i++) {
-					texcoords.push_back(texCoordData[i]);
+			else {
+				for (usize i = 0; i < count; ++i, src += src_stride, dst += dst_stride) {
+					memcpy(dst, src, components * sizeof(float));
 				}
 			}
+			break;
+		case GL_UNSIGNED_BYTE:
+			ConvertAccessor<u8>(src, src_stride, count, components, normalized ? 1.0f / 255.0f : 1.0f, false, dst, dst_stride);
+			break;
+		case GL_BYTE:
+			ConvertAccessor<i8>(src, src_stride, count, components, normalized ? 1.0f / 127.0f : 1.0f, normalized, dst, dst_stride);
+			break;
+		case GL_UNSIGNED_SHORT:
+			ConvertAccessor<u16>(src, src_stride, count, components, normalized ? 1.0f / 65535.0f : 1.0f, false, dst, dst_stride);
+			break;
+		case GL_SHORT:
+			ConvertAccessor<i16>(src, src_stride, count, components, normalized ? 1.0f / 32767.0f : 1.0f, normalized, dst, dst_stride);
+			break;
+		case GL_UNSIGNED_INT:
+			ConvertAccessor<u32>(src, src_stride, count, components, 1.0f, false, dst, dst_stride);
+			break;
+		}
+	}
 
-			//Get Tangents
-			if (primitive.attributes.count("TANGENT") > 0) {
-				const auto& tanAccessor = model.accessors[primitive.attributes.at("TANGENT")];
-				const auto& tanView = model.bufferViews[tanAccessor.bufferView];
-				const float* tangentData = reinterpret_cast<const float*>(model.buffers[tanView.buffer].data.data() + tanView.byteOffset + tanAccessor.byteOffset);
-				for (size_t i = 0; i < tanAccessor.count * 3; i++) {
-					tangents.push_back(tangentData[i]);
-				}
+	static u32 ReadIndex(const unsigned char* src, int component_type) {
+		switch (component_type) {
+		case GL_UNSIGNED_BYTE: return *src;
+		case GL_UNSIGNED_SHORT: { u16 v; memcpy(&v, src, sizeof(v)); return v; }
+		default: { u32 v; memcpy(&v, src, sizeof(v)); return v; }
+		}
+	}
+
+	//Writes up to count elements of the accessor into dst, sparse substitutions included.
+	//Elements beyond the accessor's own components are left untouched
+	static void ReadAccessor(const tinygltf::Model& model, const tinygltf::Accessor& accessor, usize count, u32 components, float* dst, usize dst_stride) {
+		const u32 accessor_components = tinygltf::GetNumComponentsInType(accessor.type);
+		const usize element_size = tinygltf::GetComponentSizeInBytes(accessor.componentType);
+		if (components > accessor_components) components = accessor_components;
+		if (count > accessor.count) count = accessor.count;
+
+		if (accessor.bufferView >= 0) {
+			const auto& view = model.bufferViews[accessor.bufferView];
+			int stride = accessor.ByteStride(view);
+			if (stride <= 0) return;
+			const unsigned char* src = model.buffers[view.buffer].data.data() + view.byteOffset + accessor.byteOffset;
+			ConvertElements(src, stride, count, accessor.componentType, accessor.normalized, components, dst, dst_stride);
+		}
+		else {
+			//No buffer view means all zeros, only the sparse values below are set
+			for (usize i = 0; i < count; ++i) {
+				memset(dst + i * dst_stride, 0, components * sizeof(float));
 			}
+		}
 
-			//Get Indices
-			const auto& indexAccessor = model.accessors[primitive.indices];
-			const auto& indexView = model.bufferViews[indexAccessor.bufferView];
-			if (indexAccessor.componentType == GL_UNSIGNED_INT) {
-				const unsigned int* indexData = reinterpret_cast<const unsigned int*>(model.buffers[indexView.buffer].data.data() + indexView.byteOffset + indexAccessor.byteOffset);
-				for (size_t i = 0; i < indexAccessor.count; i++) {
-					indices.push_back(indexData[i]);
-				}
+		if (accessor.sparse.isSparse) {
+			const auto& index_view = model.bufferViews[accessor.sparse.indices.bufferView];
+			const auto& value_view = model.bufferViews[accessor.sparse.values.bufferView];
+			const unsigned char* indices = model.buffers[index_view.buffer].data.data() + index_view.byteOffset + accessor.sparse.indices.byteOffset;
+			const unsigned char* values = model.buffers[value_view.buffer].data.data() + value_view.byteOffset + accessor.sparse.values.byteOffset;
+			const usize index_size = tinygltf::GetComponentSizeInBytes(accessor.sparse.indices.componentType);
+			const usize value_size = element_size * accessor_components;
+
+			for (int i = 0; i < accessor.sparse.count; ++i) {
+				u32 target = ReadIndex(indices + i * index_size, accessor.sparse.indices.componentType);
+				if (target >= count) continue;
+				ConvertElements(values + i * value_size, value_size, 1, accessor.componentType, accessor.normalized, components, dst + target * dst_stride, dst_stride);
 			}
-			else {
-				const unsigned short* indexData = reinterpret_cast<const unsigned short*>(model.buffers[indexView.buffer].data.data() + indexView.byteOffset + indexAccessor.byteOffset);
-				for (size_t i = 0; i < indexAccessor.count; i++) {
-					indices.push_back(indexData[i]);
-				}
+		}
+	}
+
+	static const tinygltf::Accessor* FindAttribute(const tinygltf::Model& model, const tinygltf::Primitive& primitive, const char* name) {
+		auto it = primitive.attributes.find(name);
+		if (it == primitive.attributes.end() || it->second < 0) return nullptr;
+		return &model.accessors[it->second];
+	}
+
+	//Sizes a primitive without touching its data, so the output can be allocated exactly once.
+	//tangent_components is 0, 3 or 4 depending on how much of the TANGENT the caller wants
+	static PrimitiveLayout MeasurePrimitive(const tinygltf::Model& model, const tinygltf::Primitive& primitive, u32 tangent_components) {
+		PrimitiveLayout layout = {};
+		const tinygltf::Accessor* position = FindAttribute(model, primitive, "POSITION");
+		if (!position) return layout;
+
+		layout.m_vertex_count = position->count;
+		layout.m_index_count = primitive.indices >= 0 ? model.accessors[primitive.indices].count : position->count;
+		layout.m_tangent_components = FindAttribute(model, primitive, "TANGENT") ? tangent_components : 0;
+		layout.m_stride = 8 + layout.m_tangent_components;
+
+		auto covers = [&](const char* name, u32 components) {
+			const tinygltf::Accessor* accessor = FindAttribute(model, primitive, name);
+			return accessor && accessor->count >= position->count && (u32)tinygltf::GetNumComponentsInType(accessor->type) >= components;
+		};
+		layout.m_complete = covers("NORMAL", 3) && covers("TEXCOORD_0", 2) &&
+			(layout.m_tangent_components == 0 || covers("TANGENT", layout.m_tangent_components));
+		return layout;
+	}
+
+	//Fills vertices (m_vertex_count * m_stride floats) and indices (m_index_count) in one pass per
+	//attribute. Either pointer may be a mapped GL buffer. Non-indexed primitives get 0..n-1
+	static void ExtractPrimitive(const tinygltf::Model& model, const tinygltf::Primitive& primitive, const PrimitiveLayout& layout, float* vertices, u32* indices) {
+		const usize count = layout.m_vertex_count;
+		if (!layout.m_complete) {
+			memset(vertices, 0, count * layout.m_stride * sizeof(float));
+		}
+
+		if (const tinygltf::Accessor* position = FindAttribute(model, primitive, "POSITION")) {
+			ReadAccessor(model, *position, count, 3, vertices + 0, layout.m_stride);
+		}
+		if (const tinygltf::Accessor* normal = FindAttribute(model, primitive, "NORMAL")) {
+			ReadAccessor(model, *normal, count, 3, vertices + 3, layout.m_stride);
+		}
+		if (const tinygltf::Accessor* texcoord = FindAttribute(model, primitive, "TEXCOORD_0")) {
+			ReadAccessor(model, *texcoord, count, 2, vertices + 6, layout.m_stride);
+		}
+		if (layout.m_tangent_components) {
+			if (const tinygltf::Accessor* tangent = FindAttribute(model, primitive, "TANGENT")) {
+				ReadAccessor(model, *tangent, count, layout.m_tangent_components, vertices + 8, layout.m_stride);
 			}
+		}
 
-			//Rearrange data into a vector<float> of vertex data
-			vector<float> vertex;
-			for (size_t i = 0; i < positions.size() / 3; ++i) {
-				vertex.push_back(positions[3 * i + 0]);
-				vertex.push_back(positions[3 * i + 1]);
-				vertex.push_back(positions[3 * i + 2]);
-				vertex.push_back(normals[3 * i + 0]);
-				vertex.push_back(normals[3 * i + 1]);
-				vertex.push_back(normals[3 * i + 2]);
-				vertex.push_back(texcoords[2 * i + 0]);
-				vertex.push_back(texcoords[2 * i + 1]);
-				if (!tangents.empty()) {
-					vertex.push_back(tangents[3 * i + 0]);
-					vertex.push_back(tangents[3 * i + 1]);
-					vertex.push_back(tangents[3 * i + 2]);
-				}
+		if (primitive.indices < 0) {
+			for (u32 i = 0; i < layout.m_index_count; ++i) indices[i] = i;
+			return;
+		}
+
+		const auto& accessor = model.accessors[primitive.indices];
+		const auto& view = model.bufferViews[accessor.bufferView];
+		const unsigned char* src = model.buffers[view.buffer].data.data() + view.byteOffset + accessor.byteOffset;
+		int stride = accessor.ByteStride(view);
+		switch (accessor.componentType) {
+		case GL_UNSIGNED_INT:
+			if (stride == sizeof(u32)) {
+				memcpy(indices, src, layout.m_index_count * sizeof(u32));
+				break;
 			}
-			
-			//Bind all data to related VAO
-			glCreateVertexArrays(1, &m_vao);
+			for (u32 i = 0; i < layout.m_index_count; ++i) indices[i] = ReadIndex(src + i * stride, GL_UNSIGNED_INT);
+			break;
+		case GL_UNSIGNED_SHORT:
+			for (u32 i = 0; i < layout.m_index_count; ++i) indices[i] = ReadIndex(src + i * stride, GL_UNSIGNED_SHORT);
+			break;
+		case GL_UNSIGNED_BYTE:
+			for (u32 i = 0; i < layout.m_index_count; ++i) indices[i] = src[i * stride];
+			break;
+		}
+	}
+
+	//Creates the VAO for an extracted layout around existing buffers
+	static GLuint CreatePrimitiveVAO(const PrimitiveLayout& layout, GLuint vertex_buffer, GLuint index_buffer) {
+		GLuint vao;
+		glCreateVertexArrays(1, &vao);
+
+		glVertexArrayAttribBinding(vao, 0, 0);
+		glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_FALSE, 0);
+		glEnableVertexArrayAttrib(vao, 0);
+
+		glVertexArrayAttribBinding(vao, 1, 0);
+		glVertexArrayAttribFormat(vao, 1, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3);
+		glEnableVertexArrayAttrib(vao, 1);
+
+		glVertexArrayAttribBinding(vao, 2, 0);
+		glVertexArrayAttribFormat(vao, 2, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 6);
+		glEnableVertexArrayAttrib(vao, 2);
+
+		if (layout.m_tangent_components) {
+			glVertexArrayAttribBinding(vao, 3, 0);
+			glVertexArrayAttribFormat(vao, 3, layout.m_tangent_components, GL_FLOAT, GL_FALSE, sizeof(float) * 8);
+			glEnableVertexArrayAttrib(vao, 3);
+		}
+
+		glVertexArrayVertexBuffer(vao, 0, vertex_buffer, 0, sizeof(float) * layout.m_stride);
+		glVertexArrayElementBuffer(vao, index_buffer);
+		return vao;
+	}
+
+	//Extracts straight into write-mapped buffer storage, no CPU side copy of the vertices
+	static MeshData UploadPrimitive(const tinygltf::Model& model, const tinygltf::Primitive& primitive, u32 tangent_components) {
+		MeshData mesh_data = {};
+		mesh_data.m_material = primitive.material;
+		mesh_data.m_topology = primitive.mode;
 
-			glCreateBuffers(1, &m_vertex_buffer);
-			glNamedBufferStorage(m_vertex_buffer, vertex.size() * sizeof(float), &vertex[0], 0);
+		PrimitiveLayout layout = MeasurePrimitive(model, primitive, tangent_components);
+		if (layout.m_vertex_count == 0 || layout.m_index_count == 0) return mesh_data;
 
-			glCreateBuffers(1, &m_index_buffer);
-			glNamedBufferStorage(m_index_buffer, indices.size() * sizeof(unsigned int), &indices[0], 0);
+		const GLsizeiptr vertex_size = (GLsizeiptr)layout.m_vertex_count * layout.m_stride * sizeof(float);
+		const GLsizeiptr index_size = (GLsizeiptr)layout.m_index_count * sizeof(u32);
 
-			glVertexArrayAttribBinding(m_vao, 0, 0);
-			glVertexArrayAttribFormat(m_vao, 0, 3, GL_FLOAT, GL_FALSE, 0);
-			glEnableVertexArrayAttrib(m_vao, 0);
+		GLuint buffers[2];
+		glCreateBuffers(2, buffers);
+		glNamedBufferStorage(buffers[0], vertex_size, nullptr, GL_MAP_WRITE_BIT);
+		glNamedBufferStorage(buffers[1], index_size, nullptr, GL_MAP_WRITE_BIT);
+		float* vertices = (float*)glMapNamedBufferRange(buffers[0], 0, vertex_size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		u32* indices = (u32*)glMapNamedBufferRange(buffers[1], 0, index_size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
 
-			glVertexArrayAttribBinding(m_vao, 1, 0);
-			glVertexArrayAttribFormat(m_vao, 1, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3);
-			glEnableVertexArrayAttrib(m_vao, 1);
+		ExtractPrimitive(model, primitive, layout, vertices, indices);
 
-			glVertexArrayAttribBinding(m_vao, 2, 0);
-			glVertexArrayAttribFormat(m_vao, 2, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 6);
-			glEnableVertexArrayAttrib(m_vao, 2);
+		glUnmapNamedBuffer(buffers[0]);
+		glUnmapNamedBuffer(buffers[1]);
+
+		mesh_data.m_vao = CreatePrimitiveVAO(layout, buffers[0], buffers[1]);
+		mesh_data.m_count = layout.m_index_count;
+		mesh_data.m_vertex_buffer = buffers[0];
+		mesh_data.m_index_buffer = buffers[1];
+		mesh_data.m_vertex_count = layout.m_vertex_count;
+		mesh_data.m_stride = layout.m_stride * sizeof(float);
+		return mesh_data;
+	}
+
+	//Interleaved primitive kept after upload so Model can bake it
+	struct PrimitiveBake {
+		vector<float> m_vertices;
+		vector<unsigned int> m_indices;
+		bool m_tangents;
+	};
+
+	static const BakedAttribute primitive_attributes[] = {
+		{ 0, 3, 0 },
+		{ 1, 3, sizeof(float) * 3 },
+		{ 2, 2, sizeof(float) * 6 },
+		{ 3, 3, sizeof(float) * 8 },
+	};
+
+	struct Mesh {
+		Mesh(const tinygltf::Model& model, int mesh_index, vector<PrimitiveBake>* bake = nullptr);
+		//Builds from a baked mesh, part is the bake's first part for this mesh and is advanced past it
+		Mesh(const tinygltf::Model& model, int mesh_index, const BakedMesh& baked, u32& part);
+		string m_name;
+		vector<MeshData> m_meshes;
+	};
+
+	Mesh::Mesh(const tinygltf::Model& model, int mesh_index, const BakedMesh& baked, u32& part)
+		:m_name(model.meshes[mesh_index].name)
+	{
+		for (const auto& primitive : model.meshes[mesh_index].primitives) {
+			const BakedPart& baked_part = baked.Part(part);
+			BakedBuffers buffers = baked.Upload(part++);
+
+			MeshData mesh_data = {};
+			mesh_data.m_vao = buffers.m_vao;
+			mesh_data.m_count = buffers.m_count;
+			mesh_data.m_vertex_buffer = buffers.m_vertex_buffer;
+			mesh_data.m_index_buffer = buffers.m_index_buffer;
+			mesh_data.m_vertex_count = baked_part.m_vertex_count;
+			mesh_data.m_stride = baked_part.m_stride;
+			mesh_data.m_material = primitive.material;
+			mesh_data.m_topology = primitive.mode;
+
+			m_meshes.push_back(mesh_data);
+		}
+	}
 
-			if (!tangents.empty()) {
-				glVertexArrayAttribBinding(m_vao, 3, 0);
-				glVertexArrayAttribFormat(m_vao, 3, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 8);
-				glEnableVertexArrayAttrib(m_vao, 3);
+	Mesh::Mesh(const tinygltf::Model& model, int mesh_index, vector<PrimitiveBake>* bake)
+		:m_name(model.meshes[mesh_index].name)
+	{
+		for (const auto& primitive : model.meshes[mesh_index].primitives) {
+			if (!bake) {
+				m_meshes.push_back(UploadPrimitive(model, primitive, 3));
+				continue;
 			}
 
-			if (!tangents.empty())
-				glVertexArrayVertexBuffer(m_vao, 0, m_vertex_buffer, 0, sizeof(float) * 11);
-			else
-				glVertexArrayVertexBuffer(m_vao, 0, m_vertex_buffer, 0, sizeof(float) * 8);
-			glVertexArrayElementBuffer(m_vao, m_index_buffer);
+			//Baking needs a CPU copy anyway, so extract into it once and upload from there
+			PrimitiveLayout layout = MeasurePrimitive(model, primitive, 3);
+			PrimitiveBake primitive_bake;
+			primitive_bake.m_vertices.resize((usize)layout.m_vertex_count * layout.m_stride);
+			primitive_bake.m_indices.resize(layout.m_index_count);
+			primitive_bake.m_tangents = layout.m_tangent_components != 0;
+			if (layout.m_vertex_count) {
+				ExtractPrimitive(model, primitive, layout, primitive_bake.m_vertices.data(), primitive_bake.m_indices.data());
+			}
 
-			glBindVertexArray(0);
+			BakedBuffers buffers = Upload_Interleaved(primitive_bake.m_vertices.data(), layout.m_vertex_count, layout.m_stride * sizeof(float),
+				primitive_attributes, primitive_bake.m_tangents ? 4 : 3, primitive_bake.m_indices.data(), layout.m_index_count);
 
-			MeshData mesh_data;
-			mesh_data.m_vao = m_vao;
-			mesh_data.m_count = indices.size();
+			MeshData mesh_data = {};
+			mesh_data.m_vao = buffers.m_vao;
+			mesh_data.m_count = buffers.m_count;
 			mesh_data.m_material = primitive.material;
 			mesh_data.m_topology = primitive.mode;
-			
+			mesh_data.m_vertex_buffer = buffers.m_vertex_buffer;
+			mesh_data.m_index_buffer = buffers.m_index_buffer;
+			mesh_data.m_vertex_count = layout.m_vertex_count;
+			mesh_data.m_stride = layout.m_stride * sizeof(float);
 			m_meshes.push_back(mesh_data);
+
+			bake->push_back(std::move(primitive_bake));
 		}
-		
 	}
 
 	struct Node {
@@ -692,6 +983,211 @@ namespace SB
 		}
 	}
 
+	//-------------------------------------------------------------------------------------------------
+	// SCENE GRAPH
+	//-------------------------------------------------------------------------------------------------
+
+	//The nodes of one scene flattened breadth first into parallel arrays, so every parent sits
+	//before its children and each depth level is contiguous. World and normal matrices are cached
+	//and only recomputed for nodes whose local transform, or an ancestor's, changed since the last
+	//Update. Indices into these arrays are flat indices, m_flat maps a node index back to one.
+	struct SceneGraph {
+		int m_scene = -1;
+		vector<int> m_node;				//Node index for each flat index
+		vector<int> m_parent;			//Flat index of the parent, -1 for scene roots
+		vector<int> m_mesh;
+		vector<int> m_flat;				//Flat index for each node index, -1 if not in the scene
+
+		vector<vec3> m_translation;
+		vector<quat> m_rotation;
+		vector<vec3> m_scale;
+		vector<mat4> m_world;
+		vector<mat3> m_normal;
+		vector<u8> m_local_dirty;
+		vector<u8> m_world_dirty;		//Set by Update for every node it recomputed
+
+		vec3 m_root_position = vec3(0.0f);
+		vec3 m_root_scale = vec3(1.0f);
+		bool m_root_dirty = true;
+
+		void Build(const vector<Node>& nodes, const Scene& scene, int scene_index);
+		void SetLocal(int node_index, const vec3& translation, const quat& rotation, const vec3& scale);
+		//Returns true if any world matrix changed
+		bool Update(const vec3& position, const vec3& scale);
+		usize Size() const { return m_node.size(); }
+	};
+
+	void SceneGraph::Build(const vector<Node>& nodes, const Scene& scene, int scene_index) {
+		m_scene = scene_index;
+		m_node.clear();
+		m_parent.clear();
+		m_flat.assign(nodes.size(), -1);
+
+		for (const auto node_index : scene.m_node_indices) {
+			m_flat[node_index] = (int)m_node.size();
+			m_node.push_back(node_index);
+			m_parent.push_back(-1);
+		}
+		for (size_t i = 0; i < m_node.size(); ++i) {
+			for (const auto child : nodes[m_node[i]].m_children_nodes) {
+				m_flat[child] = (int)m_node.size();
+				m_node.push_back(child);
+				m_parent.push_back((int)i);
+			}
+		}
+
+		const usize count = m_node.size();
+		m_mesh.resize(count);
+		m_translation.resize(count);
+		m_rotation.resize(count);
+		m_scale.resize(count);
+		m_world.resize(count);
+		m_normal.resize(count);
+		m_local_dirty.assign(count, 1);
+		m_world_dirty.assign(count, 1);
+		for (size_t i = 0; i < count; ++i) {
+			const Node& node = nodes[m_node[i]];
+			m_mesh[i] = node.m_mesh_index;
+			m_translation[i] = node.m_translation;
+			m_rotation[i] = node.m_rotation;
+			m_scale[i] = node.m_scale;
+		}
+		m_root_dirty = true;
+	}
+
+	void SceneGraph::SetLocal(int node_index, const vec3& translation, const quat& rotation, const vec3& scale) {
+		const int i = node_index < m_flat.size() ? m_flat[node_index] : -1;
+		if (i < 0) return;
+		m_translation[i] = translation;
+		m_rotation[i] = rotation;
+		m_scale[i] = scale;
+		m_local_dirty[i] = 1;
+	}
+
+	bool SceneGraph::Update(const vec3& position, const vec3& scale) {
+		if (position != m_root_position || scale != m_root_scale) {
+			m_root_position = position;
+			m_root_scale = scale;
+			m_root_dirty = true;
+		}
+
+		//Dirty propagation only needs the parent, which the ordering guarantees is already resolved
+		const usize count = m_node.size();
+		bool changed = false;
+		for (size_t i = 0; i < count; ++i) {
+			const int parent = m_parent[i];
+			m_world_dirty[i] = m_local_dirty[i] | (parent < 0 ? (u8)m_root_dirty : m_world_dirty[parent]);
+			changed |= m_world_dirty[i] != 0;
+		}
+		if (!changed) return false;
+
+		for (size_t i = 0; i < count; ++i) {
+			if (!m_world_dirty[i]) continue;
+			mat4 local = glm::translate(mat4(1.0f), m_translation[i]) * glm::mat4_cast(m_rotation[i]) * glm::scale(mat4(1.0f), m_scale[i]);
+			const int parent = m_parent[i];
+			if (parent < 0) {
+				//Model position and scale are applied in the root's local space, as they always were
+				m_world[i] = glm::scale(glm::translate(local, m_root_position), m_root_scale);
+			}
+			else {
+				m_world[i] = m_world[parent] * local;
+			}
+			m_local_dirty[i] = 0;
+		}
+
+		//Normal matrices don't depend on each other, this pass is a flat loop over the dirty nodes
+		for (size_t i = 0; i < count; ++i) {
+			if (m_world_dirty[i]) m_normal[i] = glm::transpose(glm::inverse(mat3(m_world[i])));
+		}
+		m_root_dirty = false;
+		return true;
+	}
+
+	//-------------------------------------------------------------------------------------------------
+	// COMPILED MODEL
+	//-------------------------------------------------------------------------------------------------
+
+	//Shader storage bindings read by shaders drawing a compiled model, see Model::DrawIndirect
+	#define MODEL_DRAW_BINDING 3
+	#define MODEL_MATERIAL_BINDING 4
+
+	//Base color, metallic roughness, normal, occlusion, emissive
+	#define MODEL_MATERIAL_TEXTURES 5
+	//MaterialBackend::TextureArray binds its arrays from this unit up, one per texture size
+	#define MODEL_TEXTURE_ARRAY_UNIT 8
+	#define MODEL_MAX_TEXTURE_ARRAYS 8
+
+	//Compiled arenas use one vertex format for every primitive: position, normal, texcoord, tangent
+	#define MODEL_ARENA_STRIDE 11
+
+	struct DrawElementsIndirectCommand {
+		GLuint m_count;
+		GLuint m_instance_count;
+		GLuint m_first_index;
+		GLint m_base_vertex;
+		GLuint m_base_instance;
+	};
+
+	//Per-draw SSBO entry (std430), indexed with gl_BaseInstanceARB
+	struct ModelDrawData {
+		glm::mat4 m_model;
+		glm::mat4 m_normal;		//mat3 normal matrix in the upper left
+		GLint m_material;
+		GLint m_pad[3];
+	};
+
+	//Where a compiled model's shader finds the material textures
+	enum struct MaterialBackend {
+		Bound,			//BindMaterial per batch, batches split on every material change
+		Bindless,		//Resident GL_ARB_bindless_texture handles in the material SSBO, batches split per material without GL_NV_gpu_shader5
+		TextureArray,	//Array and layer in the material SSBO, one array per texture size
+	};
+
+	//Per-material SSBO entry (std430), the last entry is the fallback for primitives without one.
+	//m_textures holds a bindless handle as uvec2 with MaterialBackend::Bindless, the array
+	//(offset from MODEL_TEXTURE_ARRAY_UNIT) and layer with TextureArray, and is unused otherwise
+	struct ModelMaterialData {
+		glm::vec4 m_color_factor;
+		float m_alpha_cutoff;
+		float m_pad[3];
+		glm::uvec2 m_textures[MODEL_MATERIAL_TEXTURES];
+		GLuint m_pad2[2];
+	};
+
+	struct ModelDrawRecord {
+		int m_node;				//Flat index into the scene graph
+		int m_mesh;
+		int m_primitive;
+	};
+
+	//Consecutive draws sharing a material and topology, submitted with one multi-draw
+	struct ModelBatch {
+		GLint m_material;
+		GLint m_topology;
+		GLuint m_first;
+		GLsizei m_count;
+	};
+
+	struct ModelArena {
+		GLuint m_vao = 0;
+		GLuint m_vertex_buffer = 0;
+		GLuint m_index_buffer = 0;
+		GLuint m_indirect_buffer = 0;
+		GLuint m_draw_buffer = 0;
+		GLuint m_material_buffer = 0;
+		int m_scene = -1;
+		bool m_transforms_dirty = true;		//Graph changed while drawing without the arena
+
+		MaterialBackend m_backend = MaterialBackend::Bound;
+		vector<GLuint64> m_handles;			//Resident while the bindless backend is active
+		vector<GLuint> m_texture_arrays;
+		GLuint m_array_sampler = 0;
+
+		vector<ModelDrawRecord> m_draws;
+		vector<ModelBatch> m_batches;
+		vector<ModelDrawData> m_draw_data;
+	};
+
 	struct Model {
 		Model();
 		Model(const char* filename);
@@ -712,7 +1208,31 @@ namespace SB
 		glm::vec3 m_position;
 		glm::vec3 m_scale;
 
-		void DrawNode(glm::mat4 trs_matrix, int node_index);
+		//Set by Compile, OnDraw then uses DrawIndirect. Needs a shader reading the draw SSBOs
+		bool m_draw_indirect = false;
+		ModelArena m_arena;
+		SceneGraph m_graph;
+
+		//Parses the file on an AssetManager worker and builds the model once it's uploaded
+		void LoadAsync(const char* filename);
+
+		static bool Parse(const char* filename, tinygltf::Model& model);
+		void Build(tinygltf::Model& model);
+		void BuildMeshes(tinygltf::Model& model);
+		//Changes a node's local transform, only its subtree is recomputed on the next draw
+		void SetNodeTransform(int node_index, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale);
+		//Rebuilds the scene graph if the current scene changed, then refreshes dirty transforms
+		bool UpdateGraph();
+		void DrawFlat();
+
+		//Moves every primitive into one vertex and one index arena and builds material sorted
+		//indirect batches for the current scene. Per-primitive buffers are released
+		void Compile(MaterialBackend backend = MaterialBackend::Bound);
+		//Rebuilds the material SSBO for a backend and rebatches. Bindless falls back to texture
+		//arrays without GL_ARB_bindless_texture, arrays to Bound with too many texture sizes
+		void CompileMaterials(MaterialBackend backend);
+		void CompileDraws();
+		void DrawIndirect();
 
 		void OnUpdate(f64 dt);
 		void OnDraw();
@@ -734,6 +1254,14 @@ namespace SB
 		m_scale(glm::vec3(1.0f, 1.0f, 1.0f))
 	{
 		tinygltf::Model model;
+		if (!Parse(filename, model)) {
+			assert(false);
+			return;
+		}
+		Build(model);
+	}
+
+	bool Model::Parse(const char* filename, tinygltf::Model& model) {
 		tinygltf::TinyGLTF loader;
 		std::string err;
 		std::string warn;
@@ -759,9 +1287,11 @@ namespace SB
 
 		if (!ret) {
 			printf("Failed to parse glTF\n");
-			assert(false);
 		}
+		return ret;
+	}
 
+	void Model::Build(tinygltf::Model& model) {
 		m_default_scene = model.defaultScene;
 		m_current_scene = model.defaultScene;
 
@@ -773,13 +1303,15 @@ namespace SB
 		for (size_t i = 0; i < model.nodes.size(); ++i) {
 			m_nodes.push_back(Node(model.nodes[i], i));
 		}
-		//Collect meshes
-		for (size_t i = 0; i < model.meshes.size(); ++i) {
-			m_meshes.push_back(Mesh(model, i));
-		}
+		//Collect meshes, straight from the bake when it's current
+		BuildMeshes(model);
 
 		//Create Image Buffers
-		m_image.Init(model.images);
+		m_image.Init(model);
+		if (!model.images.empty()) {
+			std::cout << m_filename << ": textures use " << m_image.m_bytes / (1024.0 * 1024.0) << " MB with mips, "
+				<< m_image.m_rgba32f_bytes / (1024.0 * 1024.0) << " MB as single level RGBA32F" << std::endl;
+		}
 
 		//Collect Samplers
 		m_sampler.Init(model.samplers);
@@ -791,14 +1323,101 @@ namespace SB
 		m_camera.Init(model);
 	}
 
-	void Model::DrawNode(glm::mat4 trs_matrix, int node_index) {
-		glUniformMatrix4fv(3, 1, GL_FALSE, glm::value_ptr(trs_matrix));
-		glm::mat3 normal_matrix = glm::mat3(glm::transpose(glm::inverse(trs_matrix)));
-		glUniformMatrix3fv(4, 1, GL_FALSE, glm::value_ptr(normal_matrix));
-		if (m_nodes[node_index].m_mesh_index >= 0) {
-			Mesh& mesh = m_meshes[m_nodes[node_index].m_mesh_index];
+	void Model::BuildMeshes(tinygltf::Model& model) {
+		if (m_filename.empty()) {
+			for (size_t i = 0; i < model.meshes.size(); ++i) {
+				m_meshes.push_back(Mesh(model, i));
+			}
+			return;
+		}
+
+		//External .bin buffers aren't part of the .gltf bytes, so fold them into the key
+		u64 extra_key = 0;
+		if (path(m_filename).extension() != ".glb") {
+			for (const auto& buffer : model.buffers) {
+				extra_key = BakedMesh::Hash(buffer.data.data(), buffer.data.size(), extra_key);
+			}
+		}
+
+		u32 primitive_count = 0;
+		for (const auto& mesh : model.meshes) {
+			primitive_count += mesh.primitives.size();
+		}
+
+		BakedMesh baked;
+		if (baked.Open(m_filename.c_str(), "gltf", 0, extra_key) && baked.PartCount() == primitive_count) {
+			u32 part = 0;
+			for (size_t i = 0; i < model.meshes.size(); ++i) {
+				m_meshes.push_back(Mesh(model, i, baked, part));
+			}
+			return;
+		}
+
+		vector<PrimitiveBake> bake;
+		bake.reserve(primitive_count);
+		for (size_t i = 0; i < model.meshes.size(); ++i) {
+			m_meshes.push_back(Mesh(model, i, &bake));
+		}
+
+		vector<BakedPartDesc> parts(bake.size());
+		for (size_t i = 0; i < bake.size(); ++i) {
+			const u32 stride = sizeof(float) * (bake[i].m_tangents ? 11 : 8);
+			parts[i].m_vertices = bake[i].m_vertices.data();
+			parts[i].m_vertex_count = bake[i].m_vertices.size() * sizeof(float) / stride;
+			parts[i].m_stride = stride;
+			parts[i].m_attributes = primitive_attributes;
+			parts[i].m_attribute_count = bake[i].m_tangents ? 4 : 3;
+			parts[i].m_indices = bake[i].m_indices.data();
+			parts[i].m_index_count = bake[i].m_indices.size();
+		}
+		BakedMesh::Write(m_filename.c_str(), "gltf", 0, parts.data(), parts.size(), extra_key);
+	}
+
+	void Model::LoadAsync(const char* filename) {
+		//File I/O, JSON and image decoding happen on a worker, the GL objects are built on upload.
+		//The model draws nothing until then and must stay at the same address.
+		m_filename = filename;
+		m_position = glm::vec3(0.0f, 0.0f, 0.0f);
+		m_scale = glm::vec3(1.0f, 1.0f, 1.0f);
+
+		auto model = std::make_shared<tinygltf::Model>();
+		string name = filename;
+
+		AssetManager::Submit(
+			[model, name]() {
+				return Parse(name.c_str(), *model);
+			},
+			[model, this]() {
+				Build(*model);
+			}
+		);
+	}
+
+	void Model::SetNodeTransform(int node_index, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale) {
+		Node& node = m_nodes[node_index];
+		node.m_translation = translation;
+		node.m_rotation = rotation;
+		node.m_scale = scale;
+		node.m_trs_matrix = glm::translate(glm::mat4(1.0f), translation) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(1.0f), scale);
+		m_graph.SetLocal(node_index, translation, rotation, scale);
+	}
+
+	bool Model::UpdateGraph() {
+		if (m_graph.m_scene != m_current_scene || m_graph.m_flat.size() != m_nodes.size()) {
+			m_graph.Build(m_nodes, m_scenes[m_current_scene], m_current_scene);
+		}
+		return m_graph.Update(m_position, m_scale);
+	}
+
+	void Model::DrawFlat() {
+		if (UpdateGraph()) m_arena.m_transforms_dirty = true;
+		for (size_t n = 0; n < m_graph.Size(); ++n) {
+			if (m_graph.m_mesh[n] < 0) continue;
+			glUniformMatrix4fv(3, 1, GL_FALSE, glm::value_ptr(m_graph.m_world[n]));
+			glUniformMatrix3fv(4, 1, GL_FALSE, glm::value_ptr(m_graph.m_normal[n]));
+			Mesh& mesh = m_meshes[m_graph.m_mesh[n]];
 			for (int i = 0; i < mesh.m_meshes.size(); ++i) {
-				glBindVertexArray(mesh.m_meshes[i].m_vao);
+				GLState::BindVertexArray(mesh.m_meshes[i].m_vao);
 				if (mesh.m_meshes[i].m_material < m_material.m_materials.size()) {
 					m_material.GetMaterial(mesh.m_meshes[i].m_material).BindMaterial();
 				}
@@ -806,31 +1425,331 @@ namespace SB
 					//Fall back if no associated material
 					// --- Needs lighting or a default texture other than white pixel to be visible
 					const float color[] = { 0.5f, 0.5f, 0.5f, 0.5f };
-					glActiveTexture(GL_TEXTURE0 + 0);
 					//glBindTextureUnit(0, m_image.GetTexture(m_image.m_textures.size() - 1));
-					glBindTextureUnit(0, m_image.m_default_texture);
+					GLState::BindTextureUnit(0, m_image.m_default_texture);
 					glUniform4fv(7, 1, color);
 				}
-				glDrawElements(mesh.m_meshes[i].m_topology, mesh.m_meshes[i].m_count, GL_UNSIGNED_INT, (void*)0);
+				const MeshData& primitive = mesh.m_meshes[i];
+				glDrawElementsBaseVertex(primitive.m_topology, primitive.m_count, GL_UNSIGNED_INT, (void*)(primitive.m_first_index * sizeof(GLuint)), primitive.m_base_vertex);
+			}
+		}
+	}
+
+	void Model::OnUpdate(f64 dt) {
+
+	}
+
+	void Model::Compile(MaterialBackend backend) {
+		//Gather every primitive into CPU side arenas, widened to the shared vertex format
+		vector<float> vertices;
+		vector<GLuint> indices;
+		usize vertex_total = 0, index_total = 0;
+		for (const auto& mesh : m_meshes) {
+			for (const auto& primitive : mesh.m_meshes) {
+				vertex_total += primitive.m_vertex_count;
+				index_total += primitive.m_count;
+			}
+		}
+		if (vertex_total == 0 || index_total == 0) return;
+		vertices.resize(vertex_total * MODEL_ARENA_STRIDE, 0.0f);
+		indices.resize(index_total);
+
+		vector<float> scratch;
+		GLint base_vertex = 0;
+		GLuint first_index = 0;
+		for (auto& mesh : m_meshes) {
+			for (auto& primitive : mesh.m_meshes) {
+				if (primitive.m_vertex_buffer == 0) continue;
+
+				const usize floats = primitive.m_stride / sizeof(float);
+				scratch.resize(primitive.m_vertex_count * floats);
+				glGetNamedBufferSubData(primitive.m_vertex_buffer, 0, scratch.size() * sizeof(float), scratch.data());
+				glGetNamedBufferSubData(primitive.m_index_buffer, 0, primitive.m_count * sizeof(GLuint), &indices[first_index]);
+
+				const usize copy = floats < MODEL_ARENA_STRIDE ? floats : MODEL_ARENA_STRIDE;
+				float* dst = &vertices[(usize)base_vertex * MODEL_ARENA_STRIDE];
+				for (GLsizei v = 0; v < primitive.m_vertex_count; ++v) {
+					memcpy(dst + v * MODEL_ARENA_STRIDE, &scratch[v * floats], copy * sizeof(float));
+				}
+
+				glDeleteVertexArrays(1, &primitive.m_vao);
+				glDeleteBuffers(1, &primitive.m_vertex_buffer);
+				glDeleteBuffers(1, &primitive.m_index_buffer);
+
+				primitive.m_vertex_buffer = 0;
+				primitive.m_index_buffer = 0;
+				primitive.m_stride = MODEL_ARENA_STRIDE * sizeof(float);
+				primitive.m_base_vertex = base_vertex;
+				primitive.m_first_index = first_index;
+				base_vertex += primitive.m_vertex_count;
+				first_index += primitive.m_count;
 			}
 		}
 
-		for (const auto& child_node_index : m_nodes[node_index].m_children_nodes) {
-			glm::mat4 new_trs_matrix = trs_matrix * m_nodes[child_node_index].m_trs_matrix;
-			DrawNode(new_trs_matrix, child_node_index);
+		static const BakedAttribute arena_attributes[] = {
+			{ 0, 3, 0 },
+			{ 1, 3, sizeof(float) * 3 },
+			{ 2, 2, sizeof(float) * 6 },
+			{ 3, 3, sizeof(float) * 8 },
+		};
+		BakedBuffers buffers = Upload_Interleaved(vertices.data(), base_vertex, MODEL_ARENA_STRIDE * sizeof(float), arena_attributes, 4, indices.data(), first_index);
+		m_arena.m_vao = buffers.m_vao;
+		m_arena.m_vertex_buffer = buffers.m_vertex_buffer;
+		m_arena.m_index_buffer = buffers.m_index_buffer;
+
+		//The regular DrawFlat path keeps working against the arena through the base offsets
+		for (auto& mesh : m_meshes) {
+			for (auto& primitive : mesh.m_meshes) {
+				primitive.m_vao = m_arena.m_vao;
+			}
 		}
+
+		CompileMaterials(backend);
+		m_draw_indirect = true;
 	}
 
-	void Model::OnUpdate(f64 dt) {
+	void Model::CompileMaterials(MaterialBackend backend) {
+		for (GLuint64 handle : m_arena.m_handles) glMakeTextureHandleNonResidentARB(handle);
+		if (!m_arena.m_texture_arrays.empty()) glDeleteTextures((GLsizei)m_arena.m_texture_arrays.size(), m_arena.m_texture_arrays.data());
+		glDeleteSamplers(1, &m_arena.m_array_sampler);
+		glDeleteBuffers(1, &m_arena.m_material_buffer);
+		m_arena.m_handles.clear();
+		m_arena.m_texture_arrays.clear();
+		m_arena.m_array_sampler = 0;
+		m_arena.m_material_buffer = 0;
+
+		if (backend == MaterialBackend::Bindless && !GLEW_ARB_bindless_texture) {
+			std::cerr << "GL_ARB_bindless_texture is not supported, using texture arrays" << std::endl;
+			backend = MaterialBackend::TextureArray;
+		}
+
+		//Every texture slot of every material, the fallback material last
+		const size_t count = m_material.m_materials.size() + 1;
+		vector<GLuint> textures(count * MODEL_MATERIAL_TEXTURES, m_image.m_white_texture);
+		vector<GLuint> samplers(count * MODEL_MATERIAL_TEXTURES, 0);
+		for (size_t i = 0; i < m_material.m_materials.size(); ++i) {
+			const Material& material = m_material.m_materials[i];
+			const GLuint material_textures[] = { material.m_base_color_texture, material.m_metallic_roughness_texture, material.m_normal_texture, material.m_occlusion_texture, material.m_emissive_texture };
+			const GLuint material_samplers[] = { material.m_base_sampler, material.m_metallic_sampler, material.m_normal_sampler, material.m_occlusion_sampler, material.m_emissive_sampler };
+			for (int t = 0; t < MODEL_MATERIAL_TEXTURES; ++t) {
+				textures[i * MODEL_MATERIAL_TEXTURES + t] = material_textures[t];
+				samplers[i * MODEL_MATERIAL_TEXTURES + t] = material_samplers[t];
+			}
+		}
+		textures[(count - 1) * MODEL_MATERIAL_TEXTURES] = m_image.m_default_texture;
+
+		//Material factors, mirroring what BindMaterial sets as uniforms
+		vector<ModelMaterialData> materials(count);
+		for (size_t i = 0; i < m_material.m_materials.size(); ++i) {
+			const Material& material = m_material.m_materials[i];
+			materials[i].m_color_factor = glm::make_vec4(material.m_color_factors);
+			materials[i].m_alpha_cutoff = material.m_alpha_mode == AlphaMode::Mask ? material.m_alpha_cutoff : 0.0f;
+		}
+		materials.back().m_color_factor = glm::vec4(0.5f);
+		materials.back().m_alpha_cutoff = 0.0f;
+
+		if (backend == MaterialBackend::TextureArray) {
+			//Textures of the same size and format share an array, each texture is one layer of it
+			std::map<std::tuple<GLint, GLint, GLint>, vector<GLuint>> sizes;
+			std::map<GLuint, glm::uvec2> locations;
+			for (GLuint texture : textures) {
+				if (locations.count(texture)) continue;
+				GLint width, height, format;
+				glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_WIDTH, &width);
+				glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_HEIGHT, &height);
+				glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+				vector<GLuint>& layers = sizes[{ width, height, format }];
+				locations[texture] = glm::uvec2(0, (GLuint)layers.size());
+				layers.push_back(texture);
+			}
+
+			if (sizes.size() > MODEL_MAX_TEXTURE_ARRAYS) {
+				std::cerr << "Model uses " << sizes.size() << " texture sizes, texture arrays support " << MODEL_MAX_TEXTURE_ARRAYS << std::endl;
+				backend = MaterialBackend::Bound;
+			}
+			else {
+				for (const auto& size : sizes) {
+					const GLint width = std::get<0>(size.first), height = std::get<1>(size.first);
+					const GLenum format = std::get<2>(size.first);
+					const GLsizei levels = MipLevels(width, height);
+
+					GLuint array;
+					glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &array);
+					glTextureStorage3D(array, levels, format, width, height, (GLsizei)size.second.size());
+					SetImageSwizzle(array, format);
+					for (size_t layer = 0; layer < size.second.size(); ++layer) {
+						glCopyImageSubData(size.second[layer], GL_TEXTURE_2D, 0, 0, 0, 0, array, GL_TEXTURE_2D_ARRAY, 0, 0, 0, (GLint)layer, width, height, 1);
+						locations[size.second[layer]].x = (GLuint)m_arena.m_texture_arrays.size();
+					}
+					glGenerateTextureMipmap(array);
+					m_arena.m_texture_arrays.push_back(array);
+				}
+
+				//Per-texture glTF samplers can't follow into an array, one sampler serves all of them
+				glCreateSamplers(1, &m_arena.m_array_sampler);
+				glSamplerParameteri(m_arena.m_array_sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+				glSamplerParameteri(m_arena.m_array_sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+				glSamplerParameteri(m_arena.m_array_sampler, GL_TEXTURE_WRAP_S, GL_REPEAT);
+				glSamplerParameteri(m_arena.m_array_sampler, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+				for (size_t i = 0; i < textures.size(); ++i) {
+					materials[i / MODEL_MATERIAL_TEXTURES].m_textures[i % MODEL_MATERIAL_TEXTURES] = locations[textures[i]];
+				}
+			}
+		}
+		else if (backend == MaterialBackend::Bindless) {
+			//One resident handle per image and sampler pair
+			std::map<std::pair<GLuint, GLuint>, GLuint64> handles;
+			for (size_t i = 0; i < textures.size(); ++i) {
+				GLuint64& handle = handles[{ textures[i], samplers[i] }];
+				if (!handle) {
+					handle = samplers[i] ? glGetTextureSamplerHandleARB(textures[i], samplers[i]) : glGetTextureHandleARB(textures[i]);
+					glMakeTextureHandleResidentARB(handle);
+					m_arena.m_handles.push_back(handle);
+				}
+				materials[i / MODEL_MATERIAL_TEXTURES].m_textures[i % MODEL_MATERIAL_TEXTURES] = glm::uvec2((GLuint)(handle & 0xFFFFFFFF), (GLuint)(handle >> 32));
+			}
+		}
+
+		glCreateBuffers(1, &m_arena.m_material_buffer);
+		glNamedBufferStorage(m_arena.m_material_buffer, materials.size() * sizeof(ModelMaterialData), materials.data(), 0);
+
+		m_arena.m_backend = backend;
+		CompileDraws();
+	}
+
+	void Model::CompileDraws() {
+		m_arena.m_draws.clear();
+		m_arena.m_batches.clear();
+		m_arena.m_scene = m_current_scene;
+		if (m_scenes.empty() || m_current_scene < 0) return;
+
+		//Collect every (node, primitive) pair of the scene from the flattened graph
+		m_graph.Build(m_nodes, m_scenes[m_current_scene], m_current_scene);
+		for (int n = 0; n < (int)m_graph.Size(); ++n) {
+			const int mesh_index = m_graph.m_mesh[n];
+			if (mesh_index < 0) continue;
+			for (int i = 0; i < m_meshes[mesh_index].m_meshes.size(); ++i) {
+				if (m_meshes[mesh_index].m_meshes[i].m_count > 0) {
+					m_arena.m_draws.push_back({ n, mesh_index, i });
+				}
+			}
+		}
+
+		//Opaque before blended, then by material and topology so each batch binds state once.
+		//With a texture table materials only differ in blend and cull state, which is all a
+		//batch has to split on. A bindless handle read per draw isn't dynamically uniform across
+		//a multi-draw though, only GL_NV_gpu_shader5 lets a sampler come from one. Without it
+		//each batch keeps to one material, so every invocation of it reads the same handle
+		const int fallback = (int)m_material.m_materials.size();
+		const bool table = m_arena.m_backend == MaterialBackend::TextureArray || (m_arena.m_backend == MaterialBackend::Bindless && GLEW_NV_gpu_shader5);
+		auto material_of = [&](const ModelDrawRecord& draw) {
+			int material = m_meshes[draw.m_mesh].m_meshes[draw.m_primitive].m_material;
+			return material >= 0 && material < fallback ? material : fallback;
+		};
+		auto blended = [&](int material) {
+			return material < fallback && m_material.m_materials[material].m_alpha_mode == AlphaMode::Blend;
+		};
+		auto state_of = [&](int material) {
+			if (!table) return material;
+			return material < fallback && m_material.m_materials[material].m_double_sided ? 1 : 0;
+		};
+		std::stable_sort(m_arena.m_draws.begin(), m_arena.m_draws.end(), [&](const ModelDrawRecord& a, const ModelDrawRecord& b) {
+			int ma = material_of(a), mb = material_of(b);
+			if (blended(ma) != blended(mb)) return !blended(ma);
+			if (state_of(ma) != state_of(mb)) return state_of(ma) < state_of(mb);
+			return m_meshes[a.m_mesh].m_meshes[a.m_primitive].m_topology < m_meshes[b.m_mesh].m_meshes[b.m_primitive].m_topology;
+		});
+
+		vector<DrawElementsIndirectCommand> commands(m_arena.m_draws.size());
+		for (GLuint i = 0; i < m_arena.m_draws.size(); ++i) {
+			const ModelDrawRecord& draw = m_arena.m_draws[i];
+			const MeshData& primitive = m_meshes[draw.m_mesh].m_meshes[draw.m_primitive];
+			commands[i] = { (GLuint)primitive.m_count, 1, primitive.m_first_index, primitive.m_base_vertex, i };
+
+			const GLint material = material_of(draw);
+			const ModelBatch* last = m_arena.m_batches.empty() ? nullptr : &m_arena.m_batches.back();
+			if (!last || blended(last->m_material) != blended(material) || state_of(last->m_material) != state_of(material) || last->m_topology != primitive.m_topology) {
+				m_arena.m_batches.push_back({ material, primitive.m_topology, i, 0 });
+			}
+			m_arena.m_batches.back().m_count++;
+		}
+
+		glDeleteBuffers(1, &m_arena.m_indirect_buffer);
+		glDeleteBuffers(1, &m_arena.m_draw_buffer);
+		m_arena.m_indirect_buffer = 0;
+		m_arena.m_draw_buffer = 0;
+		m_arena.m_draw_data.resize(m_arena.m_draws.size());
+		m_arena.m_transforms_dirty = true;
+		if (commands.empty()) return;
+
+		glCreateBuffers(1, &m_arena.m_indirect_buffer);
+		glNamedBufferStorage(m_arena.m_indirect_buffer, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), 0);
+		glCreateBuffers(1, &m_arena.m_draw_buffer);
+		glNamedBufferStorage(m_arena.m_draw_buffer, m_arena.m_draw_data.size() * sizeof(ModelDrawData), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	}
+
+	void Model::DrawIndirect() {
+		if (m_arena.m_scene != m_current_scene) CompileDraws();
+		if (m_arena.m_draws.empty()) return;
+
+		//Draw data only changes with the transforms, materials are fixed once compiled
+		const int fallback = (int)m_material.m_materials.size();
+		if (UpdateGraph() || m_arena.m_transforms_dirty) {
+			for (size_t i = 0; i < m_arena.m_draws.size(); ++i) {
+				const ModelDrawRecord& draw = m_arena.m_draws[i];
+				const GLint material = m_meshes[draw.m_mesh].m_meshes[draw.m_primitive].m_material;
+				ModelDrawData& data = m_arena.m_draw_data[i];
+				data.m_model = m_graph.m_world[draw.m_node];
+				data.m_normal = glm::mat4(m_graph.m_normal[draw.m_node]);
+				data.m_material = material >= 0 && material < fallback ? material : fallback;
+			}
+			glNamedBufferSubData(m_arena.m_draw_buffer, 0, m_arena.m_draw_data.size() * sizeof(ModelDrawData), m_arena.m_draw_data.data());
+			m_arena.m_transforms_dirty = false;
+		}
 
+		GLState::BindVertexArray(m_arena.m_vao);
+		GLState::BindBuffer(GL_DRAW_INDIRECT_BUFFER, m_arena.m_indirect_buffer);
+		GLState::BindBufferBase(GL_SHADER_STORAGE_BUFFER, MODEL_DRAW_BINDING, m_arena.m_draw_buffer);
+		GLState::BindBufferBase(GL_SHADER_STORAGE_BUFFER, MODEL_MATERIAL_BINDING, m_arena.m_material_buffer);
+
+		if (m_arena.m_backend == MaterialBackend::TextureArray) {
+			for (size_t i = 0; i < m_arena.m_texture_arrays.size(); ++i) {
+				GLState::BindTextureUnit(MODEL_TEXTURE_ARRAY_UNIT + (GLuint)i, m_arena.m_texture_arrays[i]);
+				GLState::BindSampler(MODEL_TEXTURE_ARRAY_UNIT + (GLuint)i, m_arena.m_array_sampler);
+			}
+		}
+
+		for (const ModelBatch& batch : m_arena.m_batches) {
+			if (m_arena.m_backend != MaterialBackend::Bound) {
+				if (batch.m_material < fallback) m_material.GetMaterial(batch.m_material).BindState();
+				else {
+					GLState::Enable(GL_BLEND, false);
+					GLState::Enable(GL_CULL_FACE, true);
+				}
+			}
+			else if (batch.m_material < fallback) {
+				m_material.GetMaterial(batch.m_material).BindMaterial(false);
+			}
+			else {
+				GLState::Enable(GL_BLEND, false);
+				GLState::Enable(GL_CULL_FACE, true);
+				GLState::BindTextureUnit(0, m_image.m_default_texture);
+			}
+			glMultiDrawElementsIndirect(batch.m_topology, GL_UNSIGNED_INT, (void*)(batch.m_first * sizeof(DrawElementsIndirectCommand)), batch.m_count, 0);
+		}
+		GLState::BindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
 	}
 
 	void Model::OnDraw() {
-		for (const auto& node_index : m_scenes[m_current_scene].m_node_indices) {
-			glm::mat4 trs_matrix = glm::translate(m_nodes[node_index].m_trs_matrix, m_position);
-			trs_matrix = glm::scale(trs_matrix, m_scale);
-			DrawNode(trs_matrix, node_index);
+		if (m_scenes.empty()) return;
+		//The sample may have changed anything with raw GL calls since the last model was drawn
+		GLState::Invalidate();
+		if (m_draw_indirect && m_arena.m_vao) {
+			DrawIndirect();
+			return;
 		}
+		DrawFlat();
 	}
 
 	struct ModelDump {
@@ -868,66 +1787,11 @@ namespace SB
 			size_t current_primitive_num = 0;
 			//Extract the Position, Normal and TextureCoord data for current mesh
 			for (const auto& primitive : mesh.primitives) {
-				vector<float> positions;
-				vector<float> normals;
-				vector<float> texcoords;
-				vector<unsigned int> indices;
-
-				//Get Positions
-				const auto& positionAccessor = model.accessors[primitive.attributes.at("POSITION")];
-				const auto& positionView = model.bufferViews[positionAccessor.bufferView];
-				const float* positionData = reinterpret_cast<const float*>(model.buffers[positionView.buffer].data.data() + positionView.byteOffset + positionAccessor.byteOffset);
-				for (size_t i = 0; i < positionAccessor.count * 3; i++) {
-					positions.push_back(positionData[i]);
-				}
-
-				//Get Normals
-				if (primitive.attributes.count("NORMAL") > 0) {
-					const auto& normalAccessor = model.accessors[primitive.attributes.at("NORMAL")];
-					const auto& normalView = model.bufferViews[normalAccessor.bufferView];
-					const float* normalData = reinterpret_cast<const float*>(model.buffers[normalView.buffer].data.data() + normalView.byteOffset + normalAccessor.byteOffset);
-					for (size_t i = 0; i < normalAccessor.count * 3; i++) {
-						normals.push_back(normalData[i]);
-					}
-				}
-
-				//Get Texture Coords
-				if (primitive.attributes.count("TEXCOORD_0") > 0) {
-					const auto& texAccessor = model.accessors[primitive.attributes.at("TEXCOORD_0")];
-					const auto& texView = model.bufferViews[texAccessor.bufferView];
-					const float* texCoordData = reinterpret_cast<const float*>(model.buffers[texView.buffer].data.data() + texView.byteOffset + texAccessor.byteOffset);
-					for (size_t i = 0; i < texAccessor.count * 2; i++) {
-						texcoords.push_back(texCoordData[i]);
-					}
-				}
-
-				//Get Indices
-				const auto& indexAccessor = model.accessors[primitive.indices];
-				const auto& indexView = model.bufferViews[indexAccessor.bufferView];
-				if (indexAccessor.componentType == GL_UNSIGNED_INT) {
-					const unsigned int* indexData = reinterpret_cast<const unsigned int*>(model.buffers[indexView.buffer].data.data() + indexView.byteOffset + indexAccessor.byteOffset);
-					for (size_t i = 0; i < indexAccessor.count; i++) {
-						indices.push_back(indexData[i]);
-					}
-				}
-				else {
-					const unsigned short* indexData = reinterpret_cast<const unsigned short*>(model.buffers[indexView.buffer].data.data() + indexView.byteOffset + indexAccessor.byteOffset);
-					for (size_t i = 0; i < indexAccessor.count; i++) {
-						indices.push_back(indexData[i]);
-					}
-				}
-
-				//Rearrange data into a vector<float> of vertex data
-				vector<float> vertex;
-				for (size_t i = 0; i < positions.size() / 3; ++i) {
-					vertex.push_back(positions[3 * i + 0]);
-					vertex.push_back(positions[3 * i + 1]);
-					vertex.push_back(positions[3 * i + 2]);
-					vertex.push_back(normals[3 * i + 0]);
-					vertex.push_back(normals[3 * i + 1]);
-					vertex.push_back(normals[3 * i + 2]);
-					vertex.push_back(texcoords[2 * i + 0]);
-					vertex.push_back(texcoords[2 * i + 1]);
+				PrimitiveLayout layout = MeasurePrimitive(model, primitive, 0);
+				vector<float> vertex((usize)layout.m_vertex_count * layout.m_stride);
+				vector<unsigned int> indices(layout.m_index_count);
+				if (layout.m_vertex_count) {
+					ExtractPrimitive(model, primitive, layout, vertex.data(), indices.data());
 				}
 
 				string mesh_name = "mesh" + std::to_string(i);
@@ -977,137 +1841,13 @@ namespace SB
 			assert(false);
 		}
 
-		const auto& mesh = model.meshes[0];
-		const auto& primitive = mesh.primitives[0];
-		
-		GLuint m_vao, m_vertex_buffer, m_index_buffer;
-
-		vector<float> positions;
-		vector<float> normals;
-		vector<float> texcoords;
-		vector<float> tangents;
-		vector<unsigned int> indices;
-
-		//Get Positions
-		const auto& positionAccessor = model.accessors[primitive.attributes.at("POSITION")];
-		const auto& positionView = model.bufferViews[positionAccessor.bufferView];
-		const float* positionData = reinterpret_cast<const float*>(model.buffers[positionView.buffer].data.data() + positionView.byteOffset + positionAccessor.byteOffset);
-		for (size_t i = 0; i < positionAccessor.count * 3; i++) {
-			positions.push_back(positionData[i]);
-		}
-
-		//Get Normals
-		if (primitive.attributes.count("NORMAL") > 0) {
-			const auto& normalAccessor = model.accessors[primitive.attributes.at("NORMAL")];
-			const auto& normalView = model.bufferViews[normalAccessor.bufferView];
-			const float* normalData = reinterpret_cast<const float*>(model.buffers[normalView.buffer].data.data() + normalView.byteOffset + normalAccessor.byteOffset);
-			for (size_t i = 0; i < normalAccessor.count * 3; i++) {
-				normals.push_back(normalData[i]);
-			}
-		}
-
-		//Get Texture Coords
-		if (primitive.attributes.count("TEXCOORD_0") > 0) {
-			const auto& texAccessor = model.accessors[primitive.attributes.at("TEXCOORD_0")];
-			const auto& texView = model.bufferViews[texAccessor.bufferView];
-			const float* texCoordData = reinterpret_cast<const float*>(model.buffers[texView.buffer].data.data() + texView.byteOffset + texAccessor.byteOffset);
-			for (size_t i = 0; i < texAccessor.count * 2; i++) {
-				texcoords.push_back(texCoordData[i]);
-			}
-		}
-
-		//Get Tangents
-		if (primitive.attributes.count("TANGENT") > 0) {
-			const auto& tanAccessor = model.accessors[primitive.attributes.at("TANGENT")];
-			const auto& tanView = model.bufferViews[tanAccessor.bufferView];
-			const float* tangentData = reinterpret_cast<const float*>(model.buffers[tanView.buffer].data.data() + tanView.byteOffset + tanAccessor.byteOffset);
-			for (size_t i = 0; i < tanAccessor.count * 4; i++) {
-				tangents.push_back(tangentData[i]);
-			}
-		}
-
-		//Get Indices
-		const auto& indexAccessor = model.accessors[primitive.indices];
-		const auto& indexView = model.bufferViews[indexAccessor.bufferView];
-		if (indexAccessor.componentType == GL_UNSIGNED_INT) {
-			const unsigned int* indexData = reinterpret_cast<const unsigned int*>(model.buffers[indexView.buffer].data.data() + indexView.byteOffset + indexAccessor.byteOffset);
-			for (size_t i = 0; i < indexAccessor.count; i++) {
-				indices.push_back(indexData[i]);
-			}
-		}
-		else {
-			const unsigned short* indexData = reinterpret_cast<const unsigned short*>(model.buffers[indexView.buffer].data.data() + indexView.byteOffset + indexAccessor.byteOffset);
-			for (size_t i = 0; i < indexAccessor.count; i++) {
-				indices.push_back(indexData[i]);
-			}
-		}
-		
-		//Rearrange data into a vector<float> of vertex data
-		vector<float> vertex;
-		for (size_t i = 0; i < positions.size() / 3; ++i) {
-			vertex.push_back(positions[3 * i + 0]);
-			vertex.push_back(positions[3 * i + 1]);
-			vertex.push_back(positions[3 * i + 2]);
-			vertex.push_back(normals[3 * i + 0]);
-			vertex.push_back(normals[3 * i + 1]);
-			vertex.push_back(normals[3 * i + 2]);
-			vertex.push_back(texcoords[2 * i + 0]);
-			vertex.push_back(texcoords[2 * i + 1]);
-			if (!tangents.empty()) {
-				vertex.push_back(tangents[3 * i + 0]);
-				vertex.push_back(tangents[3 * i + 1]);
-				vertex.push_back(tangents[3 * i + 2]);
-				vertex.push_back(tangents[3 * i + 3]);
-			}
-		}
-
-		//Bind all data to related VAO
-		glCreateVertexArrays(1, &m_vao);
-
-		glCreateBuffers(1, &m_vertex_buffer);
-		glNamedBufferStorage(m_vertex_buffer, vertex.size() * sizeof(float), &vertex[0], 0);
-
-		glCreateBuffers(1, &m_index_buffer);
-		glNamedBufferStorage(m_index_buffer, indices.size() * sizeof(unsigned int), &indices[0], 0);
-
-		glVertexArrayAttribBinding(m_vao, 0, 0);
-		glVertexArrayAttribFormat(m_vao, 0, 3, GL_FLOAT, GL_FALSE, 0);
-		glEnableVertexArrayAttrib(m_vao, 0);
-
-		glVertexArrayAttribBinding(m_vao, 1, 0);
-		glVertexArrayAttribFormat(m_vao, 1, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3);
-		glEnableVertexArrayAttrib(m_vao, 1);
-
-		glVertexArrayAttribBinding(m_vao, 2, 0);
-		glVertexArrayAttribFormat(m_vao, 2, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 6);
-		glEnableVertexArrayAttrib(m_vao, 2);
-
-		if (!tangents.empty()) {
-			glVertexArrayAttribBinding(m_vao, 3, 0);
-			glVertexArrayAttribFormat(m_vao, 3, 4, GL_FLOAT, GL_FALSE, sizeof(float) * 8);
-			glEnableVertexArrayAttrib(m_vao, 3);
-		}
-
-		if (!tangents.empty())
-			glVertexArrayVertexBuffer(m_vao, 0, m_vertex_buffer, 0, sizeof(float) * 12);
-		else
-			glVertexArrayVertexBuffer(m_vao, 0, m_vertex_buffer, 0, sizeof(float) * 8);
-		glVertexArrayElementBuffer(m_vao, m_index_buffer);
-
-		glBindVertexArray(0);
-
-		MeshData mesh_data;
-		mesh_data.m_vao = m_vao;
-		mesh_data.m_count = indices.size();
-		mesh_data.m_material = primitive.material;
-		mesh_data.m_topology = primitive.mode;		
-		
-		return mesh_data;
+		//Tangents keep their handedness in w here
+		return UploadPrimitive(model, model.meshes[0].primitives[0], 4);
 	}
 
 	static void DrawMesh(MeshData mesh) {
 		glBindVertexArray(mesh.m_vao);
-		glDrawElements(mesh.m_topology, mesh.m_count, GL_UNSIGNED_INT, (void*)0);
+		glDrawElementsBaseVertex(mesh.m_topology, mesh.m_count, GL_UNSIGNED_INT, (void*)(mesh.m_first_index * sizeof(GLuint)), mesh.m_base_vertex);
 	}
 }
 
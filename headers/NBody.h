@@ -0,0 +1,117 @@
+#pragma once
+
+#include "GL_Helpers.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+//-------------------------------------------------------------------------------------------------
+// N-BODY
+//-------------------------------------------------------------------------------------------------
+
+//Every particle attracts every other with a 1/r^2 falloff, distances below NBODY_MIN_DISTANCE
+//are clamped so close pairs don't explode
+#define NBODY_MIN_DISTANCE 0.005f
+#define NBODY_FORCE_SCALE 0.0001f
+
+enum struct NBodySolver {
+	Scalar,		//Plain loops over the SoA store, one thread
+	SIMD,		//AVX2 when the CPU has it, SSE otherwise, one thread
+	SIMD_OMP,	//SIMD kernel with rows spread over OpenMP threads
+	BarnesHut,	//Octree with a far field approximation, O(N log N), OpenMP threads
+};
+
+struct ParticleStore;
+
+//-------------------------------------------------------------------------------------------------
+// BARNES-HUT
+//-------------------------------------------------------------------------------------------------
+
+//Octree cells are stored depth first. Particles are walked in Morton ordered groups: a cell whose
+//edge length is below theta times its distance to the group's bounds stands in for all of its
+//particles at its centre of mass, otherwise the walk descends into it. Leaves that are too close
+//contribute each particle.
+struct OctreeNode {
+	float m_cx, m_cy, m_cz;		//Centre of mass
+	float m_mass;				//Number of particles below the cell
+	float m_size;				//Cell edge length
+	u32 m_next;					//First node after this subtree, where the walk goes when it skips the cell
+	u32 m_first;				//Particles below the cell, as a range of the Morton sorted arrays
+	u32 m_count;
+	u32 m_leaf;
+};
+
+//Point masses a group of particles interacts with, collected by the tree walk and then summed
+//by the SIMD kernel in one go
+struct NBodySources {
+	std::vector<float> m_x, m_y, m_z, m_mass;
+
+	void Clear() { m_x.clear(); m_y.clear(); m_z.clear(); m_mass.clear(); }
+	void Push(float x, float y, float z, float mass) { m_x.push_back(x); m_y.push_back(y); m_z.push_back(z); m_mass.push_back(mass); }
+	usize Count() const { return m_x.size(); }
+};
+
+//A subtree built on its own thread, spliced into the tree once every task is done
+struct OctreeTask {
+	u32 m_first;
+	u32 m_count;
+	u32 m_level;
+};
+
+struct NBodyOctree {
+	float m_theta = 0.5f;
+	std::vector<OctreeNode> m_nodes;
+
+	//Kept between builds so a steady particle count doesn't allocate
+	std::vector<u32> m_codes, m_order;
+	std::vector<u32> m_codes_scratch, m_order_scratch;
+	std::vector<float> m_sx, m_sy, m_sz;		//Positions in Morton order
+	std::vector<OctreeTask> m_tasks;
+	std::vector<std::vector<OctreeNode>> m_task_nodes;
+
+	//Sorts the particles along a Morton curve and rebuilds the tree over them
+	void Build(const ParticleStore& store);
+	//Accumulates every particle's velocity change by walking the tree, needs a Build first
+	void Accumulate(ParticleStore& store) const;
+};
+
+//Structure of arrays particle store. Positions and velocities are kept per component so the
+//force kernel can load eight (or four) neighbours with one instruction
+struct ParticleStore {
+	std::vector<float> m_px, m_py, m_pz;
+	std::vector<float> m_vx, m_vy, m_vz;
+	std::vector<float> m_ax, m_ay, m_az;	//Accumulated velocity change for the current step
+	NBodyOctree m_tree;						//Rebuilt every step by the Barnes-Hut solver
+
+	void Resize(usize count);
+	usize Count() const { return m_px.size(); }
+};
+
+//Accumulates the velocity change of every particle into m_ax/m_ay/m_az
+void NBody_Accumulate(ParticleStore& store, NBodySolver solver);
+//Accumulates, then moves every particle by its old velocity and applies the velocity change.
+//If positions isn't null the new positions are also written there as packed xyz triples
+void NBody_Step(ParticleStore& store, f64 dt, NBodySolver solver, float* positions = nullptr);
+
+//Velocity change from j on i is d / (r * max(r, min)^2) with d = pj - pi. Coincident pairs,
+//including i == j, contribute nothing
+inline void NBody_AccumulatePair(float xi, float yi, float zi, float xj, float yj, float zj, float& ax, float& ay, float& az)
+{
+	const float dx = xj - xi;
+	const float dy = yj - yi;
+	const float dz = zj - zi;
+	const float r2 = dx * dx + dy * dy + dz * dz;
+	if (r2 <= 0.0f) return;
+	const float inv_r = 1.0f / std::sqrt(r2);
+	const float inv_rc = std::min(inv_r, 1.0f / NBODY_MIN_DISTANCE);
+	const float s = inv_r * inv_rc * inv_rc;
+	ax += dx * s;
+	ay += dy * s;
+	az += dz * s;
+}
+
+//Adds the pull of every source on each of the targets to ax/ay/az
+void NBody_AccumulateSources(const NBodySources& sources, const float* tx, const float* ty, const float* tz, usize targets, float* ax, float* ay, float* az);
+
+const char* NBody_SolverName(NBodySolver solver);
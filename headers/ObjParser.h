@@ -0,0 +1,10 @@
+#pragma once
+
+#include "GL_Helpers.h"
+#include "Mesh.h"
+
+//Parses OBJ text straight out of a buffer (normally a MappedFile) into an indexed mesh.
+//Vertices are deduplicated on their position/texcoord/normal triple, polygons are fan
+//triangulated and missing normals are generated from the faces. With parallel set, large
+//buffers are split at line boundaries and the chunks are parsed on OpenMP threads.
+bool Parse_OBJ_Buffer(const char* data, usize size, ObjMeshData& out, bool parallel = true);
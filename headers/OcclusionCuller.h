@@ -0,0 +1,77 @@
+#pragma once
+
+#include "GL_Helpers.h"
+#include "glm/glm.hpp"
+
+#include <deque>
+#include <vector>
+
+//-------------------------------------------------------------------------------------------------
+// OCCLUSION CULLING
+//-------------------------------------------------------------------------------------------------
+
+//Objects per group, groups are queried as one box
+#define OCCLUSION_GROUP_SIZE 32
+
+struct OcclusionBox {
+	glm::vec3 m_min;
+	glm::vec3 m_max;
+};
+
+struct OcclusionStats {
+	u32 m_queries;			//Issued this frame
+	u32 m_pending;			//Still waiting on a result, not reissued
+	u32 m_visible_groups;
+	u32 m_visible_objects;
+};
+
+//Occlusion culling that never waits on a query. Objects are grouped along a Morton curve and
+//every group's bounding box is queried with GL_ANY_SAMPLES_PASSED_CONSERVATIVE after the scene
+//is drawn. Objects of groups that came back visible get queried one by one as well, so a hidden
+//group costs one query however many objects it holds. Results are picked up in a later Update
+//once GL_QUERY_RESULT_AVAILABLE says they're in, until then the last known visibility stands,
+//so an object coming into view shows up a frame or two late.
+//
+//	culler.Update(eye);
+//	draw culler.Visible()
+//	culler.Query(view_proj, eye);
+struct OcclusionCuller {
+	OcclusionStats m_stats = {};
+
+	bool Init();
+	void Destroy();
+
+	//Groups the objects and creates a query per group and object. Boxes are in world space
+	void Build(const OcclusionBox* boxes, u32 count);
+
+	//Reads the results that are available and rebuilds the visible list
+	void Update(const glm::vec3& eye);
+	//Indices of the objects to draw, ordered by group
+	const std::vector<u32>& Visible() const { return m_visible; }
+
+	//Draws the boxes of everything that needs a new result against the current depth buffer.
+	//Color and depth writes are off while it runs and restored after
+	void Query(const glm::mat4& view_proj, const glm::vec3& eye);
+
+private:
+	struct Node {
+		u32 m_query;
+		bool m_pending;		//Query issued, result not read yet
+		bool m_visible;
+	};
+
+	bool Inside(u32 node, const glm::vec3& eye) const;
+	void Issue(u32 node);
+
+	GLuint m_program = 0;
+	GLuint m_vao = 0;
+	GLuint m_box_buffer = 0;		//OcclusionBox per node, groups first, std430 padded to vec4s
+
+	u32 m_object_count = 0;
+	u32 m_group_count = 0;
+	std::vector<u32> m_order;		//Objects in Morton order, groups are runs of it
+	std::vector<OcclusionBox> m_boxes;
+	std::vector<Node> m_nodes;		//Groups first, then objects by original index
+	std::deque<u32> m_in_flight;	//Nodes with a pending query, in issue order, read ones popped
+	std::vector<u32> m_visible;
+};
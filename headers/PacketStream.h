@@ -0,0 +1,162 @@
+#pragma once
+
+#include "GL_Helpers.h"
+
+#include <memory>
+#include <vector>
+
+//-------------------------------------------------------------------------------------------------
+// COMMAND PACKETS
+//-------------------------------------------------------------------------------------------------
+
+//Bytes per arena block of a PacketStream, packets never straddle blocks
+#define PACKET_BLOCK_SIZE (64 * 1024)
+//Indexed bindings and texture units the replay tracks, anything above is always issued
+#define PACKET_MAX_BINDINGS 16
+#define PACKET_UNKNOWN 0xffffffffu
+
+//GL calls recorded as plain data so any thread can record them, only the thread owning the
+//context replays them. Every packet starts with a Header and is padded to 8 bytes.
+namespace packet
+{
+	enum struct Type : u16 {
+		BindProgram,
+		BindVertexArray,
+		BindBufferRange,
+		BindTexture,
+		DrawArrays,
+		DrawElements,
+	};
+
+	struct Header {
+		Type type;
+		u16 size;		//Bytes including the header
+	};
+
+	struct BIND_PROGRAM {
+		Header header;
+		GLuint program;
+	};
+
+	struct BIND_VERTEX_ARRAY {
+		Header header;
+		GLuint vao;
+	};
+
+	struct BIND_BUFFER_RANGE {
+		Header header;
+		GLenum target;
+		GLuint index;
+		GLuint buffer;
+		usize offset;
+		usize size;
+	};
+
+	struct BIND_TEXTURE {
+		Header header;
+		GLuint unit;
+		GLuint texture;
+	};
+
+	struct DRAW_ARRAYS {
+		Header header;
+		GLenum mode;
+		GLint first;
+		GLsizei count;
+		GLsizei instances;
+		GLuint base_instance;
+	};
+
+	struct DRAW_ELEMENTS {
+		Header header;
+		GLenum mode;
+		GLsizei count;
+		GLenum type;
+		GLint base_vertex;
+		usize offset;
+		GLsizei instances;
+		GLuint base_instance;
+	};
+}
+
+//A list of packets in arena blocks that are kept across Reset, so a stream recording about the
+//same amount every frame stops allocating after the first. Each recording thread owns one,
+//aligned to a cache line so neighbouring streams in an array don't share one.
+struct alignas(64) PacketStream {
+	void Reset();
+
+	void BindProgram(GLuint program);
+	void BindVertexArray(GLuint vao);
+	void BindBufferRange(GLenum target, GLuint index, GLuint buffer, usize offset, usize size);
+	void BindTexture(GLuint unit, GLuint texture);
+	void DrawArrays(GLenum mode, GLint first, GLsizei count, GLsizei instances = 1, GLuint base_instance = 0);
+	void DrawElements(GLenum mode, GLsizei count, GLenum type, usize offset, GLsizei instances = 1, GLint base_vertex = 0, GLuint base_instance = 0);
+
+	usize Count() const { return m_count; }
+	usize Bytes() const;
+
+	//Calls f(const packet::Header*) for every packet in recording order
+	template <typename F>
+	void ForEach(F f) const
+	{
+		for (usize b = 0; b <= m_block && b < m_blocks.size(); ++b) {
+			const u8* data = m_blocks[b].m_data.get();
+			for (usize at = 0; at < m_blocks[b].m_used; at += ((const packet::Header*)(data + at))->size) {
+				f((const packet::Header*)(data + at));
+			}
+		}
+	}
+
+private:
+	struct Block {
+		std::unique_ptr<u8[]> m_data;
+		usize m_used = 0;
+	};
+
+	template <typename T>
+	T* Next(packet::Type type);
+
+	std::vector<Block> m_blocks;
+	usize m_block = 0;		//Block being recorded into
+	usize m_count = 0;
+};
+
+struct PacketReplayStats {
+	u64 m_packets;		//Packets read
+	u64 m_draws;
+	u64 m_skipped;		//Binds dropped because the state was already set
+};
+
+//Replays streams on the context thread. Binds matching what the previous packets left bound
+//are dropped, so recorders can bind everything a draw needs without knowing what came before.
+struct PacketReplay {
+	bool m_eliminate = true;
+	PacketReplayStats m_stats = {};
+
+	PacketReplay() { Invalidate(); }
+
+	//Forgets the tracked state, call it when GL bindings were changed outside the replay
+	void Invalidate();
+
+	void Execute(const PacketStream& stream);
+	//Streams are merged in array order, stream i's packets all run before stream i + 1's
+	void Execute(const PacketStream* streams, usize count);
+
+private:
+	struct BufferRange {
+		GLuint buffer;
+		usize offset;
+		usize size;
+	};
+
+	void ExecutePacket(const packet::Header* header);
+	//True when the range differs from the tracked one, which is updated
+	bool SetRange(BufferRange* ranges, const packet::BIND_BUFFER_RANGE* p);
+
+	//Unknown state is held as PACKET_UNKNOWN, which no GL name ever matches
+	GLuint m_program;
+	GLuint m_vao;
+	BufferRange m_uniform[PACKET_MAX_BINDINGS];
+	BufferRange m_storage[PACKET_MAX_BINDINGS];
+	GLuint m_textures[PACKET_MAX_BINDINGS];
+};
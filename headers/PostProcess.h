@@ -1,10 +1,13 @@
 #include "GL_Helpers.h"
+#include "ShaderCache.h"
 #include "GL/glew.h"
 #include <iostream>
 #include <sstream>
 #include <fstream>
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <cstring>
 
 static const GLchar* default_vertex_shader_source = R"(
 #version 450 core
@@ -55,6 +58,35 @@ static ShaderText default_shader_text[] = {
 	{GL_NONE, NULL, NULL}
 };
 
+//Index into PostProcess::m_uniforms, resolved once with GetUniform. Stays valid until the next Init
+typedef i32 UniformHandle;
+#define INVALID_UNIFORM -1
+
+//A reflected uniform. Members of a uniform block are written into that block's std140 copy,
+//the rest are set with glProgramUniform when they changed
+struct PostUniform {
+	std::string name;		//Without a trailing [0]
+	u64 hash;
+	GLenum type;
+	GLint count;			//Array size
+	GLint location;			//Loose uniforms
+	GLint block;			//Index into m_blocks, -1 for loose uniforms
+	GLint offset;			//In the block, std140
+	GLint array_stride;
+	GLint matrix_stride;
+	usize size;				//Of the value as the caller passes it, tightly packed
+	usize value;			//Offset of the current value in m_values
+	bool dirty;
+};
+
+struct PostUniformBlock {
+	GLuint binding;
+	GLuint buffer;
+	std::vector<u8> data;	//std140, mirrors the buffer
+	usize dirty_begin;
+	usize dirty_end;
+};
+
 struct PostProcess {
 	GLuint m_program;
 	GLuint m_fbo;
@@ -66,12 +98,12 @@ struct PostProcess {
 	GLuint m_enabled_program;
 
 	//Uniform information
-	GLint m_uniform_count;
-	std::vector<std::string> m_uniform_names;
-	std::vector<GLenum> m_uniform_types;
-	std::vector<GLuint> m_uniform_locations;
+	std::vector<PostUniform> m_uniforms;
+	std::vector<PostUniformBlock> m_blocks;
+	std::vector<u8> m_values;				//Last value set for every uniform
+	std::vector<UniformHandle> m_dirty;		//Loose uniforms waiting for FlushUniforms
 
-	PostProcess() :m_program(0), m_fbo(0), m_texture(0), m_depth(0), m_default_program(0), m_disabled_program(0), m_enabled_program(0), m_uniform_count(0) {}
+	PostProcess() :m_program(0), m_fbo(0), m_texture(0), m_depth(0), m_default_program(0), m_disabled_program(0), m_enabled_program(0) {}
 	void Init(const char* fragment_shader_filename, int window_width, int window_height);
 	void StartFrame(float clear_color[4]);
 	void EndFrame(float clear_color[4]);
@@ -80,11 +112,69 @@ struct PostProcess {
 	void Enable() { m_program = m_enabled_program; }
 	void Disable() { m_program = m_disabled_program; }
 
+	//Resolve names once, then set by handle. Values are kept and only uploaded on PresentFrame
+	//or ReadyFrame if they changed, all changes to a uniform block go up in one update.
+	//Matrices are column major and tightly packed like glm's, bools are passed as GLint
+	UniformHandle GetUniform(const char* name) const;
+	template<typename T>
+	void SetUniform(UniformHandle handle, const T& value) { SetUniformData(handle, &value, sizeof(T)); }
+	void SetUniformData(UniformHandle handle, const void* value, usize size);
+	//Looks the name up on every call, prefer handles
 	void SetUniform(const char* name, void* value);
+	void FlushUniforms();
+
+private:
+	void ReflectUniforms();
 };
 
+//FNV-1a, for looking up uniform names without building strings
+static u64 UniformNameHash(const char* name)
+{
+	u64 hash = 0xCBF29CE484222325ull;
+	for (; *name; ++name) {
+		hash ^= (u8)*name;
+		hash *= 0x100000001B3ull;
+	}
+	return hash;
+}
+
+//Columns of a matrix type, 1 for scalars and vectors, 0 for types that hold no value (samplers, images)
+static u32 UniformColumns(GLenum type)
+{
+	switch (type) {
+	case GL_FLOAT: case GL_FLOAT_VEC2: case GL_FLOAT_VEC3: case GL_FLOAT_VEC4:
+	case GL_INT: case GL_INT_VEC2: case GL_INT_VEC3: case GL_INT_VEC4:
+	case GL_UNSIGNED_INT: case GL_UNSIGNED_INT_VEC2: case GL_UNSIGNED_INT_VEC3: case GL_UNSIGNED_INT_VEC4:
+	case GL_BOOL: case GL_BOOL_VEC2: case GL_BOOL_VEC3: case GL_BOOL_VEC4:
+		return 1;
+	case GL_FLOAT_MAT2: case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT2x4:
+		return 2;
+	case GL_FLOAT_MAT3: case GL_FLOAT_MAT3x2: case GL_FLOAT_MAT3x4:
+		return 3;
+	case GL_FLOAT_MAT4: case GL_FLOAT_MAT4x2: case GL_FLOAT_MAT4x3:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+//Size of one element as the caller passes it. GetGLTypeSize counts bools as GLboolean, uniforms take them as GLint
+static usize UniformElementSize(GLenum type)
+{
+	switch (type) {
+	case GL_BOOL: return sizeof(GLint);
+	case GL_BOOL_VEC2: return 2 * sizeof(GLint);
+	case GL_BOOL_VEC3: return 3 * sizeof(GLint);
+	case GL_BOOL_VEC4: return 4 * sizeof(GLint);
+	default: return GetGLTypeSize(type);
+	}
+}
+
 void PostProcess::Init(const char* fragment_shader_filename, int window_width, int window_height) {
-	m_default_program = LoadShaders(default_shader_text);
+	//The pass-through program is the same for every PostProcess, only build it once
+	static GLuint default_program = 0;
+	if (!default_program) default_program = LoadShaders(default_shader_text);
+	m_default_program = default_program;
 	m_disabled_program = m_default_program;
 
 	std::ifstream ifs;
@@ -105,32 +195,19 @@ void PostProcess::Init(const char* fragment_shader_filename, int window_width, i
 			{GL_NONE, NULL, NULL}
 		};
 
+		//Both programs compile at once in async mode, only this one has to be waited on
 		m_program = LoadShaders(pp_shader_text);
-		if (!m_program)
+		if (!ShaderCache::Resolve(m_program))
 		{
 			std::cerr << "Invalid shader program, falling back to default" << std::endl;
+			if (m_program) glDeleteProgram(m_program);
 			m_program = m_default_program;
 		}
 	}
 	m_enabled_program = m_program;
 
-	//Determine Uniform Data
-	glGetProgramiv(m_program, GL_ACTIVE_UNIFORMS, &m_uniform_count);
-	for (size_t i = 0; i < m_uniform_count; ++i) {
-		const GLsizei bufSize = 256;
-		GLchar name[bufSize];
-		GLsizei length;
-		GLint size;
-		GLenum type;
-		glGetActiveUniform(m_program, i, bufSize, &length, &size, &type, name);
-		GLint location = glGetUniformLocation(m_program, name);
+	ReflectUniforms();
 
-		std::cout << type << std::endl;
-		m_uniform_names.push_back(std::string(name));
-		m_uniform_types.push_back(type);
-		m_uniform_locations.push_back(location);
-	}
-	
 	if (m_fbo) return;
 
 	static const GLenum draw_buffers[] = { GL_COLOR_ATTACHMENT0 };
@@ -174,34 +251,189 @@ void PostProcess::EndFrame(float clear_color[4]) {
 }
 
 void PostProcess::ReadyFrame() {
+	FlushUniforms();
 	glUseProgram(m_program);
 }
 
 void PostProcess::PresentFrame() {
+	FlushUniforms();
 	glUseProgram(m_program);
 	glActiveTexture(GL_TEXTURE0);
 	glBindTextureUnit(0, m_texture);
 	glDrawArrays(GL_TRIANGLES, 0, 6);
 }
 
-void PostProcess::SetUniform(const char* name, void* value) {
-	if (m_program == m_disabled_program) return;
-	glUseProgram(m_program);
-	std::string string_name = std::string(name);
-	for (size_t i = 0; i < m_uniform_names.size(); ++i) {
-		if (string_name == m_uniform_names[i]) {
-			switch (m_uniform_types[i]) {
-			case GL_FLOAT:
-				glUniform1f(m_uniform_locations[i], *(float*)value);
-				return;
-			case GL_INT_VEC2:
-				glUniform2iv(m_uniform_locations[i], 1, (int*)value);
-				return;
+void PostProcess::ReflectUniforms() {
+	for (PostUniformBlock& block : m_blocks) glDeleteBuffers(1, &block.buffer);
+	m_uniforms.clear();
+	m_blocks.clear();
+	m_values.clear();
+	m_dirty.clear();
+
+	GLint block_count = 0;
+	glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_BLOCKS, &block_count);
+	for (GLint i = 0; i < block_count; ++i) {
+		GLint size, binding;
+		glGetActiveUniformBlockiv(m_program, i, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+		glGetActiveUniformBlockiv(m_program, i, GL_UNIFORM_BLOCK_BINDING, &binding);
+
+		PostUniformBlock block;
+		block.binding = binding;
+		block.data.assign(size, 0);
+		block.dirty_begin = size;
+		block.dirty_end = 0;
+		glCreateBuffers(1, &block.buffer);
+		glNamedBufferStorage(block.buffer, size, block.data.data(), GL_DYNAMIC_STORAGE_BIT);
+		m_blocks.push_back(std::move(block));
+	}
+
+	GLint uniform_count = 0;
+	glGetProgramiv(m_program, GL_ACTIVE_UNIFORMS, &uniform_count);
+	for (GLint i = 0; i < uniform_count; ++i) {
+		const GLsizei bufSize = 256;
+		GLchar name[bufSize];
+		GLsizei length;
+		GLint size;
+		GLenum type;
+		glGetActiveUniform(m_program, i, bufSize, &length, &size, &type, name);
+		if (UniformColumns(type) == 0) continue;
+
+		const GLuint index = i;
+		PostUniform uniform;
+		glGetActiveUniformsiv(m_program, 1, &index, GL_UNIFORM_BLOCK_INDEX, &uniform.block);
+		glGetActiveUniformsiv(m_program, 1, &index, GL_UNIFORM_OFFSET, &uniform.offset);
+		glGetActiveUniformsiv(m_program, 1, &index, GL_UNIFORM_ARRAY_STRIDE, &uniform.array_stride);
+		glGetActiveUniformsiv(m_program, 1, &index, GL_UNIFORM_MATRIX_STRIDE, &uniform.matrix_stride);
+
+		if (length > 3 && strcmp(name + length - 3, "[0]") == 0) name[length - 3] = '\0';
+		uniform.name = name;
+		uniform.hash = UniformNameHash(name);
+		uniform.type = type;
+		uniform.count = size;
+		uniform.location = uniform.block < 0 ? glGetUniformLocation(m_program, name) : -1;
+		uniform.size = UniformElementSize(type) * size;
+		uniform.value = m_values.size();
+		uniform.dirty = false;
+		m_values.resize(m_values.size() + uniform.size);
+
+		//Start from what the program holds, that keeps initializers of loose uniforms
+		if (uniform.block < 0 && uniform.location >= 0 && uniform.size) {
+			void* value = &m_values[uniform.value];
+			switch (type) {
+			case GL_INT: case GL_INT_VEC2: case GL_INT_VEC3: case GL_INT_VEC4:
+			case GL_BOOL: case GL_BOOL_VEC2: case GL_BOOL_VEC3: case GL_BOOL_VEC4:
+				glGetnUniformiv(m_program, uniform.location, (GLsizei)uniform.size, (GLint*)value);
+				break;
+			case GL_UNSIGNED_INT: case GL_UNSIGNED_INT_VEC2: case GL_UNSIGNED_INT_VEC3: case GL_UNSIGNED_INT_VEC4:
+				glGetnUniformuiv(m_program, uniform.location, (GLsizei)uniform.size, (GLuint*)value);
+				break;
 			default:
-				std::cerr << "Unsupported Uniform Type" << std::endl;
+				glGetnUniformfv(m_program, uniform.location, (GLsizei)uniform.size, (GLfloat*)value);
+				break;
 			}
+		}
+		m_uniforms.push_back(std::move(uniform));
+	}
+}
+
+UniformHandle PostProcess::GetUniform(const char* name) const {
+	const u64 hash = UniformNameHash(name);
+	for (size_t i = 0; i < m_uniforms.size(); ++i) {
+		if (m_uniforms[i].hash == hash && m_uniforms[i].name == name) return (UniformHandle)i;
+	}
+	std::cerr << "Uniform name: " << name << " doesn't exist or was optimized away." << std::endl;
+	return INVALID_UNIFORM;
+}
+
+void PostProcess::SetUniformData(UniformHandle handle, const void* value, usize size) {
+	if (handle < 0 || handle >= (UniformHandle)m_uniforms.size()) return;
+	PostUniform& uniform = m_uniforms[handle];
+	if (size != uniform.size) {
+		std::cerr << "Uniform " << uniform.name << " is " << uniform.size << " bytes, got " << size << std::endl;
+		return;
+	}
+
+	//Same value as last time, nothing to upload
+	u8* current = &m_values[uniform.value];
+	if (memcmp(current, value, size) == 0) return;
+	memcpy(current, value, size);
+
+	if (uniform.block < 0) {
+		if (!uniform.dirty) m_dirty.push_back(handle);
+		uniform.dirty = true;
+		return;
+	}
+
+	//Scatter into the block's std140 layout, arrays and matrix columns are padded there
+	PostUniformBlock& block = m_blocks[uniform.block];
+	const u32 columns = UniformColumns(uniform.type);
+	const usize element_size = UniformElementSize(uniform.type);
+	const usize column_size = element_size / columns;
+	const u8* src = (const u8*)value;
+	for (GLint e = 0; e < uniform.count; ++e) {
+		for (u32 c = 0; c < columns; ++c) {
+			const usize dst = uniform.offset + e * uniform.array_stride + c * uniform.matrix_stride;
+			memcpy(&block.data[dst], src + e * element_size + c * column_size, column_size);
+		}
+	}
+	const usize last = uniform.offset + (uniform.count - 1) * uniform.array_stride + (columns - 1) * uniform.matrix_stride + column_size;
+	block.dirty_begin = std::min(block.dirty_begin, (usize)uniform.offset);
+	block.dirty_end = std::max(block.dirty_end, last);
+}
+
+void PostProcess::FlushUniforms() {
+	if (m_program != m_enabled_program) return;
 
+	for (PostUniformBlock& block : m_blocks) {
+		if (block.dirty_begin < block.dirty_end) {
+			glNamedBufferSubData(block.buffer, block.dirty_begin, block.dirty_end - block.dirty_begin, &block.data[block.dirty_begin]);
+			block.dirty_begin = block.data.size();
+			block.dirty_end = 0;
+		}
+		glBindBufferBase(GL_UNIFORM_BUFFER, block.binding, block.buffer);
+	}
+
+	for (UniformHandle handle : m_dirty) {
+		PostUniform& uniform = m_uniforms[handle];
+		const void* value = &m_values[uniform.value];
+		const GLint location = uniform.location;
+		const GLsizei count = uniform.count;
+		uniform.dirty = false;
+
+		switch (uniform.type) {
+		case GL_FLOAT: glProgramUniform1fv(m_program, location, count, (const GLfloat*)value); break;
+		case GL_FLOAT_VEC2: glProgramUniform2fv(m_program, location, count, (const GLfloat*)value); break;
+		case GL_FLOAT_VEC3: glProgramUniform3fv(m_program, location, count, (const GLfloat*)value); break;
+		case GL_FLOAT_VEC4: glProgramUniform4fv(m_program, location, count, (const GLfloat*)value); break;
+		case GL_INT: case GL_BOOL: glProgramUniform1iv(m_program, location, count, (const GLint*)value); break;
+		case GL_INT_VEC2: case GL_BOOL_VEC2: glProgramUniform2iv(m_program, location, count, (const GLint*)value); break;
+		case GL_INT_VEC3: case GL_BOOL_VEC3: glProgramUniform3iv(m_program, location, count, (const GLint*)value); break;
+		case GL_INT_VEC4: case GL_BOOL_VEC4: glProgramUniform4iv(m_program, location, count, (const GLint*)value); break;
+		case GL_UNSIGNED_INT: glProgramUniform1uiv(m_program, location, count, (const GLuint*)value); break;
+		case GL_UNSIGNED_INT_VEC2: glProgramUniform2uiv(m_program, location, count, (const GLuint*)value); break;
+		case GL_UNSIGNED_INT_VEC3: glProgramUniform3uiv(m_program, location, count, (const GLuint*)value); break;
+		case GL_UNSIGNED_INT_VEC4: glProgramUniform4uiv(m_program, location, count, (const GLuint*)value); break;
+		case GL_FLOAT_MAT2: glProgramUniformMatrix2fv(m_program, location, count, GL_FALSE, (const GLfloat*)value); break;
+		case GL_FLOAT_MAT2x3: glProgramUniformMatrix2x3fv(m_program, location, count, GL_FALSE, (const GLfloat*)value); break;
+		case GL_FLOAT_MAT2x4: glProgramUniformMatrix2x4fv(m_program, location, count, GL_FALSE, (const GLfloat*)value); break;
+		case GL_FLOAT_MAT3: glProgramUniformMatrix3fv(m_program, location, count, GL_FALSE, (const GLfloat*)value); break;
+		case GL_FLOAT_MAT3x2: glProgramUniformMatrix3x2fv(m_program, location, count, GL_FALSE, (const GLfloat*)value); break;
+		case GL_FLOAT_MAT3x4: glProgramUniformMatrix3x4fv(m_program, location, count, GL_FALSE, (const GLfloat*)value); break;
+		case GL_FLOAT_MAT4: glProgramUniformMatrix4fv(m_program, location, count, GL_FALSE, (const GLfloat*)value); break;
+		case GL_FLOAT_MAT4x2: glProgramUniformMatrix4x2fv(m_program, location, count, GL_FALSE, (const GLfloat*)value); break;
+		case GL_FLOAT_MAT4x3: glProgramUniformMatrix4x3fv(m_program, location, count, GL_FALSE, (const GLfloat*)value); break;
+		}
+	}
+	m_dirty.clear();
+}
+
+void PostProcess::SetUniform(const char* name, void* value) {
+	const u64 hash = UniformNameHash(name);
+	for (size_t i = 0; i < m_uniforms.size(); ++i) {
+		if (m_uniforms[i].hash == hash && m_uniforms[i].name == name) {
+			SetUniformData((UniformHandle)i, value, m_uniforms[i].size);
+			return;
 		}
 	}
 	std::cerr << "Uniform name: " << name << " doesn't exist or was optimized away." << std::endl;
-}
\ No newline at end of file
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "System.h"
+
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------------------------------------------
+// PROGRAM BENCHMARK
+//-------------------------------------------------------------------------------------------------
+
+#define PROGRAM_BENCHMARK_WARMUP 60
+#define PROGRAM_BENCHMARK_FRAMES 300
+
+typedef Program* (*ProgramFactory)();
+
+struct RegisteredProgram {
+	std::string m_name;			//Source file of the program without its directory and extension
+	SystemConf m_config;
+	ProgramFactory m_factory;
+};
+
+//Programs that registered themselves from static initializers, in registration order
+struct ProgramRegistry {
+	static void Register(const char* name, const SystemConf& config, ProgramFactory factory);
+	static const std::vector<RegisteredProgram>& Programs();
+};
+
+struct ProgramRegistrar {
+	ProgramRegistrar(const char* name, const SystemConf& config, ProgramFactory factory) { ProgramRegistry::Register(name, config, factory); }
+};
+
+#define PROGRAM_REGISTRAR_CONCAT(a, b) a##b
+#define PROGRAM_REGISTRAR_NAME(line) PROGRAM_REGISTRAR_CONCAT(program_registrar_, line)
+
+//Registers a default constructible Program subclass. MAIN does this for Application under
+//BENCHMARK_PROGRAMS, a file can add more, name is usually __FILE__
+#define REGISTER_PROGRAM(type, name, config) \
+static ProgramRegistrar PROGRAM_REGISTRAR_NAME(__LINE__)(name, config, []() -> Program* { return new type(); });
+
+struct BenchmarkSettings {
+	u32 m_warmup = PROGRAM_BENCHMARK_WARMUP;	//Frames run before measuring, caches and drivers settle
+	u32 m_frames = PROGRAM_BENCHMARK_FRAMES;
+	f64 m_dt = 1.0 / 60.0;						//Every OnUpdate gets it, so runs animate the same
+	i32 m_width = 0;							//0 keeps the program's SystemConf size
+	i32 m_height = 0;
+	const char* m_filter = nullptr;				//Only programs whose name contains it
+	const char* m_json = nullptr;				//Reports, not written when null
+	const char* m_csv = nullptr;
+};
+
+struct FrameTimeStats {
+	u32 m_samples;
+	f64 m_mean;
+	f64 m_min;
+	f64 m_p50;
+	f64 m_p90;
+	f64 m_p95;
+	f64 m_p99;
+	f64 m_max;
+};
+
+struct ProgramBenchmarkResult {
+	std::string m_name;
+	std::string m_renderer;
+	i32 m_width;
+	i32 m_height;
+	f64 m_init_ms;				//OnInit, its shaders resolved and the loads it submitted landed
+	FrameTimeStats m_frame;		//Whole frame on the CPU, buffer swap included
+	FrameTimeStats m_update;	//OnUpdate
+	FrameTimeStats m_draw;		//OnDraw, the commands it submits rather than their execution
+	FrameTimeStats m_gpu;		//GPU profiler frames, fewer samples if the profiler had to skip
+};
+
+//Runs registered programs for a fixed number of frames in a hidden window and reports frame time
+//percentiles. The loop is Event::Run's with the pacer, ImGui and OnGui left out: dt is fixed,
+//nothing waits between frames and the swap interval is 0. The context is always the platform's,
+//GLEW resolves through it. For software GL on machines without a GPU driver put Mesa's llvmpipe
+//opengl32.dll next to the executable. A program that gets no context fails on its own, the rest
+//still run. GPU times are GpuProfiler frames, read back after the last frame.
+//
+//	Application.exe [-w warmup] [-n frames] [-d dt] [-s WxH] [-f filter] [-j results.json] [-c results.csv]
+struct ProgramBenchmark {
+	static bool Run(const RegisteredProgram& program, const BenchmarkSettings& settings, ProgramBenchmarkResult* result);
+
+	static bool WriteJSON(const char* filename, const BenchmarkSettings& settings, const std::vector<ProgramBenchmarkResult>& results);
+	//One row per program and measurement
+	static bool WriteCSV(const char* filename, const std::vector<ProgramBenchmarkResult>& results);
+
+	//Parses the command line, runs every registered program that matches and writes the reports
+	static int Main(int argc, char** argv);
+};
+
+//Entry point MAIN expands to under BENCHMARK_PROGRAMS. Release builds link as a windowed
+//application, so a console is opened there for the output
+#ifdef _DEBUG
+#define BENCHMARK_MAIN					\
+int main(int argc, char** argv) {		\
+	return ProgramBenchmark::Main(argc, argv);	\
+}
+#else
+#define BENCHMARK_MAIN					\
+int CALLBACK WinMain(					\
+	_In_ HINSTANCE hInstance,			\
+	_In_opt_ HINSTANCE hPrevInstance,	\
+	_In_ LPSTR     lpCmdLine,			\
+	_In_ int       nCmdShow				\
+) {										\
+	AllocConsole();						\
+	freopen("CONOUT$", "w", stdout);	\
+	freopen("CONOUT$", "w", stderr);	\
+	return ProgramBenchmark::Main(__argc, __argv);	\
+}
+#endif //_DEBUG
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "GL_Helpers.h"
+
+//-------------------------------------------------------------------------------------------------
+// SHADER CACHE
+//-------------------------------------------------------------------------------------------------
+
+struct ShaderCacheStats {
+	u32 m_programs;		//Loaded through the cache
+	u32 m_hits;			//Of those, created from a stored binary
+	u32 m_failed;		//Failed to compile or link
+	f64 m_submit_ms;	//Spent in LoadShaders
+	f64 m_resolve_ms;	//Spent waiting on link results
+};
+
+//Every program LoadShaders builds goes through here. Linked programs are stored with
+//glGetProgramBinary under a hash of their sources and the driver strings, the next run loads
+//them back with glProgramBinary instead of compiling. A binary the driver rejects, after a
+//driver update say, is deleted and the program is compiled again.
+//
+//In async mode LoadShaders only submits the compile and link and returns, with
+//GL_KHR_parallel_shader_compile the driver works on all of them at once. Link status is checked
+//in Resolve, which Event::Run calls for everything once OnInit returns, right before the
+//programs are first used. A program that failed is still a valid name then, it just draws nothing,
+//callers that need to know check ShaderCache::Resolve rather than comparing against 0.
+//
+//Transform feedback varyings are part of the link, so they're passed in and set before it rather
+//than relinking afterwards: a program loaded from a binary has no shaders left to relink.
+struct ShaderCache {
+	//Compiles or loads a program from count stages. shaders receives the shader objects,
+	//0 for a program loaded from a binary. varyings, if any, are captured with buffer_mode.
+	//Returns 0 when it failed, in async mode only if the sources couldn't be read
+	static GLuint Load(const GLenum* types, const char* const* sources, u32 count, GLuint* shaders,
+		const char* const* varyings = nullptr, u32 varying_count = 0, GLenum buffer_mode = GL_INTERLEAVED_ATTRIBS);
+
+	//Waits for the program to link, reports errors and stores its binary. Returns whether it linked
+	static bool Resolve(GLuint program);
+	static void ResolveAll();
+	//True once the driver is done with the program, Resolve won't wait then
+	static bool Ready(GLuint program);
+
+	//Prints how the programs were loaded, init_ms being the whole startup
+	static void Report(f64 init_ms);
+	static const ShaderCacheStats& Stats();
+
+	static void SetAsync(bool async) { s_async = async; }
+	static bool IsAsync() { return s_async; }
+	static void SetBinaries(bool binaries) { s_binaries = binaries; }
+	static void SetDirectory(const char* directory) { s_directory = directory; }
+
+private:
+	static bool s_async;
+	static bool s_binaries;
+	static const char* s_directory;
+};
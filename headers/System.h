@@ -19,6 +19,11 @@ typedef unsigned long DWORD;
 #include "imgui_impl_opengl3.h"
 
 #include "GL_Helpers.h"
+#include "FramePacer.h"
+#include "AssetManager.h"
+#include "GpuProfiler.h"
+#include "GLState.h"
+#include "ShaderCache.h"
 
 #include <iostream>
 #include <irrKlang.h>
@@ -38,6 +43,7 @@ struct SystemConf;
 struct Window {
 	friend struct System;
 	friend struct Event;
+	friend struct ProgramBenchmark;
 
 	Window(SystemConf config);
 	~Window();
@@ -53,10 +59,14 @@ struct Window {
 	void GetWindowStats();
 	void VSync(bool state);
 	void SetFrameLimit(f64 limit);
+	void SetFramePacing(PacingPolicy policy);
+	void SetFixedTimestep(f64 rate);
 
 	u64 GetFPS() { return m_fps; }
 	f64 GetTime() { return m_time; }
 	f64 GetFrameLimit() { return m_framelimit; }
+	f64 GetInterpolationAlpha() { return m_pacer.GetAlpha(); }
+	PacingStats GetPacingStats() { return m_pacer.GetStats(); }
 	bool IsRunning() { return m_running; }
 	GLFWwindow* GetHandle() { return m_handle; }
 	WindowXY GetWindowDimensions() { return WindowXY{ m_width, m_height }; }
@@ -77,6 +87,7 @@ private:
 	u64 m_framecount;
 	u64 m_fps;
 	f64 m_time;
+	FramePacer m_pacer;
 };
 
 //-------------------------------------------------------------------------------------------------
@@ -87,6 +98,7 @@ private:
 struct Input {
 	friend struct System;
 	friend struct Event;
+	friend struct ProgramBenchmark;
 
 	//Keyboard Input
 public:
@@ -151,7 +163,8 @@ private:
 //-------------------------------------------------------------------------------------------------
 
 struct Audio {
-	Audio();
+	//silent opens irrKlang's null driver, for machines without a sound device
+	Audio(bool silent = false);
 	~Audio();
 	ISoundEngine* m_engine;
 
@@ -187,12 +200,16 @@ struct SystemConf {
 	bool vsync;
 	f64 frame_limit;
 	const char* icon_path;
+	bool hidden = false;						//Never shown, silent audio, set by the benchmark runner. A window
+												//or GLEW failure leaves the System invalid instead of exiting
 };
 
 struct System
 {
 	System(SystemConf config);
 
+	bool IsValid() const { return m_valid; }
+
 	Window m_window;
 	Input m_input;
 	Audio m_audio;
@@ -206,6 +223,9 @@ struct System
 	static void Cursor_Enter_Callback(GLFWwindow* window, int entered);
 	static void Mouse_Button_Callback(GLFWwindow* window, int button, int action, int mods);
 	static void Mouse_Scroll_Callback(GLFWwindow* window, double xoffset, double yoffset);
+
+private:
+	bool m_valid = false;
 };
 
 //-------------------------------------------------------------------------------------------------
@@ -213,6 +233,7 @@ struct System
 //-------------------------------------------------------------------------------------------------
 
 struct Program {
+	virtual ~Program() = default;
 	virtual void OnInit(Input& input, Audio& audio, Window& window) = 0;
 	virtual void OnUpdate(Input& input, Audio& audio, Window& window, f64 dt) = 0;
 	virtual void OnDraw() = 0;
@@ -232,7 +253,12 @@ struct Event
 // ENTRY POINT
 //-------------------------------------------------------------------------------------------------
 
-#ifdef _DEBUG
+#if defined(BENCHMARK_PROGRAMS)
+//The sample registers itself and the benchmark runner takes over main, see ProgramBenchmark.h
+#define MAIN(config)					\
+REGISTER_PROGRAM(Application, __FILE__, config)	\
+BENCHMARK_MAIN
+#elif defined(_DEBUG)
 #define MAIN(config)					\
 int main() {							\
 	System system(config);				\
@@ -253,4 +279,30 @@ int CALLBACK WinMain(					\
 }
 #endif //_DEBUG
 
+//Entry point for programs that never open a window, function is int(). Release builds link as
+//a windowed application, so a console is opened there for the output
+#ifdef _DEBUG
+#define HEADLESS_MAIN(function)			\
+int main() {							\
+	return function();					\
+}
+#else
+#define HEADLESS_MAIN(function)			\
+int CALLBACK WinMain(					\
+	_In_ HINSTANCE hInstance,			\
+	_In_opt_ HINSTANCE hPrevInstance,	\
+	_In_ LPSTR     lpCmdLine,			\
+	_In_ int       nCmdShow				\
+) {										\
+	AllocConsole();						\
+	freopen("CONOUT$", "w", stdout);	\
+	freopen("CONOUT$", "w", stderr);	\
+	int result = function();			\
+	system("pause");					\
+	return result;						\
+}
+#endif //_DEBUG
 
+#ifdef BENCHMARK_PROGRAMS
+#include "ProgramBenchmark.h"
+#endif //BENCHMARK_PROGRAMS
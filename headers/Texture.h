@@ -1,33 +1,39 @@
 #pragma once
 
 #include "GL_Helpers.h"
+#include "MappedFile.h"
 
+//Non-owning view over the header and image data of a KTX file.
+//Points straight into the mapping, so the MappedFile must outlive the view.
 struct KTX_Raw {
-	KTX_Raw() :m_data(nullptr) {}
-	KTX_Raw(
-		unsigned char* data, 
-		int width, 
-		int height, 
-		int format, 
-		int internal_format, 
-		int gltype, 
-		int miplevels
-	)
-		:m_data(data), m_width(width), m_height(height),
-		m_glformat(format), m_glinternal_format(internal_format), 
-		m_gltype(gltype), m_miplevels(miplevels)
+	KTX_Raw()
+		:m_data(nullptr), m_size(0), m_width(0), m_height(0), m_depth(0),
+		m_array_elements(0), m_faces(0), m_glformat(0), m_glinternal_format(0),
+		m_gltype(0), m_gltypesize(0), m_miplevels(0), m_target(0), m_swap(false), m_image_sizes(true)
 	{}
-	~KTX_Raw() { delete[] m_data; }
 
-	unsigned char* m_data;
+	const unsigned char* m_data;	//Start of the mip chain, first imageSize field
+	usize m_size;					//Bytes from m_data to the end of the file
 	int m_width;
 	int m_height;
+	int m_depth;
+	int m_array_elements;
+	int m_faces;
 	int m_glformat;
 	int m_glinternal_format;
 	int m_gltype;
+	int m_gltypesize;
 	int m_miplevels;
+	GLenum m_target;
+	bool m_swap;
+	bool m_image_sizes;				//False for files written without the imageSize field
 };
 
 GLuint Load_KTX(const char* filename, GLuint texture = 0);
-KTX_Raw Get_KTX_Raw(const char* filename);
+GLuint Upload_KTX(const KTX_Raw& ktx, GLuint texture = 0);
+KTX_Raw Get_KTX_Raw(const MappedFile& file);
+const unsigned char* Get_KTX_Level(const KTX_Raw& ktx, int level, u32* image_size);
+//Writes a KTX with ktx's header fields, m_data is ignored. levels[i] is level i laid out as
+//Get_KTX_Level returns it and sizes[i] its imageSize. Compressed data has m_gltype GL_NONE
+bool Save_KTX(const char* filename, const KTX_Raw& ktx, const unsigned char* const* levels, const u32* sizes);
 GLuint CreateTextureArray(const char* filenames[], size_t length);
\ No newline at end of file
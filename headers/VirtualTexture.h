@@ -0,0 +1,174 @@
+#pragma once
+
+#include "GL_Helpers.h"
+#include "MappedFile.h"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+//-------------------------------------------------------------------------------------------------
+// VIRTUAL TEXTURE
+//-------------------------------------------------------------------------------------------------
+
+//Baked virtual textures are "*.svt" files, a header followed by every page of every level. A page
+//is (page size + 2 * border) texels square of RGBA8, the border repeating its neighbours so the
+//atlas can filter across a page edge. Levels run finest first, pages row by row, and stop once
+//the shorter side is down to one page.
+
+#define VIRTUAL_TEXTURE_VERSION 1
+#define VIRTUAL_TEXTURE_PAGE_SIZE 128
+#define VIRTUAL_TEXTURE_BORDER 4
+//Feedback readbacks in flight before EndFeedback starts skipping frames
+#define VIRTUAL_TEXTURE_READBACKS 3
+
+//Texture units and uniform block binding virtual_texture_glsl reads, Bind fills them
+#define VIRTUAL_TEXTURE_POOL_UNIT 14
+#define VIRTUAL_TEXTURE_TABLE_UNIT 15
+#define VIRTUAL_TEXTURE_UBO_BINDING 14
+
+struct VirtualTextureHeader {
+	char m_magic[4];
+	u32 m_version;
+	u32 m_width;
+	u32 m_height;
+	u32 m_page_size;
+	u32 m_border;
+	u32 m_levels;
+	u32 m_format;			//GL_RGBA8 or GL_SRGB8_ALPHA8
+};
+
+struct VirtualTextureStats {
+	u32 m_requested;		//Pages of the last working set, the levels above them included
+	u32 m_missing;			//Of those, not resident when it was applied
+	u32 m_in_flight;		//Loads on the workers
+	u32 m_resident;
+	u32 m_capacity;			//Pool slots, the pinned coarse levels included
+	u32 m_feedback_latency;	//Frames between drawing the feedback and applying its working set
+	u64 m_loaded;
+	u64 m_evicted;
+	u64 m_dropped;			//Loads that found every slot in use by the current working set
+};
+
+//Shared by the sample shaders, paste it after the #version line.
+//	uint VT_Feedback(vec2 uv)		page request to write to the feedback target
+//	vec4 VT_Sample(vec2 uv)			the finest resident texels at uv
+//	float VT_ResidentLevel(vec2 uv)	level VT_Sample reads at uv
+extern const char* const virtual_texture_glsl;
+
+//Streams the pages of a baked virtual texture into a fixed pool, driven by what's on screen.
+//
+//The scene is drawn a second time into a small R32UI target with VT_Feedback, every texel the
+//page and level it wants. The target is read back into a pixel buffer and picked up in a later
+//Update once its fence has signalled, so nothing waits on the GPU. An AssetManager worker reduces
+//it to the working set and the render thread queues the missing pages coarsest first. Workers
+//copy them out of the mapped file, their uploads run in AssetManager::Pump and take the slot of
+//the page least recently part of a working set.
+//
+//With ARB_sparse_texture and a page size that divides ours the pool is the virtual texture itself,
+//pages committed and decommitted as they come and go, sampled trilinearly. Without it the pool is
+//an atlas of bordered slots sampled bilinearly. Either way a page table with a level per virtual
+//level maps every page to the finest resident one covering it. The coarsest level, or the whole
+//sparse mip tail, stays resident and a page is only evicted once none of its children is, so a
+//lookup always lands on resident texels.
+//
+//	vt.Update();
+//	vt.BeginFeedback();
+//	draw writing VT_Feedback
+//	vt.EndFeedback();
+//	vt.Bind();
+//	draw reading VT_Sample
+struct VirtualTexture {
+	VirtualTextureStats m_stats = {};
+	f32 m_lod_bias = 0.0f;			//Added to the requested level, positive asks for coarser pages
+	u32 m_max_in_flight = 32;		//Loads handed to the workers at once
+
+	//Writes rgba, tightly packed RGBA8 with power of two sides no smaller than a page, to filename.
+	//The levels are built with MipGenerator
+	static bool Bake(const char* filename, const u8* rgba, u32 width, u32 height, bool srgb);
+	//Whether filename holds a bake this version reads
+	static bool IsBaked(const char* filename);
+
+	//pool_pages is how many streamed pages fit in VRAM at once. The feedback target is the
+	//framebuffer size divided by feedback_scale. force_atlas skips the sparse path
+	bool Init(const char* filename, u32 pool_pages, u32 width, u32 height, u32 feedback_scale = 8, bool force_atlas = false);
+	//Waits for the loads in flight, their uploads write into this
+	void Destroy();
+
+	//Update, the feedback pass and Bind do nothing until an Init succeeded
+	bool IsValid() const { return m_pool != 0; }
+
+	//Applies nothing itself, picks up finished readbacks and uploads the page table if it changed
+	void Update();
+	//Binds and clears the feedback target, EndFeedback starts its readback and restores framebuffer 0
+	void BeginFeedback();
+	void EndFeedback();
+	void Bind() const;
+
+	bool IsSparse() const { return m_sparse; }
+	const VirtualTextureHeader& Header() const { return m_header; }
+	u32 Levels() const { return m_header.m_levels; }
+
+private:
+	struct Slot {
+		u32 m_page;			//Page key, U32_MAX if free
+		u32 m_used;			//Working set that last asked for it
+		u32 m_children;		//Resident pages one level finer inside it
+		bool m_pinned;
+	};
+
+	struct Readback {
+		GLuint m_buffer;
+		GLsync m_fence;
+		u32 m_width;
+		u32 m_height;
+		u32 m_frame;
+	};
+
+	u32 PagesX(u32 level) const;
+	u32 PagesY(u32 level) const;
+	const u8* PageData(u32 page) const;
+
+	void ApplyWorkingSet(const std::vector<u32>& pages, u32 frame);
+	void Load(u32 page);
+	//Uploads a page into a slot, false if none could be freed
+	bool Place(u32 page, const u8* data, bool pinned);
+	void Evict(u32 slot);
+	void Commit(u32 page, u32 slot, const u8* data);
+	//Commits or releases a sparse page, leaves the GL_TEXTURE_2D binding as it was
+	void PageCommitment(u32 page, bool commit);
+	void UploadTable();
+
+	MappedFile m_file;
+	VirtualTextureHeader m_header = {};
+	std::vector<u64> m_level_offsets;		//Byte offset of each level's first page
+	usize m_page_bytes = 0;
+
+	bool m_sparse = false;
+	u32 m_pinned_level = 0;					//This level and the coarser ones never leave
+	GLuint m_pool = 0;
+	GLuint m_table = 0;
+	GLuint m_uniforms = 0;
+	u32 m_atlas_slots = 0;					//Slots per side of the atlas
+
+	std::vector<Slot> m_slots;
+	std::vector<u32> m_free_slots;
+	std::unordered_map<u32, u32> m_resident;	//Page key to slot
+	std::unordered_set<u32> m_pending;
+	std::vector<std::vector<u8>> m_table_levels;	//CPU copy of the page table, RGBA8UI
+	bool m_table_dirty = true;
+	u32 m_working_set = 0;					//Serial of the last applied working set
+
+	GLuint m_feedback_fbo = 0;
+	GLuint m_feedback_color = 0;
+	GLuint m_feedback_depth = 0;
+	u32 m_feedback_width = 0;
+	u32 m_feedback_height = 0;
+	u32 m_feedback_scale = 1;
+	i32 m_saved_viewport[4] = {};
+	Readback m_readbacks[VIRTUAL_TEXTURE_READBACKS] = {};
+	u32 m_readback_head = 0;				//Next one EndFeedback writes
+	u32 m_readback_count = 0;
+	bool m_analysing = false;				//A working set is on the workers
+	u32 m_frame = 0;
+};
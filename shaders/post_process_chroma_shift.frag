@@ -3,8 +3,12 @@
 layout (binding = 0)
 uniform sampler2D u_texture;
 
-uniform float u_time;
-uniform ivec2 u_resolution;
+layout (std140, binding = 0)
+uniform PostProcessUniforms
+{
+	float u_time;
+	ivec2 u_resolution;
+};
 
 out vec4 color;
 
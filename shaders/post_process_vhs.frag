@@ -3,9 +3,13 @@
 layout (binding = 0)
 uniform sampler2D u_texture;
 
-uniform float u_time;
-uniform ivec2 u_resolution;
-uniform float u_rate = 1.0f;
+layout (std140, binding = 0)
+uniform PostProcessUniforms
+{
+	float u_time;
+	ivec2 u_resolution;
+	float u_rate;
+};
 
 out vec4 color;
 
@@ -0,0 +1,216 @@
+#include "AssetManager.h"
+#include "Mesh.h"
+#include "Texture.h"
+
+#include "GL/glew.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//Decoded assets allowed to wait for upload before workers block
+#define UPLOAD_QUEUE_CAPACITY 32
+
+struct AssetWorkers {
+	std::vector<std::thread> threads;
+	std::atomic<bool> running{ false };
+
+	std::mutex job_mutex;
+	std::condition_variable job_ready;
+	std::deque<std::function<void()>> jobs;
+
+	std::mutex upload_mutex;
+	std::condition_variable upload_not_full;
+	std::condition_variable upload_ready;
+	std::deque<std::function<void()>> uploads;
+
+	std::atomic<u32> outstanding{ 0 };
+};
+
+static AssetWorkers s_workers;
+
+f64 AssetManager::s_upload_budget = 0.002;
+
+static void WorkerLoop()
+{
+	for (;;) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(s_workers.job_mutex);
+			s_workers.job_ready.wait(lock, [] { return !s_workers.running || !s_workers.jobs.empty(); });
+			if (!s_workers.running && s_workers.jobs.empty()) return;
+			job = std::move(s_workers.jobs.front());
+			s_workers.jobs.pop_front();
+		}
+		job();
+	}
+}
+
+void AssetManager::Init(u32 thread_count)
+{
+	if (s_workers.running) return;
+
+	if (thread_count == 0) {
+		//Leave a core for the render thread
+		u32 cores = std::thread::hardware_concurrency();
+		thread_count = cores > 2 ? cores - 1 : 1;
+	}
+
+	s_workers.running = true;
+	for (u32 i = 0; i < thread_count; ++i) {
+		s_workers.threads.emplace_back(WorkerLoop);
+	}
+}
+
+void AssetManager::Shutdown()
+{
+	if (!s_workers.running) return;
+	{
+		std::lock_guard<std::mutex> lock(s_workers.job_mutex);
+		s_workers.running = false;
+		s_workers.jobs.clear();
+	}
+	{
+		//Unblock workers waiting on a full upload queue, their results are dropped
+		std::lock_guard<std::mutex> lock(s_workers.upload_mutex);
+		s_workers.uploads.clear();
+	}
+	s_workers.job_ready.notify_all();
+	s_workers.upload_not_full.notify_all();
+
+	for (auto& thread : s_workers.threads) {
+		thread.join();
+	}
+	s_workers.threads.clear();
+	s_workers.uploads.clear();
+	s_workers.outstanding = 0;
+}
+
+void AssetManager::Submit(std::function<bool()> decode, std::function<void()> upload)
+{
+	if (!s_workers.running) Init();
+
+	s_workers.outstanding++;
+	auto job = [decode = std::move(decode), upload = std::move(upload)]() {
+		if (!decode()) {
+			s_workers.outstanding--;
+			s_workers.upload_ready.notify_all();
+			return;
+		}
+
+		std::unique_lock<std::mutex> lock(s_workers.upload_mutex);
+		s_workers.upload_not_full.wait(lock, [] { return !s_workers.running || s_workers.uploads.size() < UPLOAD_QUEUE_CAPACITY; });
+		if (!s_workers.running) return;
+		s_workers.uploads.push_back(std::move(upload));
+		s_workers.upload_ready.notify_all();
+	};
+
+	{
+		std::lock_guard<std::mutex> lock(s_workers.job_mutex);
+		s_workers.jobs.push_back(std::move(job));
+	}
+	s_workers.job_ready.notify_one();
+}
+
+void AssetManager::Pump(f64 budget)
+{
+	auto start = std::chrono::steady_clock::now();
+	for (;;) {
+		std::function<void()> upload;
+		{
+			std::lock_guard<std::mutex> lock(s_workers.upload_mutex);
+			if (s_workers.uploads.empty()) return;
+			upload = std::move(s_workers.uploads.front());
+			s_workers.uploads.pop_front();
+		}
+		s_workers.upload_not_full.notify_one();
+
+		upload();
+		s_workers.outstanding--;
+
+		f64 elapsed = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+		if (elapsed >= budget) return;
+	}
+}
+
+void AssetManager::WaitIdle()
+{
+	while (s_workers.outstanding > 0) {
+		{
+			std::unique_lock<std::mutex> lock(s_workers.upload_mutex);
+			s_workers.upload_ready.wait_for(lock, std::chrono::milliseconds(1), [] { return !s_workers.uploads.empty(); });
+		}
+		Pump(1.0e9);
+	}
+}
+
+u32 AssetManager::Pending()
+{
+	return s_workers.outstanding;
+}
+
+GLuint AssetManager::LoadKTX(const char* filename, GLenum target)
+{
+	//Create the object now, a name from glGenTextures can't be bound to a unit until it's created
+	GLuint texture;
+	glCreateTextures(target, 1, &texture);
+
+	auto file = std::make_shared<MappedFile>();
+	auto ktx = std::make_shared<KTX_Raw>();
+	std::string name = filename;
+
+	Submit(
+		[file, ktx, name]() {
+			if (!file->Open(name.c_str())) return false;
+			*ktx = Get_KTX_Raw(*file);
+			if (ktx->m_data == nullptr) {
+				std::cerr << "Bad KTX file:" << name << std::endl;
+				return false;
+			}
+			//Fault the pages in here so the render thread doesn't wait on the disk
+			unsigned char sum = 0;
+			for (usize i = 0; i < ktx->m_size; i += 4096) sum += ktx->m_data[i];
+			volatile unsigned char sink = sum;
+			return true;
+		},
+		[file, ktx, texture, target, name]() {
+			if (ktx->m_target != target) {
+				std::cerr << "KTX file " << name << " doesn't hold the texture target it was loaded as" << std::endl;
+				return;
+			}
+			Upload_KTX(*ktx, texture);
+		}
+	);
+
+	return texture;
+}
+
+void AssetManager::LoadOBJ(ObjMesh* mesh, const char* filename, bool tangents)
+{
+	mesh->m_vao = 0;
+	mesh->m_count = 0;
+
+	auto data = std::make_shared<ObjMeshData>();
+	std::string name = filename;
+
+	Submit(
+		[data, name, tangents]() {
+			if (!Parse_OBJ(name.c_str(), *data, tangents)) {
+				std::cout << "Failed to load mesh: " << name << std::endl;
+				return false;
+			}
+			return true;
+		},
+		[data, mesh]() {
+			mesh->Upload(*data);
+		}
+	);
+}
+
+#undef UPLOAD_QUEUE_CAPACITY
@@ -0,0 +1,513 @@
+#include <GL/glew.h>
+#include "BlockCompression.h"
+
+#include <cstring>
+
+//-------------------------------------------------------------------------------------------------
+// BC1-BC5
+//-------------------------------------------------------------------------------------------------
+
+enum ColorBlockMode {
+	COLOR_BC1_RGB,		//Three color blocks use opaque black for index 3
+	COLOR_BC1_RGBA,		//Three color blocks use transparent black for index 3
+	COLOR_FOUR			//BC2 and BC3 always interpolate four colors
+};
+
+static void Expand565(u32 color, u8* rgba)
+{
+	const u32 r = (color >> 11) & 31;
+	const u32 g = (color >> 5) & 63;
+	const u32 b = color & 31;
+	rgba[0] = (u8)((r << 3) | (r >> 2));
+	rgba[1] = (u8)((g << 2) | (g >> 4));
+	rgba[2] = (u8)((b << 3) | (b >> 2));
+	rgba[3] = 255;
+}
+
+static void DecodeColorBlock(const u8* block, u8* texels, ColorBlockMode mode)
+{
+	const u32 c0 = block[0] | (block[1] << 8);
+	const u32 c1 = block[2] | (block[3] << 8);
+
+	u8 palette[4][4];
+	Expand565(c0, palette[0]);
+	Expand565(c1, palette[1]);
+	if (c0 > c1 || mode == COLOR_FOUR) {
+		for (u32 c = 0; c < 3; ++c) {
+			palette[2][c] = (u8)((2 * palette[0][c] + palette[1][c]) / 3);
+			palette[3][c] = (u8)((palette[0][c] + 2 * palette[1][c]) / 3);
+		}
+		palette[2][3] = palette[3][3] = 255;
+	}
+	else {
+		for (u32 c = 0; c < 3; ++c) {
+			palette[2][c] = (u8)((palette[0][c] + palette[1][c]) / 2);
+			palette[3][c] = 0;
+		}
+		palette[2][3] = 255;
+		palette[3][3] = mode == COLOR_BC1_RGBA ? 0 : 255;
+	}
+
+	const u32 indices = block[4] | (block[5] << 8) | (block[6] << 16) | ((u32)block[7] << 24);
+	for (u32 i = 0; i < 16; ++i) {
+		memcpy(texels + i * 4, palette[(indices >> (2 * i)) & 3], 4);
+	}
+}
+
+//BC4 block, also the alpha of BC3 and each channel of BC5. Writes every stride bytes
+static void DecodeChannelBlock(const u8* block, u8* texels, u32 stride, bool is_signed)
+{
+	int palette[8];
+	if (is_signed) {
+		palette[0] = (i8)block[0] == -128 ? -127 : (i8)block[0];
+		palette[1] = (i8)block[1] == -128 ? -127 : (i8)block[1];
+	}
+	else {
+		palette[0] = block[0];
+		palette[1] = block[1];
+	}
+
+	if (palette[0] > palette[1]) {
+		for (int i = 2; i < 8; ++i) palette[i] = ((8 - i) * palette[0] + (i - 1) * palette[1]) / 7;
+	}
+	else {
+		for (int i = 2; i < 6; ++i) palette[i] = ((6 - i) * palette[0] + (i - 1) * palette[1]) / 5;
+		palette[6] = is_signed ? -127 : 0;
+		palette[7] = is_signed ? 127 : 255;
+	}
+
+	u64 indices = 0;
+	for (u32 i = 0; i < 6; ++i) indices |= (u64)block[2 + i] << (8 * i);
+	for (u32 i = 0; i < 16; ++i) {
+		texels[i * stride] = (u8)palette[(indices >> (3 * i)) & 7];
+	}
+}
+
+static void DecodeBC1RGB(const u8* block, u8* texels)
+{
+	DecodeColorBlock(block, texels, COLOR_BC1_RGB);
+}
+
+static void DecodeBC1RGBA(const u8* block, u8* texels)
+{
+	DecodeColorBlock(block, texels, COLOR_BC1_RGBA);
+}
+
+static void DecodeBC2(const u8* block, u8* texels)
+{
+	DecodeColorBlock(block + 8, texels, COLOR_FOUR);
+	for (u32 i = 0; i < 16; ++i) {
+		const u32 alpha = (block[i / 2] >> ((i & 1) * 4)) & 15;
+		texels[i * 4 + 3] = (u8)(alpha * 17);
+	}
+}
+
+static void DecodeBC3(const u8* block, u8* texels)
+{
+	DecodeColorBlock(block + 8, texels, COLOR_FOUR);
+	DecodeChannelBlock(block, texels + 3, 4, false);
+}
+
+static void DecodeBC4(const u8* block, u8* texels)
+{
+	DecodeChannelBlock(block, texels, 1, false);
+}
+
+static void DecodeBC4Signed(const u8* block, u8* texels)
+{
+	DecodeChannelBlock(block, texels, 1, true);
+}
+
+static void DecodeBC5(const u8* block, u8* texels)
+{
+	DecodeChannelBlock(block, texels, 2, false);
+	DecodeChannelBlock(block + 8, texels + 1, 2, false);
+}
+
+static void DecodeBC5Signed(const u8* block, u8* texels)
+{
+	DecodeChannelBlock(block, texels, 2, true);
+	DecodeChannelBlock(block + 8, texels + 1, 2, true);
+}
+
+//-------------------------------------------------------------------------------------------------
+// ETC2 / EAC
+//-------------------------------------------------------------------------------------------------
+
+static const int s_etc_modifiers[8][4] = {
+	{ 2, 8, -2, -8 }, { 5, 17, -5, -17 }, { 9, 29, -9, -29 }, { 13, 42, -13, -42 },
+	{ 18, 60, -18, -60 }, { 24, 80, -24, -80 }, { 33, 106, -33, -106 }, { 47, 183, -47, -183 }
+};
+
+static const int s_etc_distances[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
+
+static const int s_eac_modifiers[16][8] = {
+	{ -3, -6, -9, -15, 2, 5, 8, 14 }, { -3, -7, -10, -13, 2, 6, 9, 12 },
+	{ -2, -5, -8, -13, 1, 4, 7, 12 }, { -2, -4, -6, -13, 1, 3, 5, 12 },
+	{ -3, -6, -8, -12, 2, 5, 7, 11 }, { -3, -7, -9, -11, 2, 6, 8, 10 },
+	{ -4, -7, -8, -11, 3, 6, 7, 10 }, { -3, -5, -8, -11, 2, 4, 7, 10 },
+	{ -2, -6, -8, -10, 1, 5, 7, 9 }, { -2, -5, -8, -10, 1, 4, 7, 9 },
+	{ -2, -4, -8, -10, 1, 3, 7, 9 }, { -2, -5, -7, -10, 1, 4, 6, 9 },
+	{ -3, -4, -7, -10, 2, 3, 6, 9 }, { -1, -2, -3, -10, 0, 1, 2, 9 },
+	{ -4, -6, -8, -9, 3, 5, 7, 8 }, { -3, -5, -7, -9, 2, 4, 6, 8 }
+};
+
+static int Clamp(int value, int low, int high)
+{
+	return value < low ? low : value > high ? high : value;
+}
+
+//ETC blocks are stored big-endian
+static u64 ReadBigEndian64(const u8* bytes)
+{
+	u64 value = 0;
+	for (u32 i = 0; i < 8; ++i) value = (value << 8) | bytes[i];
+	return value;
+}
+
+static u32 Bits(u64 value, u32 high, u32 count)
+{
+	return (u32)(value >> (high + 1 - count)) & ((1u << count) - 1);
+}
+
+static void SetColor(u8* texel, int r, int g, int b)
+{
+	texel[0] = (u8)Clamp(r, 0, 255);
+	texel[1] = (u8)Clamp(g, 0, 255);
+	texel[2] = (u8)Clamp(b, 0, 255);
+	texel[3] = 255;
+}
+
+//ETC2 RGB block with all five modes. With punchthrough the differential bit is the opaque bit
+//instead and there's no individual mode
+static void DecodeETC2Block(const u8* block, u8* texels, bool punchthrough)
+{
+	const u64 bits = ReadBigEndian64(block);
+	const bool differential = Bits(bits, 33, 1) != 0;
+	const bool flip = Bits(bits, 32, 1) != 0;
+	const bool opaque = !punchthrough || differential;
+
+	//Pixels are indexed column by column, most significant index bits in the upper half
+	auto Index = [&](u32 x, u32 y) -> u32 {
+		const u32 i = x * 4 + y;
+		return (u32)(((bits >> (16 + i)) & 1) << 1 | ((bits >> i) & 1));
+	};
+
+	int base[2][3];
+	if (!differential && !punchthrough) {
+		for (u32 c = 0; c < 3; ++c) {
+			base[0][c] = Bits(bits, 63 - c * 8, 4) * 17;
+			base[1][c] = Bits(bits, 59 - c * 8, 4) * 17;
+		}
+	}
+	else {
+		int color[3], delta[3];
+		for (u32 c = 0; c < 3; ++c) {
+			color[c] = Bits(bits, 63 - c * 8, 5);
+			delta[c] = Bits(bits, 58 - c * 8, 3);
+			if (delta[c] >= 4) delta[c] -= 8;
+		}
+
+		//A differential that overflows a channel selects one of the ETC2 modes instead
+		const bool t_mode = color[0] + delta[0] < 0 || color[0] + delta[0] > 31;
+		const bool h_mode = !t_mode && (color[1] + delta[1] < 0 || color[1] + delta[1] > 31);
+		const bool planar = !t_mode && !h_mode && (color[2] + delta[2] < 0 || color[2] + delta[2] > 31);
+		int paint[4][3];
+		if (t_mode) {
+			const int c0[3] = { (int)((Bits(bits, 60, 2) << 2) | Bits(bits, 57, 2)), (int)Bits(bits, 55, 4), (int)Bits(bits, 51, 4) };
+			const int c1[3] = { (int)Bits(bits, 47, 4), (int)Bits(bits, 43, 4), (int)Bits(bits, 39, 4) };
+			const int d = s_etc_distances[(Bits(bits, 35, 2) << 1) | Bits(bits, 32, 1)];
+			for (u32 c = 0; c < 3; ++c) {
+				paint[0][c] = c0[c] * 17;
+				paint[1][c] = c1[c] * 17 + d;
+				paint[2][c] = c1[c] * 17;
+				paint[3][c] = c1[c] * 17 - d;
+			}
+		}
+		else if (h_mode) {
+			const int c0[3] = { (int)Bits(bits, 62, 4), (int)((Bits(bits, 58, 3) << 1) | Bits(bits, 52, 1)), (int)((Bits(bits, 51, 1) << 3) | Bits(bits, 49, 3)) };
+			const int c1[3] = { (int)Bits(bits, 46, 4), (int)Bits(bits, 42, 4), (int)Bits(bits, 38, 4) };
+			const int order = ((c0[0] << 8) | (c0[1] << 4) | c0[2]) >= ((c1[0] << 8) | (c1[1] << 4) | c1[2]) ? 1 : 0;
+			const int d = s_etc_distances[(Bits(bits, 34, 1) << 2) | (Bits(bits, 32, 1) << 1) | order];
+			for (u32 c = 0; c < 3; ++c) {
+				paint[0][c] = c0[c] * 17 + d;
+				paint[1][c] = c0[c] * 17 - d;
+				paint[2][c] = c1[c] * 17 + d;
+				paint[3][c] = c1[c] * 17 - d;
+			}
+		}
+		else if (planar) {
+			//Always opaque
+			int o[3], h[3], v[3];
+			o[0] = Bits(bits, 62, 6);
+			o[1] = (Bits(bits, 56, 1) << 6) | Bits(bits, 54, 6);
+			o[2] = (Bits(bits, 48, 1) << 5) | (Bits(bits, 44, 2) << 3) | Bits(bits, 41, 3);
+			h[0] = (Bits(bits, 38, 5) << 1) | Bits(bits, 32, 1);
+			h[1] = Bits(bits, 31, 7);
+			h[2] = Bits(bits, 24, 6);
+			v[0] = Bits(bits, 18, 6);
+			v[1] = Bits(bits, 12, 7);
+			v[2] = Bits(bits, 5, 6);
+			for (u32 c = 0; c < 3; ++c) {
+				const u32 width = c == 1 ? 7 : 6;
+				o[c] = (o[c] << (8 - width)) | (o[c] >> (2 * width - 8));
+				h[c] = (h[c] << (8 - width)) | (h[c] >> (2 * width - 8));
+				v[c] = (v[c] << (8 - width)) | (v[c] >> (2 * width - 8));
+			}
+			for (u32 y = 0; y < 4; ++y) {
+				for (u32 x = 0; x < 4; ++x) {
+					int rgb[3];
+					for (u32 c = 0; c < 3; ++c) rgb[c] = (x * (h[c] - o[c]) + y * (v[c] - o[c]) + 4 * o[c] + 2) >> 2;
+					SetColor(texels + (y * 4 + x) * 4, rgb[0], rgb[1], rgb[2]);
+				}
+			}
+			return;
+		}
+
+		if (t_mode || h_mode) {
+			//Pick one of the four paint colors per pixel
+			for (u32 y = 0; y < 4; ++y) {
+				for (u32 x = 0; x < 4; ++x) {
+					const u32 index = Index(x, y);
+					u8* texel = texels + (y * 4 + x) * 4;
+					if (!opaque && index == 2) memset(texel, 0, 4);
+					else SetColor(texel, paint[index][0], paint[index][1], paint[index][2]);
+				}
+			}
+			return;
+		}
+
+		for (u32 c = 0; c < 3; ++c) {
+			const int second = color[c] + delta[c];
+			base[0][c] = (color[c] << 3) | (color[c] >> 2);
+			base[1][c] = (second << 3) | (second >> 2);
+		}
+	}
+
+	//Individual and differential modes, two 2x4 or 4x2 halves with their own base color and table
+	const u32 tables[2] = { Bits(bits, 39, 3), Bits(bits, 36, 3) };
+	for (u32 y = 0; y < 4; ++y) {
+		for (u32 x = 0; x < 4; ++x) {
+			const u32 half = flip ? (y >= 2) : (x >= 2);
+			const u32 index = Index(x, y);
+			u8* texel = texels + (y * 4 + x) * 4;
+			if (!opaque && index == 2) {
+				memset(texel, 0, 4);
+				continue;
+			}
+			const int modifier = (!opaque && index == 0) ? 0 : s_etc_modifiers[tables[half]][index];
+			SetColor(texel, base[half][0] + modifier, base[half][1] + modifier, base[half][2] + modifier);
+		}
+	}
+}
+
+enum EACMode {
+	EAC_ALPHA8,
+	EAC_R11,
+	EAC_SIGNED_R11
+};
+
+//EAC block, the alpha of RGBA8 ETC2 and each channel of R11/RG11. Writes every stride bytes,
+//11 bit channels are rounded to 8 bits
+static void DecodeEACBlock(const u8* block, u8* texels, u32 stride, EACMode mode)
+{
+	const u64 bits = ReadBigEndian64(block);
+	const int multiplier = Bits(bits, 55, 4);
+	const int* modifiers = s_eac_modifiers[Bits(bits, 51, 4)];
+
+	for (u32 y = 0; y < 4; ++y) {
+		for (u32 x = 0; x < 4; ++x) {
+			const int modifier = modifiers[Bits(bits, 47 - (x * 4 + y) * 3, 3)];
+			u8* texel = texels + (y * 4 + x) * stride;
+			switch (mode) {
+			case EAC_ALPHA8:
+				*texel = (u8)Clamp(block[0] + modifier * multiplier, 0, 255);
+				break;
+			case EAC_R11: {
+				const int value = Clamp(block[0] * 8 + 4 + modifier * (multiplier ? multiplier * 8 : 1), 0, 2047);
+				*texel = (u8)((value * 255 + 1023) / 2047);
+				break;
+			}
+			case EAC_SIGNED_R11: {
+				const int base = (i8)block[0] == -128 ? -127 : (i8)block[0];
+				const int value = Clamp(base * 8 + modifier * (multiplier ? multiplier * 8 : 1), -1023, 1023);
+				*texel = (u8)(i8)((value * 127 + (value >= 0 ? 511 : -511)) / 1023);
+				break;
+			}
+			}
+		}
+	}
+}
+
+static void DecodeETC2(const u8* block, u8* texels)
+{
+	DecodeETC2Block(block, texels, false);
+}
+
+static void DecodeETC2Punchthrough(const u8* block, u8* texels)
+{
+	DecodeETC2Block(block, texels, true);
+}
+
+static void DecodeETC2EAC(const u8* block, u8* texels)
+{
+	DecodeETC2Block(block + 8, texels, false);
+	DecodeEACBlock(block, texels + 3, 4, EAC_ALPHA8);
+}
+
+static void DecodeR11(const u8* block, u8* texels)
+{
+	DecodeEACBlock(block, texels, 1, EAC_R11);
+}
+
+static void DecodeR11Signed(const u8* block, u8* texels)
+{
+	DecodeEACBlock(block, texels, 1, EAC_SIGNED_R11);
+}
+
+static void DecodeRG11(const u8* block, u8* texels)
+{
+	DecodeEACBlock(block, texels, 2, EAC_R11);
+	DecodeEACBlock(block + 8, texels + 1, 2, EAC_R11);
+}
+
+static void DecodeRG11Signed(const u8* block, u8* texels)
+{
+	DecodeEACBlock(block, texels, 2, EAC_SIGNED_R11);
+	DecodeEACBlock(block + 8, texels + 1, 2, EAC_SIGNED_R11);
+}
+
+//-------------------------------------------------------------------------------------------------
+// FORMAT TABLE
+//-------------------------------------------------------------------------------------------------
+
+#define RGBA8_FALLBACK(decode) GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, decode
+#define SRGB8_FALLBACK(decode) GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE, decode
+#define NO_FALLBACK GL_NONE, GL_NONE, GL_NONE, nullptr
+
+//BC6H, BC7 and ASTC are sized here but have no CPU decoder, a driver that rejects them fails the load
+static const BlockFormat s_block_formats[] = {
+	//S3TC
+	{ GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 4, 4, 8, RGBA8_FALLBACK(DecodeBC1RGB) },
+	{ GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 4, 4, 8, RGBA8_FALLBACK(DecodeBC1RGBA) },
+	{ GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, 4, 4, 16, RGBA8_FALLBACK(DecodeBC2) },
+	{ GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 4, 4, 16, RGBA8_FALLBACK(DecodeBC3) },
+	{ GL_COMPRESSED_SRGB_S3TC_DXT1_EXT, 4, 4, 8, SRGB8_FALLBACK(DecodeBC1RGB) },
+	{ GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, 4, 4, 8, SRGB8_FALLBACK(DecodeBC1RGBA) },
+	{ GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT, 4, 4, 16, SRGB8_FALLBACK(DecodeBC2) },
+	{ GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, 4, 4, 16, SRGB8_FALLBACK(DecodeBC3) },
+	//RGTC
+	{ GL_COMPRESSED_RED_RGTC1, 4, 4, 8, GL_R8, GL_RED, GL_UNSIGNED_BYTE, DecodeBC4 },
+	{ GL_COMPRESSED_SIGNED_RED_RGTC1, 4, 4, 8, GL_R8_SNORM, GL_RED, GL_BYTE, DecodeBC4Signed },
+	{ GL_COMPRESSED_RG_RGTC2, 4, 4, 16, GL_RG8, GL_RG, GL_UNSIGNED_BYTE, DecodeBC5 },
+	{ GL_COMPRESSED_SIGNED_RG_RGTC2, 4, 4, 16, GL_RG8_SNORM, GL_RG, GL_BYTE, DecodeBC5Signed },
+	//BPTC
+	{ GL_COMPRESSED_RGBA_BPTC_UNORM, 4, 4, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM, 4, 4, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT, 4, 4, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT, 4, 4, 16, NO_FALLBACK },
+	//ETC2 / EAC
+	{ GL_COMPRESSED_RGB8_ETC2, 4, 4, 8, RGBA8_FALLBACK(DecodeETC2) },
+	{ GL_COMPRESSED_SRGB8_ETC2, 4, 4, 8, SRGB8_FALLBACK(DecodeETC2) },
+	{ GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2, 4, 4, 8, RGBA8_FALLBACK(DecodeETC2Punchthrough) },
+	{ GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2, 4, 4, 8, SRGB8_FALLBACK(DecodeETC2Punchthrough) },
+	{ GL_COMPRESSED_RGBA8_ETC2_EAC, 4, 4, 16, RGBA8_FALLBACK(DecodeETC2EAC) },
+	{ GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC, 4, 4, 16, SRGB8_FALLBACK(DecodeETC2EAC) },
+	{ GL_COMPRESSED_R11_EAC, 4, 4, 8, GL_R8, GL_RED, GL_UNSIGNED_BYTE, DecodeR11 },
+	{ GL_COMPRESSED_SIGNED_R11_EAC, 4, 4, 8, GL_R8_SNORM, GL_RED, GL_BYTE, DecodeR11Signed },
+	{ GL_COMPRESSED_RG11_EAC, 4, 4, 16, GL_RG8, GL_RG, GL_UNSIGNED_BYTE, DecodeRG11 },
+	{ GL_COMPRESSED_SIGNED_RG11_EAC, 4, 4, 16, GL_RG8_SNORM, GL_RG, GL_BYTE, DecodeRG11Signed },
+	//ASTC, every footprint is 16 bytes
+	{ GL_COMPRESSED_RGBA_ASTC_4x4_KHR, 4, 4, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_RGBA_ASTC_5x4_KHR, 5, 4, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_RGBA_ASTC_5x5_KHR, 5, 5, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_RGBA_ASTC_6x5_KHR, 6, 5, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_RGBA_ASTC_6x6_KHR, 6, 6, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_RGBA_ASTC_8x5_KHR, 8, 5, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_RGBA_ASTC_8x6_KHR, 8, 6, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_RGBA_ASTC_8x8_KHR, 8, 8, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_RGBA_ASTC_10x5_KHR, 10, 5, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_RGBA_ASTC_10x6_KHR, 10, 6, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_RGBA_ASTC_10x8_KHR, 10, 8, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_RGBA_ASTC_10x10_KHR, 10, 10, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_RGBA_ASTC_12x10_KHR, 12, 10, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_RGBA_ASTC_12x12_KHR, 12, 12, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR, 4, 4, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_SRGB8_ALPHA8_ASTC_5x4_KHR, 5, 4, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_SRGB8_ALPHA8_ASTC_5x5_KHR, 5, 5, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_SRGB8_ALPHA8_ASTC_6x5_KHR, 6, 5, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_SRGB8_ALPHA8_ASTC_6x6_KHR, 6, 6, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_SRGB8_ALPHA8_ASTC_8x5_KHR, 8, 5, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_SRGB8_ALPHA8_ASTC_8x6_KHR, 8, 6, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_SRGB8_ALPHA8_ASTC_8x8_KHR, 8, 8, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_SRGB8_ALPHA8_ASTC_10x5_KHR, 10, 5, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_SRGB8_ALPHA8_ASTC_10x6_KHR, 10, 6, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_SRGB8_ALPHA8_ASTC_10x8_KHR, 10, 8, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_SRGB8_ALPHA8_ASTC_10x10_KHR, 10, 10, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_SRGB8_ALPHA8_ASTC_12x10_KHR, 12, 10, 16, NO_FALLBACK },
+	{ GL_COMPRESSED_SRGB8_ALPHA8_ASTC_12x12_KHR, 12, 12, 16, NO_FALLBACK },
+};
+
+#undef RGBA8_FALLBACK
+#undef SRGB8_FALLBACK
+#undef NO_FALLBACK
+
+const BlockFormat* FindBlockFormat(GLenum internal_format)
+{
+	for (const BlockFormat& format : s_block_formats) {
+		if (format.m_format == internal_format) return &format;
+	}
+	return nullptr;
+}
+
+usize CompressedImageSize(const BlockFormat& format, u32 width, u32 height, u32 depth)
+{
+	const usize blocks_x = (width + format.m_block_width - 1) / format.m_block_width;
+	const usize blocks_y = (height + format.m_block_height - 1) / format.m_block_height;
+	return blocks_x * blocks_y * format.m_block_bytes * depth;
+}
+
+u32 DecodedTexelSize(const BlockFormat& format)
+{
+	switch (format.m_decoded_layout) {
+	case GL_RED: return 1;
+	case GL_RG: return 2;
+	case GL_RGBA: return 4;
+	default: return 0;
+	}
+}
+
+bool CompressedFormatSupported(GLenum target, GLenum internal_format)
+{
+	GLint supported = GL_FALSE;
+	glGetInternalformativ(target, internal_format, GL_INTERNALFORMAT_SUPPORTED, 1, &supported);
+	return supported == GL_TRUE;
+}
+
+bool DecodeCompressedImage(const BlockFormat& format, const u8* src, u32 width, u32 height, u32 depth, u8* dst)
+{
+	//Every decoder works on 4x4 blocks
+	if (!format.m_decode || format.m_block_width != 4 || format.m_block_height != 4) return false;
+
+	const u32 texel_size = DecodedTexelSize(format);
+	const u32 blocks_x = (width + 3) / 4;
+	const u32 blocks_y = (height + 3) / 4;
+	u8 texels[16 * 4];
+	for (u32 z = 0; z < depth; ++z) {
+		u8* slice = dst + (usize)z * width * height * texel_size;
+		for (u32 by = 0; by < blocks_y; ++by) {
+			for (u32 bx = 0; bx < blocks_x; ++bx) {
+				format.m_decode(src, texels);
+				src += format.m_block_bytes;
+
+				//Blocks hanging over the edge of the image are clipped
+				const u32 columns = width - bx * 4 < 4 ? width - bx * 4 : 4;
+				for (u32 y = 0; y < 4 && by * 4 + y < height; ++y) {
+					u8* row = slice + ((usize)(by * 4 + y) * width + bx * 4) * texel_size;
+					memcpy(row, texels + y * 4 * texel_size, columns * texel_size);
+				}
+			}
+		}
+	}
+	return true;
+}
@@ -0,0 +1,615 @@
+#include <GL/glew.h>
+#include "BlockEncoder.h"
+
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define ENCODER_X86 1
+#include <immintrin.h>
+#endif //x86
+
+//Largest palette, BC7 mode 6 interpolates 16 colors
+#define ENCODER_MAX_PALETTE 16
+//Least squares passes of the High tier, it stops early once a pass doesn't help
+#define ENCODER_HIGH_PASSES 8
+
+f64 EncodeStats::PSNR() const
+{
+	if (m_block_texels == 0 || m_channels == 0) return 0.0;
+	const f64 mse = m_squared_error / ((f64)m_block_texels * m_channels);
+	return mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : INFINITY;
+}
+
+GLenum EncodeFormatGL(const EncodeSettings& settings)
+{
+	switch (settings.m_format) {
+	case EncodeFormat::BC1: return settings.m_srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case EncodeFormat::BC3: return settings.m_srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case EncodeFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+	case EncodeFormat::BC7: return settings.m_srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+	}
+	return GL_NONE;
+}
+
+//-------------------------------------------------------------------------------------------------
+// PALETTE SEARCH
+//-------------------------------------------------------------------------------------------------
+
+//The 16 texels of a block, one array per channel so four texels load as one vector
+struct EncodeBlock {
+	alignas(16) f32 m_channels[4][16];
+};
+
+static void LoadBlock(const u8* rgba, u32 width, u32 height, u32 bx, u32 by, EncodeBlock& block)
+{
+	for (u32 y = 0; y < 4; ++y) {
+		const u32 sy = by * 4 + y < height ? by * 4 + y : height - 1;
+		for (u32 x = 0; x < 4; ++x) {
+			const u32 sx = bx * 4 + x < width ? bx * 4 + x : width - 1;
+			const u8* texel = rgba + ((usize)sy * width + sx) * 4;
+			for (u32 c = 0; c < 4; ++c) block.m_channels[c][y * 4 + x] = texel[c];
+		}
+	}
+}
+
+//Both search functions pick the nearest palette entry for every texel over the channels
+//[first, first + count) and return the summed squared error. Palette channels are indexed like the block's
+static f32 SearchPaletteScalar(const EncodeBlock& block, u32 first, u32 count, const f32 (*palette)[4], u32 size, u8* indices)
+{
+	f32 total = 0.0f;
+	for (u32 i = 0; i < 16; ++i) {
+		f32 best = FLT_MAX;
+		u32 best_index = 0;
+		for (u32 p = 0; p < size; ++p) {
+			f32 distance = 0.0f;
+			for (u32 c = first; c < first + count; ++c) {
+				const f32 diff = block.m_channels[c][i] - palette[p][c];
+				distance += diff * diff;
+			}
+			if (distance < best) {
+				best = distance;
+				best_index = p;
+			}
+		}
+		indices[i] = (u8)best_index;
+		total += best;
+	}
+	return total;
+}
+
+#ifdef ENCODER_X86
+//Four texels per vector, every palette entry compared against all four at once
+static f32 SearchPaletteSSE(const EncodeBlock& block, u32 first, u32 count, const f32 (*palette)[4], u32 size, u8* indices)
+{
+	__m128 total = _mm_setzero_ps();
+	for (u32 group = 0; group < 16; group += 4) {
+		__m128 texels[4];
+		for (u32 c = 0; c < count; ++c) texels[c] = _mm_load_ps(&block.m_channels[first + c][group]);
+
+		__m128 best = _mm_set1_ps(FLT_MAX);
+		__m128 best_index = _mm_setzero_ps();
+		for (u32 p = 0; p < size; ++p) {
+			__m128 distance = _mm_setzero_ps();
+			for (u32 c = 0; c < count; ++c) {
+				const __m128 diff = _mm_sub_ps(texels[c], _mm_set1_ps(palette[p][first + c]));
+				distance = _mm_add_ps(distance, _mm_mul_ps(diff, diff));
+			}
+			const __m128 closer = _mm_cmplt_ps(distance, best);
+			best = _mm_min_ps(distance, best);
+			best_index = _mm_or_ps(_mm_and_ps(closer, _mm_set1_ps((f32)p)), _mm_andnot_ps(closer, best_index));
+		}
+
+		alignas(16) f32 lanes[4];
+		_mm_store_ps(lanes, best_index);
+		for (u32 k = 0; k < 4; ++k) indices[group + k] = (u8)lanes[k];
+		total = _mm_add_ps(total, best);
+	}
+
+	alignas(16) f32 sums[4];
+	_mm_store_ps(sums, total);
+	return sums[0] + sums[1] + sums[2] + sums[3];
+}
+#endif //ENCODER_X86
+
+static f32 SearchPalette(bool simd, const EncodeBlock& block, u32 first, u32 count, const f32 (*palette)[4], u32 size, u8* indices)
+{
+#ifdef ENCODER_X86
+	if (simd) return SearchPaletteSSE(block, first, count, palette, size, indices);
+#endif //ENCODER_X86
+	return SearchPaletteScalar(block, first, count, palette, size, indices);
+}
+
+//-------------------------------------------------------------------------------------------------
+// ENDPOINT FORMATS
+//-------------------------------------------------------------------------------------------------
+
+//How one kind of block stores its two endpoints and which colors it interpolates between them.
+//Quantized endpoints are in the format's own units, indexed by block channel
+struct EndpointFormat {
+	u32 m_first;			//First channel the endpoints cover
+	u32 m_count;
+	u32 m_palette_size;
+	i32 m_step;				//Smallest change of a quantized channel that keeps the endpoint valid
+	i32 m_max[4];			//Largest quantized value per channel
+	const f32* m_weights;	//Position of each palette entry from endpoint 0 (0) to endpoint 1 (1)
+
+	void (*m_quantize)(const EndpointFormat& format, const f32* endpoint, i32* quantized);
+	//Puts the endpoints in the order the decoder expects, nullptr if any order works
+	void (*m_order)(const EndpointFormat& format, i32* e0, i32* e1);
+	//The palette exactly as the decoder builds it, in 8-bit channel values
+	void (*m_palette)(const EndpointFormat& format, const i32* e0, const i32* e1, f32 (*palette)[4]);
+};
+
+static i32 Round(f32 value, i32 max)
+{
+	const i32 rounded = (i32)floorf(value + 0.5f);
+	return rounded < 0 ? 0 : rounded > max ? max : rounded;
+}
+
+//BC1 colors, 5:6:5
+
+static const f32 s_bc1_weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+static u32 Pack565(const i32* color)
+{
+	return (color[0] << 11) | (color[1] << 5) | color[2];
+}
+
+static void QuantizeBC1(const EndpointFormat& format, const f32* endpoint, i32* quantized)
+{
+	for (u32 c = 0; c < 3; ++c) quantized[c] = Round(endpoint[c] * format.m_max[c] / 255.0f, format.m_max[c]);
+}
+
+//Four color mode needs the first endpoint to be the larger one
+static void OrderBC1(const EndpointFormat& format, i32* e0, i32* e1)
+{
+	if (Pack565(e0) < Pack565(e1)) {
+		for (u32 c = 0; c < 3; ++c) std::swap(e0[c], e1[c]);
+	}
+}
+
+static void ExpandBC1(const i32* e, f32* color)
+{
+	color[0] = (f32)((e[0] << 3) | (e[0] >> 2));
+	color[1] = (f32)((e[1] << 2) | (e[1] >> 4));
+	color[2] = (f32)((e[2] << 3) | (e[2] >> 2));
+}
+
+static void BuildPalette565(const i32* e0, const i32* e1, bool four_colors, f32 (*palette)[4])
+{
+	ExpandBC1(e0, palette[0]);
+	ExpandBC1(e1, palette[1]);
+	for (u32 c = 0; c < 3; ++c) {
+		const i32 a = (i32)palette[0][c];
+		const i32 b = (i32)palette[1][c];
+		if (four_colors) {
+			palette[2][c] = (f32)((2 * a + b) / 3);
+			palette[3][c] = (f32)((a + 2 * b) / 3);
+		}
+		else {
+			palette[2][c] = (f32)((a + b) / 2);
+			palette[3][c] = 0.0f;
+		}
+	}
+}
+
+//Equal endpoints decode in three color mode, the fourth entry being black
+static void PaletteBC1(const EndpointFormat& format, const i32* e0, const i32* e1, f32 (*palette)[4])
+{
+	BuildPalette565(e0, e1, Pack565(e0) > Pack565(e1), palette);
+}
+
+//The color half of BC3 always decodes four colors
+static void PaletteBC3Color(const EndpointFormat& format, const i32* e0, const i32* e1, f32 (*palette)[4])
+{
+	BuildPalette565(e0, e1, true, palette);
+}
+
+//BC4 channels, also the alpha of BC3 and both halves of BC5
+
+static const f32 s_bc4_weights[8] = { 0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f };
+
+static void QuantizeBC4(const EndpointFormat& format, const f32* endpoint, i32* quantized)
+{
+	quantized[format.m_first] = Round(endpoint[format.m_first], 255);
+}
+
+//Eight value mode needs the first endpoint to be the larger one
+static void OrderBC4(const EndpointFormat& format, i32* e0, i32* e1)
+{
+	if (e0[format.m_first] < e1[format.m_first]) std::swap(e0[format.m_first], e1[format.m_first]);
+}
+
+static void PaletteBC4(const EndpointFormat& format, const i32* e0, const i32* e1, f32 (*palette)[4])
+{
+	const u32 c = format.m_first;
+	const i32 a = e0[c];
+	const i32 b = e1[c];
+	palette[0][c] = (f32)a;
+	palette[1][c] = (f32)b;
+	if (a > b) {
+		for (i32 i = 2; i < 8; ++i) palette[i][c] = (f32)(((8 - i) * a + (i - 1) * b) / 7);
+	}
+	else {
+		for (i32 i = 2; i < 6; ++i) palette[i][c] = (f32)(((6 - i) * a + (i - 1) * b) / 5);
+		palette[6][c] = 0.0f;
+		palette[7][c] = 255.0f;
+	}
+}
+
+//BC7 mode 6, 7 bits per channel plus one p-bit per endpoint shared by its channels.
+//Quantized values are the full 8-bit endpoint, so a step of 2 keeps the p-bit
+
+static const i32 s_bc7_weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+static const f32 s_bc7_weights[16] = {
+	0.0f / 64.0f, 4.0f / 64.0f, 9.0f / 64.0f, 13.0f / 64.0f, 17.0f / 64.0f, 21.0f / 64.0f, 26.0f / 64.0f, 30.0f / 64.0f,
+	34.0f / 64.0f, 38.0f / 64.0f, 43.0f / 64.0f, 47.0f / 64.0f, 51.0f / 64.0f, 55.0f / 64.0f, 60.0f / 64.0f, 64.0f / 64.0f
+};
+
+static void QuantizeBC7Mode6(const EndpointFormat& format, const f32* endpoint, i32* quantized)
+{
+	f32 best_error = FLT_MAX;
+	for (i32 p = 0; p < 2; ++p) {
+		i32 candidate[4];
+		f32 error = 0.0f;
+		for (u32 c = 0; c < 4; ++c) {
+			candidate[c] = Round((endpoint[c] - p) * 0.5f, 127) * 2 + p;
+			const f32 diff = candidate[c] - endpoint[c];
+			error += diff * diff;
+		}
+		if (error < best_error) {
+			best_error = error;
+			memcpy(quantized, candidate, sizeof(candidate));
+		}
+	}
+}
+
+static void PaletteBC7Mode6(const EndpointFormat& format, const i32* e0, const i32* e1, f32 (*palette)[4])
+{
+	for (u32 i = 0; i < 16; ++i) {
+		const i32 w = s_bc7_weights4[i];
+		for (u32 c = 0; c < 4; ++c) palette[i][c] = (f32)(((64 - w) * e0[c] + w * e1[c] + 32) >> 6);
+	}
+}
+
+static const EndpointFormat s_bc1_format = { 0, 3, 4, 1, { 31, 63, 31, 0 }, s_bc1_weights, QuantizeBC1, OrderBC1, PaletteBC1 };
+static const EndpointFormat s_bc3_color_format = { 0, 3, 4, 1, { 31, 63, 31, 0 }, s_bc1_weights, QuantizeBC1, OrderBC1, PaletteBC3Color };
+static const EndpointFormat s_bc4_red_format = { 0, 1, 8, 1, { 255, 255, 255, 255 }, s_bc4_weights, QuantizeBC4, OrderBC4, PaletteBC4 };
+static const EndpointFormat s_bc4_green_format = { 1, 1, 8, 1, { 255, 255, 255, 255 }, s_bc4_weights, QuantizeBC4, OrderBC4, PaletteBC4 };
+static const EndpointFormat s_bc4_alpha_format = { 3, 1, 8, 1, { 255, 255, 255, 255 }, s_bc4_weights, QuantizeBC4, OrderBC4, PaletteBC4 };
+static const EndpointFormat s_bc7_mode6_format = { 0, 4, 16, 2, { 255, 255, 255, 255 }, s_bc7_weights, QuantizeBC7Mode6, nullptr, PaletteBC7Mode6 };
+
+//-------------------------------------------------------------------------------------------------
+// ENDPOINT SEARCH
+//-------------------------------------------------------------------------------------------------
+
+struct BlockFit {
+	i32 m_endpoints[2][4];
+	u8 m_indices[16];
+	f32 m_error;
+};
+
+static f32 Clamp255(f32 value)
+{
+	return value < 0.0f ? 0.0f : value > 255.0f ? 255.0f : value;
+}
+
+//Either the corners of the bounding box or the extent of the texels along their principal axis
+static void InitialEndpoints(const EncodeBlock& block, const EndpointFormat& format, bool principal_axis, f32* lo, f32* hi)
+{
+	const u32 first = format.m_first;
+	const u32 last = format.m_first + format.m_count;
+	f32 mean[4] = {}, minimum[4], maximum[4];
+	for (u32 c = first; c < last; ++c) {
+		minimum[c] = FLT_MAX;
+		maximum[c] = -FLT_MAX;
+		for (u32 i = 0; i < 16; ++i) {
+			const f32 value = block.m_channels[c][i];
+			mean[c] += value;
+			minimum[c] = value < minimum[c] ? value : minimum[c];
+			maximum[c] = value > maximum[c] ? value : maximum[c];
+		}
+		mean[c] /= 16.0f;
+	}
+
+	if (format.m_count == 1 || !principal_axis) {
+		u32 widest = first;
+		for (u32 c = first; c < last; ++c) {
+			lo[c] = minimum[c];
+			hi[c] = maximum[c];
+			if (maximum[c] - minimum[c] > maximum[widest] - minimum[widest]) widest = c;
+		}
+		//The box diagonal only follows the texels if each channel rises along with the widest one
+		for (u32 c = first; c < last; ++c) {
+			if (c == widest) continue;
+			f32 covariance = 0.0f;
+			for (u32 i = 0; i < 16; ++i) {
+				covariance += (block.m_channels[c][i] - mean[c]) * (block.m_channels[widest][i] - mean[widest]);
+			}
+			if (covariance < 0.0f) std::swap(lo[c], hi[c]);
+		}
+		return;
+	}
+
+	f32 covariance[4][4] = {};
+	for (u32 i = 0; i < 16; ++i) {
+		for (u32 a = first; a < last; ++a) {
+			for (u32 b = first; b < last; ++b) {
+				covariance[a][b] += (block.m_channels[a][i] - mean[a]) * (block.m_channels[b][i] - mean[b]);
+			}
+		}
+	}
+
+	//Power iteration from the box diagonal
+	f32 axis[4] = {};
+	for (u32 c = first; c < last; ++c) axis[c] = maximum[c] - minimum[c];
+	for (u32 iteration = 0; iteration < 8; ++iteration) {
+		f32 next[4] = {};
+		f32 largest = 0.0f;
+		for (u32 a = first; a < last; ++a) {
+			for (u32 b = first; b < last; ++b) next[a] += covariance[a][b] * axis[b];
+			largest = fabsf(next[a]) > largest ? fabsf(next[a]) : largest;
+		}
+		if (largest == 0.0f) break;
+		for (u32 c = first; c < last; ++c) axis[c] = next[c] / largest;
+	}
+
+	f32 length = 0.0f;
+	for (u32 c = first; c < last; ++c) length += axis[c] * axis[c];
+	if (length == 0.0f) {
+		//Every texel is the same color
+		for (u32 c = first; c < last; ++c) lo[c] = hi[c] = mean[c];
+		return;
+	}
+	length = sqrtf(length);
+	for (u32 c = first; c < last; ++c) axis[c] /= length;
+
+	f32 t_min = FLT_MAX, t_max = -FLT_MAX;
+	for (u32 i = 0; i < 16; ++i) {
+		f32 t = 0.0f;
+		for (u32 c = first; c < last; ++c) t += (block.m_channels[c][i] - mean[c]) * axis[c];
+		t_min = t < t_min ? t : t_min;
+		t_max = t > t_max ? t : t_max;
+	}
+	for (u32 c = first; c < last; ++c) {
+		lo[c] = Clamp255(mean[c] + axis[c] * t_min);
+		hi[c] = Clamp255(mean[c] + axis[c] * t_max);
+	}
+}
+
+static void EvaluateQuantized(const EncodeBlock& block, const EndpointFormat& format, bool simd, const i32* e0, const i32* e1, BlockFit& fit)
+{
+	memcpy(fit.m_endpoints[0], e0, sizeof(fit.m_endpoints[0]));
+	memcpy(fit.m_endpoints[1], e1, sizeof(fit.m_endpoints[1]));
+	if (format.m_order) format.m_order(format, fit.m_endpoints[0], fit.m_endpoints[1]);
+
+	f32 palette[ENCODER_MAX_PALETTE][4] = {};
+	format.m_palette(format, fit.m_endpoints[0], fit.m_endpoints[1], palette);
+	fit.m_error = SearchPalette(simd, block, format.m_first, format.m_count, palette, format.m_palette_size, fit.m_indices);
+}
+
+static void Evaluate(const EncodeBlock& block, const EndpointFormat& format, bool simd, const f32* lo, const f32* hi, BlockFit& fit)
+{
+	i32 e0[4] = {}, e1[4] = {};
+	format.m_quantize(format, lo, e0);
+	format.m_quantize(format, hi, e1);
+	EvaluateQuantized(block, format, simd, e0, e1, fit);
+}
+
+//Endpoints that best reproduce the texels with the palette positions the indices picked
+static bool LeastSquares(const EncodeBlock& block, const EndpointFormat& format, const u8* indices, f32* lo, f32* hi)
+{
+	f32 aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	f32 ax[4] = {}, bx[4] = {};
+	for (u32 i = 0; i < 16; ++i) {
+		const f32 b = format.m_weights[indices[i]];
+		const f32 a = 1.0f - b;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for (u32 c = format.m_first; c < format.m_first + format.m_count; ++c) {
+			ax[c] += a * block.m_channels[c][i];
+			bx[c] += b * block.m_channels[c][i];
+		}
+	}
+
+	const f32 determinant = aa * bb - ab * ab;
+	if (fabsf(determinant) < 1.0e-6f) return false;
+	for (u32 c = format.m_first; c < format.m_first + format.m_count; ++c) {
+		lo[c] = Clamp255((bb * ax[c] - ab * bx[c]) / determinant);
+		hi[c] = Clamp255((aa * bx[c] - ab * ax[c]) / determinant);
+	}
+	return true;
+}
+
+//Nudges each quantized channel of each endpoint by one step while that lowers the error
+static void SearchQuantized(const EncodeBlock& block, const EndpointFormat& format, bool simd, BlockFit& fit)
+{
+	bool improved = true;
+	for (u32 pass = 0; pass < 4 && improved; ++pass) {
+		improved = false;
+		for (u32 e = 0; e < 2; ++e) {
+			for (u32 c = format.m_first; c < format.m_first + format.m_count; ++c) {
+				for (i32 direction = -1; direction <= 1; direction += 2) {
+					i32 candidate[2][4];
+					memcpy(candidate, fit.m_endpoints, sizeof(candidate));
+					candidate[e][c] += direction * format.m_step;
+					if (candidate[e][c] < 0 || candidate[e][c] > format.m_max[c]) continue;
+
+					BlockFit trial;
+					EvaluateQuantized(block, format, simd, candidate[0], candidate[1], trial);
+					if (trial.m_error < fit.m_error) {
+						fit = trial;
+						improved = true;
+					}
+				}
+			}
+		}
+	}
+}
+
+static void FitBlock(const EncodeBlock& block, const EndpointFormat& format, const EncodeSettings& settings, BlockFit& fit)
+{
+	f32 lo[4] = {}, hi[4] = {};
+	InitialEndpoints(block, format, false, lo, hi);
+	Evaluate(block, format, settings.m_simd, lo, hi, fit);
+	if (fit.m_error == 0.0f || settings.m_quality == EncodeQuality::Fast) return;
+
+	//The principal axis misses blocks whose colors don't lie on one line, keep whichever start is better
+	if (format.m_count > 1) {
+		f32 axis_lo[4] = {}, axis_hi[4] = {};
+		InitialEndpoints(block, format, true, axis_lo, axis_hi);
+		BlockFit trial;
+		Evaluate(block, format, settings.m_simd, axis_lo, axis_hi, trial);
+		if (trial.m_error < fit.m_error) {
+			fit = trial;
+			memcpy(lo, axis_lo, sizeof(lo));
+			memcpy(hi, axis_hi, sizeof(hi));
+		}
+	}
+
+	const u32 passes = settings.m_quality == EncodeQuality::Normal ? 1 : ENCODER_HIGH_PASSES;
+	for (u32 pass = 0; pass < passes; ++pass) {
+		if (!LeastSquares(block, format, fit.m_indices, lo, hi)) break;
+		BlockFit trial;
+		Evaluate(block, format, settings.m_simd, lo, hi, trial);
+		if (trial.m_error >= fit.m_error) break;
+		fit = trial;
+	}
+
+	if (settings.m_quality == EncodeQuality::High && fit.m_error > 0.0f) {
+		SearchQuantized(block, format, settings.m_simd, fit);
+	}
+}
+
+//-------------------------------------------------------------------------------------------------
+// PACKING
+//-------------------------------------------------------------------------------------------------
+
+static void PackBC1(const BlockFit& fit, u8* out)
+{
+	const u32 c0 = Pack565(fit.m_endpoints[0]);
+	const u32 c1 = Pack565(fit.m_endpoints[1]);
+	u32 indices = 0;
+	for (u32 i = 0; i < 16; ++i) indices |= (u32)fit.m_indices[i] << (2 * i);
+
+	out[0] = (u8)c0;
+	out[1] = (u8)(c0 >> 8);
+	out[2] = (u8)c1;
+	out[3] = (u8)(c1 >> 8);
+	for (u32 i = 0; i < 4; ++i) out[4 + i] = (u8)(indices >> (8 * i));
+}
+
+static void PackBC4(const BlockFit& fit, u32 channel, u8* out)
+{
+	u64 indices = 0;
+	for (u32 i = 0; i < 16; ++i) indices |= (u64)fit.m_indices[i] << (3 * i);
+
+	out[0] = (u8)fit.m_endpoints[0][channel];
+	out[1] = (u8)fit.m_endpoints[1][channel];
+	for (u32 i = 0; i < 6; ++i) out[2 + i] = (u8)(indices >> (8 * i));
+}
+
+//Blocks are a little-endian bit stream
+static void WriteBits(u8* out, u32& position, u32 value, u32 count)
+{
+	for (u32 i = 0; i < count; ++i, ++position) {
+		if ((value >> i) & 1) out[position >> 3] |= (u8)(1 << (position & 7));
+	}
+}
+
+static void PackBC7Mode6(const BlockFit& fit, u8* out)
+{
+	i32 endpoints[2][4];
+	u8 indices[16];
+	memcpy(endpoints, fit.m_endpoints, sizeof(endpoints));
+	memcpy(indices, fit.m_indices, sizeof(indices));
+
+	//The first texel's index drops its top bit, so it has to be in the lower half
+	if (indices[0] >= 8) {
+		for (u32 c = 0; c < 4; ++c) std::swap(endpoints[0][c], endpoints[1][c]);
+		for (u32 i = 0; i < 16; ++i) indices[i] = (u8)(15 - indices[i]);
+	}
+
+	memset(out, 0, 16);
+	u32 position = 0;
+	WriteBits(out, position, 1 << 6, 7);
+	for (u32 c = 0; c < 4; ++c) {
+		WriteBits(out, position, endpoints[0][c] >> 1, 7);
+		WriteBits(out, position, endpoints[1][c] >> 1, 7);
+	}
+	WriteBits(out, position, endpoints[0][0] & 1, 1);
+	WriteBits(out, position, endpoints[1][0] & 1, 1);
+	WriteBits(out, position, indices[0], 3);
+	for (u32 i = 1; i < 16; ++i) WriteBits(out, position, indices[i], 4);
+}
+
+//-------------------------------------------------------------------------------------------------
+// IMAGES
+//-------------------------------------------------------------------------------------------------
+
+//Returns the block's squared error
+static f32 EncodeOne(const EncodeBlock& block, const EncodeSettings& settings, u8* out)
+{
+	BlockFit fit, second;
+	switch (settings.m_format) {
+	case EncodeFormat::BC1:
+		FitBlock(block, s_bc1_format, settings, fit);
+		PackBC1(fit, out);
+		return fit.m_error;
+	case EncodeFormat::BC3:
+		FitBlock(block, s_bc4_alpha_format, settings, fit);
+		FitBlock(block, s_bc3_color_format, settings, second);
+		PackBC4(fit, 3, out);
+		PackBC1(second, out + 8);
+		return fit.m_error + second.m_error;
+	case EncodeFormat::BC5:
+		FitBlock(block, s_bc4_red_format, settings, fit);
+		FitBlock(block, s_bc4_green_format, settings, second);
+		PackBC4(fit, 0, out);
+		PackBC4(second, 1, out + 8);
+		return fit.m_error + second.m_error;
+	case EncodeFormat::BC7:
+		FitBlock(block, s_bc7_mode6_format, settings, fit);
+		PackBC7Mode6(fit, out);
+		return fit.m_error;
+	}
+	return 0.0f;
+}
+
+void EncodeImage(const u8* rgba, u32 width, u32 height, const EncodeSettings& settings, std::vector<u8>& out, EncodeStats* stats)
+{
+	const auto start = std::chrono::steady_clock::now();
+	const usize block_bytes = settings.m_format == EncodeFormat::BC1 ? 8 : 16;
+	const int blocks_x = (int)((width + 3) / 4);
+	const int blocks_y = (int)((height + 3) / 4);
+	out.resize((usize)blocks_x * blocks_y * block_bytes);
+	u8* dst = out.data();
+
+	//A row of blocks per task, blocks cost very different amounts with the refining tiers
+	f64 error = 0.0;
+#pragma omp parallel for schedule(dynamic) reduction(+:error) if(settings.m_threads)
+	for (int by = 0; by < blocks_y; ++by) {
+		EncodeBlock block;
+		for (int bx = 0; bx < blocks_x; ++bx) {
+			LoadBlock(rgba, width, height, bx, by, block);
+			error += EncodeOne(block, settings, dst + ((usize)by * blocks_x + bx) * block_bytes);
+		}
+	}
+
+	if (stats) {
+		stats->m_texels += (u64)width * height;
+		stats->m_block_texels += (u64)blocks_x * blocks_y * 16;
+		stats->m_seconds += std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+		stats->m_squared_error += error;
+		switch (settings.m_format) {
+		case EncodeFormat::BC1: stats->m_channels = 3; break;
+		case EncodeFormat::BC5: stats->m_channels = 2; break;
+		default: stats->m_channels = 4; break;
+		}
+	}
+}
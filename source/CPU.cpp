@@ -0,0 +1,39 @@
+#include "GL_Helpers.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif //_MSC_VER
+
+//CPU feature checks live apart from the GL helpers so tools without a GL context can link them
+
+static bool DetectAVX2()
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+
+	__cpuid(info, 1);
+	const bool fma = (info[2] & (1 << 12)) != 0;
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+	if (!fma || !osxsave || !avx) return false;
+
+	//The OS has to save the YMM registers on context switches
+	if ((_xgetbv(0) & 6) != 6) return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#elif defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+	return false;
+#endif
+}
+
+bool CPU_HasAVX2()
+{
+	static const bool has_avx2 = DetectAVX2();
+	return has_avx2;
+}
@@ -0,0 +1,278 @@
+#include "Fractal.h"
+
+#include <algorithm>
+#include <chrono>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FRACTAL_X86 1
+#include <immintrin.h>
+#endif //x86
+
+//Tiles are small enough that the expensive ones spread over every thread, and a multiple of
+//FRACTAL_COARSEST_STEP so progressive blocks never cross a tile edge
+#define FRACTAL_TILE_SIZE 32
+#define FRACTAL_ESCAPE_SQUARED 256.0f
+//Longest run of pixels handed to a kernel in one call
+#define FRACTAL_MAX_SPAN FRACTAL_TILE_SIZE
+
+bool FractalParams::operator==(const FractalParams& other) const
+{
+	return m_cx == other.m_cx && m_cy == other.m_cy &&
+		m_offset_x == other.m_offset_x && m_offset_y == other.m_offset_y &&
+		m_zoom == other.m_zoom && m_max_iterations == other.m_max_iterations;
+}
+
+//-------------------------------------------------------------------------------------------------
+// KERNELS
+//-------------------------------------------------------------------------------------------------
+
+//Each kernel computes the escape counts of count pixels on row y, at columns x, x + x_step, ...
+//and returns the iterations spent. The arithmetic is kept in the same order in every kernel and
+//without FMA, so all of them produce the same image. MSVC doesn't contract on its own, GCC and
+//Clang would inside the AVX2 kernel
+#ifdef __GNUC__
+#pragma GCC optimize("fp-contract=off")
+#endif //__GNUC__
+
+static inline int EscapeScalar(float cx, float cy, int max_iterations, float zx, float zy)
+{
+	int it;
+	for (it = 0; it < max_iterations; it++) {
+		const float x = zx * zx - zy * zy;
+		const float y = 2.0f * zx * zy;
+		zx = x + cx;
+		zy = y + cy;
+		if ((zx * zx + zy * zy) > FRACTAL_ESCAPE_SQUARED) break;
+	}
+	return it;
+}
+
+static u64 SpanScalar(const FractalParams& p, int width, int height, int x, int x_step, int y, int count, int* out)
+{
+	const float zy = p.m_zoom * ((float)y / (float)height - 0.5f) + p.m_offset_y;
+	u64 iterations = 0;
+	for (int i = 0; i < count; ++i) {
+		const float zx = p.m_zoom * ((float)(x + i * x_step) / (float)width - 0.5f) + p.m_offset_x;
+		out[i] = EscapeScalar(p.m_cx, p.m_cy, p.m_max_iterations, zx, zy);
+		iterations += out[i];
+	}
+	return iterations;
+}
+
+#ifdef FRACTAL_X86
+//Two vectors per group keep two independent dependency chains in flight
+static u64 SpanSSE(const FractalParams& p, int width, int height, int x, int x_step, int y, int count, int* out)
+{
+	const int group_end = count & ~7;
+	const __m128 cx = _mm_set1_ps(p.m_cx);
+	const __m128 cy = _mm_set1_ps(p.m_cy);
+	const __m128 zoom = _mm_set1_ps(p.m_zoom);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 width_f = _mm_set1_ps((float)width);
+	const __m128 offset_x = _mm_set1_ps(p.m_offset_x);
+	const __m128 escape = _mm_set1_ps(FRACTAL_ESCAPE_SQUARED);
+	const __m128 step = _mm_set1_ps((float)x_step);
+	const __m128 lane = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+	const float zy0 = p.m_zoom * ((float)y / (float)height - 0.5f) + p.m_offset_y;
+
+	u64 iterations = 0;
+	for (int i = 0; i < group_end; i += 8) {
+		const __m128 column_a = _mm_add_ps(_mm_set1_ps((float)(x + i * x_step)), _mm_mul_ps(lane, step));
+		const __m128 column_b = _mm_add_ps(_mm_set1_ps((float)(x + (i + 4) * x_step)), _mm_mul_ps(lane, step));
+		__m128 zx_a = _mm_add_ps(_mm_mul_ps(zoom, _mm_sub_ps(_mm_div_ps(column_a, width_f), half)), offset_x);
+		__m128 zx_b = _mm_add_ps(_mm_mul_ps(zoom, _mm_sub_ps(_mm_div_ps(column_b, width_f), half)), offset_x);
+		__m128 zy_a = _mm_set1_ps(zy0);
+		__m128 zy_b = zy_a;
+		__m128 active_a = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		__m128 active_b = active_a;
+		__m128i count_a = _mm_setzero_si128();
+		__m128i count_b = _mm_setzero_si128();
+
+		for (int it = 0; it < p.m_max_iterations; ++it) {
+			const __m128 x_a = _mm_sub_ps(_mm_mul_ps(zx_a, zx_a), _mm_mul_ps(zy_a, zy_a));
+			const __m128 x_b = _mm_sub_ps(_mm_mul_ps(zx_b, zx_b), _mm_mul_ps(zy_b, zy_b));
+			const __m128 y_a = _mm_mul_ps(_mm_add_ps(zx_a, zx_a), zy_a);
+			const __m128 y_b = _mm_mul_ps(_mm_add_ps(zx_b, zx_b), zy_b);
+			zx_a = _mm_add_ps(x_a, cx);
+			zx_b = _mm_add_ps(x_b, cx);
+			zy_a = _mm_add_ps(y_a, cy);
+			zy_b = _mm_add_ps(y_b, cy);
+
+			const __m128 magnitude_a = _mm_add_ps(_mm_mul_ps(zx_a, zx_a), _mm_mul_ps(zy_a, zy_a));
+			const __m128 magnitude_b = _mm_add_ps(_mm_mul_ps(zx_b, zx_b), _mm_mul_ps(zy_b, zy_b));
+			active_a = _mm_andnot_ps(_mm_cmpgt_ps(magnitude_a, escape), active_a);
+			active_b = _mm_andnot_ps(_mm_cmpgt_ps(magnitude_b, escape), active_b);
+			//Active lanes are all ones, -1, so subtracting counts them
+			count_a = _mm_sub_epi32(count_a, _mm_castps_si128(active_a));
+			count_b = _mm_sub_epi32(count_b, _mm_castps_si128(active_b));
+
+			if ((_mm_movemask_ps(active_a) | _mm_movemask_ps(active_b)) == 0) break;
+		}
+
+		_mm_storeu_si128((__m128i*)(out + i), count_a);
+		_mm_storeu_si128((__m128i*)(out + i + 4), count_b);
+		for (int k = 0; k < 8; ++k) iterations += out[i + k];
+	}
+	return iterations + SpanScalar(p, width, height, x + group_end * x_step, x_step, y, count - group_end, out + group_end);
+}
+
+AVX2_TARGET static u64 SpanAVX2(const FractalParams& p, int width, int height, int x, int x_step, int y, int count, int* out)
+{
+	const int group_end = count & ~15;
+	const __m256 cx = _mm256_set1_ps(p.m_cx);
+	const __m256 cy = _mm256_set1_ps(p.m_cy);
+	const __m256 zoom = _mm256_set1_ps(p.m_zoom);
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 width_f = _mm256_set1_ps((float)width);
+	const __m256 offset_x = _mm256_set1_ps(p.m_offset_x);
+	const __m256 escape = _mm256_set1_ps(FRACTAL_ESCAPE_SQUARED);
+	const __m256 step = _mm256_set1_ps((float)x_step);
+	const __m256 lane = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+	const float zy0 = p.m_zoom * ((float)y / (float)height - 0.5f) + p.m_offset_y;
+
+	u64 iterations = 0;
+	for (int i = 0; i < group_end; i += 16) {
+		const __m256 column_a = _mm256_add_ps(_mm256_set1_ps((float)(x + i * x_step)), _mm256_mul_ps(lane, step));
+		const __m256 column_b = _mm256_add_ps(_mm256_set1_ps((float)(x + (i + 8) * x_step)), _mm256_mul_ps(lane, step));
+		__m256 zx_a = _mm256_add_ps(_mm256_mul_ps(zoom, _mm256_sub_ps(_mm256_div_ps(column_a, width_f), half)), offset_x);
+		__m256 zx_b = _mm256_add_ps(_mm256_mul_ps(zoom, _mm256_sub_ps(_mm256_div_ps(column_b, width_f), half)), offset_x);
+		__m256 zy_a = _mm256_set1_ps(zy0);
+		__m256 zy_b = zy_a;
+		__m256 active_a = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		__m256 active_b = active_a;
+		__m256i count_a = _mm256_setzero_si256();
+		__m256i count_b = _mm256_setzero_si256();
+
+		for (int it = 0; it < p.m_max_iterations; ++it) {
+			const __m256 x_a = _mm256_sub_ps(_mm256_mul_ps(zx_a, zx_a), _mm256_mul_ps(zy_a, zy_a));
+			const __m256 x_b = _mm256_sub_ps(_mm256_mul_ps(zx_b, zx_b), _mm256_mul_ps(zy_b, zy_b));
+			const __m256 y_a = _mm256_mul_ps(_mm256_add_ps(zx_a, zx_a), zy_a);
+			const __m256 y_b = _mm256_mul_ps(_mm256_add_ps(zx_b, zx_b), zy_b);
+			zx_a = _mm256_add_ps(x_a, cx);
+			zx_b = _mm256_add_ps(x_b, cx);
+			zy_a = _mm256_add_ps(y_a, cy);
+			zy_b = _mm256_add_ps(y_b, cy);
+
+			const __m256 magnitude_a = _mm256_add_ps(_mm256_mul_ps(zx_a, zx_a), _mm256_mul_ps(zy_a, zy_a));
+			const __m256 magnitude_b = _mm256_add_ps(_mm256_mul_ps(zx_b, zx_b), _mm256_mul_ps(zy_b, zy_b));
+			active_a = _mm256_andnot_ps(_mm256_cmp_ps(magnitude_a, escape, _CMP_GT_OQ), active_a);
+			active_b = _mm256_andnot_ps(_mm256_cmp_ps(magnitude_b, escape, _CMP_GT_OQ), active_b);
+			count_a = _mm256_sub_epi32(count_a, _mm256_castps_si256(active_a));
+			count_b = _mm256_sub_epi32(count_b, _mm256_castps_si256(active_b));
+
+			if ((_mm256_movemask_ps(active_a) | _mm256_movemask_ps(active_b)) == 0) break;
+		}
+
+		_mm256_storeu_si256((__m256i*)(out + i), count_a);
+		_mm256_storeu_si256((__m256i*)(out + i + 8), count_b);
+		for (int k = 0; k < 16; ++k) iterations += out[i + k];
+	}
+	return iterations + SpanSSE(p, width, height, x + group_end * x_step, x_step, y, count - group_end, out + group_end);
+}
+#endif //FRACTAL_X86
+
+typedef u64 (*SpanKernel)(const FractalParams&, int, int, int, int, int, int, int*);
+
+static SpanKernel SelectKernel(FractalKernel kernel)
+{
+#ifdef FRACTAL_X86
+	if (kernel == FractalKernel::SIMD) {
+		return CPU_HasAVX2() ? SpanAVX2 : SpanSSE;
+	}
+#endif //FRACTAL_X86
+	return SpanScalar;
+}
+
+//-------------------------------------------------------------------------------------------------
+// RENDERER
+//-------------------------------------------------------------------------------------------------
+
+void FractalRenderer::Init(int width, int height)
+{
+	m_width = width;
+	m_height = height;
+	m_tiles.clear();
+	for (int y = 0; y < height; y += FRACTAL_TILE_SIZE) {
+		for (int x = 0; x < width; x += FRACTAL_TILE_SIZE) {
+			m_tiles.push_back({ x, y, std::min(FRACTAL_TILE_SIZE, width - x), std::min(FRACTAL_TILE_SIZE, height - y) });
+		}
+	}
+	m_tile_cost.assign(m_tiles.size(), 0);
+	m_order.resize(m_tiles.size());
+	m_step = 0;
+}
+
+void FractalRenderer::RenderTile(const FractalParams& params, unsigned char* out, const Tile& tile, int step, bool refine, u64* iterations)
+{
+	SpanKernel kernel = SelectKernel(m_kernel);
+	int values[FRACTAL_MAX_SPAN];
+	u64 spent = 0;
+
+	for (int y = tile.m_y; y < tile.m_y + tile.m_height; y += step) {
+		//Rows already computed at the coarser level only gain the columns in between
+		const bool known_row = refine && (y % (step * 2)) == 0;
+		const int first = known_row ? tile.m_x + step : tile.m_x;
+		const int x_step = known_row ? step * 2 : step;
+		const int end = tile.m_x + tile.m_width;
+		if (first >= end) continue;
+		const int count = (end - first + x_step - 1) / x_step;
+
+		spent += kernel(params, m_width, m_height, first, x_step, y, count, values);
+
+		const int block_height = std::min(step, m_height - y);
+		for (int i = 0; i < count; ++i) {
+			const int x = first + i * x_step;
+			const int block_width = std::min(step, m_width - x);
+			const unsigned char value = (unsigned char)values[i];
+			for (int by = 0; by < block_height; ++by) {
+				unsigned char* row = out + (usize)(y + by) * m_width + x;
+				for (int bx = 0; bx < block_width; ++bx) row[bx] = value;
+			}
+		}
+	}
+	*iterations = spent;
+}
+
+void FractalRenderer::RenderLevel(const FractalParams& params, unsigned char* out, int step, bool refine)
+{
+	//Most expensive first, the cheap tiles fill in the gaps at the end
+	for (int i = 0; i < (int)m_order.size(); ++i) m_order[i] = i;
+	std::stable_sort(m_order.begin(), m_order.end(), [this](int a, int b) { return m_tile_cost[a] > m_tile_cost[b]; });
+
+	const int tiles = (int)m_order.size();
+#pragma omp parallel for schedule(dynamic, 1) if (m_threads)
+	for (int t = 0; t < tiles; ++t) {
+		const int tile = m_order[t];
+		RenderTile(params, out, m_tiles[tile], step, refine, &m_tile_cost[tile]);
+	}
+}
+
+void FractalRenderer::Render(const FractalParams& params, unsigned char* out)
+{
+	RenderLevel(params, out, 1, false);
+	m_refine_params = params;
+	m_step = 1;
+}
+
+bool FractalRenderer::Refine(const FractalParams& params, unsigned char* out, f64 budget)
+{
+	if (params != m_refine_params) {
+		m_refine_params = params;
+		m_step = 0;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	while (m_step != 1) {
+		const int step = m_step == 0 ? FRACTAL_COARSEST_STEP : m_step / 2;
+		RenderLevel(params, out, step, m_step != 0);
+		m_step = step;
+
+		f64 elapsed = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+		if (elapsed >= budget) break;
+	}
+	return m_step == 1;
+}
+
+#undef FRACTAL_TILE_SIZE
+#undef FRACTAL_ESCAPE_SQUARED
+#undef FRACTAL_MAX_SPAN
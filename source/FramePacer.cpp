@@ -0,0 +1,215 @@
+#include "FramePacer.h"
+
+#include <cmath>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN 1
+#include <Windows.h>
+#include <timeapi.h>
+#pragma comment(lib, "winmm.lib")
+#endif //_WIN32
+
+//Sleep granularity requested from the OS, and the minimum time left to the spin loop
+#define PACER_SLEEP_SLICE 0.001
+#define PACER_SPIN_MARGIN 0.0002
+
+FramePacer::FramePacer(f64 frame_limit)
+	:m_epoch(std::chrono::steady_clock::now()),
+	m_policy(PacingPolicy::FixedCap),
+	m_interval(0.0),
+	m_target(0.0),
+	m_timestep(1.0 / 60.0),
+	m_accumulator(0.0),
+	m_last(0.0),
+	m_deadline(0.0),
+	m_work(0.0),
+	m_sleep_error(0.0),
+	m_history{ 0.0 },
+	m_history_count(0),
+	m_history_head(0),
+	m_missed(0),
+	m_frames(0)
+{
+#ifdef _WIN32
+	//Default scheduler tick is ~15.6ms which makes a 1ms sleep useless for pacing
+	timeBeginPeriod(1);
+#endif //_WIN32
+	SetFrameLimit(frame_limit);
+	Reset();
+}
+
+FramePacer::~FramePacer()
+{
+#ifdef _WIN32
+	timeEndPeriod(1);
+#endif //_WIN32
+}
+
+void FramePacer::SetFrameLimit(f64 limit)
+{
+	if (limit > 0.0) {
+		m_interval = 1.0 / limit;
+		if (m_policy == PacingPolicy::Uncapped) m_policy = PacingPolicy::FixedCap;
+	}
+	else {
+		m_interval = 0.0;
+		if (m_policy != PacingPolicy::FixedTimestep) m_policy = PacingPolicy::Uncapped;
+	}
+	m_deadline = Now();
+}
+
+void FramePacer::SetFixedTimestep(f64 rate)
+{
+	m_timestep = rate > 0.0 ? 1.0 / rate : 1.0 / 60.0;
+	m_accumulator = 0.0;
+}
+
+void FramePacer::Reset()
+{
+	m_last = Now();
+	m_deadline = m_last;
+	m_accumulator = 0.0;
+	m_work = 0.0;
+	m_history_count = 0;
+	m_history_head = 0;
+	m_missed = 0;
+	m_frames = 0;
+}
+
+f64 FramePacer::Wait()
+{
+	f64 now = Now();
+	f64 work = now - m_last;
+	m_work = m_frames == 0 ? work : m_work * 0.9 + work * 0.1;
+
+	switch (m_policy) {
+	case PacingPolicy::Uncapped:
+		m_target = 0.0;
+		break;
+	case PacingPolicy::Adaptive:
+		m_target = AdaptiveInterval();
+		break;
+	default:
+		m_target = m_interval;
+		break;
+	}
+
+	if (m_target > 0.0) {
+		//Schedule against the previous deadline so rounding errors don't accumulate,
+		//but resync if we fell more than a whole interval behind
+		m_deadline += m_target;
+		if (now > m_deadline + 0.001) {
+			m_missed++;
+		}
+		if (now > m_deadline + m_target) {
+			m_deadline = now;
+		}
+		SleepUntil(m_deadline);
+	}
+
+	now = Now();
+	f64 dt = now - m_last;
+	m_last = now;
+	Record(dt);
+
+	if (m_policy == PacingPolicy::FixedTimestep) {
+		m_accumulator += dt;
+	}
+	return dt;
+}
+
+u32 FramePacer::ConsumeSteps()
+{
+	u32 steps = static_cast<u32>(m_accumulator / m_timestep);
+	if (steps > MAX_STEPS) {
+		//Drop the backlog rather than spiral trying to catch up
+		steps = MAX_STEPS;
+		m_accumulator = 0.0;
+	}
+	else {
+		m_accumulator -= steps * m_timestep;
+	}
+	return steps;
+}
+
+PacingStats FramePacer::GetStats()
+{
+	PacingStats stats = {};
+	stats.target = m_target;
+	stats.work = m_work;
+	stats.sleep_error = m_sleep_error;
+	stats.missed = m_missed;
+	stats.frames = m_frames;
+
+	if (m_history_count == 0) return stats;
+
+	f64 sum = 0.0;
+	stats.min = m_history[0];
+	stats.max = m_history[0];
+	for (u32 i = 0; i < m_history_count; ++i) {
+		sum += m_history[i];
+		if (m_history[i] < stats.min) stats.min = m_history[i];
+		if (m_history[i] > stats.max) stats.max = m_history[i];
+	}
+	stats.mean = sum / m_history_count;
+
+	f64 variance = 0.0;
+	for (u32 i = 0; i < m_history_count; ++i) {
+		f64 d = m_history[i] - stats.mean;
+		variance += d * d;
+	}
+	stats.jitter = std::sqrt(variance / m_history_count);
+
+	return stats;
+}
+
+f64 FramePacer::Now()
+{
+	return std::chrono::duration<f64>(std::chrono::steady_clock::now() - m_epoch).count();
+}
+
+void FramePacer::SleepUntil(f64 deadline)
+{
+	//Coarse phase: sleep in small slices while the remaining time covers the worst oversleep seen
+	for (;;) {
+		f64 remaining = deadline - Now();
+		if (remaining <= PACER_SLEEP_SLICE + m_sleep_error + PACER_SPIN_MARGIN) break;
+
+		f64 before = Now();
+		std::this_thread::sleep_for(std::chrono::duration<f64>(PACER_SLEEP_SLICE));
+		f64 overshoot = (Now() - before) - PACER_SLEEP_SLICE;
+
+		//Track the worst case with a slow decay so one bad wakeup doesn't pin the margin forever
+		m_sleep_error = overshoot > m_sleep_error ? overshoot : m_sleep_error * 0.995;
+	}
+
+	//Fine phase: spin for the last fraction of a millisecond
+	while (Now() < deadline) {
+		std::this_thread::yield();
+	}
+}
+
+f64 FramePacer::AdaptiveInterval()
+{
+	if (m_interval <= 0.0) return 0.0;
+
+	//Hold a steady multiple of the base interval instead of alternating between hit and miss
+	f64 budget = m_work * 1.1;
+	if (budget <= m_interval) return m_interval;
+
+	f64 multiple = std::ceil(budget / m_interval);
+	if (multiple > 4.0) multiple = 4.0;
+	return m_interval * multiple;
+}
+
+void FramePacer::Record(f64 interval)
+{
+	m_history[m_history_head] = interval;
+	m_history_head = (m_history_head + 1) % HISTORY;
+	if (m_history_count < HISTORY) m_history_count++;
+	m_frames++;
+}
+
+#undef PACER_SLEEP_SLICE
+#undef PACER_SPIN_MARGIN
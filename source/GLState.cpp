@@ -0,0 +1,190 @@
+#include <GL/glew.h>
+#include "GLState.h"
+
+//Tracked values hold this until the first call after Invalidate
+#define GL_STATE_UNKNOWN 0xFFFFFFFFu
+
+enum GLStateCap {
+	CAP_BLEND,
+	CAP_CULL_FACE,
+	CAP_DEPTH_TEST,
+	CAP_COUNT
+};
+
+enum GLStateBuffer {
+	BUFFER_DRAW_INDIRECT,
+	BUFFER_PARAMETER,
+	BUFFER_DISPATCH_INDIRECT,
+	BUFFER_COUNT
+};
+
+struct GLStateShadow {
+	u32 caps[CAP_COUNT];
+	u32 blend_src;
+	u32 blend_dst;
+	u32 cull_face;
+	u32 depth_func;
+	u32 depth_mask;
+	u32 program;
+	u32 vao;
+	u32 textures[GL_STATE_TEXTURE_UNITS];
+	u32 samplers[GL_STATE_TEXTURE_UNITS];
+	u32 buffers[BUFFER_COUNT];
+	u32 uniform_buffers[GL_STATE_BUFFER_BINDINGS];
+	u32 storage_buffers[GL_STATE_BUFFER_BINDINGS];
+};
+
+static GLStateShadow s_shadow;
+static GLStateStats s_this_frame = {};
+static GLStateStats s_last_frame = {};
+static bool s_initialized = false;
+
+//Updates the shadow value and says whether the call has to be made
+static bool Changed(u32& shadow, u32 value)
+{
+	if (shadow == value) {
+		s_this_frame.m_elided++;
+		return false;
+	}
+	shadow = value;
+	s_this_frame.m_issued++;
+	return true;
+}
+
+static void EnsureInit()
+{
+	if (!s_initialized) GLState::Invalidate();
+}
+
+void GLState::Invalidate()
+{
+	//Every field is a u32, so the whole shadow can be filled with the sentinel
+	u32* values = (u32*)&s_shadow;
+	for (usize i = 0; i < sizeof(s_shadow) / sizeof(u32); ++i) values[i] = GL_STATE_UNKNOWN;
+	s_initialized = true;
+}
+
+void GLState::BeginFrame()
+{
+	s_last_frame = s_this_frame;
+	s_this_frame = {};
+	Invalidate();
+}
+
+const GLStateStats& GLState::LastFrame()
+{
+	return s_last_frame;
+}
+
+const GLStateStats& GLState::ThisFrame()
+{
+	return s_this_frame;
+}
+
+void GLState::Enable(GLenum cap, bool enable)
+{
+	EnsureInit();
+	u32* shadow = nullptr;
+	switch (cap) {
+	case GL_BLEND: shadow = &s_shadow.caps[CAP_BLEND]; break;
+	case GL_CULL_FACE: shadow = &s_shadow.caps[CAP_CULL_FACE]; break;
+	case GL_DEPTH_TEST: shadow = &s_shadow.caps[CAP_DEPTH_TEST]; break;
+	default: s_this_frame.m_issued++; break;
+	}
+	if (shadow && !Changed(*shadow, enable ? 1 : 0)) return;
+
+	if (enable) glEnable(cap);
+	else glDisable(cap);
+}
+
+void GLState::BlendFunc(GLenum src, GLenum dst)
+{
+	EnsureInit();
+	if (s_shadow.blend_src == src && s_shadow.blend_dst == dst) {
+		s_this_frame.m_elided++;
+		return;
+	}
+	s_shadow.blend_src = src;
+	s_shadow.blend_dst = dst;
+	s_this_frame.m_issued++;
+	glBlendFunc(src, dst);
+}
+
+void GLState::CullFace(GLenum face)
+{
+	EnsureInit();
+	if (Changed(s_shadow.cull_face, face)) glCullFace(face);
+}
+
+void GLState::DepthFunc(GLenum func)
+{
+	EnsureInit();
+	if (Changed(s_shadow.depth_func, func)) glDepthFunc(func);
+}
+
+void GLState::DepthMask(bool write)
+{
+	EnsureInit();
+	if (Changed(s_shadow.depth_mask, write ? 1 : 0)) glDepthMask(write ? GL_TRUE : GL_FALSE);
+}
+
+void GLState::UseProgram(GLuint program)
+{
+	EnsureInit();
+	if (Changed(s_shadow.program, program)) glUseProgram(program);
+}
+
+void GLState::BindVertexArray(GLuint vao)
+{
+	EnsureInit();
+	if (Changed(s_shadow.vao, vao)) glBindVertexArray(vao);
+}
+
+void GLState::BindTextureUnit(GLuint unit, GLuint texture)
+{
+	EnsureInit();
+	if (unit >= GL_STATE_TEXTURE_UNITS) {
+		s_this_frame.m_issued++;
+		glBindTextureUnit(unit, texture);
+		return;
+	}
+	if (Changed(s_shadow.textures[unit], texture)) glBindTextureUnit(unit, texture);
+}
+
+void GLState::BindSampler(GLuint unit, GLuint sampler)
+{
+	EnsureInit();
+	if (unit >= GL_STATE_TEXTURE_UNITS) {
+		s_this_frame.m_issued++;
+		glBindSampler(unit, sampler);
+		return;
+	}
+	if (Changed(s_shadow.samplers[unit], sampler)) glBindSampler(unit, sampler);
+}
+
+void GLState::BindBuffer(GLenum target, GLuint buffer)
+{
+	EnsureInit();
+	u32* shadow = nullptr;
+	switch (target) {
+	case GL_DRAW_INDIRECT_BUFFER: shadow = &s_shadow.buffers[BUFFER_DRAW_INDIRECT]; break;
+	case GL_PARAMETER_BUFFER: shadow = &s_shadow.buffers[BUFFER_PARAMETER]; break;
+	case GL_DISPATCH_INDIRECT_BUFFER: shadow = &s_shadow.buffers[BUFFER_DISPATCH_INDIRECT]; break;
+	default: s_this_frame.m_issued++; break;
+	}
+	if (shadow && !Changed(*shadow, buffer)) return;
+	glBindBuffer(target, buffer);
+}
+
+void GLState::BindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	EnsureInit();
+	u32* shadow = nullptr;
+	if (index < GL_STATE_BUFFER_BINDINGS) {
+		if (target == GL_UNIFORM_BUFFER) shadow = &s_shadow.uniform_buffers[index];
+		else if (target == GL_SHADER_STORAGE_BUFFER) shadow = &s_shadow.storage_buffers[index];
+	}
+	if (shadow && !Changed(*shadow, buffer)) return;
+	if (!shadow) s_this_frame.m_issued++;
+	glBindBufferBase(target, index, buffer);
+}
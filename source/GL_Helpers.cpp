@@ -1,6 +1,9 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include "GL_Helpers.h"
+#include "ShaderCache.h"
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <filesystem>
@@ -33,139 +36,40 @@ std::string ReadShaderText(const char* shader_text) {
 	return ss.str();
 }
 
-GLuint LoadShaders(ShaderText* shaders) {
+GLuint LoadShaders(ShaderText* shaders, const char* const* varyings, u32 varying_count, GLenum buffer_mode) {
 	if (shaders == nullptr) return 0;
 
-	GLuint program = glCreateProgram();
-
-	ShaderText* entry = shaders;
-	while (entry->type != GL_NONE) {
-		GLuint shader = glCreateShader(entry->type);
-		entry->shader = shader;
-
-		std::string source = ReadShaderText(entry->shader_text);
-		if (source.empty()) {
-			for (entry = shaders; entry->type != GL_NONE; ++entry) {
-				glDeleteShader(entry->shader);
-				entry->shader = 0;
-			}
-			return 0;
-		}
-
-		GLchar const* shader_source = source.c_str();
-		GLint const shader_length = static_cast<GLint>(source.size());
-
-		glShaderSource(shader, 1, &shader_source, &shader_length);
-		glCompileShader(shader);
-
-		GLint compiled;
-		glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
-		if (!compiled) {
-#ifdef _DEBUG
-			GLsizei len;
-			glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &len);
-
-			GLchar* log = new GLchar[len + 1];
-			glGetShaderInfoLog(shader, len, &len, log);
-			std::cerr << "Shader compilation failed: " << log << std::endl;
-			delete[] log;
-#endif //_DEBUG
-			return 0;
-		}
-
-		glAttachShader(program, shader);
-		++entry;
+	vector<GLenum> types;
+	vector<const char*> sources;
+	for (ShaderText* entry = shaders; entry->type != GL_NONE; ++entry) {
+		if (entry->shader_text == nullptr || entry->shader_text[0] == '\0') return 0;
+		types.push_back(entry->type);
+		sources.push_back(entry->shader_text);
 	}
 
-	glLinkProgram(program);
-
-	GLint linked;
-	glGetProgramiv(program, GL_LINK_STATUS, &linked);
-	if (!linked) {
-#ifdef _DEBUG
-		GLsizei len;
-		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &len);
-
-		GLchar* log = new GLchar[len + 1];
-		glGetProgramInfoLog(program, len, &len, log);
-		std::cerr << "Shader linking failed: " << log << std::endl;
-		delete[] log;
-#endif //_DEBUG
-
-		for (entry = shaders; entry->type != GL_NONE; ++entry) {
-			glDeleteShader(entry->shader);
-			entry->shader = 0;
-		}
-		return 0;
-	}
+	vector<GLuint> created(types.size());
+	GLuint program = ShaderCache::Load(types.data(), sources.data(), (u32)types.size(), created.data(), varyings, varying_count, buffer_mode);
+	for (usize i = 0; i < created.size(); ++i) shaders[i].shader = created[i];
 	return program;
 }
 
-GLuint LoadShaders(ShaderFiles* shaders) {
+GLuint LoadShaders(ShaderFiles* shaders, const char* const* varyings, u32 varying_count, GLenum buffer_mode) {
 	if (shaders == nullptr) return 0;
 
-	GLuint program = glCreateProgram();
-
-	ShaderFiles* entry = shaders;
-	while (entry->type != GL_NONE) {
-		GLuint shader = glCreateShader(entry->type);
-		entry->shader = shader;
-
-		std::string source = ReadShader(entry->filename);
-		if (source.empty()) {
-			for (entry = shaders; entry->type != GL_NONE; ++entry) {
-				glDeleteShader(entry->shader);
-				entry->shader = 0;
-			}
-			return 0;
-		}
-
-		GLchar const* shader_source = source.c_str();
-		GLint const shader_length = static_cast<GLint>(source.size());
-
-		glShaderSource(shader, 1, &shader_source, &shader_length);
-		glCompileShader(shader);
-
-		GLint compiled;
-		glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
-		if (!compiled) {
-#ifdef _DEBUG
-			GLsizei len;
-			glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &len);
-
-			GLchar* log = new GLchar[len + 1];
-			glGetShaderInfoLog(shader, len, &len, log);
-			std::cerr << "Shader compilation failed: " << log << std::endl;
-			delete[] log;
-#endif //_DEBUG
-			return 0;
-		}
-
-		glAttachShader(program, shader);
-		++entry;
+	vector<GLenum> types;
+	vector<std::string> text;
+	for (ShaderFiles* entry = shaders; entry->type != GL_NONE; ++entry) {
+		text.push_back(ReadShader(entry->filename));
+		if (text.back().empty()) return 0;
+		types.push_back(entry->type);
 	}
 
-	glLinkProgram(program);
-
-	GLint linked;
-	glGetProgramiv(program, GL_LINK_STATUS, &linked);
-	if (!linked) {
-#ifdef _DEBUG
-		GLsizei len;
-		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &len);
+	vector<const char*> sources;
+	for (const std::string& source : text) sources.push_back(source.c_str());
 
-		GLchar* log = new GLchar[len + 1];
-		glGetProgramInfoLog(program, len, &len, log);
-		std::cerr << "Shader linking failed: " << log << std::endl;
-		delete[] log;
-#endif //_DEBUG
-
-		for (entry = shaders; entry->type != GL_NONE; ++entry) {
-			glDeleteShader(entry->shader);
-			entry->shader = 0;
-		}
-		return 0;
-	}
+	vector<GLuint> created(types.size());
+	GLuint program = ShaderCache::Load(types.data(), sources.data(), (u32)types.size(), created.data(), varyings, varying_count, buffer_mode);
+	for (usize i = 0; i < created.size(); ++i) shaders[i].shader = created[i];
 	return program;
 }
 
@@ -357,3 +261,126 @@ void GetProgramLinkedStatus(GLuint program) {
 		delete[] log;
 	}
 }
+
+//-------------------------------------------------------------------------------------------------
+// FRAME RING BUFFER
+//-------------------------------------------------------------------------------------------------
+
+bool FrameRingBuffer::Init(usize frame_size, u32 frames)
+{
+	Destroy();
+	if (frames == 0 || frames > FRAME_RING_MAX_FRAMES) {
+		std::cerr << "FrameRingBuffer: " << frames << " frames requested, at most " << FRAME_RING_MAX_FRAMES << " are supported" << std::endl;
+		return false;
+	}
+
+	GLint uniform_alignment = 0, storage_alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniform_alignment);
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storage_alignment);
+	m_alignment = (usize)std::max(16, std::max(uniform_alignment, storage_alignment));
+
+	m_frame_size = (frame_size + m_alignment - 1) / m_alignment * m_alignment;
+	m_frames = frames;
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glCreateBuffers(1, &m_buffer);
+	glNamedBufferStorage(m_buffer, m_frame_size * m_frames, nullptr, flags);
+	m_mapped = (u8*)glMapNamedBufferRange(m_buffer, 0, m_frame_size * m_frames, flags);
+	if (!m_mapped) {
+		std::cerr << "FrameRingBuffer: unable to map " << m_frame_size * m_frames << " bytes" << std::endl;
+		Destroy();
+		return false;
+	}
+	return true;
+}
+
+void FrameRingBuffer::Destroy()
+{
+	for (u32 i = 0; i < FRAME_RING_MAX_FRAMES; ++i) {
+		if (m_fences[i]) glDeleteSync(m_fences[i]);
+		m_fences[i] = 0;
+	}
+	if (m_buffer) {
+		if (m_mapped) glUnmapNamedBuffer(m_buffer);
+		glDeleteBuffers(1, &m_buffer);
+	}
+	m_buffer = 0;
+	m_mapped = nullptr;
+	m_frame_size = 0;
+	m_frames = 0;
+	m_frame = 0;
+	m_head = 0;
+	m_in_frame = false;
+	m_stats = {};
+}
+
+void FrameRingBuffer::BeginFrame()
+{
+	if (m_in_frame) EndFrame();
+	m_frame = (m_frame + 1) % m_frames;
+	m_head = 0;
+	m_in_frame = true;
+	m_stats.m_frames++;
+	m_stats.m_last_stall_ms = 0.0;
+
+	GLsync fence = m_fences[m_frame];
+	if (!fence) return;
+
+	//Poll first, a signalled fence is the common case and costs no wait
+	GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (result == GL_TIMEOUT_EXPIRED) {
+		const f64 start = glfwGetTime();
+		while (result == GL_TIMEOUT_EXPIRED) {
+			result = glClientWaitSync(fence, 0, 1000000);
+		}
+		m_stats.m_last_stall_ms = (glfwGetTime() - start) * 1000.0;
+		m_stats.m_stall_ms += m_stats.m_last_stall_ms;
+		m_stats.m_stalls++;
+	}
+	glDeleteSync(fence);
+	m_fences[m_frame] = 0;
+}
+
+void FrameRingBuffer::EndFrame()
+{
+	if (!m_in_frame) return;
+	m_fences[m_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	m_stats.m_peak = std::max(m_stats.m_peak, m_head);
+	m_in_frame = false;
+}
+
+void* FrameRingBuffer::Allocate(usize size, usize* offset, usize alignment)
+{
+	if (!m_mapped) return nullptr;
+	if (!m_in_frame) BeginFrame();
+	if (alignment == 0) alignment = m_alignment;
+
+	const usize start = (m_head + alignment - 1) / alignment * alignment;
+	if (start + size > m_frame_size) {
+		m_stats.m_failed++;
+		return nullptr;
+	}
+	m_head = start + size;
+	*offset = (usize)m_frame * m_frame_size + start;
+	return m_mapped + *offset;
+}
+
+bool FrameRingBuffer::Upload(GLenum target, GLuint index, const void* data, usize size)
+{
+	usize offset;
+	void* dst = Allocate(size, &offset);
+	if (!dst) return false;
+	memcpy(dst, data, size);
+	BindRange(target, index, offset, size);
+	return true;
+}
+
+void FrameRingBuffer::BindRange(GLenum target, GLuint index, usize offset, usize size) const
+{
+	if (target == GL_DRAW_INDIRECT_BUFFER || target == GL_DISPATCH_INDIRECT_BUFFER || target == GL_PARAMETER_BUFFER_ARB) {
+		//Non indexed targets, commands take the offset as their indirect pointer
+		glBindBuffer(target, m_buffer);
+		return;
+	}
+	glBindBufferRange(target, index, m_buffer, (GLintptr)offset, (GLsizeiptr)size);
+}
@@ -0,0 +1,249 @@
+#include "GpuProfiler.h"
+
+#include "GL/glew.h"
+#include "imgui.h"
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+//Queries created at once when the pool runs dry
+#define QUERY_POOL_GROWTH 64
+
+struct GpuScopeRecord {
+	const char* name;
+	u32 depth;
+	i32 parent;
+	GLuint begin;
+	GLuint end;
+};
+
+//A frame whose queries have been issued but not read back yet
+struct GpuFrameRecord {
+	u64 frame;
+	GLuint first;		//Timestamps around the whole frame
+	GLuint last;
+	std::vector<GpuScopeRecord> scopes;
+};
+
+struct GpuProfilerState {
+	std::vector<GLuint> pool;			//Free queries
+	std::vector<GLuint> all;			//Every query created, for Shutdown
+	std::deque<GpuFrameRecord> pending;
+
+	GpuFrameRecord current;
+	bool recording = false;
+	std::vector<i32> stack;				//Open scopes of the current frame
+
+	std::deque<GpuFrameTimings> history;
+	u32 history_size = GPU_PROFILER_HISTORY;
+	GpuFrameTimings latest = {};
+	u64 frame = 0;
+	u64 latency = 0;
+	u64 skipped = 0;
+};
+
+static GpuProfilerState s_profiler;
+
+bool GpuProfiler::s_enabled = true;
+
+static GLuint AcquireQuery()
+{
+	if (s_profiler.pool.empty()) {
+		GLuint queries[QUERY_POOL_GROWTH];
+		glGenQueries(QUERY_POOL_GROWTH, queries);
+		s_profiler.pool.insert(s_profiler.pool.end(), queries, queries + QUERY_POOL_GROWTH);
+		s_profiler.all.insert(s_profiler.all.end(), queries, queries + QUERY_POOL_GROWTH);
+	}
+	GLuint query = s_profiler.pool.back();
+	s_profiler.pool.pop_back();
+	return query;
+}
+
+static GLuint Timestamp()
+{
+	GLuint query = AcquireQuery();
+	glQueryCounter(query, GL_TIMESTAMP);
+	return query;
+}
+
+static void ReleaseFrame(const GpuFrameRecord& record)
+{
+	s_profiler.pool.push_back(record.first);
+	s_profiler.pool.push_back(record.last);
+	for (const GpuScopeRecord& scope : record.scopes) {
+		s_profiler.pool.push_back(scope.begin);
+		s_profiler.pool.push_back(scope.end);
+	}
+}
+
+//Reads back every pending frame whose results are in, oldest first. Timestamps land in order,
+//so once a frame's last query is available all of its queries are
+static void Resolve()
+{
+	while (!s_profiler.pending.empty()) {
+		const GpuFrameRecord& record = s_profiler.pending.front();
+		GLint available = 0;
+		glGetQueryObjectiv(record.last, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) break;
+
+		GLuint64 first, last;
+		glGetQueryObjectui64v(record.first, GL_QUERY_RESULT, &first);
+		glGetQueryObjectui64v(record.last, GL_QUERY_RESULT, &last);
+
+		GpuFrameTimings timings;
+		timings.frame = record.frame;
+		timings.start_ns = first;
+		timings.ms = (f64)(last - first) * 1.0e-6;
+		timings.scopes.reserve(record.scopes.size());
+		for (const GpuScopeRecord& scope : record.scopes) {
+			GLuint64 begin, end;
+			glGetQueryObjectui64v(scope.begin, GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(scope.end, GL_QUERY_RESULT, &end);
+			timings.scopes.push_back({ scope.name, scope.depth, scope.parent, (f64)(begin - first) * 1.0e-6, (f64)(end - begin) * 1.0e-6 });
+		}
+
+		s_profiler.latency = s_profiler.frame - record.frame;
+		ReleaseFrame(record);
+		s_profiler.pending.pop_front();
+
+		s_profiler.latest = timings;
+		s_profiler.history.push_back(std::move(timings));
+		if (s_profiler.history.size() > s_profiler.history_size) s_profiler.history.pop_front();
+	}
+}
+
+void GpuProfiler::BeginFrame()
+{
+	s_profiler.frame++;
+	s_profiler.stack.clear();
+	s_profiler.recording = false;
+	if (!s_enabled) return;
+
+	Resolve();
+	if (s_profiler.pending.size() >= GPU_PROFILER_FRAMES) {
+		//The GPU is that far behind, skip this frame instead of waiting on it
+		s_profiler.skipped++;
+		return;
+	}
+
+	s_profiler.recording = true;
+	s_profiler.current.frame = s_profiler.frame;
+	s_profiler.current.scopes.clear();
+	s_profiler.current.first = Timestamp();
+}
+
+void GpuProfiler::EndFrame()
+{
+	if (!s_profiler.recording) return;
+	while (!s_profiler.stack.empty()) Pop();
+
+	s_profiler.current.last = Timestamp();
+	s_profiler.pending.push_back(s_profiler.current);
+	s_profiler.recording = false;
+}
+
+void GpuProfiler::Shutdown()
+{
+	if (!s_profiler.all.empty()) {
+		glDeleteQueries((GLsizei)s_profiler.all.size(), s_profiler.all.data());
+	}
+	s_profiler = GpuProfilerState();
+}
+
+void GpuProfiler::Push(const char* name)
+{
+	if (!s_profiler.recording) return;
+
+	GpuScopeRecord scope;
+	scope.name = name;
+	scope.depth = (u32)s_profiler.stack.size();
+	scope.parent = s_profiler.stack.empty() ? -1 : s_profiler.stack.back();
+	scope.begin = Timestamp();
+	scope.end = 0;
+	s_profiler.stack.push_back((i32)s_profiler.current.scopes.size());
+	s_profiler.current.scopes.push_back(scope);
+}
+
+void GpuProfiler::Pop()
+{
+	if (!s_profiler.recording || s_profiler.stack.empty()) return;
+	s_profiler.current.scopes[s_profiler.stack.back()].end = Timestamp();
+	s_profiler.stack.pop_back();
+}
+
+const GpuFrameTimings& GpuProfiler::Latest()
+{
+	return s_profiler.latest;
+}
+
+u64 GpuProfiler::Latency()
+{
+	return s_profiler.latency;
+}
+
+u64 GpuProfiler::Skipped()
+{
+	return s_profiler.skipped;
+}
+
+const std::deque<GpuFrameTimings>& GpuProfiler::History()
+{
+	return s_profiler.history;
+}
+
+void GpuProfiler::SetHistory(u32 frames)
+{
+	s_profiler.history_size = frames > 0 ? frames : 1;
+	while (s_profiler.history.size() > s_profiler.history_size) s_profiler.history.pop_front();
+}
+
+void GpuProfiler::Flush()
+{
+	if (s_profiler.pending.empty()) return;
+	glFinish();
+	Resolve();
+}
+
+void GpuProfiler::OnGui()
+{
+	const GpuFrameTimings& latest = s_profiler.latest;
+
+	ImGui::Begin("GPU Profiler");
+	ImGui::Checkbox("Enabled", &s_enabled);
+	ImGui::Text("Frame %llu: %.3f ms, %llu frames behind, %llu skipped", latest.frame, latest.ms, s_profiler.latency, s_profiler.skipped);
+	ImGui::Separator();
+	for (const GpuTiming& scope : latest.scopes) {
+		ImGui::Text("%*s%-*s %8.3f ms", (int)scope.depth * 2, "", 24 - (int)scope.depth * 2, scope.name, scope.ms);
+	}
+	if (ImGui::Button("Export trace")) {
+		Export("gpu_profile.json");
+	}
+	ImGui::End();
+}
+
+bool GpuProfiler::Export(const char* filename)
+{
+	std::ofstream file(filename);
+	if (!file.is_open()) {
+		std::cerr << "Unable to open file '" << filename << "'" << std::endl;
+		return false;
+	}
+
+	//Complete events in microseconds from the oldest frame, the viewer nests them by time
+	const u64 origin = s_profiler.history.empty() ? 0 : s_profiler.history.front().start_ns;
+	bool first = true;
+	file << std::fixed << std::setprecision(3);
+	file << "{\"traceEvents\":[";
+	for (const GpuFrameTimings& frame : s_profiler.history) {
+		const f64 frame_us = (f64)(frame.start_ns - origin) * 1.0e-3;
+		file << (first ? "\n" : ",\n");
+		file << "{\"name\":\"Frame " << frame.frame << "\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":" << frame_us << ",\"dur\":" << frame.ms * 1000.0 << "}";
+		first = false;
+		for (const GpuTiming& scope : frame.scopes) {
+			file << ",\n{\"name\":\"" << scope.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":" << frame_us + scope.start_ms * 1000.0 << ",\"dur\":" << scope.ms * 1000.0 << "}";
+		}
+	}
+	file << "\n]}\n";
+	return true;
+}
@@ -0,0 +1,142 @@
+#include "MappedFile.h"
+
+#include <iostream>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN 1
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif //_WIN32
+
+MappedFile::MappedFile()
+	:m_data(nullptr),
+	m_size(0),
+#ifdef _WIN32
+	m_file(INVALID_HANDLE_VALUE),
+	m_mapping(nullptr)
+#else
+	m_file(-1)
+#endif //_WIN32
+{}
+
+MappedFile::MappedFile(const char* filename)
+	:MappedFile()
+{
+	Open(filename);
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+	:MappedFile()
+{
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other) {
+		Close();
+		std::swap(m_data, other.m_data);
+		std::swap(m_size, other.m_size);
+		std::swap(m_file, other.m_file);
+#ifdef _WIN32
+		std::swap(m_mapping, other.m_mapping);
+#endif //_WIN32
+	}
+	return *this;
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+bool MappedFile::Open(const char* filename)
+{
+	Close();
+
+	m_file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (m_file == INVALID_HANDLE_VALUE) {
+		std::cerr << "Couldn't open file:" << filename << std::endl;
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0) {
+		Close();
+		return false;
+	}
+
+	m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_mapping == nullptr) {
+		std::cerr << "Couldn't map file:" << filename << std::endl;
+		Close();
+		return false;
+	}
+
+	m_data = static_cast<const unsigned char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (m_data == nullptr) {
+		std::cerr << "Couldn't map file:" << filename << std::endl;
+		Close();
+		return false;
+	}
+	m_size = static_cast<usize>(size.QuadPart);
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_data) UnmapViewOfFile(m_data);
+	if (m_mapping) CloseHandle(m_mapping);
+	if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+	m_data = nullptr;
+	m_size = 0;
+	m_mapping = nullptr;
+	m_file = INVALID_HANDLE_VALUE;
+}
+#else
+bool MappedFile::Open(const char* filename)
+{
+	Close();
+
+	m_file = open(filename, O_RDONLY);
+	if (m_file < 0) {
+		std::cerr << "Couldn't open file:" << filename << std::endl;
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(m_file, &info) != 0 || info.st_size == 0) {
+		Close();
+		return false;
+	}
+
+	void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, m_file, 0);
+	if (data == MAP_FAILED) {
+		std::cerr << "Couldn't map file:" << filename << std::endl;
+		Close();
+		return false;
+	}
+	madvise(data, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+
+	m_data = static_cast<const unsigned char*>(data);
+	m_size = static_cast<usize>(info.st_size);
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_data) munmap(const_cast<unsigned char*>(m_data), m_size);
+	if (m_file >= 0) close(m_file);
+	m_data = nullptr;
+	m_size = 0;
+	m_file = -1;
+}
+#endif //_WIN32
@@ -1,9 +1,13 @@
 #include "Mesh.h"
 #include "GL/glew.h"
-#include "OBJ_Loader.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "ObjParser.h"
 #include "glm/common.hpp"
 #include "glm/glm.hpp"
 #include "glm/gtc/type_ptr.hpp"
+#include <iostream>
+#include <vector>
 
 
 namespace SB {
@@ -15,127 +19,173 @@ namespace SB {
 	};
 }
 
-void ObjMesh::Load_OBJ(const char* filename) {
-	objl::Loader loader;
-	bool success = loader.LoadFile(filename);
-	if (success) {
-		int vert_count = loader.LoadedVertices.size();
-		m_count = loader.LoadedIndices.size();
+static const BakedAttribute obj_attributes[] = {
+	{ 0, 3, offsetof(SB::Vertex, Position) },
+	{ 1, 3, offsetof(SB::Vertex, Normal) },
+	{ 2, 2, offsetof(SB::Vertex, TextureCoordinate) },
+	{ 3, 3, offsetof(SB::Vertex, Tangent) },
+};
 
-		glCreateVertexArrays(1, &m_vao);
+static const BakedLayout obj_layout = { "obj", sizeof(float) * 8, obj_attributes, 3 };
+static const BakedLayout obj_tangent_layout = { "tan", sizeof(SB::Vertex), obj_attributes, 4 };
 
-		glCreateBuffers(1, &m_vertex_buffer);
-		glNamedBufferStorage(m_vertex_buffer, vert_count * sizeof(objl::Vertex), &loader.LoadedVertices[0], 0);
+static inline const BakedLayout& BakeLayout(bool tangents) { return tangents ? obj_tangent_layout : obj_layout; }
 
-		glCreateBuffers(1, &m_index_buffer);
-		glNamedBufferStorage(m_index_buffer, loader.LoadedIndices.size() * sizeof(GLuint), &loader.LoadedIndices[0], 0);
+static bool Open_Baked_OBJ(const char* filename, BakedMesh& baked, bool tangents) {
+	return baked.OpenSingle(filename, BakeLayout(tangents), 0);
+}
 
-		glVertexArrayAttribBinding(m_vao, 0, 0);
-		glVertexArrayAttribFormat(m_vao, 0, 3, GL_FLOAT, GL_FALSE, offsetof(objl::Vertex, Position));
-		glEnableVertexArrayAttrib(m_vao, 0);
+//Parses the source text and bakes the result for the next run
+static bool Import_OBJ(const char* filename, ObjMeshData& data, bool tangents);
 
-		glVertexArrayAttribBinding(m_vao, 1, 0);
-		glVertexArrayAttribFormat(m_vao, 1, 3, GL_FLOAT, GL_FALSE, offsetof(objl::Vertex, Normal));
-		glEnableVertexArrayAttrib(m_vao, 1);
+bool Parse_OBJ(const char* filename, ObjMeshData& data, bool tangents) {
+	BakedMesh baked;
+	if (!Open_Baked_OBJ(filename, baked, tangents)) {
+		return Import_OBJ(filename, data, tangents);
+	}
 
-		glVertexArrayAttribBinding(m_vao, 2, 0);
-		glVertexArrayAttribFormat(m_vao, 2, 2, GL_FLOAT, GL_FALSE, offsetof(objl::Vertex, TextureCoordinate));
-		glEnableVertexArrayAttrib(m_vao, 2);
+	const BakedPart& part = baked.Part(0);
+	data.m_tangents = tangents;
+	data.m_vertices.assign(baked.Vertices(0), baked.Vertices(0) + (usize)part.m_vertex_count * part.m_stride / sizeof(float));
+	data.m_indices.assign(baked.Indices(0), baked.Indices(0) + part.m_index_count);
+	return true;
+}
 
-		glVertexArrayVertexBuffer(m_vao, 0, m_vertex_buffer, 0, sizeof(objl::Vertex));
-		glVertexArrayElementBuffer(m_vao, m_index_buffer);
+static bool Import_OBJ(const char* filename, ObjMeshData& data, bool tangents) {
+	if (!Parse_OBJ_Source(filename, data, tangents)) {
+		return false;
+	}
 
-		glBindVertexArray(0);
+	BakedMesh::WriteSingle(filename, BakeLayout(tangents), 0, data.m_vertices, data.m_indices);
+	return true;
+}
+
+bool Parse_OBJ_Source(const char* filename, ObjMeshData& data, bool tangents) {
+	MappedFile file;
+	if (!file.Open(filename)) {
+		return false;
 	}
-	else {
-		std::cout << "Failed to load mesh: " << filename << std::endl;
+	if (!Parse_OBJ_Buffer((const char*)file.Data(), file.Size(), data)) {
+		return false;
+	}
+	if (!tangents) {
+		return true;
 	}
-}
 
-void ObjMesh::Load_OBJ_Tan(const char* filename) {
-	objl::Loader loader;
-	bool success = loader.LoadFile(filename);
-	if (success) {
-		int vert_count = loader.LoadedVertices.size();
-		m_count = loader.LoadedIndices.size();
-
-		std::vector<SB::Vertex> vertices;
-
-		for (size_t i = 0; i < m_count; i += 3) {
-			objl::Vertex& v0 = loader.LoadedVertices[loader.LoadedIndices[i]];
-			objl::Vertex& v1 = loader.LoadedVertices[loader.LoadedIndices[i + 1]];
-			objl::Vertex& v2 = loader.LoadedVertices[loader.LoadedIndices[i + 2]];
-
-			glm::vec3 edge1 = glm::vec3(v1.Position.X, v1.Position.Y, v1.Position.Z) - glm::vec3(v0.Position.X, v0.Position.Y, v0.Position.Z);
-			glm::vec3 edge2 = glm::vec3(v2.Position.X, v2.Position.Y, v2.Position.Z) - glm::vec3(v0.Position.X, v0.Position.Y, v0.Position.Z);
-			glm::vec2 deltaUV1 = glm::vec2(v1.TextureCoordinate.X, v1.TextureCoordinate.Y) - glm::vec2(v0.TextureCoordinate.X, v0.TextureCoordinate.Y);
-			glm::vec2 deltaUV2 = glm::vec2(v2.TextureCoordinate.X, v2.TextureCoordinate.Y) - glm::vec2(v0.TextureCoordinate.X, v0.TextureCoordinate.Y);
-
-			float f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
-
-			glm::vec3 tangent;
-			tangent.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
-			tangent.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
-			tangent.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
-			tangent = glm::normalize(tangent);
-
-			SB::Vertex v00 = { glm::vec3(v0.Position.X, v0.Position.Y, v0.Position.Z), glm::vec3(v0.Normal.X, v0.Normal.Y, v0.Normal.Z), glm::vec2(v0.TextureCoordinate.X, v0.TextureCoordinate.Y), tangent };
-			SB::Vertex v01 = { glm::vec3(v1.Position.X, v1.Position.Y, v1.Position.Z), glm::vec3(v1.Normal.X, v1.Normal.Y, v1.Normal.Z), glm::vec2(v1.TextureCoordinate.X, v1.TextureCoordinate.Y), tangent };
-			SB::Vertex v02 = { glm::vec3(v2.Position.X, v2.Position.Y, v2.Position.Z), glm::vec3(v2.Normal.X, v2.Normal.Y, v2.Normal.Z), glm::vec2(v2.TextureCoordinate.X, v2.TextureCoordinate.Y), tangent };
-
-			/*v0.Tangent += tangent;
-			v1.Tangent += tangent;
-			v2.Tangent += tangent;*/
-
-			vertices.push_back(v00);
-			vertices.push_back(v01);
-			vertices.push_back(v02);
-		}
+	//Widen to SB::Vertex and accumulate per-triangle tangents onto the shared vertices
+	const usize count = data.m_vertices.size() / 8;
+	std::vector<SB::Vertex> vertices(count);
+	for (usize i = 0; i < count; ++i) {
+		const float* v = &data.m_vertices[i * 8];
+		vertices[i] = { glm::vec3(v[0], v[1], v[2]), glm::vec3(v[3], v[4], v[5]), glm::vec2(v[6], v[7]), glm::vec3(0.0f) };
+	}
 
-		glCreateVertexArrays(1, &m_vao);
+	for (usize i = 0; i + 2 < data.m_indices.size(); i += 3) {
+		SB::Vertex& v0 = vertices[data.m_indices[i]];
+		SB::Vertex& v1 = vertices[data.m_indices[i + 1]];
+		SB::Vertex& v2 = vertices[data.m_indices[i + 2]];
 
-		glCreateBuffers(1, &m_vertex_buffer);
-		glNamedBufferStorage(m_vertex_buffer, vert_count * sizeof(SB::Vertex), &vertices[0], 0);
+		glm::vec3 edge1 = v1.Position - v0.Position;
+		glm::vec3 edge2 = v2.Position - v0.Position;
+		glm::vec2 deltaUV1 = v1.TextureCoordinate - v0.TextureCoordinate;
+		glm::vec2 deltaUV2 = v2.TextureCoordinate - v0.TextureCoordinate;
 
-		glCreateBuffers(1, &m_index_buffer);
-		glNamedBufferStorage(m_index_buffer, loader.LoadedIndices.size() * sizeof(GLuint), &loader.LoadedIndices[0], 0);
+		float det = deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y;
+		if (det == 0.0f) continue;
+		float f = 1.0f / det;
 
-		glVertexArrayAttribBinding(m_vao, 0, 0);
-		glVertexArrayAttribFormat(m_vao, 0, 3, GL_FLOAT, GL_FALSE, offsetof(SB::Vertex, Position));
-		glEnableVertexArrayAttrib(m_vao, 0);
+		glm::vec3 tangent = f * (deltaUV2.y * edge1 - deltaUV1.y * edge2);
+		v0.Tangent += tangent;
+		v1.Tangent += tangent;
+		v2.Tangent += tangent;
+	}
+
+	//Gram-Schmidt against the normal, anything degenerate gets an arbitrary perpendicular
+	for (SB::Vertex& v : vertices) {
+		glm::vec3 tangent = v.Tangent - v.Normal * glm::dot(v.Normal, v.Tangent);
+		float length = glm::length(tangent);
+		if (length > 1e-6f) {
+			v.Tangent = tangent / length;
+		}
+		else {
+			glm::vec3 axis = fabsf(v.Normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+			v.Tangent = glm::normalize(glm::cross(v.Normal, axis));
+		}
+	}
 
-		glVertexArrayAttribBinding(m_vao, 1, 0);
-		glVertexArrayAttribFormat(m_vao, 1, 3, GL_FLOAT, GL_FALSE, offsetof(SB::Vertex, Normal));
-		glEnableVertexArrayAttrib(m_vao, 1);
+	data.m_tangents = true;
+	data.m_vertices.resize(count * (sizeof(SB::Vertex) / sizeof(float)));
+	memcpy(data.m_vertices.data(), vertices.data(), count * sizeof(SB::Vertex));
+	return true;
+}
 
-		glVertexArrayAttribBinding(m_vao, 2, 0);
-		glVertexArrayAttribFormat(m_vao, 2, 2, GL_FLOAT, GL_FALSE, offsetof(SB::Vertex, TextureCoordinate));
-		glEnableVertexArrayAttrib(m_vao, 2);
+void ObjMesh::Load_OBJ(const char* filename) {
+	//Warm start, the bake goes from the mapping straight into buffer storage
+	BakedMesh baked;
+	if (Open_Baked_OBJ(filename, baked, false)) {
+		Upload_Baked(baked);
+		return;
+	}
 
-		glVertexArrayAttribBinding(m_vao, 3, 0);
-		glVertexArrayAttribFormat(m_vao, 3, 3, GL_FLOAT, GL_FALSE, offsetof(SB::Vertex, Tangent));
-		glEnableVertexArrayAttrib(m_vao, 3);
+	ObjMeshData data;
+	if (Import_OBJ(filename, data, false)) {
+		Upload(data);
+	}
+	else {
+		std::cout << "Failed to load mesh: " << filename << std::endl;
+	}
+}
 
-		glVertexArrayVertexBuffer(m_vao, 0, m_vertex_buffer, 0, sizeof(SB::Vertex));
-		glVertexArrayElementBuffer(m_vao, m_index_buffer);
+void ObjMesh::Load_OBJ_Tan(const char* filename) {
+	BakedMesh baked;
+	if (Open_Baked_OBJ(filename, baked, true)) {
+		Upload_Baked(baked);
+		return;
+	}
 
-		glBindVertexArray(0);
+	ObjMeshData data;
+	if (Import_OBJ(filename, data, true)) {
+		Upload(data);
 	}
 	else {
 		std::cout << "Failed to load mesh: " << filename << std::endl;
 	}
 }
 
+void ObjMesh::Upload(const ObjMeshData& data) {
+	if (data.m_vertices.empty() || data.m_indices.empty()) return;
+
+	const BakedLayout& layout = BakeLayout(data.m_tangents);
+	BakedBuffers buffers = Upload_Interleaved(data.m_vertices.data(), (u32)(data.m_vertices.size() * sizeof(float) / layout.m_stride), layout.m_stride,
+		layout.m_attributes, layout.m_attribute_count, data.m_indices.data(), (u32)data.m_indices.size());
+
+	m_vao = buffers.m_vao;
+	m_vertex_buffer = buffers.m_vertex_buffer;
+	m_index_buffer = buffers.m_index_buffer;
+	m_count = buffers.m_count;
+}
+
+void ObjMesh::Upload_Baked(const BakedMesh& baked) {
+	BakedBuffers buffers = baked.Upload(0);
+
+	m_vao = buffers.m_vao;
+	m_vertex_buffer = buffers.m_vertex_buffer;
+	m_index_buffer = buffers.m_index_buffer;
+	m_count = buffers.m_count;
+}
+
 void ObjMesh::OnUpdate(f64 dt) {
 
 }
 
 void ObjMesh::OnDraw() {
+	if (m_count == 0) return;
 	glBindVertexArray(m_vao);
 	glDrawElements(GL_TRIANGLES, m_count, GL_UNSIGNED_INT, (void*)0);
 }
 
 void ObjMesh::OnDraw(int instances) {
+	if (m_count == 0) return;
 	glBindVertexArray(m_vao);
 	glDrawElementsInstanced(GL_TRIANGLES, m_count, GL_UNSIGNED_INT, (void*)0, instances);
 }
\ No newline at end of file
@@ -0,0 +1,312 @@
+#include "MeshCache.h"
+
+#include "GL/glew.h"
+#include <atomic>
+#include <cfloat>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+static const char baked_magic[4] = { 'S', 'B', 'M', 'B' };
+
+static const BakedAttribute tangent_frame_attributes[] = {
+	{ 0, 3, 0 }, { 1, 3, sizeof(float) * 3 }, { 2, 3, sizeof(float) * 6 }, { 3, 3, sizeof(float) * 9 }, { 4, 2, sizeof(float) * 12 }
+};
+const BakedLayout tangent_frame_layout = { "assimp", sizeof(float) * TANGENT_FRAME_FLOATS, tangent_frame_attributes, 5 };
+
+static std::string BakedPath(const char* source, const char* tag)
+{
+	std::string path = source;
+	path += '.';
+	path += tag;
+	path += ".sbmesh";
+	return path;
+}
+
+//Size and last write time, the cheap check that runs before any hashing
+static bool SourceStamp(const char* source, u64* size, i64* time)
+{
+	std::error_code error;
+	*size = std::filesystem::file_size(source, error);
+	if (error) return false;
+	*time = std::filesystem::last_write_time(source, error).time_since_epoch().count();
+	return !error;
+}
+
+//Best effort, fails while another reader has the bake mapped and the next open tries again
+static bool Restamp(const std::string& path, i64 source_time)
+{
+	std::fstream file(path, std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+	if (!file.is_open()) return false;
+	file.seekp(offsetof(BakedMeshHeader, m_source_time));
+	file.write((const char*)&source_time, sizeof(source_time));
+	return file.good();
+}
+
+static inline u64 AlignUp(u64 value, u64 alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static inline u64 Rotl(u64 x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline u64 Mix(u64 h)
+{
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDull;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+//Word at a time multiply-rotate hash, only used to spot changed sources so it doesn't need to be
+//cryptographic, just fast enough that hashing a few MB stays well under a millisecond
+u64 BakedMesh::Hash(const void* data, usize size, u64 seed)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	u64 h = seed ^ (size * 0x9E3779B97F4A7C15ull);
+
+	usize words = size / 8;
+	for (usize i = 0; i < words; ++i, p += 8) {
+		u64 k;
+		memcpy(&k, p, 8);
+		k *= 0x87C37B91114253D5ull;
+		k = Rotl(k, 31);
+		k *= 0x4CF5AD432745937Full;
+		h ^= k;
+		h = Rotl(h, 27) * 5 + 0x52DCE729;
+	}
+
+	u64 tail = 0;
+	memcpy(&tail, p, size & 7);
+	h ^= tail * 0x87C37B91114253D5ull;
+
+	return Mix(h);
+}
+
+u64 BakedMesh::Key(u32 flags, u64 extra_key)
+{
+	return Mix((((u64)BAKED_MESH_VERSION << 32) | flags) ^ Mix(extra_key));
+}
+
+u64 BakedMesh::SourceHash(const char* source)
+{
+	MappedFile file;
+	if (!file.Open(source)) return 0;
+	return Hash(file.Data(), file.Size(), BAKED_MESH_VERSION);
+}
+
+bool BakedMesh::Open(const char* source, const char* tag, u32 flags, u64 extra_key)
+{
+	m_header = nullptr;
+	m_parts = nullptr;
+
+	u64 source_size;
+	i64 source_time;
+	if (!SourceStamp(source, &source_size, &source_time)) return false;
+
+	std::string path = BakedPath(source, tag);
+	if (!std::filesystem::exists(path)) return false;
+
+	//A second pass only follows a restamp
+	for (int pass = 0; pass < 2; ++pass) {
+		if (!m_file.Open(path.c_str())) return false;
+
+		const usize size = m_file.Size();
+		const BakedMeshHeader* header = (const BakedMeshHeader*)m_file.Data();
+		if (size < sizeof(BakedMeshHeader) ||
+			memcmp(header->m_magic, baked_magic, 4) != 0 ||
+			header->m_version != BAKED_MESH_VERSION ||
+			header->m_key != Key(flags, extra_key) ||
+			header->m_source_size != source_size ||
+			sizeof(BakedMeshHeader) + (u64)header->m_part_count * sizeof(BakedPart) > size) {
+			m_file.Close();
+			return false;
+		}
+		//Same size but written since the bake, a checkout or copy can do that without changing it.
+		//Its new time goes into the header so later opens skip the hash again. The mapping holds
+		//the file read only, so it's closed for the write and mapped again
+		if (header->m_source_time != source_time) {
+			if (header->m_source_hash != SourceHash(source)) {
+				m_file.Close();
+				return false;
+			}
+			if (pass == 0) {
+				m_file.Close();
+				Restamp(path, source_time);
+				continue;
+			}
+		}
+
+		//Make sure every part lies inside the file before handing out pointers into it
+		const BakedPart* parts = (const BakedPart*)(m_file.Data() + sizeof(BakedMeshHeader));
+		for (u32 i = 0; i < header->m_part_count; ++i) {
+			const BakedPart& part = parts[i];
+			if (part.m_attribute_count > BAKED_MESH_MAX_ATTRIBUTES ||
+				part.m_vertex_offset + (u64)part.m_vertex_count * part.m_stride > size ||
+				part.m_index_offset + (u64)part.m_index_count * sizeof(u32) > size) {
+				m_file.Close();
+				return false;
+			}
+		}
+
+		m_header = header;
+		m_parts = parts;
+		return true;
+	}
+	return false;
+}
+
+bool BakedMesh::Write(const char* source, const char* tag, u32 flags, const BakedPartDesc* descs, u32 part_count, u64 extra_key)
+{
+	BakedMeshHeader header = {};
+	memcpy(header.m_magic, baked_magic, 4);
+	header.m_version = BAKED_MESH_VERSION;
+	header.m_key = Key(flags, extra_key);
+	header.m_part_count = part_count;
+	if (!SourceStamp(source, &header.m_source_size, &header.m_source_time)) return false;
+	header.m_source_hash = SourceHash(source);
+
+	std::vector<BakedPart> parts(part_count);
+	u64 offset = AlignUp(sizeof(BakedMeshHeader) + sizeof(BakedPart) * part_count, 16);
+	for (u32 i = 0; i < part_count; ++i) {
+		const BakedPartDesc& desc = descs[i];
+		BakedPart& part = parts[i];
+		memset(&part, 0, sizeof(part));
+		if (desc.m_attribute_count > BAKED_MESH_MAX_ATTRIBUTES) return false;
+
+		part.m_stride = desc.m_stride;
+		part.m_attribute_count = desc.m_attribute_count;
+		memcpy(part.m_attributes, desc.m_attributes, sizeof(BakedAttribute) * desc.m_attribute_count);
+		part.m_vertex_count = desc.m_vertex_count;
+		part.m_index_count = desc.m_index_count;
+
+		//Bounds from the position, attribute location 0 by convention
+		const u32 floats = desc.m_stride / sizeof(float);
+		for (int k = 0; k < 3; ++k) {
+			part.m_bounds_min[k] = desc.m_vertex_count ? FLT_MAX : 0.0f;
+			part.m_bounds_max[k] = desc.m_vertex_count ? -FLT_MAX : 0.0f;
+		}
+		for (u32 v = 0; v < desc.m_vertex_count; ++v) {
+			const float* position = desc.m_vertices + v * floats;
+			for (int k = 0; k < 3; ++k) {
+				if (position[k] < part.m_bounds_min[k]) part.m_bounds_min[k] = position[k];
+				if (position[k] > part.m_bounds_max[k]) part.m_bounds_max[k] = position[k];
+			}
+		}
+
+		part.m_vertex_offset = offset;
+		offset = AlignUp(offset + (u64)desc.m_vertex_count * desc.m_stride, 16);
+		part.m_index_offset = offset;
+		offset = AlignUp(offset + (u64)desc.m_index_count * sizeof(u32), 16);
+	}
+
+	//Write to a temporary and rename so a reader never maps a half written bake. Loads of the same
+	//source can bake at once, so every write gets a temporary of its own
+	static std::atomic<u32> writes = 0;
+	std::string path = BakedPath(source, tag);
+	std::string temp = path + '.' + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + '.' + std::to_string(writes++) + ".tmp";
+	{
+		std::ofstream ofs(temp, std::ios_base::binary | std::ios_base::trunc);
+		if (!ofs.is_open()) {
+			std::cerr << "Couldn't write baked mesh:" << path << std::endl;
+			return false;
+		}
+
+		static const char padding[16] = {};
+		u64 written = 0;
+		auto put = [&](const void* data, u64 size) {
+			ofs.write((const char*)data, size);
+			written += size;
+		};
+		auto pad = [&](u64 to) {
+			put(padding, to - written);
+		};
+
+		put(&header, sizeof(header));
+		put(parts.data(), sizeof(BakedPart) * part_count);
+		for (u32 i = 0; i < part_count; ++i) {
+			pad(parts[i].m_vertex_offset);
+			put(descs[i].m_vertices, (u64)descs[i].m_vertex_count * descs[i].m_stride);
+			pad(parts[i].m_index_offset);
+			put(descs[i].m_indices, (u64)descs[i].m_index_count * sizeof(u32));
+		}
+		if (!ofs.good()) {
+			ofs.close();
+			std::filesystem::remove(temp);
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temp, path, error);
+	if (error) {
+		std::filesystem::remove(temp, error);
+		return false;
+	}
+	return true;
+}
+
+bool BakedMesh::OpenSingle(const char* source, const BakedLayout& layout, u32 flags)
+{
+	if (!Open(source, layout.m_tag, flags)) return false;
+	if (PartCount() == 1 && m_parts[0].m_stride == layout.m_stride) return true;
+	m_file.Close();
+	m_header = nullptr;
+	m_parts = nullptr;
+	return false;
+}
+
+bool BakedMesh::WriteSingle(const char* source, const BakedLayout& layout, u32 flags, const std::vector<float>& vertices, const std::vector<u32>& indices)
+{
+	BakedPartDesc desc;
+	desc.m_vertices = vertices.data();
+	desc.m_stride = layout.m_stride;
+	desc.m_vertex_count = (u32)(vertices.size() * sizeof(float) / layout.m_stride);
+	desc.m_attributes = layout.m_attributes;
+	desc.m_attribute_count = layout.m_attribute_count;
+	desc.m_indices = indices.data();
+	desc.m_index_count = (u32)indices.size();
+	return Write(source, layout.m_tag, flags, &desc, 1);
+}
+
+BakedBuffers BakedMesh::Upload(u32 index) const
+{
+	const BakedPart& part = m_parts[index];
+	return Upload_Interleaved(Vertices(index), part.m_vertex_count, part.m_stride, part.m_attributes, part.m_attribute_count, Indices(index), part.m_index_count);
+}
+
+BakedBuffers Upload_Interleaved(const float* vertices, u32 vertex_count, u32 stride, const BakedAttribute* attributes, u32 attribute_count, const u32* indices, u32 index_count)
+{
+	BakedBuffers result = {};
+	if (vertex_count == 0 || index_count == 0) return result;
+
+	glCreateVertexArrays(1, &result.m_vao);
+
+	glCreateBuffers(1, &result.m_vertex_buffer);
+	glNamedBufferStorage(result.m_vertex_buffer, (GLsizeiptr)vertex_count * stride, vertices, 0);
+
+	glCreateBuffers(1, &result.m_index_buffer);
+	glNamedBufferStorage(result.m_index_buffer, (GLsizeiptr)index_count * sizeof(u32), indices, 0);
+
+	for (u32 i = 0; i < attribute_count; ++i) {
+		const BakedAttribute& attribute = attributes[i];
+		glVertexArrayAttribBinding(result.m_vao, attribute.m_location, 0);
+		glVertexArrayAttribFormat(result.m_vao, attribute.m_location, attribute.m_components, GL_FLOAT, GL_FALSE, attribute.m_offset);
+		glEnableVertexArrayAttrib(result.m_vao, attribute.m_location);
+	}
+
+	glVertexArrayVertexBuffer(result.m_vao, 0, result.m_vertex_buffer, 0, stride);
+	glVertexArrayElementBuffer(result.m_vao, result.m_index_buffer);
+
+	result.m_count = index_count;
+	return result;
+}
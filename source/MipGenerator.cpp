@@ -0,0 +1,418 @@
+#include "MipGenerator.h"
+
+#include <cmath>
+#include <omp.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MIP_X86 1
+#include <immintrin.h>
+#endif //x86
+
+//Widest filter, the Kaiser one
+#define MIP_MAX_TAPS 8
+//Clamped texels either side of an expanded row, enough for the widest filter to read past both edges
+#define MIP_PAD_LEFT 3
+#define MIP_PAD_RIGHT 4
+//Levels smaller than this aren't worth waking the threads for
+#define MIP_PARALLEL_TEXELS 16384
+
+u32 MipLevelCount(u32 width, u32 height, u32 depth)
+{
+	u32 size = width > height ? width : height;
+	size = size > depth ? size : depth;
+	u32 levels = 1;
+	while (size > 1) {
+		size >>= 1;
+		levels++;
+	}
+	return levels;
+}
+
+//-------------------------------------------------------------------------------------------------
+// FILTERS
+//-------------------------------------------------------------------------------------------------
+
+//Destination texel x of a 2:1 reduction reads source texels 2x + m_offset onwards, the same
+//weights are used across and down
+struct MipTaps {
+	u32 m_count;
+	i32 m_offset;
+	f32 m_weights[MIP_MAX_TAPS];
+	//Two destination texels per AVX vector, entry j weighs source texel 2x + j for the low one
+	//and 2x + j - 1 for the high one
+	alignas(32) f32 m_pairs[MIP_MAX_TAPS + 1][8];
+};
+
+//Modified Bessel function of the first kind, order 0
+static f64 BesselI0(f64 x)
+{
+	f64 sum = 1.0;
+	f64 term = 1.0;
+	for (u32 k = 1; k < 32; ++k) {
+		term *= (x * 0.5) / k;
+		sum += term * term;
+	}
+	return sum;
+}
+
+static MipTaps MakeTaps(MipFilter filter)
+{
+	MipTaps taps = {};
+	if (filter == MipFilter::Box) {
+		taps.m_count = 2;
+		taps.m_offset = 0;
+		taps.m_weights[0] = 0.5f;
+		taps.m_weights[1] = 0.5f;
+	}
+	else {
+		//sinc at half the source rate, windowed over 4 source texels each side
+		const f64 pi = 3.14159265358979323846;
+		const f64 alpha = 4.0;
+		taps.m_count = 8;
+		taps.m_offset = -3;
+		f64 weights[8];
+		f64 total = 0.0;
+		for (u32 k = 0; k < 8; ++k) {
+			const f64 distance = k - 3.5;
+			const f64 t = distance * 0.5;
+			const f64 sinc = sin(pi * t) / (pi * t);
+			const f64 window = t / 2.0;
+			weights[k] = sinc * BesselI0(alpha * sqrt(1.0 - window * window)) / BesselI0(alpha);
+			total += weights[k];
+		}
+		for (u32 k = 0; k < 8; ++k) taps.m_weights[k] = (f32)(weights[k] / total);
+	}
+
+	for (u32 j = 0; j <= taps.m_count; ++j) {
+		for (u32 c = 0; c < 4; ++c) {
+			taps.m_pairs[j][c] = j < taps.m_count ? taps.m_weights[j] : 0.0f;
+			taps.m_pairs[j][c + 4] = j > 0 ? taps.m_weights[j - 1] : 0.0f;
+		}
+	}
+	return taps;
+}
+
+//-------------------------------------------------------------------------------------------------
+// CONVERSION
+//-------------------------------------------------------------------------------------------------
+
+//Rows are filtered as RGBA floats whatever the source holds
+struct MipTables {
+	f32 m_unorm[256];
+	f32 m_snorm[256];
+	f32 m_srgb_to_linear[256];
+	u8 m_linear_to_srgb[4096];
+};
+
+static MipTables MakeTables()
+{
+	MipTables tables;
+	for (u32 i = 0; i < 256; ++i) {
+		const f32 value = i / 255.0f;
+		tables.m_unorm[i] = value;
+		tables.m_snorm[i] = value * 2.0f - 1.0f;
+		tables.m_srgb_to_linear[i] = value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+	}
+	for (u32 i = 0; i < 4096; ++i) {
+		const f32 value = i / 4095.0f;
+		const f32 srgb = value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+		tables.m_linear_to_srgb[i] = (u8)(srgb * 255.0f + 0.5f);
+	}
+	return tables;
+}
+
+static const MipTables& Tables()
+{
+	static const MipTables tables = MakeTables();
+	return tables;
+}
+
+static u8 PackUnorm(f32 value)
+{
+	value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+	return (u8)(value * 255.0f + 0.5f);
+}
+
+//Expands width texels into padded RGBA floats, the padding repeats the edge texels
+static void ExpandRow(const u8* src, u32 width, u32 channels, MipContent content, f32* padded)
+{
+	const MipTables& tables = Tables();
+	//sRGB covers the color channels, a fourth channel is alpha
+	const u32 srgb_channels = content == MipContent::SRGB ? (channels < 3 ? channels : 3) : 0;
+	const f32* values = content == MipContent::NormalMap ? tables.m_snorm : tables.m_unorm;
+
+	f32* dst = padded + MIP_PAD_LEFT * 4;
+	for (u32 x = 0; x < width; ++x, src += channels, dst += 4) {
+		dst[0] = dst[1] = dst[2] = dst[3] = 0.0f;
+		for (u32 c = 0; c < channels; ++c) {
+			dst[c] = c < srgb_channels ? tables.m_srgb_to_linear[src[c]] : values[src[c]];
+		}
+		if (content == MipContent::NormalMap && channels == 2) {
+			const f32 z = 1.0f - dst[0] * dst[0] - dst[1] * dst[1];
+			dst[2] = z > 0.0f ? sqrtf(z) : 0.0f;
+		}
+	}
+
+	const f32* first = padded + MIP_PAD_LEFT * 4;
+	const f32* last = padded + (MIP_PAD_LEFT + width - 1) * 4;
+	for (u32 x = 0; x < MIP_PAD_LEFT; ++x) {
+		for (u32 c = 0; c < 4; ++c) padded[x * 4 + c] = first[c];
+	}
+	for (u32 x = 0; x < MIP_PAD_RIGHT; ++x) {
+		for (u32 c = 0; c < 4; ++c) padded[(MIP_PAD_LEFT + width + x) * 4 + c] = last[c];
+	}
+}
+
+static void PackRow(const f32* src, u32 width, u32 channels, MipContent content, u8* dst)
+{
+	const MipTables& tables = Tables();
+	const u32 srgb_channels = content == MipContent::SRGB ? (channels < 3 ? channels : 3) : 0;
+	for (u32 x = 0; x < width; ++x, src += 4, dst += channels) {
+		if (content == MipContent::NormalMap) {
+			const f32 length = sqrtf(src[0] * src[0] + src[1] * src[1] + src[2] * src[2]);
+			const f32 scale = length > 0.0f ? 0.5f / length : 0.0f;
+			for (u32 c = 0; c < channels; ++c) {
+				dst[c] = PackUnorm(c < 3 ? src[c] * scale + 0.5f : src[c] * 0.5f + 0.5f);
+			}
+			continue;
+		}
+		for (u32 c = 0; c < channels; ++c) {
+			if (c < srgb_channels) {
+				const f32 value = src[c] < 0.0f ? 0.0f : (src[c] > 1.0f ? 1.0f : src[c]);
+				dst[c] = tables.m_linear_to_srgb[(u32)(value * 4095.0f + 0.5f)];
+			}
+			else {
+				dst[c] = PackUnorm(src[c]);
+			}
+		}
+	}
+}
+
+//-------------------------------------------------------------------------------------------------
+// FILTER KERNELS
+//-------------------------------------------------------------------------------------------------
+
+//Reduce reads a padded row and writes dst_width RGBA texels. Blend weighs one float of each
+//row by the taps, floats is a multiple of 4
+typedef void (*MipReduceFn)(const f32* padded, u32 dst_width, const MipTaps& taps, f32* dst);
+typedef void (*MipBlendFn)(const f32* const* rows, u32 floats, const MipTaps& taps, f32* dst);
+
+static void ReduceScalar(const f32* padded, u32 dst_width, const MipTaps& taps, f32* dst)
+{
+	const f32* base = padded + (MIP_PAD_LEFT + taps.m_offset) * 4;
+	for (u32 x = 0; x < dst_width; ++x, dst += 4) {
+		const f32* texel = base + x * 8;
+		f32 sum[4] = {};
+		for (u32 k = 0; k < taps.m_count; ++k) {
+			for (u32 c = 0; c < 4; ++c) sum[c] += texel[k * 4 + c] * taps.m_weights[k];
+		}
+		for (u32 c = 0; c < 4; ++c) dst[c] = sum[c];
+	}
+}
+
+static void BlendScalar(const f32* const* rows, u32 floats, const MipTaps& taps, f32* dst)
+{
+	for (u32 i = 0; i < floats; ++i) {
+		f32 sum = 0.0f;
+		for (u32 k = 0; k < taps.m_count; ++k) sum += rows[k][i] * taps.m_weights[k];
+		dst[i] = sum;
+	}
+}
+
+#ifdef MIP_X86
+//One texel per vector
+static void ReduceSSE(const f32* padded, u32 dst_width, const MipTaps& taps, f32* dst)
+{
+	__m128 weights[MIP_MAX_TAPS];
+	for (u32 k = 0; k < taps.m_count; ++k) weights[k] = _mm_set1_ps(taps.m_weights[k]);
+
+	const f32* base = padded + (MIP_PAD_LEFT + taps.m_offset) * 4;
+	for (u32 x = 0; x < dst_width; ++x) {
+		const f32* texel = base + x * 8;
+		__m128 sum = _mm_setzero_ps();
+		for (u32 k = 0; k < taps.m_count; ++k) {
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(texel + k * 4), weights[k]));
+		}
+		_mm_storeu_ps(dst + x * 4, sum);
+	}
+}
+
+static void BlendSSE(const f32* const* rows, u32 floats, const MipTaps& taps, f32* dst)
+{
+	__m128 weights[MIP_MAX_TAPS];
+	for (u32 k = 0; k < taps.m_count; ++k) weights[k] = _mm_set1_ps(taps.m_weights[k]);
+
+	for (u32 i = 0; i < floats; i += 4) {
+		__m128 sum = _mm_setzero_ps();
+		for (u32 k = 0; k < taps.m_count; ++k) {
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[k] + i), weights[k]));
+		}
+		_mm_storeu_ps(dst + i, sum);
+	}
+}
+
+//Two destination texels per vector. Loading two neighbouring source texels at once lines the
+//high one up with the next destination texel's tap a step earlier, so no shuffles are needed
+AVX2_TARGET static void ReduceAVX2(const f32* padded, u32 dst_width, const MipTaps& taps, f32* dst)
+{
+	__m256 pairs[MIP_MAX_TAPS + 1];
+	for (u32 j = 0; j <= taps.m_count; ++j) pairs[j] = _mm256_load_ps(taps.m_pairs[j]);
+
+	const f32* base = padded + (MIP_PAD_LEFT + taps.m_offset) * 4;
+	u32 x = 0;
+	for (; x + 1 < dst_width; x += 2) {
+		const f32* texel = base + x * 8;
+		__m256 sum = _mm256_setzero_ps();
+		for (u32 j = 0; j <= taps.m_count; ++j) {
+			sum = _mm256_fmadd_ps(_mm256_loadu_ps(texel + j * 4), pairs[j], sum);
+		}
+		_mm256_storeu_ps(dst + x * 4, sum);
+	}
+	if (x < dst_width) {
+		const f32* texel = base + x * 8;
+		__m128 sum = _mm_setzero_ps();
+		for (u32 k = 0; k < taps.m_count; ++k) {
+			sum = _mm_fmadd_ps(_mm_loadu_ps(texel + k * 4), _mm_set1_ps(taps.m_weights[k]), sum);
+		}
+		_mm_storeu_ps(dst + x * 4, sum);
+	}
+}
+
+AVX2_TARGET static void BlendAVX2(const f32* const* rows, u32 floats, const MipTaps& taps, f32* dst)
+{
+	__m256 weights[MIP_MAX_TAPS];
+	for (u32 k = 0; k < taps.m_count; ++k) weights[k] = _mm256_set1_ps(taps.m_weights[k]);
+
+	u32 i = 0;
+	for (; i + 8 <= floats; i += 8) {
+		__m256 sum = _mm256_setzero_ps();
+		for (u32 k = 0; k < taps.m_count; ++k) {
+			sum = _mm256_fmadd_ps(_mm256_loadu_ps(rows[k] + i), weights[k], sum);
+		}
+		_mm256_storeu_ps(dst + i, sum);
+	}
+	if (i < floats) {
+		__m128 sum = _mm_setzero_ps();
+		for (u32 k = 0; k < taps.m_count; ++k) {
+			sum = _mm_fmadd_ps(_mm_loadu_ps(rows[k] + i), _mm256_castps256_ps128(weights[k]), sum);
+		}
+		_mm_storeu_ps(dst + i, sum);
+	}
+}
+#endif //MIP_X86
+
+//-------------------------------------------------------------------------------------------------
+// CHAINS
+//-------------------------------------------------------------------------------------------------
+
+//One level built from the one above it
+struct MipLevelJob {
+	const u8* m_src;
+	usize m_src_pitch;
+	u32 m_width;
+	u32 m_height;
+	u8* m_dst;
+	u32 m_dst_width;
+	u32 m_dst_height;
+	u32 m_channels;
+	MipContent m_content;
+	const MipTaps* m_taps;
+	MipReduceFn m_reduce;
+	MipBlendFn m_blend;
+};
+
+//Builds destination rows [begin, end). Source rows are expanded and reduced across once each
+//into a ring, every destination row then blends the ones its taps cover
+static void GenerateRows(const MipLevelJob& job, u32 begin, u32 end)
+{
+	const MipTaps& taps = *job.m_taps;
+	const u32 floats = job.m_dst_width * 4;
+	std::vector<f32> padded((usize)(job.m_width + MIP_PAD_LEFT + MIP_PAD_RIGHT) * 4);
+	std::vector<f32> ring((usize)floats * MIP_MAX_TAPS);
+	std::vector<f32> blended(floats);
+	i32 ring_rows[MIP_MAX_TAPS];
+	for (u32 i = 0; i < MIP_MAX_TAPS; ++i) ring_rows[i] = -1;
+
+	for (u32 y = begin; y < end; ++y) {
+		const f32* rows[MIP_MAX_TAPS];
+		for (u32 k = 0; k < taps.m_count; ++k) {
+			i32 row = (i32)(y * 2 + k) + taps.m_offset;
+			row = row < 0 ? 0 : (row >= (i32)job.m_height ? (i32)job.m_height - 1 : row);
+			//Rows one destination row reads are at most MIP_MAX_TAPS apart, so never share a slot
+			const u32 slot = (u32)row % MIP_MAX_TAPS;
+			f32* reduced = ring.data() + (usize)slot * floats;
+			if (ring_rows[slot] != row) {
+				ExpandRow(job.m_src + (usize)row * job.m_src_pitch, job.m_width, job.m_channels, job.m_content, padded.data());
+				job.m_reduce(padded.data(), job.m_dst_width, taps, reduced);
+				ring_rows[slot] = row;
+			}
+			rows[k] = reduced;
+		}
+		job.m_blend(rows, floats, taps, blended.data());
+		PackRow(blended.data(), job.m_dst_width, job.m_channels, job.m_content, job.m_dst + (usize)y * job.m_dst_width * job.m_channels);
+	}
+}
+
+static void GenerateChain(MipChain& chain, const MipSettings& settings, const MipTaps& taps, MipReduceFn reduce, MipBlendFn blend, bool parallel_rows)
+{
+	chain.m_levels.clear();
+	//A single channel has no direction to renormalize
+	const MipContent content = settings.m_content == MipContent::NormalMap && chain.m_channels < 2 ? MipContent::Linear : settings.m_content;
+
+	const u8* src = chain.m_source;
+	usize src_pitch = chain.m_pitch ? chain.m_pitch : (usize)chain.m_width * chain.m_channels;
+	u32 width = chain.m_width;
+	u32 height = chain.m_height;
+	while (width > 1 || height > 1) {
+		MipLevelJob job;
+		job.m_src = src;
+		job.m_src_pitch = src_pitch;
+		job.m_width = width;
+		job.m_height = height;
+		job.m_dst_width = width > 1 ? width >> 1 : 1;
+		job.m_dst_height = height > 1 ? height >> 1 : 1;
+		job.m_channels = chain.m_channels;
+		job.m_content = content;
+		job.m_taps = &taps;
+		job.m_reduce = reduce;
+		job.m_blend = blend;
+
+		chain.m_levels.emplace_back((usize)job.m_dst_width * job.m_dst_height * chain.m_channels);
+		job.m_dst = chain.m_levels.back().data();
+
+		//Each thread takes a band of rows, the rows either side of a band are expanded twice
+		const bool parallel = parallel_rows && (usize)job.m_dst_width * job.m_dst_height >= MIP_PARALLEL_TEXELS;
+#pragma omp parallel if(parallel)
+		{
+			const u32 threads = omp_get_num_threads();
+			const u32 thread = omp_get_thread_num();
+			GenerateRows(job, (u32)((u64)job.m_dst_height * thread / threads), (u32)((u64)job.m_dst_height * (thread + 1) / threads));
+		}
+
+		src = job.m_dst;
+		src_pitch = (usize)job.m_dst_width * chain.m_channels;
+		width = job.m_dst_width;
+		height = job.m_dst_height;
+	}
+}
+
+void GenerateMipChains(MipChain* chains, u32 count, const MipSettings& settings)
+{
+	const MipTaps taps = MakeTaps(settings.m_filter);
+	MipReduceFn reduce = ReduceScalar;
+	MipBlendFn blend = BlendScalar;
+#ifdef MIP_X86
+	if (settings.m_simd) {
+		const bool avx2 = CPU_HasAVX2();
+		reduce = avx2 ? ReduceAVX2 : ReduceSSE;
+		blend = avx2 ? BlendAVX2 : BlendSSE;
+	}
+#endif //MIP_X86
+
+	//Several images run one per thread, a lone one splits its rows instead
+	const bool across_chains = settings.m_threads && count > 1;
+#pragma omp parallel for schedule(dynamic) if(across_chains)
+	for (i32 i = 0; i < (i32)count; ++i) {
+		GenerateChain(chains[i], settings, taps, reduce, blend, settings.m_threads && !across_chains);
+	}
+}
@@ -0,0 +1,364 @@
+#include "NBody.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define NBODY_X86 1
+#include <immintrin.h>
+#endif //x86
+
+//Rows handed to one thread at a time, and neighbours kept hot in L1 while those rows sweep them.
+//A tile is three floats per particle, 1024 of them fit in 12KB
+#define NBODY_ROW_BLOCK 64
+#define NBODY_TILE 1024
+
+void ParticleStore::Resize(usize count)
+{
+	m_px.assign(count, 0.0f);
+	m_py.assign(count, 0.0f);
+	m_pz.assign(count, 0.0f);
+	m_vx.assign(count, 0.0f);
+	m_vy.assign(count, 0.0f);
+	m_vz.assign(count, 0.0f);
+	m_ax.assign(count, 0.0f);
+	m_ay.assign(count, 0.0f);
+	m_az.assign(count, 0.0f);
+}
+
+const char* NBody_SolverName(NBodySolver solver)
+{
+	switch (solver) {
+	case NBodySolver::Scalar: return "Scalar";
+	case NBodySolver::SIMD: return "SIMD";
+	case NBodySolver::SIMD_OMP: return "SIMD + OpenMP";
+	case NBodySolver::BarnesHut: return "Barnes-Hut";
+	}
+	return "Unknown";
+}
+
+//-------------------------------------------------------------------------------------------------
+// KERNELS
+//-------------------------------------------------------------------------------------------------
+
+static void AccumulateRowsScalar(ParticleStore& store, usize begin, usize end, usize tile_begin, usize tile_end)
+{
+	const float* px = store.m_px.data();
+	const float* py = store.m_py.data();
+	const float* pz = store.m_pz.data();
+
+	for (usize i = begin; i < end; ++i) {
+		float ax = 0.0f, ay = 0.0f, az = 0.0f;
+		for (usize j = tile_begin; j < tile_end; ++j) {
+			NBody_AccumulatePair(px[i], py[i], pz[i], px[j], py[j], pz[j], ax, ay, az);
+		}
+		store.m_ax[i] += ax;
+		store.m_ay[i] += ay;
+		store.m_az[i] += az;
+	}
+}
+
+#ifdef NBODY_X86
+static inline float HorizontalSum(__m128 v)
+{
+	__m128 shuffled = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+	__m128 sums = _mm_add_ps(v, shuffled);
+	shuffled = _mm_movehl_ps(shuffled, sums);
+	return _mm_cvtss_f32(_mm_add_ss(sums, shuffled));
+}
+
+static void AccumulateRowsSSE(ParticleStore& store, usize begin, usize end, usize tile_begin, usize tile_end)
+{
+	const float* px = store.m_px.data();
+	const float* py = store.m_py.data();
+	const float* pz = store.m_pz.data();
+	const usize simd_end = tile_begin + ((tile_end - tile_begin) & ~(usize)3);
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 three_halves = _mm_set1_ps(1.5f);
+	const __m128 max_inv = _mm_set1_ps(1.0f / NBODY_MIN_DISTANCE);
+
+	for (usize i = begin; i < end; ++i) {
+		const __m128 xi = _mm_set1_ps(px[i]);
+		const __m128 yi = _mm_set1_ps(py[i]);
+		const __m128 zi = _mm_set1_ps(pz[i]);
+		__m128 ax = zero, ay = zero, az = zero;
+
+		for (usize j = tile_begin; j < simd_end; j += 4) {
+			const __m128 dx = _mm_sub_ps(_mm_loadu_ps(px + j), xi);
+			const __m128 dy = _mm_sub_ps(_mm_loadu_ps(py + j), yi);
+			const __m128 dz = _mm_sub_ps(_mm_loadu_ps(pz + j), zi);
+			const __m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+			//rsqrt estimate plus one Newton-Raphson step, close to full float precision
+			__m128 inv_r = _mm_rsqrt_ps(r2);
+			inv_r = _mm_mul_ps(inv_r, _mm_sub_ps(three_halves, _mm_mul_ps(_mm_mul_ps(half, r2), _mm_mul_ps(inv_r, inv_r))));
+			const __m128 inv_rc = _mm_min_ps(inv_r, max_inv);
+			__m128 s = _mm_mul_ps(inv_r, _mm_mul_ps(inv_rc, inv_rc));
+			s = _mm_and_ps(s, _mm_cmpgt_ps(r2, zero));
+
+			ax = _mm_add_ps(ax, _mm_mul_ps(dx, s));
+			ay = _mm_add_ps(ay, _mm_mul_ps(dy, s));
+			az = _mm_add_ps(az, _mm_mul_ps(dz, s));
+		}
+
+		float sx = HorizontalSum(ax), sy = HorizontalSum(ay), sz = HorizontalSum(az);
+		for (usize j = simd_end; j < tile_end; ++j) {
+			NBody_AccumulatePair(px[i], py[i], pz[i], px[j], py[j], pz[j], sx, sy, sz);
+		}
+		store.m_ax[i] += sx;
+		store.m_ay[i] += sy;
+		store.m_az[i] += sz;
+	}
+}
+
+AVX2_TARGET static void AccumulateRowsAVX2(ParticleStore& store, usize begin, usize end, usize tile_begin, usize tile_end)
+{
+	const float* px = store.m_px.data();
+	const float* py = store.m_py.data();
+	const float* pz = store.m_pz.data();
+	const usize simd_end = tile_begin + ((tile_end - tile_begin) & ~(usize)7);
+
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 three_halves = _mm256_set1_ps(1.5f);
+	const __m256 max_inv = _mm256_set1_ps(1.0f / NBODY_MIN_DISTANCE);
+
+	for (usize i = begin; i < end; ++i) {
+		const __m256 xi = _mm256_set1_ps(px[i]);
+		const __m256 yi = _mm256_set1_ps(py[i]);
+		const __m256 zi = _mm256_set1_ps(pz[i]);
+		__m256 ax = zero, ay = zero, az = zero;
+
+		for (usize j = tile_begin; j < simd_end; j += 8) {
+			const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(px + j), xi);
+			const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(py + j), yi);
+			const __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(pz + j), zi);
+			const __m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+
+			__m256 inv_r = _mm256_rsqrt_ps(r2);
+			inv_r = _mm256_mul_ps(inv_r, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2), _mm256_mul_ps(inv_r, inv_r), three_halves));
+			const __m256 inv_rc = _mm256_min_ps(inv_r, max_inv);
+			__m256 s = _mm256_mul_ps(inv_r, _mm256_mul_ps(inv_rc, inv_rc));
+			s = _mm256_and_ps(s, _mm256_cmp_ps(r2, zero, _CMP_GT_OQ));
+
+			ax = _mm256_fmadd_ps(dx, s, ax);
+			ay = _mm256_fmadd_ps(dy, s, ay);
+			az = _mm256_fmadd_ps(dz, s, az);
+		}
+
+		float sx = HorizontalSum(_mm_add_ps(_mm256_castps256_ps128(ax), _mm256_extractf128_ps(ax, 1)));
+		float sy = HorizontalSum(_mm_add_ps(_mm256_castps256_ps128(ay), _mm256_extractf128_ps(ay, 1)));
+		float sz = HorizontalSum(_mm_add_ps(_mm256_castps256_ps128(az), _mm256_extractf128_ps(az, 1)));
+		for (usize j = simd_end; j < tile_end; ++j) {
+			NBody_AccumulatePair(px[i], py[i], pz[i], px[j], py[j], pz[j], sx, sy, sz);
+		}
+		store.m_ax[i] += sx;
+		store.m_ay[i] += sy;
+		store.m_az[i] += sz;
+	}
+}
+
+//Interaction list kernels, same falloff as the row kernels but every source carries a mass
+static void AccumulateSourcesSSE(const NBodySources& sources, const float* tx, const float* ty, const float* tz, usize targets, float* out_x, float* out_y, float* out_z)
+{
+	const usize count = sources.Count();
+	const usize simd_end = count & ~(usize)3;
+	const float* sx = sources.m_x.data();
+	const float* sy = sources.m_y.data();
+	const float* sz = sources.m_z.data();
+	const float* sm = sources.m_mass.data();
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 three_halves = _mm_set1_ps(1.5f);
+	const __m128 max_inv = _mm_set1_ps(1.0f / NBODY_MIN_DISTANCE);
+
+	for (usize i = 0; i < targets; ++i) {
+		const __m128 xi = _mm_set1_ps(tx[i]);
+		const __m128 yi = _mm_set1_ps(ty[i]);
+		const __m128 zi = _mm_set1_ps(tz[i]);
+		__m128 ax = zero, ay = zero, az = zero;
+
+		for (usize j = 0; j < simd_end; j += 4) {
+			const __m128 dx = _mm_sub_ps(_mm_loadu_ps(sx + j), xi);
+			const __m128 dy = _mm_sub_ps(_mm_loadu_ps(sy + j), yi);
+			const __m128 dz = _mm_sub_ps(_mm_loadu_ps(sz + j), zi);
+			const __m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+			__m128 inv_r = _mm_rsqrt_ps(r2);
+			inv_r = _mm_mul_ps(inv_r, _mm_sub_ps(three_halves, _mm_mul_ps(_mm_mul_ps(half, r2), _mm_mul_ps(inv_r, inv_r))));
+			const __m128 inv_rc = _mm_min_ps(inv_r, max_inv);
+			__m128 s = _mm_mul_ps(_mm_mul_ps(inv_r, _mm_loadu_ps(sm + j)), _mm_mul_ps(inv_rc, inv_rc));
+			s = _mm_and_ps(s, _mm_cmpgt_ps(r2, zero));
+
+			ax = _mm_add_ps(ax, _mm_mul_ps(dx, s));
+			ay = _mm_add_ps(ay, _mm_mul_ps(dy, s));
+			az = _mm_add_ps(az, _mm_mul_ps(dz, s));
+		}
+
+		float px = 0.0f, py = 0.0f, pz = 0.0f;
+		for (usize j = simd_end; j < count; ++j) {
+			float mx = 0.0f, my = 0.0f, mz = 0.0f;
+			NBody_AccumulatePair(tx[i], ty[i], tz[i], sx[j], sy[j], sz[j], mx, my, mz);
+			px += mx * sm[j];
+			py += my * sm[j];
+			pz += mz * sm[j];
+		}
+		out_x[i] += HorizontalSum(ax) + px;
+		out_y[i] += HorizontalSum(ay) + py;
+		out_z[i] += HorizontalSum(az) + pz;
+	}
+}
+
+AVX2_TARGET static void AccumulateSourcesAVX2(const NBodySources& sources, const float* tx, const float* ty, const float* tz, usize targets, float* out_x, float* out_y, float* out_z)
+{
+	const usize count = sources.Count();
+	const usize simd_end = count & ~(usize)7;
+	const float* sx = sources.m_x.data();
+	const float* sy = sources.m_y.data();
+	const float* sz = sources.m_z.data();
+	const float* sm = sources.m_mass.data();
+
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 three_halves = _mm256_set1_ps(1.5f);
+	const __m256 max_inv = _mm256_set1_ps(1.0f / NBODY_MIN_DISTANCE);
+
+	for (usize i = 0; i < targets; ++i) {
+		const __m256 xi = _mm256_set1_ps(tx[i]);
+		const __m256 yi = _mm256_set1_ps(ty[i]);
+		const __m256 zi = _mm256_set1_ps(tz[i]);
+		__m256 ax = zero, ay = zero, az = zero;
+
+		for (usize j = 0; j < simd_end; j += 8) {
+			const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(sx + j), xi);
+			const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(sy + j), yi);
+			const __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(sz + j), zi);
+			const __m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+
+			__m256 inv_r = _mm256_rsqrt_ps(r2);
+			inv_r = _mm256_mul_ps(inv_r, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2), _mm256_mul_ps(inv_r, inv_r), three_halves));
+			const __m256 inv_rc = _mm256_min_ps(inv_r, max_inv);
+			__m256 s = _mm256_mul_ps(_mm256_mul_ps(inv_r, _mm256_loadu_ps(sm + j)), _mm256_mul_ps(inv_rc, inv_rc));
+			s = _mm256_and_ps(s, _mm256_cmp_ps(r2, zero, _CMP_GT_OQ));
+
+			ax = _mm256_fmadd_ps(dx, s, ax);
+			ay = _mm256_fmadd_ps(dy, s, ay);
+			az = _mm256_fmadd_ps(dz, s, az);
+		}
+
+		float px = 0.0f, py = 0.0f, pz = 0.0f;
+		for (usize j = simd_end; j < count; ++j) {
+			float mx = 0.0f, my = 0.0f, mz = 0.0f;
+			NBody_AccumulatePair(tx[i], ty[i], tz[i], sx[j], sy[j], sz[j], mx, my, mz);
+			px += mx * sm[j];
+			py += my * sm[j];
+			pz += mz * sm[j];
+		}
+		out_x[i] += HorizontalSum(_mm_add_ps(_mm256_castps256_ps128(ax), _mm256_extractf128_ps(ax, 1))) + px;
+		out_y[i] += HorizontalSum(_mm_add_ps(_mm256_castps256_ps128(ay), _mm256_extractf128_ps(ay, 1))) + py;
+		out_z[i] += HorizontalSum(_mm_add_ps(_mm256_castps256_ps128(az), _mm256_extractf128_ps(az, 1))) + pz;
+	}
+}
+#endif //NBODY_X86
+
+void NBody_AccumulateSources(const NBodySources& sources, const float* tx, const float* ty, const float* tz, usize targets, float* ax, float* ay, float* az)
+{
+#ifdef NBODY_X86
+	if (CPU_HasAVX2()) AccumulateSourcesAVX2(sources, tx, ty, tz, targets, ax, ay, az);
+	else AccumulateSourcesSSE(sources, tx, ty, tz, targets, ax, ay, az);
+#else
+	for (usize i = 0; i < targets; ++i) {
+		for (usize j = 0; j < sources.Count(); ++j) {
+			float mx = 0.0f, my = 0.0f, mz = 0.0f;
+			NBody_AccumulatePair(tx[i], ty[i], tz[i], sources.m_x[j], sources.m_y[j], sources.m_z[j], mx, my, mz);
+			ax[i] += mx * sources.m_mass[j];
+			ay[i] += my * sources.m_mass[j];
+			az[i] += mz * sources.m_mass[j];
+		}
+	}
+#endif //NBODY_X86
+}
+
+typedef void (*RowKernel)(ParticleStore&, usize, usize, usize, usize);
+
+static RowKernel SelectKernel(NBodySolver solver)
+{
+#ifdef NBODY_X86
+	if (solver != NBodySolver::Scalar) {
+		return CPU_HasAVX2() ? AccumulateRowsAVX2 : AccumulateRowsSSE;
+	}
+#endif //NBODY_X86
+	return AccumulateRowsScalar;
+}
+
+//One block of rows against every tile of neighbours
+static void AccumulateBlock(ParticleStore& store, RowKernel kernel, usize begin, usize end)
+{
+	const usize count = store.Count();
+	for (usize tile = 0; tile < count; tile += NBODY_TILE) {
+		kernel(store, begin, end, tile, std::min(tile + NBODY_TILE, count));
+	}
+}
+
+//-------------------------------------------------------------------------------------------------
+// STEP
+//-------------------------------------------------------------------------------------------------
+
+void NBody_Accumulate(ParticleStore& store, NBodySolver solver)
+{
+	const i64 count = (i64)store.Count();
+	std::fill(store.m_ax.begin(), store.m_ax.end(), 0.0f);
+	std::fill(store.m_ay.begin(), store.m_ay.end(), 0.0f);
+	std::fill(store.m_az.begin(), store.m_az.end(), 0.0f);
+
+	if (solver == NBodySolver::BarnesHut) {
+		store.m_tree.Build(store);
+		store.m_tree.Accumulate(store);
+		return;
+	}
+
+	RowKernel kernel = SelectKernel(solver);
+	const i64 blocks = (count + NBODY_ROW_BLOCK - 1) / NBODY_ROW_BLOCK;
+
+	if (solver == NBodySolver::SIMD_OMP) {
+#pragma omp parallel for schedule(dynamic)
+		for (i64 block = 0; block < blocks; ++block) {
+			const usize begin = (usize)block * NBODY_ROW_BLOCK;
+			AccumulateBlock(store, kernel, begin, std::min(begin + NBODY_ROW_BLOCK, (usize)count));
+		}
+	}
+	else {
+		for (i64 block = 0; block < blocks; ++block) {
+			const usize begin = (usize)block * NBODY_ROW_BLOCK;
+			AccumulateBlock(store, kernel, begin, std::min(begin + NBODY_ROW_BLOCK, (usize)count));
+		}
+	}
+}
+
+void NBody_Step(ParticleStore& store, f64 dt, NBodySolver solver, float* positions)
+{
+	NBody_Accumulate(store, solver);
+
+	const i64 count = (i64)store.Count();
+	const float scale = (float)dt * NBODY_FORCE_SCALE;
+#pragma omp parallel for schedule(static) if (solver == NBodySolver::SIMD_OMP || solver == NBodySolver::BarnesHut)
+	for (i64 i = 0; i < count; ++i) {
+		store.m_px[i] += store.m_vx[i];
+		store.m_py[i] += store.m_vy[i];
+		store.m_pz[i] += store.m_vz[i];
+		store.m_vx[i] += store.m_ax[i] * scale;
+		store.m_vy[i] += store.m_ay[i] * scale;
+		store.m_vz[i] += store.m_az[i] * scale;
+		if (positions) {
+			positions[i * 3 + 0] = store.m_px[i];
+			positions[i * 3 + 1] = store.m_py[i];
+			positions[i * 3 + 2] = store.m_pz[i];
+		}
+	}
+}
+
+#undef NBODY_ROW_BLOCK
+#undef NBODY_TILE
@@ -0,0 +1,332 @@
+#include "NBody.h"
+
+#include <cfloat>
+#include <cstring>
+
+//Morton codes interleave 10 bits per axis, so the tree is at most 10 levels deep
+#define OCTREE_MAX_LEVEL 10
+//Cells with this many particles or fewer are leaves, summed exactly
+#define OCTREE_LEAF_SIZE 16
+//Subtrees rooted at this level are built in parallel, up to 8^2 of them
+#define OCTREE_TASK_LEVEL 2
+#define OCTREE_RADIX_BITS 10
+#define OCTREE_BOUNDS_CHUNKS 64
+//Particles sharing one tree walk and interaction list
+#define OCTREE_GROUP_SIZE 32
+
+//Spreads the low 10 bits of v out to every third bit
+static inline u32 SpreadBits(u32 v)
+{
+	v = (v | (v << 16)) & 0x030000FF;
+	v = (v | (v << 8)) & 0x0300F00F;
+	v = (v | (v << 4)) & 0x030C30C3;
+	v = (v | (v << 2)) & 0x09249249;
+	return v;
+}
+
+static inline u32 Digit(u32 code, u32 level)
+{
+	return (code >> (3 * (OCTREE_MAX_LEVEL - 1 - level))) & 7;
+}
+
+//Splits a Morton sorted range into its non-empty children at the next level.
+//Within a cell the child digit never decreases, so each child is found with a binary search
+static int SplitRange(const u32* codes, u32 first, u32 count, u32 level, u32 child_first[8], u32 child_count[8])
+{
+	int children = 0;
+	const u32 end = first + count;
+	u32 start = first;
+	while (start < end) {
+		const u32 digit = Digit(codes[start], level);
+		u32 low = start + 1, high = end;
+		while (low < high) {
+			u32 mid = low + (high - low) / 2;
+			if (Digit(codes[mid], level) == digit) low = mid + 1;
+			else high = mid;
+		}
+		child_first[children] = start;
+		child_count[children] = low - start;
+		children++;
+		start = low;
+	}
+	return children;
+}
+
+static void MakeLeaf(OctreeNode& node, const float* sx, const float* sy, const float* sz, u32 first, u32 count)
+{
+	float x = 0.0f, y = 0.0f, z = 0.0f;
+	for (u32 i = first; i < first + count; ++i) {
+		x += sx[i];
+		y += sy[i];
+		z += sz[i];
+	}
+	node.m_mass = (float)count;
+	node.m_cx = x / node.m_mass;
+	node.m_cy = y / node.m_mass;
+	node.m_cz = z / node.m_mass;
+	node.m_leaf = 1;
+}
+
+//Appends the subtree over [first, first + count) to nodes depth first, returns its root index
+static u32 BuildSubtree(std::vector<OctreeNode>& nodes, const NBodyOctree& tree, float root_size, u32 first, u32 count, u32 level)
+{
+	const u32 index = (u32)nodes.size();
+	nodes.push_back({});
+	{
+		OctreeNode& node = nodes[index];
+		node.m_size = root_size / (float)(1u << level);
+		node.m_first = first;
+		node.m_count = count;
+		node.m_leaf = 0;
+	}
+
+	if (count <= OCTREE_LEAF_SIZE || level == OCTREE_MAX_LEVEL) {
+		MakeLeaf(nodes[index], tree.m_sx.data(), tree.m_sy.data(), tree.m_sz.data(), first, count);
+	}
+	else {
+		u32 child_first[8], child_count[8];
+		const int children = SplitRange(tree.m_codes.data(), first, count, level, child_first, child_count);
+		float x = 0.0f, y = 0.0f, z = 0.0f;
+		for (int c = 0; c < children; ++c) {
+			const u32 child = BuildSubtree(nodes, tree, root_size, child_first[c], child_count[c], level + 1);
+			const OctreeNode& child_node = nodes[child];
+			x += child_node.m_cx * child_node.m_mass;
+			y += child_node.m_cy * child_node.m_mass;
+			z += child_node.m_cz * child_node.m_mass;
+		}
+		OctreeNode& node = nodes[index];
+		node.m_mass = (float)count;
+		node.m_cx = x / node.m_mass;
+		node.m_cy = y / node.m_mass;
+		node.m_cz = z / node.m_mass;
+	}
+	nodes[index].m_next = (u32)nodes.size();
+	return index;
+}
+
+//Walks the cells above the task level. With tasks null it only records the task ranges in
+//order, otherwise it emits the top cells and splices the built task subtrees in between
+static void BuildTop(NBodyOctree& tree, float root_size, u32 first, u32 count, u32 level, u32* next_task)
+{
+	if (level == OCTREE_TASK_LEVEL || count <= OCTREE_LEAF_SIZE) {
+		if (next_task == nullptr) {
+			tree.m_tasks.push_back({ first, count, level });
+			return;
+		}
+		//Task nodes index from zero, shift them to where the subtree lands
+		const std::vector<OctreeNode>& subtree = tree.m_task_nodes[(*next_task)++];
+		const u32 offset = (u32)tree.m_nodes.size();
+		for (OctreeNode node : subtree) {
+			node.m_next += offset;
+			tree.m_nodes.push_back(node);
+		}
+		return;
+	}
+
+	u32 index = 0;
+	if (next_task) {
+		index = (u32)tree.m_nodes.size();
+		tree.m_nodes.push_back({});
+	}
+
+	u32 child_first[8], child_count[8];
+	const int children = SplitRange(tree.m_codes.data(), first, count, level, child_first, child_count);
+	float x = 0.0f, y = 0.0f, z = 0.0f;
+	for (int c = 0; c < children; ++c) {
+		const u32 child = next_task ? (u32)tree.m_nodes.size() : 0;
+		BuildTop(tree, root_size, child_first[c], child_count[c], level + 1, next_task);
+		if (next_task) {
+			const OctreeNode& child_node = tree.m_nodes[child];
+			x += child_node.m_cx * child_node.m_mass;
+			y += child_node.m_cy * child_node.m_mass;
+			z += child_node.m_cz * child_node.m_mass;
+		}
+	}
+
+	if (next_task) {
+		OctreeNode& node = tree.m_nodes[index];
+		node.m_size = root_size / (float)(1u << level);
+		node.m_first = first;
+		node.m_count = count;
+		node.m_leaf = 0;
+		node.m_mass = (float)count;
+		node.m_cx = x / node.m_mass;
+		node.m_cy = y / node.m_mass;
+		node.m_cz = z / node.m_mass;
+		node.m_next = (u32)tree.m_nodes.size();
+	}
+}
+
+//LSD radix sort of the codes, carrying the particle indices along
+static void SortCodes(NBodyOctree& tree)
+{
+	const usize count = tree.m_codes.size();
+	u32 histogram[1 << OCTREE_RADIX_BITS];
+	for (u32 shift = 0; shift < 3 * OCTREE_MAX_LEVEL; shift += OCTREE_RADIX_BITS) {
+		memset(histogram, 0, sizeof(histogram));
+		for (usize i = 0; i < count; ++i) {
+			histogram[(tree.m_codes[i] >> shift) & ((1 << OCTREE_RADIX_BITS) - 1)]++;
+		}
+		u32 sum = 0;
+		for (u32 b = 0; b < (1 << OCTREE_RADIX_BITS); ++b) {
+			u32 bucket = histogram[b];
+			histogram[b] = sum;
+			sum += bucket;
+		}
+		for (usize i = 0; i < count; ++i) {
+			u32 slot = histogram[(tree.m_codes[i] >> shift) & ((1 << OCTREE_RADIX_BITS) - 1)]++;
+			tree.m_codes_scratch[slot] = tree.m_codes[i];
+			tree.m_order_scratch[slot] = tree.m_order[i];
+		}
+		tree.m_codes.swap(tree.m_codes_scratch);
+		tree.m_order.swap(tree.m_order_scratch);
+	}
+}
+
+void NBodyOctree::Build(const ParticleStore& store)
+{
+	const i64 count = (i64)store.Count();
+	m_nodes.clear();
+	m_tasks.clear();
+	if (count == 0) return;
+
+	//Bounds, reduced per chunk since OpenMP 2.0 has no min/max reductions
+	float chunk_min[OCTREE_BOUNDS_CHUNKS][3], chunk_max[OCTREE_BOUNDS_CHUNKS][3];
+	const i64 chunk_size = (count + OCTREE_BOUNDS_CHUNKS - 1) / OCTREE_BOUNDS_CHUNKS;
+#pragma omp parallel for schedule(static)
+	for (int c = 0; c < OCTREE_BOUNDS_CHUNKS; ++c) {
+		float low[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float high[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		const i64 end = std::min(count, (c + 1) * chunk_size);
+		for (i64 i = c * chunk_size; i < end; ++i) {
+			low[0] = std::min(low[0], store.m_px[i]); high[0] = std::max(high[0], store.m_px[i]);
+			low[1] = std::min(low[1], store.m_py[i]); high[1] = std::max(high[1], store.m_py[i]);
+			low[2] = std::min(low[2], store.m_pz[i]); high[2] = std::max(high[2], store.m_pz[i]);
+		}
+		memcpy(chunk_min[c], low, sizeof(low));
+		memcpy(chunk_max[c], high, sizeof(high));
+	}
+	float low[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float high[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (int c = 0; c < OCTREE_BOUNDS_CHUNKS; ++c) {
+		for (int a = 0; a < 3; ++a) {
+			low[a] = std::min(low[a], chunk_min[c][a]);
+			high[a] = std::max(high[a], chunk_max[c][a]);
+		}
+	}
+	//A cube around everything, padded so the far faces still quantize inside the grid
+	const float root_size = std::max(std::max(high[0] - low[0], high[1] - low[1]), std::max(high[2] - low[2], 1e-6f)) * 1.0001f;
+	const float to_grid = (float)(1 << OCTREE_MAX_LEVEL) / root_size;
+
+	m_codes.resize(count);
+	m_order.resize(count);
+	m_codes_scratch.resize(count);
+	m_order_scratch.resize(count);
+	m_sx.resize(count);
+	m_sy.resize(count);
+	m_sz.resize(count);
+
+#pragma omp parallel for schedule(static)
+	for (i64 i = 0; i < count; ++i) {
+		const u32 cell_max = (1 << OCTREE_MAX_LEVEL) - 1;
+		u32 x = std::min((u32)((store.m_px[i] - low[0]) * to_grid), cell_max);
+		u32 y = std::min((u32)((store.m_py[i] - low[1]) * to_grid), cell_max);
+		u32 z = std::min((u32)((store.m_pz[i] - low[2]) * to_grid), cell_max);
+		m_codes[i] = (SpreadBits(x) << 2) | (SpreadBits(y) << 1) | SpreadBits(z);
+		m_order[i] = (u32)i;
+	}
+
+	SortCodes(*this);
+
+	//Neighbours on the curve are neighbours in space, gathering keeps each cell's particles together
+#pragma omp parallel for schedule(static)
+	for (i64 i = 0; i < count; ++i) {
+		m_sx[i] = store.m_px[m_order[i]];
+		m_sy[i] = store.m_py[m_order[i]];
+		m_sz[i] = store.m_pz[m_order[i]];
+	}
+
+	//Find the task subtrees, build them in parallel into their own pools, then splice them in
+	BuildTop(*this, root_size, 0, (u32)count, 0, nullptr);
+	if (m_task_nodes.size() < m_tasks.size()) m_task_nodes.resize(m_tasks.size());
+
+	const int tasks = (int)m_tasks.size();
+#pragma omp parallel for schedule(dynamic)
+	for (int t = 0; t < tasks; ++t) {
+		m_task_nodes[t].clear();
+		BuildSubtree(m_task_nodes[t], *this, root_size, m_tasks[t].m_first, m_tasks[t].m_count, m_tasks[t].m_level);
+	}
+
+	u32 next_task = 0;
+	BuildTop(*this, root_size, 0, (u32)count, 0, &next_task);
+}
+
+void NBodyOctree::Accumulate(ParticleStore& store) const
+{
+	const i64 count = (i64)m_order.size();
+	if (m_nodes.empty() || count != (i64)store.Count()) return;
+
+	const float theta2 = m_theta * m_theta;
+	const u32 node_count = (u32)m_nodes.size();
+	const i64 groups = (count + OCTREE_GROUP_SIZE - 1) / OCTREE_GROUP_SIZE;
+
+#pragma omp parallel
+	{
+		NBodySources sources;
+		float ax[OCTREE_GROUP_SIZE], ay[OCTREE_GROUP_SIZE], az[OCTREE_GROUP_SIZE];
+
+#pragma omp for schedule(dynamic)
+		for (i64 group = 0; group < groups; ++group) {
+			const i64 first = group * OCTREE_GROUP_SIZE;
+			const i64 size = std::min(count - first, (i64)OCTREE_GROUP_SIZE);
+
+			//Consecutive particles on the Morton curve form a compact group
+			float low[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+			float high[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			for (i64 i = first; i < first + size; ++i) {
+				low[0] = std::min(low[0], m_sx[i]); high[0] = std::max(high[0], m_sx[i]);
+				low[1] = std::min(low[1], m_sy[i]); high[1] = std::max(high[1], m_sy[i]);
+				low[2] = std::min(low[2], m_sz[i]); high[2] = std::max(high[2], m_sz[i]);
+			}
+
+			//One walk for the whole group, measured from the nearest point of its bounds
+			sources.Clear();
+			u32 n = 0;
+			while (n < node_count) {
+				const OctreeNode& node = m_nodes[n];
+				const float dx = std::max(std::max(low[0] - node.m_cx, node.m_cx - high[0]), 0.0f);
+				const float dy = std::max(std::max(low[1] - node.m_cy, node.m_cy - high[1]), 0.0f);
+				const float dz = std::max(std::max(low[2] - node.m_cz, node.m_cz - high[2]), 0.0f);
+				if (node.m_size * node.m_size < theta2 * (dx * dx + dy * dy + dz * dz)) {
+					sources.Push(node.m_cx, node.m_cy, node.m_cz, node.m_mass);
+					n = node.m_next;
+				}
+				else if (node.m_leaf) {
+					for (u32 j = node.m_first; j < node.m_first + node.m_count; ++j) {
+						sources.Push(m_sx[j], m_sy[j], m_sz[j], 1.0f);
+					}
+					n = node.m_next;
+				}
+				else {
+					n++;
+				}
+			}
+
+			for (i64 i = 0; i < size; ++i) ax[i] = ay[i] = az[i] = 0.0f;
+			NBody_AccumulateSources(sources, &m_sx[first], &m_sy[first], &m_sz[first], (usize)size, ax, ay, az);
+			for (i64 i = 0; i < size; ++i) {
+				const u32 particle = m_order[first + i];
+				store.m_ax[particle] = ax[i];
+				store.m_ay[particle] = ay[i];
+				store.m_az[particle] = az[i];
+			}
+		}
+	}
+}
+
+#undef OCTREE_MAX_LEVEL
+#undef OCTREE_LEAF_SIZE
+#undef OCTREE_TASK_LEVEL
+#undef OCTREE_RADIX_BITS
+#undef OCTREE_BOUNDS_CHUNKS
+#undef OCTREE_GROUP_SIZE
@@ -0,0 +1,387 @@
+#include "ObjParser.h"
+
+#include "glm/glm.hpp"
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+//Buffers smaller than this are parsed on the calling thread only
+#define OBJ_MIN_CHUNK_SIZE (1024 * 1024)
+#define OBJ_MISSING I32_MIN
+
+//One face corner. Positive OBJ indices are stored 0-based and global, negative ones are
+//resolved against the chunk's own counts and flagged so the chunk offset can be added later
+struct ObjCorner {
+	i32 v;
+	i32 t;
+	i32 n;
+	u32 relative;
+};
+
+struct ObjChunk {
+	std::vector<float> positions;
+	std::vector<float> texcoords;
+	std::vector<float> normals;
+	std::vector<ObjCorner> corners;
+	bool ok = true;
+};
+
+static const double pow10_table[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool IsDigit(char c) { return (unsigned)(c - '0') < 10; }
+static inline bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+static inline const char* SkipSpace(const char* p, const char* end)
+{
+	while (p < end && IsSpace(*p)) ++p;
+	return p;
+}
+
+//Decimal float scanner, no locale and no allocation. Up to 19 significant digits are kept
+//which is far more than a float can hold, exponents inside +-22 are exact in double
+static const char* ScanFloat(const char* p, const char* end, float* out)
+{
+	p = SkipSpace(p, end);
+
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		++p;
+	}
+
+	u64 mantissa = 0;
+	int exponent = 0;
+	int digits = 0;
+	const char* start = p;
+	while (p < end && IsDigit(*p)) {
+		if (digits < 19) {
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa) ++digits;
+		}
+		else {
+			++exponent;
+		}
+		++p;
+	}
+	if (p < end && *p == '.') {
+		++p;
+		while (p < end && IsDigit(*p)) {
+			if (digits < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa) ++digits;
+				--exponent;
+			}
+			++p;
+		}
+	}
+	if (p == start) {
+		*out = 0.0f;
+		return p;
+	}
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		++p;
+		bool exp_negative = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			exp_negative = *p == '-';
+			++p;
+		}
+		int e = 0;
+		while (p < end && IsDigit(*p)) {
+			if (e < 10000) e = e * 10 + (*p - '0');
+			++p;
+		}
+		exponent += exp_negative ? -e : e;
+	}
+
+	double value = (double)mantissa;
+	if (exponent < 0) {
+		value = exponent >= -22 ? value / pow10_table[-exponent] : value * std::pow(10.0, exponent);
+	}
+	else if (exponent > 0) {
+		value = exponent <= 22 ? value * pow10_table[exponent] : value * std::pow(10.0, exponent);
+	}
+
+	*out = (float)(negative ? -value : value);
+	return p;
+}
+
+static inline const char* ScanIndex(const char* p, const char* end, i32* out)
+{
+	bool negative = false;
+	if (p < end && *p == '-') {
+		negative = true;
+		++p;
+	}
+	i32 value = 0;
+	while (p < end && IsDigit(*p)) {
+		value = value * 10 + (*p - '0');
+		++p;
+	}
+	*out = negative ? -value : value;
+	return p;
+}
+
+//Turns an OBJ index into the ObjCorner encoding, count is how many elements this chunk has seen
+static inline i32 ResolveIndex(i32 index, usize count, u32 flag, u32* relative)
+{
+	if (index > 0) return index - 1;
+	if (index < 0) {
+		*relative |= flag;
+		return (i32)count + index;
+	}
+	return OBJ_MISSING;
+}
+
+static void ParseChunk(const char* p, const char* end, ObjChunk& chunk)
+{
+	std::vector<ObjCorner> face;
+
+	while (p < end) {
+		const char* line_end = (const char*)memchr(p, '\n', end - p);
+		if (!line_end) line_end = end;
+
+		p = SkipSpace(p, line_end);
+		if (p + 1 < line_end && p[0] == 'v') {
+			if (IsSpace(p[1])) {
+				float xyz[3];
+				const char* q = p + 1;
+				q = ScanFloat(q, line_end, &xyz[0]);
+				q = ScanFloat(q, line_end, &xyz[1]);
+				q = ScanFloat(q, line_end, &xyz[2]);
+				chunk.positions.insert(chunk.positions.end(), xyz, xyz + 3);
+			}
+			else if (p[1] == 't') {
+				float uv[2];
+				const char* q = p + 2;
+				q = ScanFloat(q, line_end, &uv[0]);
+				q = ScanFloat(q, line_end, &uv[1]);
+				chunk.texcoords.insert(chunk.texcoords.end(), uv, uv + 2);
+			}
+			else if (p[1] == 'n') {
+				float xyz[3];
+				const char* q = p + 2;
+				q = ScanFloat(q, line_end, &xyz[0]);
+				q = ScanFloat(q, line_end, &xyz[1]);
+				q = ScanFloat(q, line_end, &xyz[2]);
+				chunk.normals.insert(chunk.normals.end(), xyz, xyz + 3);
+			}
+		}
+		else if (p + 1 < line_end && p[0] == 'f' && IsSpace(p[1])) {
+			face.clear();
+			const char* q = p + 1;
+			for (;;) {
+				q = SkipSpace(q, line_end);
+				if (q >= line_end || !(IsDigit(*q) || *q == '-')) break;
+
+				i32 v = 0, t = 0, n = 0;
+				q = ScanIndex(q, line_end, &v);
+				if (q < line_end && *q == '/') {
+					++q;
+					if (q < line_end && *q != '/') q = ScanIndex(q, line_end, &t);
+					if (q < line_end && *q == '/') {
+						++q;
+						q = ScanIndex(q, line_end, &n);
+					}
+				}
+
+				ObjCorner corner;
+				corner.relative = 0;
+				corner.v = ResolveIndex(v, chunk.positions.size() / 3, 1, &corner.relative);
+				corner.t = ResolveIndex(t, chunk.texcoords.size() / 2, 2, &corner.relative);
+				corner.n = ResolveIndex(n, chunk.normals.size() / 3, 4, &corner.relative);
+				if (corner.v == OBJ_MISSING) chunk.ok = false;
+				face.push_back(corner);
+			}
+
+			//Fan triangulation, fine for the convex polygons exporters write
+			for (usize i = 1; i + 1 < face.size(); ++i) {
+				chunk.corners.push_back(face[0]);
+				chunk.corners.push_back(face[i]);
+				chunk.corners.push_back(face[i + 1]);
+			}
+		}
+
+		p = line_end + 1;
+	}
+}
+
+static inline u32 HashCorner(const ObjCorner& c)
+{
+	u32 h = (u32)c.v * 0x9E3779B1u;
+	h ^= (u32)c.t * 0x85EBCA77u + (h << 6) + (h >> 2);
+	h ^= (u32)c.n * 0xC2B2AE3Du + (h << 6) + (h >> 2);
+	return h ^ (h >> 15);
+}
+
+bool Parse_OBJ_Buffer(const char* data, usize size, ObjMeshData& out, bool parallel)
+{
+	out.m_vertices.clear();
+	out.m_indices.clear();
+	out.m_tangents = false;
+	if (data == nullptr || size == 0) return false;
+
+	//Split on line boundaries
+	usize chunk_count = 1;
+	if (parallel) {
+		usize threads = std::thread::hardware_concurrency();
+		chunk_count = size / OBJ_MIN_CHUNK_SIZE;
+		if (chunk_count > threads) chunk_count = threads;
+		if (chunk_count < 1) chunk_count = 1;
+	}
+
+	std::vector<const char*> bounds(chunk_count + 1);
+	const char* end = data + size;
+	bounds[0] = data;
+	bounds[chunk_count] = end;
+	for (usize i = 1; i < chunk_count; ++i) {
+		const char* p = data + size * i / chunk_count;
+		if (p < bounds[i - 1]) p = bounds[i - 1];
+		const char* newline = (const char*)memchr(p, '\n', end - p);
+		bounds[i] = newline ? newline + 1 : end;
+	}
+
+	std::vector<ObjChunk> chunks(chunk_count);
+#pragma omp parallel for schedule(dynamic, 1) if(chunk_count > 1)
+	for (i64 i = 0; i < (i64)chunk_count; ++i) {
+		ParseChunk(bounds[i], bounds[i + 1], chunks[i]);
+	}
+
+	//Gather the attribute arrays and turn every corner index global
+	usize position_count = 0, texcoord_count = 0, normal_count = 0, corner_count = 0;
+	for (const ObjChunk& chunk : chunks) {
+		if (!chunk.ok) {
+			std::cerr << "OBJ face with a missing position index" << std::endl;
+			return false;
+		}
+		position_count += chunk.positions.size() / 3;
+		texcoord_count += chunk.texcoords.size() / 2;
+		normal_count += chunk.normals.size() / 3;
+		corner_count += chunk.corners.size();
+	}
+	if (corner_count == 0) return false;
+
+	std::vector<float> positions, texcoords, normals;
+	std::vector<ObjCorner> corners;
+	positions.reserve(position_count * 3);
+	texcoords.reserve(texcoord_count * 2);
+	normals.reserve(normal_count * 3);
+	corners.reserve(corner_count);
+
+	for (ObjChunk& chunk : chunks) {
+		const i32 v_offset = (i32)(positions.size() / 3);
+		const i32 t_offset = (i32)(texcoords.size() / 2);
+		const i32 n_offset = (i32)(normals.size() / 3);
+		for (ObjCorner c : chunk.corners) {
+			if (c.relative & 1) c.v += v_offset;
+			if (c.relative & 2) c.t += t_offset;
+			if (c.relative & 4) c.n += n_offset;
+			c.relative = 0;
+			corners.push_back(c);
+		}
+		positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+		texcoords.insert(texcoords.end(), chunk.texcoords.begin(), chunk.texcoords.end());
+		normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+		chunk = ObjChunk();
+	}
+
+	//Deduplicate with an open addressing table, sized to stay under half full
+	u32 capacity = 1;
+	while (capacity < corner_count * 2) capacity <<= 1;
+	const u32 mask = capacity - 1;
+	std::vector<u32> table(capacity, U32_MAX);
+	std::vector<ObjCorner> unique;
+	unique.reserve(corner_count / 4);
+	out.m_indices.resize(corner_count);
+
+	bool missing_normals = false;
+	for (usize i = 0; i < corner_count; ++i) {
+		ObjCorner c = corners[i];
+		if (c.v < 0 || c.v >= (i32)position_count) {
+			std::cerr << "OBJ position index out of range: " << c.v + 1 << std::endl;
+			out.m_indices.clear();
+			return false;
+		}
+		if (c.t != OBJ_MISSING && (c.t < 0 || c.t >= (i32)texcoord_count)) c.t = OBJ_MISSING;
+		if (c.n != OBJ_MISSING && (c.n < 0 || c.n >= (i32)normal_count)) c.n = OBJ_MISSING;
+		missing_normals |= c.n == OBJ_MISSING;
+
+		u32 slot = HashCorner(c) & mask;
+		for (;;) {
+			u32 index = table[slot];
+			if (index == U32_MAX) {
+				index = (u32)unique.size();
+				table[slot] = index;
+				unique.push_back(c);
+				out.m_indices[i] = index;
+				break;
+			}
+			const ObjCorner& u = unique[index];
+			if (u.v == c.v && u.t == c.t && u.n == c.n) {
+				out.m_indices[i] = index;
+				break;
+			}
+			slot = (slot + 1) & mask;
+		}
+	}
+
+	//Interleave position, normal, texcoord
+	const usize vertex_count = unique.size();
+	out.m_vertices.resize(vertex_count * 8);
+	float* dst = out.m_vertices.data();
+	for (usize i = 0; i < vertex_count; ++i, dst += 8) {
+		const ObjCorner& c = unique[i];
+		memcpy(dst, &positions[c.v * 3], sizeof(float) * 3);
+		if (c.n != OBJ_MISSING) {
+			memcpy(dst + 3, &normals[c.n * 3], sizeof(float) * 3);
+		}
+		else {
+			dst[3] = dst[4] = dst[5] = 0.0f;
+		}
+		if (c.t != OBJ_MISSING) {
+			memcpy(dst + 6, &texcoords[c.t * 2], sizeof(float) * 2);
+		}
+		else {
+			dst[6] = dst[7] = 0.0f;
+		}
+	}
+
+	//Area weighted face normals for the vertices the file gave none
+	if (missing_normals) {
+		float* vertices = out.m_vertices.data();
+		for (usize i = 0; i + 2 < corner_count; i += 3) {
+			float* a = &vertices[out.m_indices[i] * 8];
+			float* b = &vertices[out.m_indices[i + 1] * 8];
+			float* c = &vertices[out.m_indices[i + 2] * 8];
+			glm::vec3 face_normal = glm::cross(
+				glm::vec3(b[0] - a[0], b[1] - a[1], b[2] - a[2]),
+				glm::vec3(c[0] - a[0], c[1] - a[1], c[2] - a[2]));
+			float* corners_of_face[3] = { a, b, c };
+			for (int k = 0; k < 3; ++k) {
+				if (unique[out.m_indices[i + k]].n != OBJ_MISSING) continue;
+				corners_of_face[k][3] += face_normal.x;
+				corners_of_face[k][4] += face_normal.y;
+				corners_of_face[k][5] += face_normal.z;
+			}
+		}
+		for (usize i = 0; i < vertex_count; ++i) {
+			if (unique[i].n != OBJ_MISSING) continue;
+			float* v = &vertices[i * 8];
+			glm::vec3 normal(v[3], v[4], v[5]);
+			float length = glm::length(normal);
+			normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+			v[3] = normal.x;
+			v[4] = normal.y;
+			v[5] = normal.z;
+		}
+	}
+
+	return true;
+}
+
+#undef OBJ_MIN_CHUNK_SIZE
+#undef OBJ_MISSING
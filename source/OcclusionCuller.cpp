@@ -0,0 +1,266 @@
+#include "GL/glew.h"
+#include "OcclusionCuller.h"
+#include "ShaderCache.h"
+
+#include <algorithm>
+
+//Box corners come from gl_VertexID, 36 vertices per box, no vertex buffer. Faces aren't culled
+//so winding doesn't matter
+static const GLchar* proxy_vertex_shader_source = R"(
+#version 450 core
+
+#extension GL_ARB_shader_draw_parameters : require
+
+layout (location = 0)
+uniform mat4 u_viewProj;
+
+struct Box
+{
+	vec4 box_min;
+	vec4 box_max;
+};
+
+layout (std430, binding = 0) readonly buffer Boxes
+{
+	Box boxes[];
+};
+
+const int corners[36] = int[36](
+	0, 1, 2, 2, 1, 3,
+	4, 6, 5, 5, 6, 7,
+	0, 2, 4, 4, 2, 6,
+	1, 5, 3, 3, 5, 7,
+	0, 4, 1, 1, 4, 5,
+	2, 3, 6, 6, 3, 7);
+
+void main(void)
+{
+	Box box = boxes[gl_BaseInstanceARB];
+	int c = corners[gl_VertexID];
+	vec3 t = vec3(c & 1, (c >> 1) & 1, (c >> 2) & 1);
+	gl_Position = u_viewProj * vec4(mix(box.box_min.xyz, box.box_max.xyz, t), 1.0);
+}
+)";
+
+static const GLchar* proxy_fragment_shader_source = R"(
+#version 450 core
+
+void main()
+{
+}
+)";
+
+static ShaderText proxy_shader_text[] = {
+	{GL_VERTEX_SHADER, proxy_vertex_shader_source, NULL},
+	{GL_FRAGMENT_SHADER, proxy_fragment_shader_source, NULL},
+	{GL_NONE, NULL, NULL}
+};
+
+//Spreads the low 10 bits of v three apart
+static u32 ExpandBits(u32 v)
+{
+	v = (v * 0x00010001u) & 0xFF0000FFu;
+	v = (v * 0x00000101u) & 0x0F00F00Fu;
+	v = (v * 0x00000011u) & 0xC30C30C3u;
+	v = (v * 0x00000005u) & 0x49249249u;
+	return v;
+}
+
+bool OcclusionCuller::Init()
+{
+	m_program = LoadShaders(proxy_shader_text);
+	glCreateVertexArrays(1, &m_vao);
+	return ShaderCache::Resolve(m_program);
+}
+
+void OcclusionCuller::Destroy()
+{
+	for (Node& node : m_nodes) glDeleteQueries(1, &node.m_query);
+	if (m_box_buffer) glDeleteBuffers(1, &m_box_buffer);
+	if (m_vao) glDeleteVertexArrays(1, &m_vao);
+	if (m_program) glDeleteProgram(m_program);
+	m_box_buffer = m_vao = m_program = 0;
+	m_nodes.clear();
+	m_in_flight.clear();
+	m_visible.clear();
+}
+
+void OcclusionCuller::Build(const OcclusionBox* boxes, u32 count)
+{
+	for (Node& node : m_nodes) glDeleteQueries(1, &node.m_query);
+	if (m_box_buffer) glDeleteBuffers(1, &m_box_buffer);
+	m_box_buffer = 0;
+	m_in_flight.clear();
+
+	m_object_count = count;
+	m_group_count = (count + OCCLUSION_GROUP_SIZE - 1) / OCCLUSION_GROUP_SIZE;
+	if (count == 0) {
+		m_nodes.clear();
+		m_visible.clear();
+		return;
+	}
+
+	//Sort the objects along a Morton curve over the scene bounds so each run of
+	//OCCLUSION_GROUP_SIZE is spatially compact
+	OcclusionBox scene = boxes[0];
+	for (u32 i = 1; i < count; ++i) {
+		scene.m_min = glm::min(scene.m_min, boxes[i].m_min);
+		scene.m_max = glm::max(scene.m_max, boxes[i].m_max);
+	}
+	const glm::vec3 scale = 1023.0f / glm::max(scene.m_max - scene.m_min, glm::vec3(1e-6f));
+
+	std::vector<std::pair<u32, u32>> keys(count);
+	for (u32 i = 0; i < count; ++i) {
+		glm::uvec3 q = glm::uvec3(((boxes[i].m_min + boxes[i].m_max) * 0.5f - scene.m_min) * scale);
+		keys[i] = { ExpandBits(q.x) | (ExpandBits(q.y) << 1) | (ExpandBits(q.z) << 2), i };
+	}
+	std::sort(keys.begin(), keys.end());
+	m_order.resize(count);
+	for (u32 i = 0; i < count; ++i) m_order[i] = keys[i].second;
+
+	//Node boxes, groups first
+	m_boxes.resize(m_group_count + count);
+	for (u32 g = 0; g < m_group_count; ++g) {
+		const u32 first = g * OCCLUSION_GROUP_SIZE;
+		const u32 last = std::min(first + OCCLUSION_GROUP_SIZE, count);
+		OcclusionBox box = boxes[m_order[first]];
+		for (u32 i = first + 1; i < last; ++i) {
+			box.m_min = glm::min(box.m_min, boxes[m_order[i]].m_min);
+			box.m_max = glm::max(box.m_max, boxes[m_order[i]].m_max);
+		}
+		m_boxes[g] = box;
+	}
+	for (u32 i = 0; i < count; ++i) m_boxes[m_group_count + i] = boxes[i];
+
+	std::vector<glm::vec4> padded(m_boxes.size() * 2);
+	for (usize i = 0; i < m_boxes.size(); ++i) {
+		padded[i * 2 + 0] = glm::vec4(m_boxes[i].m_min, 0.0f);
+		padded[i * 2 + 1] = glm::vec4(m_boxes[i].m_max, 0.0f);
+	}
+	glCreateBuffers(1, &m_box_buffer);
+	glNamedBufferStorage(m_box_buffer, padded.size() * sizeof(glm::vec4), padded.data(), 0);
+
+	//Everything starts out visible and gets culled once the first results are in
+	m_nodes.resize(m_boxes.size());
+	std::vector<GLuint> queries(m_nodes.size());
+	glGenQueries((GLsizei)queries.size(), queries.data());
+	for (usize i = 0; i < m_nodes.size(); ++i) {
+		m_nodes[i] = { queries[i], false, true };
+	}
+	m_visible = m_order;
+}
+
+bool OcclusionCuller::Inside(u32 node, const glm::vec3& eye) const
+{
+	//A box the camera is in, or nearly in, can have all its faces clipped by the near plane and
+	//would come back hidden
+	const float margin = 0.5f;
+	const OcclusionBox& box = m_boxes[node];
+	return glm::all(glm::greaterThanEqual(eye, box.m_min - margin)) && glm::all(glm::lessThanEqual(eye, box.m_max + margin));
+}
+
+void OcclusionCuller::Update(const glm::vec3& eye)
+{
+	//Queries finish in the order they were issued, stop at the first one that isn't done
+	while (!m_in_flight.empty()) {
+		const u32 index = m_in_flight.front();
+		Node& node = m_nodes[index];
+		GLuint available = 0;
+		glGetQueryObjectuiv(node.m_query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) break;
+
+		GLuint passed = 0;
+		glGetQueryObjectuiv(node.m_query, GL_QUERY_RESULT, &passed);
+		if (index < m_group_count && passed && !node.m_visible) {
+			//A group coming into view hasn't had its objects queried for a while, draw them all
+			//until their own results say otherwise
+			const u32 first = index * OCCLUSION_GROUP_SIZE;
+			const u32 last = std::min(first + OCCLUSION_GROUP_SIZE, m_object_count);
+			for (u32 i = first; i < last; ++i) {
+				Node& object = m_nodes[m_group_count + m_order[i]];
+				if (!object.m_pending) object.m_visible = true;
+			}
+		}
+		node.m_visible = passed != 0;
+		node.m_pending = false;
+		m_in_flight.pop_front();
+	}
+
+	m_visible.clear();
+	m_stats.m_visible_groups = 0;
+	for (u32 g = 0; g < m_group_count; ++g) {
+		if (!m_nodes[g].m_visible && !Inside(g, eye)) continue;
+		m_stats.m_visible_groups++;
+
+		const u32 first = g * OCCLUSION_GROUP_SIZE;
+		const u32 last = std::min(first + OCCLUSION_GROUP_SIZE, m_object_count);
+		for (u32 i = first; i < last; ++i) {
+			const u32 object = m_order[i];
+			if (m_nodes[m_group_count + object].m_visible || Inside(m_group_count + object, eye)) {
+				m_visible.push_back(object);
+			}
+		}
+	}
+	m_stats.m_visible_objects = (u32)m_visible.size();
+}
+
+void OcclusionCuller::Issue(u32 node)
+{
+	if (m_nodes[node].m_pending) {
+		m_stats.m_pending++;
+		return;
+	}
+	glBeginQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, m_nodes[node].m_query);
+	glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, 36, 1, node);
+	glEndQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE);
+	m_nodes[node].m_pending = true;
+	m_in_flight.push_back(node);
+	m_stats.m_queries++;
+}
+
+void OcclusionCuller::Query(const glm::mat4& view_proj, const glm::vec3& eye)
+{
+	m_stats.m_queries = 0;
+	m_stats.m_pending = 0;
+	if (m_group_count == 0) return;
+
+	GLint depth_func;
+	glGetIntegerv(GL_DEPTH_FUNC, &depth_func);
+	GLboolean color_mask[4];
+	glGetBooleanv(GL_COLOR_WRITEMASK, color_mask);
+	GLboolean depth_mask;
+	glGetBooleanv(GL_DEPTH_WRITEMASK, &depth_mask);
+	const GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+	const GLboolean cull_face = glIsEnabled(GL_CULL_FACE);
+
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_FALSE);
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LEQUAL);
+	glDisable(GL_CULL_FACE);
+
+	glUseProgram(m_program);
+	glUniformMatrix4fv(0, 1, GL_FALSE, &view_proj[0][0]);
+	glBindVertexArray(m_vao);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_box_buffer);
+
+	for (u32 g = 0; g < m_group_count; ++g) {
+		const bool inside = Inside(g, eye);
+		if (!inside) Issue(g);
+
+		//Hidden groups stop here, one query stands for all of their objects
+		if (!m_nodes[g].m_visible && !inside) continue;
+		const u32 first = g * OCCLUSION_GROUP_SIZE;
+		const u32 last = std::min(first + OCCLUSION_GROUP_SIZE, m_object_count);
+		for (u32 i = first; i < last; ++i) {
+			const u32 object = m_group_count + m_order[i];
+			if (!Inside(object, eye)) Issue(object);
+		}
+	}
+
+	glColorMask(color_mask[0], color_mask[1], color_mask[2], color_mask[3]);
+	glDepthMask(depth_mask);
+	glDepthFunc(depth_func);
+	if (!depth_test) glDisable(GL_DEPTH_TEST);
+	if (cull_face) glEnable(GL_CULL_FACE);
+}
@@ -0,0 +1,195 @@
+#include <GL/glew.h>
+#include "PacketStream.h"
+
+//-------------------------------------------------------------------------------------------------
+// PACKET STREAM
+//-------------------------------------------------------------------------------------------------
+
+void PacketStream::Reset()
+{
+	for (usize b = 0; b <= m_block && b < m_blocks.size(); ++b) {
+		m_blocks[b].m_used = 0;
+	}
+	m_block = 0;
+	m_count = 0;
+}
+
+usize PacketStream::Bytes() const
+{
+	usize bytes = 0;
+	for (usize b = 0; b <= m_block && b < m_blocks.size(); ++b) {
+		bytes += m_blocks[b].m_used;
+	}
+	return bytes;
+}
+
+template <typename T>
+T* PacketStream::Next(packet::Type type)
+{
+	const usize size = (sizeof(T) + 7) & ~(usize)7;
+	static_assert(sizeof(T) <= PACKET_BLOCK_SIZE, "Packet larger than a block");
+
+	if (m_blocks.empty()) {
+		m_blocks.emplace_back();
+		m_blocks[0].m_data.reset(new u8[PACKET_BLOCK_SIZE]);
+	}
+	if (m_blocks[m_block].m_used + size > PACKET_BLOCK_SIZE) {
+		//Move on to the next block, reusing one left from an earlier frame if there is one
+		if (++m_block == m_blocks.size()) {
+			m_blocks.emplace_back();
+			m_blocks[m_block].m_data.reset(new u8[PACKET_BLOCK_SIZE]);
+		}
+		m_blocks[m_block].m_used = 0;
+	}
+
+	Block& block = m_blocks[m_block];
+	T* p = (T*)(block.m_data.get() + block.m_used);
+	block.m_used += size;
+	m_count++;
+
+	p->header.type = type;
+	p->header.size = (u16)size;
+	return p;
+}
+
+void PacketStream::BindProgram(GLuint program)
+{
+	packet::BIND_PROGRAM* p = Next<packet::BIND_PROGRAM>(packet::Type::BindProgram);
+	p->program = program;
+}
+
+void PacketStream::BindVertexArray(GLuint vao)
+{
+	packet::BIND_VERTEX_ARRAY* p = Next<packet::BIND_VERTEX_ARRAY>(packet::Type::BindVertexArray);
+	p->vao = vao;
+}
+
+void PacketStream::BindBufferRange(GLenum target, GLuint index, GLuint buffer, usize offset, usize size)
+{
+	packet::BIND_BUFFER_RANGE* p = Next<packet::BIND_BUFFER_RANGE>(packet::Type::BindBufferRange);
+	p->target = target;
+	p->index = index;
+	p->buffer = buffer;
+	p->offset = offset;
+	p->size = size;
+}
+
+void PacketStream::BindTexture(GLuint unit, GLuint texture)
+{
+	packet::BIND_TEXTURE* p = Next<packet::BIND_TEXTURE>(packet::Type::BindTexture);
+	p->unit = unit;
+	p->texture = texture;
+}
+
+void PacketStream::DrawArrays(GLenum mode, GLint first, GLsizei count, GLsizei instances, GLuint base_instance)
+{
+	packet::DRAW_ARRAYS* p = Next<packet::DRAW_ARRAYS>(packet::Type::DrawArrays);
+	p->mode = mode;
+	p->first = first;
+	p->count = count;
+	p->instances = instances;
+	p->base_instance = base_instance;
+}
+
+void PacketStream::DrawElements(GLenum mode, GLsizei count, GLenum type, usize offset, GLsizei instances, GLint base_vertex, GLuint base_instance)
+{
+	packet::DRAW_ELEMENTS* p = Next<packet::DRAW_ELEMENTS>(packet::Type::DrawElements);
+	p->mode = mode;
+	p->count = count;
+	p->type = type;
+	p->base_vertex = base_vertex;
+	p->offset = offset;
+	p->instances = instances;
+	p->base_instance = base_instance;
+}
+
+//-------------------------------------------------------------------------------------------------
+// PACKET REPLAY
+//-------------------------------------------------------------------------------------------------
+
+void PacketReplay::Invalidate()
+{
+	m_program = PACKET_UNKNOWN;
+	m_vao = PACKET_UNKNOWN;
+	for (int i = 0; i < PACKET_MAX_BINDINGS; ++i) {
+		m_uniform[i] = { PACKET_UNKNOWN, 0, 0 };
+		m_storage[i] = { PACKET_UNKNOWN, 0, 0 };
+		m_textures[i] = PACKET_UNKNOWN;
+	}
+}
+
+void PacketReplay::Execute(const PacketStream& stream)
+{
+	stream.ForEach([this](const packet::Header* header) { ExecutePacket(header); });
+}
+
+void PacketReplay::Execute(const PacketStream* streams, usize count)
+{
+	for (usize i = 0; i < count; ++i) {
+		Execute(streams[i]);
+	}
+}
+
+bool PacketReplay::SetRange(BufferRange* ranges, const packet::BIND_BUFFER_RANGE* p)
+{
+	if (p->index >= PACKET_MAX_BINDINGS) return true;
+	BufferRange& range = ranges[p->index];
+	if (range.buffer == p->buffer && range.offset == p->offset && range.size == p->size) return false;
+	range = { p->buffer, p->offset, p->size };
+	return true;
+}
+
+void PacketReplay::ExecutePacket(const packet::Header* header)
+{
+	m_stats.m_packets++;
+
+	switch (header->type) {
+	case packet::Type::BindProgram: {
+		const packet::BIND_PROGRAM* p = (const packet::BIND_PROGRAM*)header;
+		if (m_eliminate && m_program == p->program) break;
+		m_program = p->program;
+		glUseProgram(p->program);
+		return;
+	}
+	case packet::Type::BindVertexArray: {
+		const packet::BIND_VERTEX_ARRAY* p = (const packet::BIND_VERTEX_ARRAY*)header;
+		if (m_eliminate && m_vao == p->vao) break;
+		m_vao = p->vao;
+		glBindVertexArray(p->vao);
+		return;
+	}
+	case packet::Type::BindBufferRange: {
+		const packet::BIND_BUFFER_RANGE* p = (const packet::BIND_BUFFER_RANGE*)header;
+		bool changed = true;
+		if (p->target == GL_UNIFORM_BUFFER) changed = SetRange(m_uniform, p);
+		else if (p->target == GL_SHADER_STORAGE_BUFFER) changed = SetRange(m_storage, p);
+		if (m_eliminate && !changed) break;
+		glBindBufferRange(p->target, p->index, p->buffer, (GLintptr)p->offset, (GLsizeiptr)p->size);
+		return;
+	}
+	case packet::Type::BindTexture: {
+		const packet::BIND_TEXTURE* p = (const packet::BIND_TEXTURE*)header;
+		if (p->unit < PACKET_MAX_BINDINGS) {
+			if (m_eliminate && m_textures[p->unit] == p->texture) break;
+			m_textures[p->unit] = p->texture;
+		}
+		glBindTextureUnit(p->unit, p->texture);
+		return;
+	}
+	case packet::Type::DrawArrays: {
+		const packet::DRAW_ARRAYS* p = (const packet::DRAW_ARRAYS*)header;
+		glDrawArraysInstancedBaseInstance(p->mode, p->first, p->count, p->instances, p->base_instance);
+		m_stats.m_draws++;
+		return;
+	}
+	case packet::Type::DrawElements: {
+		const packet::DRAW_ELEMENTS* p = (const packet::DRAW_ELEMENTS*)header;
+		glDrawElementsInstancedBaseVertexBaseInstance(p->mode, p->count, p->type, (const void*)p->offset, p->instances, p->base_vertex, p->base_instance);
+		m_stats.m_draws++;
+		return;
+	}
+	}
+
+	//Only binds that were already in place get here
+	m_stats.m_skipped++;
+}
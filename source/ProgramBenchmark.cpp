@@ -0,0 +1,291 @@
+#include "ProgramBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+
+//-------------------------------------------------------------------------------------------------
+// PROGRAM REGISTRY
+//-------------------------------------------------------------------------------------------------
+
+//Function local so registrars in any translation unit can run before it's otherwise touched
+static std::vector<RegisteredProgram>& Registered()
+{
+	static std::vector<RegisteredProgram> programs;
+	return programs;
+}
+
+void ProgramRegistry::Register(const char* name, const SystemConf& config, ProgramFactory factory)
+{
+	std::string stem = name;
+	const usize slash = stem.find_last_of("/\\");
+	if (slash != std::string::npos) stem = stem.substr(slash + 1);
+	const usize dot = stem.find_last_of('.');
+	if (dot != std::string::npos && dot > 0) stem = stem.substr(0, dot);
+	Registered().push_back({ stem, config, factory });
+}
+
+const std::vector<RegisteredProgram>& ProgramRegistry::Programs()
+{
+	return Registered();
+}
+
+//-------------------------------------------------------------------------------------------------
+// PROGRAM BENCHMARK
+//-------------------------------------------------------------------------------------------------
+
+static f64 Milliseconds(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+	return std::chrono::duration<f64, std::milli>(end - start).count();
+}
+
+//Nearest rank percentiles
+static FrameTimeStats Summarize(std::vector<f64> samples)
+{
+	FrameTimeStats stats = {};
+	stats.m_samples = (u32)samples.size();
+	if (samples.empty()) return stats;
+
+	std::sort(samples.begin(), samples.end());
+	f64 sum = 0.0;
+	for (f64 sample : samples) sum += sample;
+	auto percentile = [&](f64 p) {
+		const usize rank = (usize)std::ceil(p * 0.01 * samples.size());
+		return samples[std::min(std::max(rank, (usize)1), (usize)samples.size()) - 1];
+	};
+	stats.m_mean = sum / samples.size();
+	stats.m_min = samples.front();
+	stats.m_p50 = percentile(50.0);
+	stats.m_p90 = percentile(90.0);
+	stats.m_p95 = percentile(95.0);
+	stats.m_p99 = percentile(99.0);
+	stats.m_max = samples.back();
+	return stats;
+}
+
+bool ProgramBenchmark::Run(const RegisteredProgram& registered, const BenchmarkSettings& settings, ProgramBenchmarkResult* result)
+{
+	SystemConf config = registered.m_config;
+	config.hidden = true;
+	config.windowed_fullscreen = false;
+	config.vsync = false;
+	if (settings.m_width > 0 && settings.m_height > 0) {
+		config.width = settings.m_width;
+		config.height = settings.m_height;
+	}
+
+	result->m_name = registered.m_name;
+	result->m_width = config.width;
+	result->m_height = config.height;
+
+	System system(config);
+	if (!system.IsValid()) {
+		std::cerr << registered.m_name << " skipped, no usable GL context" << std::endl;
+		return false;
+	}
+	Window& window = system.m_window;
+	Input& input = system.m_input;
+	Audio& audio = system.m_audio;
+	glfwSwapInterval(0);
+
+	const GLubyte* renderer = glGetString(GL_RENDERER);
+	result->m_renderer = renderer ? (const char*)renderer : "";
+
+	Random::Init();
+	AssetManager::Init();
+	GpuProfiler::SetHistory(settings.m_warmup + settings.m_frames);
+	Program* program = registered.m_factory();
+
+	const auto init_start = std::chrono::steady_clock::now();
+	program->OnInit(input, audio, window);
+	ShaderCache::ResolveAll();
+	//Loads still landing would be measured as frames otherwise
+	AssetManager::WaitIdle();
+	glFinish();
+	result->m_init_ms = Milliseconds(init_start, std::chrono::steady_clock::now());
+
+	std::vector<f64> frame_ms, update_ms, draw_ms;
+	frame_ms.reserve(settings.m_frames);
+	update_ms.reserve(settings.m_frames);
+	draw_ms.reserve(settings.m_frames);
+
+	const u32 total = settings.m_warmup + settings.m_frames;
+	for (u32 frame = 0; frame < total && window.IsRunning(); ++frame) {
+		const auto frame_start = std::chrono::steady_clock::now();
+		glfwPollEvents();
+
+		window.UpdateFPS();
+		window.UpdateTime(settings.m_dt);
+		AssetManager::Pump(AssetManager::GetUploadBudget());
+
+		const auto update_start = std::chrono::steady_clock::now();
+		program->OnUpdate(input, audio, window, settings.m_dt);
+		const auto update_end = std::chrono::steady_clock::now();
+
+		GpuProfiler::BeginFrame();
+		GLState::BeginFrame();
+		const auto draw_start = std::chrono::steady_clock::now();
+		{
+			GpuScope scope("OnDraw");
+			program->OnDraw();
+		}
+		const auto draw_end = std::chrono::steady_clock::now();
+		GpuProfiler::EndFrame();
+
+		input.AdvanceInput();
+		glfwSwapBuffers(window.m_handle);
+		const auto frame_end = std::chrono::steady_clock::now();
+
+		if (frame < settings.m_warmup) continue;
+		frame_ms.push_back(Milliseconds(frame_start, frame_end));
+		update_ms.push_back(Milliseconds(update_start, update_end));
+		draw_ms.push_back(Milliseconds(draw_start, draw_end));
+	}
+
+	//Profiler frames count from 1 after Shutdown, the warm-up ones come first
+	GpuProfiler::Flush();
+	std::vector<f64> gpu_ms;
+	for (const GpuFrameTimings& timings : GpuProfiler::History()) {
+		if (timings.frame > settings.m_warmup) gpu_ms.push_back(timings.ms);
+	}
+
+	result->m_frame = Summarize(frame_ms);
+	result->m_update = Summarize(update_ms);
+	result->m_draw = Summarize(draw_ms);
+	result->m_gpu = Summarize(gpu_ms);
+
+	delete program;
+	GpuProfiler::Shutdown();
+	AssetManager::Shutdown();
+
+	if (result->m_frame.m_samples < settings.m_frames) {
+		std::cerr << registered.m_name << " stopped after " << result->m_frame.m_samples << " of " << settings.m_frames << " measured frames" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+static void WriteStatsJSON(std::ofstream& file, const char* name, const FrameTimeStats& stats)
+{
+	file << "\"" << name << "\":{\"samples\":" << stats.m_samples << ",\"mean\":" << stats.m_mean << ",\"min\":" << stats.m_min
+		<< ",\"p50\":" << stats.m_p50 << ",\"p90\":" << stats.m_p90 << ",\"p95\":" << stats.m_p95 << ",\"p99\":" << stats.m_p99
+		<< ",\"max\":" << stats.m_max << "}";
+}
+
+static std::string EscapeJSON(const std::string& text)
+{
+	std::string escaped;
+	for (char c : text) {
+		if (c == '"' || c == '\\') escaped += '\\';
+		if ((unsigned char)c >= 0x20) escaped += c;
+	}
+	return escaped;
+}
+
+bool ProgramBenchmark::WriteJSON(const char* filename, const BenchmarkSettings& settings, const std::vector<ProgramBenchmarkResult>& results)
+{
+	std::ofstream file(filename);
+	if (!file.is_open()) {
+		std::cerr << "Unable to open file '" << filename << "'" << std::endl;
+		return false;
+	}
+
+	//Milliseconds throughout
+	file << std::fixed << std::setprecision(4);
+	file << "{\"warmup\":" << settings.m_warmup << ",\"frames\":" << settings.m_frames << ",\"dt\":" << std::setprecision(6) << settings.m_dt << std::setprecision(4)
+		<< ",\"programs\":[";
+	bool first = true;
+	for (const ProgramBenchmarkResult& result : results) {
+		file << (first ? "\n" : ",\n");
+		file << "{\"name\":\"" << EscapeJSON(result.m_name) << "\",\"renderer\":\"" << EscapeJSON(result.m_renderer)
+			<< "\",\"width\":" << result.m_width << ",\"height\":" << result.m_height << ",\"init_ms\":" << result.m_init_ms << ",";
+		WriteStatsJSON(file, "frame_ms", result.m_frame);
+		file << ",";
+		WriteStatsJSON(file, "update_ms", result.m_update);
+		file << ",";
+		WriteStatsJSON(file, "draw_ms", result.m_draw);
+		file << ",";
+		WriteStatsJSON(file, "gpu_ms", result.m_gpu);
+		file << "}";
+		first = false;
+	}
+	file << "\n]}\n";
+	return true;
+}
+
+bool ProgramBenchmark::WriteCSV(const char* filename, const std::vector<ProgramBenchmarkResult>& results)
+{
+	std::ofstream file(filename);
+	if (!file.is_open()) {
+		std::cerr << "Unable to open file '" << filename << "'" << std::endl;
+		return false;
+	}
+
+	file << std::fixed << std::setprecision(4);
+	file << "program,width,height,measure,samples,mean_ms,min_ms,p50_ms,p90_ms,p95_ms,p99_ms,max_ms\n";
+	for (const ProgramBenchmarkResult& result : results) {
+		const std::pair<const char*, const FrameTimeStats*> rows[] = {
+			{ "frame", &result.m_frame },
+			{ "update", &result.m_update },
+			{ "draw", &result.m_draw },
+			{ "gpu", &result.m_gpu },
+		};
+		for (const auto& row : rows) {
+			const FrameTimeStats& stats = *row.second;
+			file << result.m_name << "," << result.m_width << "," << result.m_height << "," << row.first << "," << stats.m_samples << ","
+				<< stats.m_mean << "," << stats.m_min << "," << stats.m_p50 << "," << stats.m_p90 << ","
+				<< stats.m_p95 << "," << stats.m_p99 << "," << stats.m_max << "\n";
+		}
+	}
+	return true;
+}
+
+static int Usage()
+{
+	std::cerr << "Usage: Application [-w warmup] [-n frames] [-d dt] [-s WxH] [-f filter] [-j results.json] [-c results.csv]" << std::endl;
+	return 1;
+}
+
+int ProgramBenchmark::Main(int argc, char** argv)
+{
+	BenchmarkSettings settings;
+	for (int i = 1; i < argc; ++i) {
+		const char* arg = argv[i];
+		const bool has_value = i + 1 < argc;
+		if (strcmp(arg, "-w") == 0 && has_value) settings.m_warmup = (u32)atoi(argv[++i]);
+		else if (strcmp(arg, "-n") == 0 && has_value) settings.m_frames = (u32)std::max(atoi(argv[++i]), 1);
+		else if (strcmp(arg, "-d") == 0 && has_value) settings.m_dt = atof(argv[++i]);
+		else if (strcmp(arg, "-s") == 0 && has_value) {
+			if (sscanf(argv[++i], "%dx%d", &settings.m_width, &settings.m_height) != 2) return Usage();
+		}
+		else if (strcmp(arg, "-f") == 0 && has_value) settings.m_filter = argv[++i];
+		else if (strcmp(arg, "-j") == 0 && has_value) settings.m_json = argv[++i];
+		else if (strcmp(arg, "-c") == 0 && has_value) settings.m_csv = argv[++i];
+		else return Usage();
+	}
+
+	std::vector<ProgramBenchmarkResult> results;
+	int failed = 0;
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "program, frames, frame p50, frame p95, frame p99, gpu p50, gpu p95, gpu p99 (ms)" << std::endl;
+	for (const RegisteredProgram& program : ProgramRegistry::Programs()) {
+		if (settings.m_filter && program.m_name.find(settings.m_filter) == std::string::npos) continue;
+
+		ProgramBenchmarkResult result = {};
+		if (!ProgramBenchmark::Run(program, settings, &result)) failed++;
+		std::cout << result.m_name << ", " << result.m_frame.m_samples << ", " << result.m_frame.m_p50 << ", " << result.m_frame.m_p95 << ", "
+			<< result.m_frame.m_p99 << ", " << result.m_gpu.m_p50 << ", " << result.m_gpu.m_p95 << ", " << result.m_gpu.m_p99 << std::endl;
+		results.push_back(result);
+	}
+	if (results.empty()) {
+		std::cerr << "No registered program to benchmark" << std::endl;
+		return 1;
+	}
+
+	if (settings.m_json && !WriteJSON(settings.m_json, settings, results)) failed++;
+	if (settings.m_csv && !WriteCSV(settings.m_csv, results)) failed++;
+	return failed ? 1 : 0;
+}
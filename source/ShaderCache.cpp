@@ -0,0 +1,258 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "ShaderCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//First four bytes of a cache file, "SBPB"
+#define PROGRAM_BINARY_MAGIC 0x42504253u
+
+struct ProgramBinaryHeader {
+	u32 magic;
+	GLenum format;
+	u64 key;			//Checked against the file name's key, catches truncated names
+	u32 size;
+};
+
+//A program whose link status hasn't been checked yet
+struct PendingProgram {
+	u64 key;
+	std::vector<GLuint> shaders;
+};
+
+struct ShaderCacheState {
+	bool initialized = false;
+	bool binaries = false;		//Driver supports at least one binary format
+	bool parallel = false;		//Driver has GL_KHR/ARB_parallel_shader_compile
+	u64 driver = 0;				//Hash of the driver strings, seeds every key
+	std::unordered_map<GLuint, PendingProgram> pending;
+	ShaderCacheStats stats = {};
+};
+
+static ShaderCacheState s_cache;
+
+bool ShaderCache::s_async = true;
+bool ShaderCache::s_binaries = true;
+const char* ShaderCache::s_directory = "shader_cache";
+
+//FNV-1a
+static u64 Hash(u64 hash, const void* data, usize size)
+{
+	const u8* bytes = (const u8*)data;
+	for (usize i = 0; i < size; ++i) {
+		hash ^= bytes[i];
+		hash *= 0x100000001B3ull;
+	}
+	return hash;
+}
+
+static void EnsureInit()
+{
+	if (s_cache.initialized) return;
+	s_cache.initialized = true;
+
+	s_cache.driver = 0xCBF29CE484222325ull;
+	const GLenum strings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+	for (GLenum name : strings) {
+		const char* value = (const char*)glGetString(name);
+		if (value) s_cache.driver = Hash(s_cache.driver, value, strlen(value));
+	}
+
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	s_cache.binaries = formats > 0;
+
+	//Let the driver use as many compiler threads as it likes
+	if (GLEW_KHR_parallel_shader_compile) {
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		s_cache.parallel = true;
+	}
+	else if (GLEW_ARB_parallel_shader_compile) {
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+		s_cache.parallel = true;
+	}
+}
+
+static std::string BinaryPath(const char* directory, u64 key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", key);
+	return std::string(directory) + "/" + name;
+}
+
+static GLuint LoadBinary(const char* directory, u64 key)
+{
+	const std::string path = BinaryPath(directory, key);
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) return 0;
+
+	ProgramBinaryHeader header;
+	std::vector<u8> data;
+	if (file.read((char*)&header, sizeof(header)) && header.magic == PROGRAM_BINARY_MAGIC && header.key == key) {
+		data.resize(header.size);
+		if (!file.read((char*)data.data(), header.size)) data.clear();
+	}
+	file.close();
+
+	if (!data.empty()) {
+		GLuint program = glCreateProgram();
+		glProgramBinary(program, header.format, data.data(), (GLsizei)data.size());
+
+		GLint linked;
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+		if (linked) return program;
+		glDeleteProgram(program);
+	}
+
+	//Stale or broken, compile the sources and write it again
+	std::error_code error;
+	std::filesystem::remove(path, error);
+	return 0;
+}
+
+static void StoreBinary(const char* directory, u64 key, GLuint program)
+{
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+
+	ProgramBinaryHeader header = { PROGRAM_BINARY_MAGIC, GL_NONE, key, 0 };
+	std::vector<u8> data(length);
+	glGetProgramBinary(program, length, &length, &header.format, data.data());
+	header.size = (u32)length;
+
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	const std::string path = BinaryPath(directory, key);
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		std::cerr << "Unable to open file '" << path << "'" << std::endl;
+		return;
+	}
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)data.data(), length);
+}
+
+GLuint ShaderCache::Load(const GLenum* types, const char* const* sources, u32 count, GLuint* shaders,
+	const char* const* varyings, u32 varying_count, GLenum buffer_mode)
+{
+	const f64 start = glfwGetTime();
+	EnsureInit();
+	const bool binaries = s_binaries && s_cache.binaries;
+
+	u64 key = s_cache.driver;
+	for (u32 i = 0; i < count; ++i) {
+		key = Hash(key, &types[i], sizeof(GLenum));
+		key = Hash(key, sources[i], strlen(sources[i]));
+		shaders[i] = 0;
+	}
+	//Same sources captured differently is a different binary
+	for (u32 i = 0; i < varying_count; ++i) {
+		key = Hash(key, varyings[i], strlen(varyings[i]) + 1);
+	}
+	if (varying_count) key = Hash(key, &buffer_mode, sizeof(GLenum));
+
+	s_cache.stats.m_programs++;
+	if (binaries) {
+		GLuint program = LoadBinary(s_directory, key);
+		if (program) {
+			s_cache.stats.m_hits++;
+			s_cache.stats.m_submit_ms += (glfwGetTime() - start) * 1000.0;
+			return program;
+		}
+	}
+
+	GLuint program = glCreateProgram();
+	if (binaries) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+	PendingProgram& pending = s_cache.pending[program];
+	pending.key = key;
+	for (u32 i = 0; i < count; ++i) {
+		shaders[i] = glCreateShader(types[i]);
+		glShaderSource(shaders[i], 1, &sources[i], nullptr);
+		glCompileShader(shaders[i]);
+		glAttachShader(program, shaders[i]);
+		pending.shaders.push_back(shaders[i]);
+	}
+	if (varying_count) glTransformFeedbackVaryings(program, (GLsizei)varying_count, varyings, buffer_mode);
+	glLinkProgram(program);
+	s_cache.stats.m_submit_ms += (glfwGetTime() - start) * 1000.0;
+
+	if (s_async) return program;
+	if (Resolve(program)) return program;
+
+	glDeleteProgram(program);
+	return 0;
+}
+
+bool ShaderCache::Resolve(GLuint program)
+{
+	auto it = s_cache.pending.find(program);
+	if (it == s_cache.pending.end()) {
+		GLint linked = GL_FALSE;
+		if (program) glGetProgramiv(program, GL_LINK_STATUS, &linked);
+		return linked != GL_FALSE;
+	}
+
+	//Blocks until the driver is done with it
+	const f64 start = glfwGetTime();
+	GLint linked;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (linked) {
+		if (s_binaries && s_cache.binaries) StoreBinary(s_directory, it->second.key, program);
+	}
+	else {
+		for (GLuint shader : it->second.shaders) GetShaderCompilationStatus(shader);
+		GetProgramLinkedStatus(program);
+		s_cache.stats.m_failed++;
+	}
+
+	for (GLuint shader : it->second.shaders) {
+		glDetachShader(program, shader);
+		glDeleteShader(shader);
+	}
+	s_cache.pending.erase(it);
+	s_cache.stats.m_resolve_ms += (glfwGetTime() - start) * 1000.0;
+	return linked != GL_FALSE;
+}
+
+void ShaderCache::ResolveAll()
+{
+	//Collect first, Resolve erases from the map
+	std::vector<GLuint> programs;
+	programs.reserve(s_cache.pending.size());
+	for (const auto& entry : s_cache.pending) programs.push_back(entry.first);
+	for (GLuint program : programs) Resolve(program);
+}
+
+bool ShaderCache::Ready(GLuint program)
+{
+	if (!s_cache.parallel || s_cache.pending.find(program) == s_cache.pending.end()) return true;
+	GLint complete = GL_TRUE;
+	glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &complete);
+	return complete != GL_FALSE;
+}
+
+void ShaderCache::Report(f64 init_ms)
+{
+	const ShaderCacheStats& stats = s_cache.stats;
+	if (stats.m_programs == 0) return;
+
+	const char* start = stats.m_hits == stats.m_programs ? "warm" : stats.m_hits == 0 ? "cold" : "partly warm";
+	std::cout << "Startup (" << start << "): " << init_ms << " ms, "
+		<< stats.m_programs << " programs, " << stats.m_hits << " from cache, "
+		<< stats.m_failed << " failed, submit " << stats.m_submit_ms << " ms, link wait " << stats.m_resolve_ms << " ms"
+		<< (s_async ? ", async" : "") << (s_cache.parallel ? ", parallel compile" : "") << std::endl;
+}
+
+const ShaderCacheStats& ShaderCache::Stats()
+{
+	return s_cache.stats;
+}
@@ -17,17 +17,21 @@ extern "C" {
 System::System(SystemConf config)
 	:m_window(config),
 	m_input(),
-	m_audio()
+	m_audio(config.hidden)
 {
 #ifdef _DEBUG
 	glfwSetErrorCallback(Error_Callback);
 #endif //_DEBUG
 
+	if (!m_window.m_handle) return;
+
 	glewExperimental = GL_TRUE;
 	if (glewInit() != GLEW_OK) {
 		std::cerr << "Failed to initialize GLEW!" << std::endl;
+		if (config.hidden) return;
 		exit(-1);
 	}
+	m_valid = true;
 
 #ifdef _DEBUG
 	const GLubyte* renderer = glGetString(GL_RENDERER);
@@ -135,16 +139,19 @@ Window::Window(SystemConf config)
 	:m_xPos(config.pos_x),
 	m_yPos(config.pos_y),
 	m_running(true),
-	m_framelimit(1.0 / config.frame_limit),
+	m_framelimit(config.frame_limit > 0.0 ? 1.0 / config.frame_limit : 0.0),
 	m_width(config.width),
 	m_height(config.height),
 	m_frametime(0),
 	m_framecount(0),
 	m_fps(0),
-	m_time(0.0)
+	m_time(0.0),
+	m_pacer(config.frame_limit)
 {
+	m_handle = nullptr;
 	if (!glfwInit()) {
 		std::cerr << "Failed to initialize GLFW!" << std::endl;
+		if (config.hidden) return;
 		exit(-1);
 	}
 
@@ -167,7 +174,17 @@ Window::Window(SystemConf config)
 
 	GLFWwindow* handle;
 
-	if (config.windowed_fullscreen) {
+	if (config.hidden) {
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+		handle = glfwCreateWindow(config.width, config.height, config.window_title, NULL, NULL);
+		if (!handle) {
+			//Software GL like Mesa's llvmpipe often stops at 4.5
+			glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+			handle = glfwCreateWindow(config.width, config.height, config.window_title, NULL, NULL);
+		}
+	}
+	else if (config.windowed_fullscreen) {
 		GLFWmonitor* monitor = glfwGetPrimaryMonitor();
 		const GLFWvidmode* mode = glfwGetVideoMode(monitor);
 
@@ -187,6 +204,7 @@ Window::Window(SystemConf config)
 
 	if (!handle) {
 		std::cerr << "GLFW window creation failed!" << std::endl;
+		if (config.hidden) return;
 		glfwTerminate();
 		exit(-1);
 	}
@@ -200,7 +218,7 @@ Window::Window(SystemConf config)
 	}
 
 	//set icon
-	Window::SetIcon(handle, config.icon_path);
+	if (!config.hidden) Window::SetIcon(handle, config.icon_path);
 
 	glfwMakeContextCurrent(handle);
 	this->m_handle = handle;
@@ -208,7 +226,7 @@ Window::Window(SystemConf config)
 
 Window::~Window()
 {
-	glfwDestroyWindow(m_handle);
+	if (m_handle) glfwDestroyWindow(m_handle);
 	glfwTerminate();
 }
 
@@ -310,7 +328,18 @@ void Window::VSync(bool state)
 
 void Window::SetFrameLimit(f64 limit)
 {
-	m_framelimit = 1.0 / limit;
+	m_framelimit = limit > 0.0 ? 1.0 / limit : 0.0;
+	m_pacer.SetFrameLimit(limit);
+}
+
+void Window::SetFramePacing(PacingPolicy policy)
+{
+	m_pacer.SetPolicy(policy);
+}
+
+void Window::SetFixedTimestep(f64 rate)
+{
+	m_pacer.SetFixedTimestep(rate);
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -490,9 +519,9 @@ void Input::MouseScroll(double xoffset, double yoffset)
 // AUDIO
 //-------------------------------------------------------------------------------------------------
 
-Audio::Audio()
+Audio::Audio(bool silent)
 {
-	m_engine = createIrrKlangDevice();
+	m_engine = createIrrKlangDevice(silent ? ESOD_NULL : ESOD_AUTO_DETECT);
 	if (!m_engine) {
 		std::cerr << "Failed to initialize sound engine" << std::endl;
 		throw;
@@ -568,32 +597,58 @@ void Event::Run(System* system, Program& program)
 #endif //_DEBUG
 	
 	Random::Init();
+	AssetManager::Init();
+	const f64 init_start = glfwGetTime();
 	program.OnInit(input, audio, window);
+	//Programs submitted in OnInit were compiling in parallel, check them before they're first used
+	ShaderCache::ResolveAll();
+	ShaderCache::Report((glfwGetTime() - init_start) * 1000.0);
 
-	f64 ticks = glfwGetTime();
+	window.m_pacer.Reset();
 	while (!glfwWindowShouldClose(window.m_handle) && window.IsRunning()) {
 		glfwPollEvents();
 
-		//Calculate DeltaTime
-		while (glfwGetTime() - ticks < window.GetFrameLimit()) {}
-		f64 dt = glfwGetTime() - ticks;
-		ticks = glfwGetTime();
+		//Wait for the frame to be due and calculate DeltaTime
+		f64 dt = window.m_pacer.Wait();
 
 		window.UpdateFPS();
 		window.UpdateTime(dt);
 
-		program.OnUpdate(input, audio, window, dt);
-		program.OnDraw();
+		//Finish a bounded slice of the asset loads that have been decoded in the background
+		AssetManager::Pump(AssetManager::GetUploadBudget());
+
+		if (window.m_pacer.GetPolicy() == PacingPolicy::FixedTimestep) {
+			const f64 step = window.m_pacer.GetTimestep();
+			for (u32 steps = window.m_pacer.ConsumeSteps(); steps > 0; --steps) {
+				program.OnUpdate(input, audio, window, step);
+			}
+		}
+		else {
+			program.OnUpdate(input, audio, window, dt);
+		}
+		GpuProfiler::BeginFrame();
+		GLState::BeginFrame();
+		{
+			GpuScope scope("OnDraw");
+			program.OnDraw();
+		}
 
 #ifdef _DEBUG
-		ImGui_StartFrame();
-		program.OnGui();
-		ImGui_RenderFrame();
+		{
+			GpuScope scope("OnGui");
+			ImGui_StartFrame();
+			program.OnGui();
+			ImGui_RenderFrame();
+		}
 #endif //_DEBUG
+		GpuProfiler::EndFrame();
 
 		input.AdvanceInput();
 		glfwSwapBuffers(system->m_window.m_handle);
 	}
+
+	GpuProfiler::Shutdown();
+	AssetManager::Shutdown();
 }
 
 void OpenGL_Debug_Init()
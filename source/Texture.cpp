@@ -1,8 +1,11 @@
 #include "Texture.h"
+#include "BlockCompression.h"
+#include "MipGenerator.h"
 
 #include "GL/glew.h"
 #include <iostream>
 #include <fstream>
+#include <deque>
 #include <vector>
 
 
@@ -56,97 +59,399 @@ void SwapHeader(KTX_Header& header) {
 	header.keypairbytes = swap32(header.keypairbytes);
 }
 
-static unsigned int calculate_stride(const KTX_Header& h, unsigned int width, unsigned int pad = 4)
+//-------------------------------------------------------------------------------------------------
+// UPLOAD RING
+//-------------------------------------------------------------------------------------------------
+
+//Persistently mapped pixel unpack buffer shared by all KTX uploads. Image data is copied
+//once from the file mapping into the ring and the driver DMAs it from there.
+#define KTX_UPLOAD_RING_SIZE (16 * 1024 * 1024)
+
+struct UploadRegion {
+	usize offset;
+	usize size;
+	GLsync fence;
+};
+
+struct UploadRing {
+	GLuint m_buffer = 0;
+	unsigned char* m_mapped = nullptr;
+	usize m_head = 0;
+	std::deque<UploadRegion> m_pending;
+
+	bool Init();
+	unsigned char* Allocate(usize size, usize* offset);
+	void Fence(usize offset, usize size);
+
+private:
+	void Retire();
+};
+
+static UploadRing s_upload_ring;
+
+bool UploadRing::Init()
 {
-	unsigned int channels = 0;
+	if (m_buffer) return m_mapped != nullptr;
 
-	switch (h.glbaseinternalformat)
-	{
-	case GL_RED:    channels = 1;
-		break;
-	case GL_RG:     channels = 2;
-		break;
-	case GL_BGR:
-	case GL_RGB:    channels = 3;
-		break;
-	case GL_BGRA:
-	case GL_RGBA:   channels = 4;
-		break;
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glCreateBuffers(1, &m_buffer);
+	glNamedBufferStorage(m_buffer, KTX_UPLOAD_RING_SIZE, nullptr, flags);
+	m_mapped = (unsigned char*)glMapNamedBufferRange(m_buffer, 0, KTX_UPLOAD_RING_SIZE, flags);
+	return m_mapped != nullptr;
+}
+
+unsigned char* UploadRing::Allocate(usize size, usize* offset)
+{
+	if (size > KTX_UPLOAD_RING_SIZE) return nullptr;
+
+	if (m_head + size > KTX_UPLOAD_RING_SIZE) {
+		//Wrapping, everything still in flight past the old head is older than what's at the front
+		while (!m_pending.empty() && m_pending.front().offset >= m_head) Retire();
+		m_head = 0;
+	}
+	while (!m_pending.empty() &&
+		m_pending.front().offset < m_head + size &&
+		m_pending.front().offset + m_pending.front().size > m_head) {
+		Retire();
 	}
 
-	unsigned int stride = h.gltypesize * channels * width;
+	*offset = m_head;
+	m_head = (m_head + size + 255) & ~(usize)255;
+	return m_mapped + *offset;
+}
 
-	stride = (stride + (pad - 1)) & ~(pad - 1);
+void UploadRing::Fence(usize offset, usize size)
+{
+	m_pending.push_back({ offset, size, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+}
 
-	return stride;
+void UploadRing::Retire()
+{
+	GLsync fence = m_pending.front().fence;
+	GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	while (result == GL_TIMEOUT_EXPIRED) {
+		result = glClientWaitSync(fence, 0, 1000000);
+	}
+	glDeleteSync(fence);
+	m_pending.pop_front();
 }
 
-static unsigned int calculate_face_size(const KTX_Header& h)
+//Upload one image, sourcing it from the ring if it fits or straight from the mapped file if not.
+//Compressed images pass their internal format as format, type is ignored for them
+static void StreamSubImage(GLuint tex, GLenum target, GLint level, GLint zoffset,
+	GLsizei width, GLsizei height, GLsizei depth,
+	GLenum format, GLenum type, const unsigned char* pixels, u32 size, bool compressed = false)
 {
-	unsigned int stride = calculate_stride(h, h.pixelwidth);
+	usize offset = 0;
+	unsigned char* dst = s_upload_ring.Init() ? s_upload_ring.Allocate(size, &offset) : nullptr;
+	const void* src = pixels;
+	if (dst) {
+		memcpy(dst, pixels, size);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, s_upload_ring.m_buffer);
+		src = (const void*)offset;
+	}
+
+	switch (target) {
+	case GL_TEXTURE_1D:
+		if (compressed) glCompressedTextureSubImage1D(tex, level, 0, width, format, size, src);
+		else glTextureSubImage1D(tex, level, 0, width, format, type, src);
+		break;
+	case GL_TEXTURE_1D_ARRAY:
+	case GL_TEXTURE_2D:
+		if (compressed) glCompressedTextureSubImage2D(tex, level, 0, 0, width, height, format, size, src);
+		else glTextureSubImage2D(tex, level, 0, 0, width, height, format, type, src);
+		break;
+	default:
+		//Cube map faces are layers of the 3D call
+		if (compressed) glCompressedTextureSubImage3D(tex, level, 0, 0, zoffset, width, height, depth, format, size, src);
+		else glTextureSubImage3D(tex, level, 0, 0, zoffset, width, height, depth, format, type, src);
+		break;
+	}
 
-	return stride * h.pixelheight;
+	if (dst) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		s_upload_ring.Fence(offset, size);
+	}
 }
 
-GLuint Load_KTX(const char* filename, GLuint texture) {
-	//Open filestream and check if successful
-	std::ifstream ifs(filename, std::ios_base::binary);
-	if (!ifs.is_open()) {
-		std::cerr << "Couldn't open file:" << filename << std::endl;
-		return 0;
+//Looks up the block layout of compressed data and whether the driver can store it. Formats it
+//rejects are decoded on the CPU and stored uncompressed. False if the data can't be loaded at all
+static bool ResolveCompressedFormat(GLenum target, GLenum internalformat, const BlockFormat** block, bool* decode)
+{
+	*block = FindBlockFormat(internalformat);
+	*decode = false;
+	if (*block == nullptr) {
+		std::cerr << "Unsupported compressed texture format 0x" << std::hex << internalformat << std::dec << std::endl;
+		return false;
 	}
+	if (target == GL_TEXTURE_1D || target == GL_TEXTURE_1D_ARRAY) {
+		std::cerr << "Compressed 1D textures aren't supported" << std::endl;
+		return false;
+	}
+	if (!CompressedFormatSupported(target, internalformat)) {
+		if ((*block)->m_decode == nullptr) {
+			std::cerr << "Compressed format 0x" << std::hex << internalformat << std::dec
+				<< " isn't supported by the driver and has no CPU decoder" << std::endl;
+			return false;
+		}
+		*decode = true;
+	}
+	return true;
+}
 
-	//Get length of file
-	ifs.seekg(0, ifs.end);
-	usize length = ifs.tellg();
-	ifs.seekg(0, ifs.beg);
+//Upload depth slices of block-compressed data, decoding them into scratch first for the fallback
+static void StreamCompressedSubImage(GLuint tex, GLenum target, GLint level, GLint zoffset,
+	GLsizei width, GLsizei height, GLsizei depth,
+	const BlockFormat& block, bool decode, const unsigned char* data, std::vector<u8>& scratch)
+{
+	if (!decode) {
+		const u32 size = (u32)CompressedImageSize(block, width, height, depth);
+		StreamSubImage(tex, target, level, zoffset, width, height, depth, block.m_format, GL_NONE, data, size, true);
+		return;
+	}
+	scratch.resize((usize)width * height * depth * DecodedTexelSize(block));
+	DecodeCompressedImage(block, data, width, height, depth, scratch.data());
+	StreamSubImage(tex, target, level, zoffset, width, height, depth,
+		block.m_decoded_layout, block.m_decoded_type, scratch.data(), (u32)scratch.size());
+}
 
-	//If file isn't empty, move data into buffer
-	std::vector<char> buffer;
-	if (!(length > 0)) {
-		return 0;
+//-------------------------------------------------------------------------------------------------
+// KTX
+//-------------------------------------------------------------------------------------------------
+
+//Channels of the 8-bit formats the CPU mip generator takes, 0 for anything else
+static u32 MipChannels(GLenum format, GLenum type)
+{
+	if (type != GL_UNSIGNED_BYTE) return 0;
+	switch (format) {
+	case GL_RED: return 1;
+	case GL_RG: return 2;
+	case GL_RGB: case GL_BGR: return 3;
+	case GL_RGBA: case GL_BGRA: return 4;
+	}
+	return 0;
+}
+
+//Builds levels 1 onwards of every image and uploads them, images are layers or cube faces
+static void UploadMipChains(GLuint tex, GLenum target, std::vector<MipChain>& chains, GLenum internalformat, GLenum format, GLenum type)
+{
+	MipSettings settings;
+	settings.m_content = internalformat == GL_SRGB8 || internalformat == GL_SRGB8_ALPHA8 ? MipContent::SRGB : MipContent::Linear;
+	GenerateMipChains(chains.data(), (u32)chains.size(), settings);
+
+	//Generated rows are tightly packed
+	GLint alignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (GLint layer = 0; layer < (GLint)chains.size(); ++layer) {
+		GLsizei width = chains[layer].m_width;
+		GLsizei height = chains[layer].m_height;
+		for (usize i = 0; i < chains[layer].m_levels.size(); ++i) {
+			width = width > 1 ? width >> 1 : 1;
+			height = height > 1 ? height >> 1 : 1;
+			const std::vector<u8>& level = chains[layer].m_levels[i];
+			StreamSubImage(tex, target, (GLint)i + 1, layer, width, height, 1, format, type, level.data(), (u32)level.size());
+		}
 	}
-	buffer.resize(length);
-	ifs.read(&buffer[0], length);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+}
+
+KTX_Raw Get_KTX_Raw(const MappedFile& file) {
+	KTX_Raw raw;
 
 	//If filesize is larger than header size, load data into header struct
-	KTX_Header* header;
-	if (!(length > sizeof(KTX_Header))) {
-		return 0;
+	if (!file.IsOpen() || !(file.Size() > sizeof(KTX_Header))) {
+		return raw;
 	}
-	header = (KTX_Header*)&buffer[0];
+	KTX_Header header;
+	memcpy(&header, file.Data(), sizeof(KTX_Header));
 
 	//Check endianness and swap if neeeded
-	if (header->endianness == 0x04030201) {}
-	else if (header->endianness == 0x01020304)
+	if (header.endianness == 0x04030201) {}
+	else if (header.endianness == 0x01020304)
 	{
-		SwapHeader(*header);
+		SwapHeader(header);
+		raw.m_swap = true;
 	}
-	else { return 0; }
+	else { return raw; }
 
 	//Guess the approriate target type
 	GLenum target = GL_NONE;
-	if (header->pixelheight == 0) {
-		if (header->arrayelements == 0) target = GL_TEXTURE_1D;
+	if (header.pixelheight == 0) {
+		if (header.arrayelements == 0) target = GL_TEXTURE_1D;
 		else target = GL_TEXTURE_1D_ARRAY;
 	}
-	else if (header->pixeldepth == 0) {
-		if (header->arrayelements == 0) {
-			if (header->faces == 0 || header->faces == 1) target = GL_TEXTURE_2D;
+	else if (header.pixeldepth == 0) {
+		if (header.arrayelements == 0) {
+			if (header.faces == 0 || header.faces == 1) target = GL_TEXTURE_2D;
 			else target = GL_TEXTURE_CUBE_MAP;
 		}
 		else {
-			if (header->faces == 0) target = GL_TEXTURE_2D_ARRAY;
+			if (header.faces == 0 || header.faces == 1) target = GL_TEXTURE_2D_ARRAY;
 			else target = GL_TEXTURE_CUBE_MAP_ARRAY;
 		}
 	}
 	else target = GL_TEXTURE_3D;
 
-	if (target == GL_NONE || header->pixelwidth == 0 || (header->pixelheight == 0 && header->pixeldepth == 0))
-	{
+	usize data_start = sizeof(KTX_Header) + header.keypairbytes;
+	if (target == GL_NONE || header.pixelwidth == 0 || data_start + 4 > file.Size()) {
+		return raw;
+	}
+
+	if (header.miplevels == 0) {
+		header.miplevels = 1;
+	}
+
+	raw.m_data = file.Data() + data_start;
+	raw.m_size = file.Size() - data_start;
+	raw.m_width = header.pixelwidth;
+	raw.m_height = header.pixelheight;
+	raw.m_depth = header.pixeldepth;
+	raw.m_array_elements = header.arrayelements;
+	raw.m_faces = header.faces == 0 ? 1 : header.faces;
+	raw.m_glformat = header.glformat;
+	raw.m_glinternal_format = header.glinternalformat;
+	raw.m_gltype = header.gltype;
+	raw.m_gltypesize = header.gltypesize;
+	raw.m_miplevels = header.miplevels;
+	raw.m_target = target;
+
+	//Some of the book's files have no imageSize field, their one level starts right after the
+	//header. Recognised by the data being exactly that level's size
+	if (header.miplevels == 1 && header.gltype != GL_NONE) {
+		usize components = 0;
+		switch (header.glformat) {
+		case GL_RED: components = 1; break;
+		case GL_RG: components = 2; break;
+		case GL_RGB: case GL_BGR: components = 3; break;
+		case GL_RGBA: case GL_BGRA: components = 4; break;
+		}
+		const usize pitch = ((usize)header.pixelwidth * components * header.gltypesize + 3) & ~(usize)3;
+		const usize rows = (usize)(header.pixelheight ? header.pixelheight : 1) * (header.pixeldepth ? header.pixeldepth : 1) *
+			(header.arrayelements ? header.arrayelements : 1) * raw.m_faces;
+		if (components && raw.m_size == pitch * rows) raw.m_image_sizes = false;
+	}
+
+	return raw;
+}
+
+const unsigned char* Get_KTX_Level(const KTX_Raw& ktx, int level, u32* image_size) {
+	//Each level is a 4 byte imageSize followed by the images, cube faces and levels padded to 4 bytes.
+	//For non-array cube maps imageSize is the size of one face.
+	const bool cube_faces = ktx.m_target == GL_TEXTURE_CUBE_MAP;
+	if (!ktx.m_image_sizes) {
+		if (level != 0) return nullptr;
+		*image_size = (u32)(cube_faces ? ktx.m_size / ktx.m_faces : ktx.m_size);
+		return ktx.m_data;
+	}
+
+	usize offset = 0;
+	for (int i = 0; i <= level; ++i) {
+		if (offset + 4 > ktx.m_size) return nullptr;
+		u32 size;
+		memcpy(&size, ktx.m_data + offset, sizeof(u32));
+		if (ktx.m_swap) size = swap32(size);
+		offset += 4;
+
+		usize level_size = cube_faces ? ((size + 3) & ~3u) * ktx.m_faces : size;
+		if (offset + level_size > ktx.m_size) return nullptr;
+		if (i == level) {
+			*image_size = size;
+			return ktx.m_data + offset;
+		}
+		offset += (level_size + 3) & ~(usize)3;
+	}
+	return nullptr;
+}
+
+bool Save_KTX(const char* filename, const KTX_Raw& ktx, const unsigned char* const* levels, const u32* sizes) {
+	static const unsigned char identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	KTX_Header header = {};
+	memcpy(header.identifier, identifier, sizeof(identifier));
+	header.endianness = 0x04030201;
+	header.gltype = ktx.m_gltype;
+	header.gltypesize = ktx.m_gltype == GL_NONE ? 1 : ktx.m_gltypesize;
+	header.glformat = ktx.m_glformat;
+	header.glinternalformat = ktx.m_glinternal_format;
+	header.glbaseinternalformat = ktx.m_glformat;
+	if (ktx.m_gltype == GL_NONE) {
+		//Block formats that decode to one or two channels have that base format, the rest RGBA
+		const BlockFormat* block = FindBlockFormat(ktx.m_glinternal_format);
+		const bool narrow = block && (block->m_decoded_layout == GL_RED || block->m_decoded_layout == GL_RG);
+		header.glbaseinternalformat = narrow ? block->m_decoded_layout : GL_RGBA;
+	}
+	header.pixelwidth = ktx.m_width;
+	header.pixelheight = ktx.m_height;
+	header.pixeldepth = ktx.m_depth;
+	header.arrayelements = ktx.m_array_elements;
+	header.faces = ktx.m_faces == 0 ? 1 : ktx.m_faces;
+	header.miplevels = ktx.m_miplevels;
+	header.keypairbytes = 0;
+
+	std::ofstream file(filename, std::ios::binary);
+	if (!file.is_open()) {
+		std::cerr << "Unable to open file '" << filename << "'" << std::endl;
+		return false;
+	}
+	file.write((const char*)&header, sizeof(header));
+
+	//Non-array cube maps store one face per imageSize, each padded to 4 bytes
+	const bool cube_faces = ktx.m_faces == 6 && ktx.m_array_elements == 0;
+	static const char padding[4] = {};
+	for (int i = 0; i < ktx.m_miplevels; ++i) {
+		const usize level_size = cube_faces ? ((sizes[i] + 3) & ~3u) * 6 : sizes[i];
+		file.write((const char*)&sizes[i], sizeof(u32));
+		file.write((const char*)levels[i], level_size);
+		file.write(padding, ((level_size + 3) & ~(usize)3) - level_size);
+	}
+	return file.good();
+}
+
+GLuint Load_KTX(const char* filename, GLuint texture) {
+	//Map the file, image data is read straight out of the mapping
+	MappedFile file(filename);
+	if (!file.IsOpen()) {
 		return 0;
 	}
 
+	KTX_Raw ktx = Get_KTX_Raw(file);
+	if (ktx.m_data == nullptr) {
+		std::cerr << "Bad KTX file:" << filename << std::endl;
+		return 0;
+	}
+
+	return Upload_KTX(ktx, texture);
+}
+
+GLuint Upload_KTX(const KTX_Raw& ktx, GLuint texture) {
+	const GLenum target = ktx.m_target;
+
+	//Adjust internal format
+	GLenum internalformat = ktx.m_glinternal_format;
+	if (target == GL_TEXTURE_2D) {
+		switch (internalformat)
+		{
+		case GL_SRGB8:
+			internalformat = GL_RGBA8;
+			break;
+		case GL_RGB32F:
+			internalformat = GL_RGBA32F;
+			break;
+		}
+	}
+
+	//Compressed data is sized from its block layout
+	const bool compressed = ktx.m_gltype == GL_NONE;
+	const BlockFormat* block = nullptr;
+	bool decode = false;
+	if (compressed) {
+		if (!ResolveCompressedFormat(target, internalformat, &block, &decode)) {
+			return 0;
+		}
+		if (decode) internalformat = block->m_decoded_format;
+	}
+
 	//Create new texture name if one wasn't passed in and bind it
 	GLuint tex = texture;
 	if (tex == 0) {
@@ -154,176 +459,212 @@ GLuint Load_KTX(const char* filename, GLuint texture) {
 	}
 	glBindTexture(target, tex);
 
-	//Get the data location and copy data into memory
-	usize data_start = sizeof(KTX_Header) + header->keypairbytes;
-	usize data_end = buffer.size();
-	unsigned char* data = new unsigned char[data_end - data_start];
-	//+4 to get past the 4 bytes of data for buffer length
-	memcpy(data, &buffer[data_start + 4], data_end - data_start);
+	//Files with a single level get a full chain. 8-bit 2D images, arrays and cube maps have it built
+	//on the CPU, anything else is left to glGenerateMipmap. Compressed formats can't render into it
+	const GLsizei file_levels = ktx.m_miplevels;
+	const bool mips = file_levels == 1 && (!compressed || decode);
+	const u32 mip_channels = compressed ? 0 : MipChannels(ktx.m_glformat, ktx.m_gltype);
+	const bool cpu_mips = mips && mip_channels && (target == GL_TEXTURE_2D || target == GL_TEXTURE_2D_ARRAY ||
+		target == GL_TEXTURE_CUBE_MAP || target == GL_TEXTURE_CUBE_MAP_ARRAY);
 
-	if (header->miplevels == 0) {
-		header->miplevels = 1;
-	}
-
-	//Adjust internal format
-	GLenum internalformat;
-	switch (header->glinternalformat)
+	//Allocate storage for every level up front
+	const GLsizei levels = mips ? MipLevelCount(ktx.m_width, target == GL_TEXTURE_1D_ARRAY ? 1 : ktx.m_height, target == GL_TEXTURE_3D ? ktx.m_depth : 1) : file_levels;
+	switch (target)
 	{
-	case GL_SRGB8:
-		internalformat = GL_RGBA8;
+	case GL_TEXTURE_1D:
+		glTextureStorage1D(tex, levels, internalformat, ktx.m_width);
 		break;
-	case GL_RGB32F:
-		internalformat = GL_RGBA32F;
+	case GL_TEXTURE_1D_ARRAY:
+		glTextureStorage2D(tex, levels, internalformat, ktx.m_width, ktx.m_array_elements);
 		break;
-	default:
-		internalformat = header->glinternalformat;
+	case GL_TEXTURE_2D:
+	case GL_TEXTURE_CUBE_MAP:
+		glTextureStorage2D(tex, levels, internalformat, ktx.m_width, ktx.m_height);
+		break;
+	case GL_TEXTURE_2D_ARRAY:
+		glTextureStorage3D(tex, levels, internalformat, ktx.m_width, ktx.m_height, ktx.m_array_elements);
+		break;
+	case GL_TEXTURE_CUBE_MAP_ARRAY:
+		glTextureStorage3D(tex, levels, internalformat, ktx.m_width, ktx.m_height, ktx.m_array_elements * 6);
 		break;
+	case GL_TEXTURE_3D:
+		glTextureStorage3D(tex, levels, internalformat, ktx.m_width, ktx.m_height, ktx.m_depth);
+		break;
+	default:
+		std::cerr << "Unsupported Texture Type" << std::endl;
+		return 0;
 	}
 
-	//Only support GL_TEXTURE_2D for now
-	switch (target)
+	if (compressed)
 	{
-	case GL_TEXTURE_2D:
-		if (header->gltype == GL_NONE)
+		//Decoded rows are tightly packed
+		GLint alignment;
+		glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+		std::vector<u8> scratch;
+		GLsizei width = ktx.m_width;
+		GLsizei height = ktx.m_height;
+		GLsizei depth = ktx.m_depth;
+		for (GLsizei i = 0; i < file_levels; i++)
 		{
-			glCompressedTexImage2D(GL_TEXTURE_2D, 0, internalformat, header->pixelwidth, header->pixelheight, 0, 420 * 380 / 2, data);
-		}
-		else
-		{
-			glTexStorage2D(GL_TEXTURE_2D, header->miplevels, internalformat, header->pixelwidth, header->pixelheight);
+			u32 size;
+			const unsigned char* data = Get_KTX_Level(ktx, i, &size);
+
+			//Layers in one image, each face of a non-array cube map is an image of its own
+			GLsizei layers = 1;
+			switch (target)
 			{
-				unsigned char* ptr = data;
-				unsigned int height = header->pixelheight;
-				unsigned int width = header->pixelwidth;
-				glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-				
-				for (unsigned int i = 0; i < header->miplevels; i++)
+			case GL_TEXTURE_2D_ARRAY: layers = ktx.m_array_elements; break;
+			case GL_TEXTURE_CUBE_MAP_ARRAY: layers = ktx.m_array_elements * 6; break;
+			case GL_TEXTURE_3D: layers = depth; break;
+			}
+			if (data == nullptr || size < CompressedImageSize(*block, width, height, layers)) {
+				std::cerr << "Truncated KTX file" << std::endl;
+				break;
+			}
+
+			if (target == GL_TEXTURE_CUBE_MAP) {
+				for (int face = 0; face < ktx.m_faces; face++)
 				{
-					glTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, width, height, header->glformat, header->gltype, ptr);
-					ptr += height * calculate_stride(*header, width, 1);
-					height >>= 1;
-					width >>= 1;
-					if (!height)
-						height = 1;
-					if (!width)
-						width = 1;
+					const unsigned char* face_data = data + ((size + 3) & ~3u) * face;
+					StreamCompressedSubImage(tex, target, i, face, width, height, 1, *block, decode, face_data, scratch);
 				}
 			}
+			else {
+				StreamCompressedSubImage(tex, target, i, 0, width, height, layers, *block, decode, data, scratch);
+			}
+
+			width = width > 1 ? width >> 1 : 1;
+			height = height > 1 ? height >> 1 : 1;
+			depth = depth > 1 ? depth >> 1 : 1;
 		}
-		break;
-	case GL_TEXTURE_CUBE_MAP:
-		glTexStorage2D(GL_TEXTURE_CUBE_MAP, header->miplevels, header->glinternalformat, header->pixelwidth, header->pixelheight);
-		// glTexSubImage3D(GL_TEXTURE_CUBE_MAP, 0, 0, 0, 0, h.pixelwidth, h.pixelheight, h.faces, h.glformat, h.gltype, data);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+	}
+	else
+	{
+		//KTX rows are padded to 4 bytes
+		GLint alignment;
+		glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		GLsizei width = ktx.m_width;
+		GLsizei height = ktx.m_height;
+		GLsizei depth = ktx.m_depth;
+		for (GLsizei i = 0; i < file_levels; i++)
 		{
-			unsigned int face_size = calculate_face_size(*header);
-			for (unsigned int i = 0; i < header->faces; i++)
+			u32 size;
+			const unsigned char* data = Get_KTX_Level(ktx, i, &size);
+			if (data == nullptr) {
+				std::cerr << "Truncated KTX file" << std::endl;
+				break;
+			}
+
+			switch (target)
 			{
-				glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, 0, 0, header->pixelwidth, header->pixelheight, header->glformat, header->gltype, data + face_size * i);
+			case GL_TEXTURE_1D:
+				StreamSubImage(tex, target, i, 0, width, 1, 1, ktx.m_glformat, ktx.m_gltype, data, size);
+				break;
+			case GL_TEXTURE_1D_ARRAY:
+				StreamSubImage(tex, target, i, 0, width, ktx.m_array_elements, 1, ktx.m_glformat, ktx.m_gltype, data, size);
+				break;
+			case GL_TEXTURE_2D:
+				StreamSubImage(tex, target, i, 0, width, height, 1, ktx.m_glformat, ktx.m_gltype, data, size);
+				break;
+			case GL_TEXTURE_CUBE_MAP:
+				for (int face = 0; face < ktx.m_faces; face++)
+				{
+					const unsigned char* face_data = data + ((size + 3) & ~3u) * face;
+					StreamSubImage(tex, target, i, face, width, height, 1, ktx.m_glformat, ktx.m_gltype, face_data, size);
+				}
+				break;
+			case GL_TEXTURE_2D_ARRAY:
+				StreamSubImage(tex, target, i, 0, width, height, ktx.m_array_elements, ktx.m_glformat, ktx.m_gltype, data, size);
+				break;
+			case GL_TEXTURE_CUBE_MAP_ARRAY:
+				StreamSubImage(tex, target, i, 0, width, height, ktx.m_array_elements * 6, ktx.m_glformat, ktx.m_gltype, data, size);
+				break;
+			case GL_TEXTURE_3D:
+				StreamSubImage(tex, target, i, 0, width, height, depth, ktx.m_glformat, ktx.m_gltype, data, size);
+				break;
+			}
+
+			if (cpu_mips) {
+				//One chain per layer and face, each layer's rows padded to 4 bytes
+				const u32 pitch = (width * mip_channels + 3) & ~3u;
+				const GLsizei elements = ktx.m_array_elements ? ktx.m_array_elements : 1;
+				std::vector<MipChain> chains(target == GL_TEXTURE_CUBE_MAP || target == GL_TEXTURE_CUBE_MAP_ARRAY ? elements * 6 : elements);
+				for (usize layer = 0; layer < chains.size(); ++layer) {
+					chains[layer].m_source = target == GL_TEXTURE_CUBE_MAP ? data + ((size + 3) & ~3u) * layer : data + (usize)pitch * height * layer;
+					chains[layer].m_width = width;
+					chains[layer].m_height = height;
+					chains[layer].m_channels = mip_channels;
+					chains[layer].m_pitch = pitch;
+				}
+				UploadMipChains(tex, target, chains, internalformat, ktx.m_glformat, ktx.m_gltype);
 			}
+
+			width = width > 1 ? width >> 1 : 1;
+			height = height > 1 ? height >> 1 : 1;
+			depth = depth > 1 ? depth >> 1 : 1;
 		}
-		break;
-	case GL_TEXTURE_3D:
-		glTexStorage3D(GL_TEXTURE_3D, header->miplevels, header->glinternalformat, header->pixelwidth, header->pixelheight, header->pixeldepth);
-		glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, header->pixelwidth, header->pixelheight, header->pixeldepth, header->glformat, header->gltype, data);
-		break;
-	case GL_TEXTURE_2D_ARRAY:
-		glTexStorage3D(GL_TEXTURE_2D_ARRAY, header->miplevels, header->glinternalformat, header->pixelwidth, header->pixelheight, header->arrayelements);
-		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, header->pixelwidth, header->pixelheight, header->arrayelements, header->glformat, header->gltype, data);
-		break;
-	default:
-		std::cerr << "Unsupported Texture Type" << std::endl;
-		delete[] data;
-		return 0;
+		glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
 	}
 
-	//Generate mipmaps if texture doesn't already have them
-	if (header->miplevels == 1) {
+	if (mips && !cpu_mips) {
 		glGenerateMipmap(target);
 	}
 
-
-	//Clean up and return texture name
-	delete[] data;
-	ifs.close();
-
 	return tex;
 }
 
-KTX_Raw Get_KTX_Raw(const char* filename) {
-	//Open filestream and check if successful
-	std::ifstream ifs(filename, std::ios_base::binary);
-	if (!ifs.is_open()) {
-		return KTX_Raw();
-	}
-
-	//Get length of file
-	ifs.seekg(0, ifs.end);
-	usize length = ifs.tellg();
-	ifs.seekg(0, ifs.beg);
-
-	//If file isn't empty, move data into buffer
-	std::vector<char> buffer;
-	if (!(length > 0)) {
-		return KTX_Raw();
+GLuint CreateTextureArray(const char* filenames[], size_t length)
+{
+	MappedFile first(filenames[0]);
+	KTX_Raw temp = Get_KTX_Raw(first);
+	if (temp.m_data == nullptr) {
+		std::cerr << "Couldn't load " << filenames[0] << "\nNo texture data!" << std::endl;
+		return 0;
 	}
-	buffer.resize(length);
-	ifs.read(&buffer[0], length);
 
-	//If filesize is larger than header size, load data into header struct
-	KTX_Header* header;
-	if (!(length > sizeof(KTX_Header))) {
-		return KTX_Raw();
+	//Every file has to share the first one's format, compressed ones are sized from its block layout
+	const bool compressed = temp.m_gltype == GL_NONE;
+	const BlockFormat* block = nullptr;
+	bool decode = false;
+	if (compressed && !ResolveCompressedFormat(GL_TEXTURE_2D_ARRAY, temp.m_glinternal_format, &block, &decode)) {
+		return 0;
 	}
-	header = (KTX_Header*)&buffer[0];
+	const GLenum internalformat = decode ? block->m_decoded_format : temp.m_glinternal_format;
 
-	//Check endianness and swap if neeeded
-	if (header->endianness == 0x04030201) {}
-	else if (header->endianness == 0x01020304)
-	{
-		SwapHeader(*header);
-	}
-	else { return KTX_Raw(); }
-
-	//Get the data location and copy data into memory
-	usize data_start = sizeof(KTX_Header) + header->keypairbytes;
-	usize data_end = buffer.size();
-	unsigned char* data = new unsigned char[data_end - data_start];
-	//+4 to get past the 4 bytes of data for buffer length
-	memcpy(data, &buffer[data_start + 4], data_end - data_start);
-
-	if (header->miplevels == 0) {
-		header->miplevels = 1;
-	}
-
-	return KTX_Raw(
-		data, 
-		header->pixelwidth, 
-		header->pixelheight, 
-		header->glformat, 
-		header->glinternalformat, 
-		header->gltype,
-		header->miplevels
-	);
-}
-
-GLuint CreateTextureArray(const char* filenames[], size_t length)
-{
-	KTX_Raw temp = Get_KTX_Raw(filenames[0]);
+	//Single level 8-bit files get their chains built on the CPU, the layers side by side
+	const bool mips = temp.m_miplevels == 1 && (!compressed || decode);
+	const u32 mip_channels = compressed ? 0 : MipChannels(temp.m_glformat, temp.m_gltype);
+	const GLsizei levels = mips ? MipLevelCount(temp.m_width, temp.m_height) : 1;
 
 	GLuint tex;
 	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &tex);
-	glTextureStorage3D(tex, 1, temp.m_glinternal_format, temp.m_width, temp.m_height, length);
+	glTextureStorage3D(tex, levels, internalformat, temp.m_width, temp.m_height, length);
 	glBindTexture(GL_TEXTURE_2D_ARRAY, tex);
 
-	
+	//KTX rows are padded to 4 bytes, decoded rows are tightly packed
+	GLint alignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, decode ? 1 : 4);
+
+	std::vector<u8> scratch;
 
-	int miplevels = temp.m_miplevels;
+	//Files stay mapped until their chains are built
+	std::vector<MappedFile> files(length);
+	std::vector<MipChain> chains(mips && mip_channels ? length : 0);
 
 	int width = -1;
 	int height = -1;
 	for (size_t i = 0; i < length; ++i) {
-		KTX_Raw texture = Get_KTX_Raw(filenames[i]);
-		if (texture.m_data == nullptr) {
+		files[i].Open(filenames[i]);
+		KTX_Raw texture = Get_KTX_Raw(files[i]);
+		u32 size;
+		const unsigned char* data = Get_KTX_Level(texture, 0, &size);
+		if (data == nullptr) {
 			std::cerr << "Couldn't load " << filenames[i] << "\nNo texture data!" << std::endl;
 			return 0;
 		}
@@ -333,20 +674,44 @@ GLuint CreateTextureArray(const char* filenames[], size_t length)
 			return 0;
 		}
 		if (height == -1) { height = texture.m_height; }
-		else if (width != texture.m_height) {
+		else if (height != texture.m_height) {
 			std::cerr << "Couldn't create array! Not all files have same height dimensions" << std::endl;
 			return 0;
 		}
-		glTextureSubImage3D(tex, 0, 0, 0, i, texture.m_width, texture.m_height, 1, texture.m_glformat, texture.m_gltype, texture.m_data);
-		
+		if (texture.m_glinternal_format != temp.m_glinternal_format) {
+			std::cerr << "Couldn't create array! Not all files have the same format" << std::endl;
+			return 0;
+		}
+		if (compressed) {
+			if (size < CompressedImageSize(*block, width, height)) {
+				std::cerr << "Couldn't load " << filenames[i] << "\nTruncated texture data!" << std::endl;
+				return 0;
+			}
+			StreamCompressedSubImage(tex, GL_TEXTURE_2D_ARRAY, 0, i, width, height, 1, *block, decode, data, scratch);
+		}
+		else {
+			StreamSubImage(tex, GL_TEXTURE_2D_ARRAY, 0, i, texture.m_width, texture.m_height, 1, texture.m_glformat, texture.m_gltype, data, size);
+		}
+		if (!chains.empty()) {
+			chains[i].m_source = data;
+			chains[i].m_width = width;
+			chains[i].m_height = height;
+			chains[i].m_channels = mip_channels;
+			chains[i].m_pitch = (width * mip_channels + 3) & ~3u;
+		}
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+	if (!chains.empty()) {
+		UploadMipChains(tex, GL_TEXTURE_2D_ARRAY, chains, internalformat, temp.m_glformat, temp.m_gltype);
 	}
-	if (miplevels == 1) {
+	else if (mips) {
 		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
 	}
 
 	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	//A built chain is only worth its memory if minification reads it
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
 	return tex;
@@ -0,0 +1,707 @@
+#include "VirtualTexture.h"
+#include "AssetManager.h"
+#include "MipGenerator.h"
+
+#include "GL/glew.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+
+static const char virtual_texture_magic[4] = { 'S', 'B', 'V', 'T' };
+
+#define VT_STRINGIFY(x) #x
+#define VT_STRING(x) VT_STRINGIFY(x)
+
+const char* const virtual_texture_glsl =
+"layout (binding = " VT_STRING(VIRTUAL_TEXTURE_POOL_UNIT) ") uniform sampler2D vt_pool;\n"
+"layout (binding = " VT_STRING(VIRTUAL_TEXTURE_TABLE_UNIT) ") uniform usampler2D vt_table;\n"
+"layout (binding = " VT_STRING(VIRTUAL_TEXTURE_UBO_BINDING) ", std140) uniform VIRTUAL_TEXTURE\n"
+R"(
+{
+    vec4 vt_size;       //Width, height, levels, 1 for the atlas and 0 for sparse
+    vec4 vt_pages;      //Pages across and down level 0, page size, border
+    vec4 vt_pool_info;  //Atlas width and height, level bias of the feedback pass
+};
+
+float VT_Lod(vec2 uv, float bias)
+{
+    vec2 texels = uv * vt_size.xy;
+    vec2 dx = dFdx(texels);
+    vec2 dy = dFdy(texels);
+    float rho = max(dot(dx, dx), dot(dy, dy));
+    return clamp(0.5 * log2(max(rho, 1e-8)) + bias, 0.0, vt_size.z - 1.0);
+}
+
+uvec2 VT_Page(vec2 uv, uint level)
+{
+    uvec2 pages = max(uvec2(vt_pages.xy) >> level, uvec2(1));
+    return min(uvec2(uv * vec2(pages)), pages - 1u);
+}
+
+uint VT_Feedback(vec2 uv)
+{
+    uv = clamp(uv, 0.0, 1.0);
+    uint level = uint(VT_Lod(uv, vt_pool_info.z));
+    uvec2 page = VT_Page(uv, level);
+    return (level << 24) | (page.y << 12) | page.x;
+}
+
+//Table entry of the finest resident page covering uv: atlas slot x and y, level
+uvec4 VT_Entry(vec2 uv, out float lod)
+{
+    lod = VT_Lod(uv, 0.0);
+    uint level = uint(lod);
+    return texelFetch(vt_table, ivec2(VT_Page(uv, level)), int(level));
+}
+
+float VT_ResidentLevel(vec2 uv)
+{
+    float lod;
+    uvec4 entry = VT_Entry(clamp(uv, 0.0, 1.0), lod);
+    return vt_size.w == 0.0 ? max(lod, float(entry.z)) : float(entry.z);
+}
+
+vec4 VT_Sample(vec2 uv)
+{
+    uv = clamp(uv, 0.0, 1.0);
+    float lod;
+    uvec4 entry = VT_Entry(uv, lod);
+    if (vt_size.w == 0.0) {
+        //Sparse, the table keeps the filter footprint on committed pages
+        return textureLod(vt_pool, uv, max(lod, float(entry.z)));
+    }
+
+    //Atlas, position inside the resident page and then inside its slot
+    vec2 pages = vec2(max(uvec2(vt_pages.xy) >> entry.z, uvec2(1)));
+    vec2 local = uv * pages - vec2(VT_Page(uv, entry.z));
+    float slot = vt_pages.z + 2.0 * vt_pages.w;
+    vec2 texel = vec2(entry.xy) * slot + vt_pages.w + local * vt_pages.z;
+    return textureLod(vt_pool, texel / vt_pool_info.xy, 0.0);
+}
+)";
+
+#undef VT_STRING
+#undef VT_STRINGIFY
+
+//Page keys are what the feedback pass writes, level in the top byte, then 12 bits of y and of x
+#define VT_NO_PAGE 0xFFFFFFFFu
+#define VT_MAX_PAGES 4096
+
+static u32 PageKey(u32 level, u32 x, u32 y) { return (level << 24) | (y << 12) | x; }
+static u32 PageLevel(u32 page) { return page >> 24; }
+static u32 PageX(u32 page) { return page & 0xFFF; }
+static u32 PageY(u32 page) { return (page >> 12) & 0xFFF; }
+static u32 ParentPage(u32 page) { return PageKey(PageLevel(page) + 1, PageX(page) >> 1, PageY(page) >> 1); }
+
+static bool IsPowerOfTwo(u32 value) { return value && !(value & (value - 1)); }
+
+static u64 BakedSize(const VirtualTextureHeader& header)
+{
+	const u64 slot = header.m_page_size + 2 * header.m_border;
+	u64 pages = 0;
+	for (u32 level = 0; level < header.m_levels; ++level) {
+		pages += (u64)std::max(1u, (header.m_width / header.m_page_size) >> level) * std::max(1u, (header.m_height / header.m_page_size) >> level);
+	}
+	return sizeof(VirtualTextureHeader) + pages * slot * slot * 4;
+}
+
+static bool ValidHeader(const MappedFile& file)
+{
+	if (file.Size() < sizeof(VirtualTextureHeader)) return false;
+	const VirtualTextureHeader* header = (const VirtualTextureHeader*)file.Data();
+	return memcmp(header->m_magic, virtual_texture_magic, 4) == 0 &&
+		header->m_version == VIRTUAL_TEXTURE_VERSION &&
+		header->m_page_size > 0 && header->m_levels > 0 && header->m_levels <= 24 &&
+		IsPowerOfTwo(header->m_width) && IsPowerOfTwo(header->m_height) &&
+		header->m_width >= header->m_page_size && header->m_height >= header->m_page_size &&
+		header->m_width / header->m_page_size <= VT_MAX_PAGES && header->m_height / header->m_page_size <= VT_MAX_PAGES &&
+		(header->m_width >> (header->m_levels - 1)) >= header->m_page_size && (header->m_height >> (header->m_levels - 1)) >= header->m_page_size &&
+		BakedSize(*header) <= file.Size();
+}
+
+//-------------------------------------------------------------------------------------------------
+// BAKING
+//-------------------------------------------------------------------------------------------------
+
+bool VirtualTexture::Bake(const char* filename, const u8* rgba, u32 width, u32 height, bool srgb)
+{
+	const u32 page_size = VIRTUAL_TEXTURE_PAGE_SIZE;
+	const u32 border = VIRTUAL_TEXTURE_BORDER;
+	if (!IsPowerOfTwo(width) || !IsPowerOfTwo(height) || width < page_size || height < page_size ||
+		width / page_size > VT_MAX_PAGES || height / page_size > VT_MAX_PAGES) {
+		std::cerr << "Virtual texture sides have to be powers of two from " << page_size << " to " << page_size * VT_MAX_PAGES << std::endl;
+		return false;
+	}
+
+	VirtualTextureHeader header = {};
+	memcpy(header.m_magic, virtual_texture_magic, 4);
+	header.m_version = VIRTUAL_TEXTURE_VERSION;
+	header.m_width = width;
+	header.m_height = height;
+	header.m_page_size = page_size;
+	header.m_border = border;
+	header.m_levels = 1;
+	while ((width >> header.m_levels) >= page_size && (height >> header.m_levels) >= page_size) header.m_levels++;
+	header.m_format = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+
+	MipChain chain;
+	chain.m_source = rgba;
+	chain.m_width = width;
+	chain.m_height = height;
+	MipSettings settings;
+	settings.m_content = srgb ? MipContent::SRGB : MipContent::Linear;
+	GenerateMipChains(&chain, 1, settings);
+
+	//Write to a temporary and rename so a reader never maps a half written bake
+	const std::string temp = std::string(filename) + ".tmp";
+	{
+		std::ofstream ofs(temp, std::ios_base::binary | std::ios_base::trunc);
+		if (!ofs.is_open()) {
+			std::cerr << "Couldn't write virtual texture:" << filename << std::endl;
+			return false;
+		}
+		ofs.write((const char*)&header, sizeof(header));
+
+		const u32 slot = page_size + 2 * border;
+		std::vector<u8> tile((usize)slot * slot * 4);
+		for (u32 level = 0; level < header.m_levels; ++level) {
+			const u8* image = level ? chain.m_levels[level - 1].data() : rgba;
+			const i32 level_width = width >> level;
+			const i32 level_height = height >> level;
+			for (i32 py = 0; py < level_height / (i32)page_size; ++py) {
+				for (i32 px = 0; px < level_width / (i32)page_size; ++px) {
+					//Borders past the edge of the texture repeat its edge, like GL_CLAMP_TO_EDGE
+					for (i32 ty = 0; ty < (i32)slot; ++ty) {
+						const i32 sy = std::clamp(py * (i32)page_size + ty - (i32)border, 0, level_height - 1);
+						for (i32 tx = 0; tx < (i32)slot; ++tx) {
+							const i32 sx = std::clamp(px * (i32)page_size + tx - (i32)border, 0, level_width - 1);
+							memcpy(&tile[((usize)ty * slot + tx) * 4], image + ((usize)sy * level_width + sx) * 4, 4);
+						}
+					}
+					ofs.write((const char*)tile.data(), tile.size());
+				}
+			}
+		}
+		if (!ofs.good()) {
+			ofs.close();
+			std::filesystem::remove(temp);
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temp, filename, error);
+	if (error) {
+		std::filesystem::remove(temp, error);
+		return false;
+	}
+	return true;
+}
+
+bool VirtualTexture::IsBaked(const char* filename)
+{
+	if (!std::filesystem::exists(filename)) return false;
+	MappedFile file(filename);
+	return file.IsOpen() && ValidHeader(file);
+}
+
+//-------------------------------------------------------------------------------------------------
+// POOL
+//-------------------------------------------------------------------------------------------------
+
+bool VirtualTexture::Init(const char* filename, u32 pool_pages, u32 width, u32 height, u32 feedback_scale, bool force_atlas)
+{
+	Destroy();
+	if (!m_file.Open(filename)) return false;
+	if (!ValidHeader(m_file)) {
+		std::cerr << "Bad virtual texture:" << filename << std::endl;
+		m_file.Close();
+		return false;
+	}
+	memcpy(&m_header, m_file.Data(), sizeof(m_header));
+
+	const u32 levels = m_header.m_levels;
+	const u32 slot_size = m_header.m_page_size + 2 * m_header.m_border;
+	m_page_bytes = (usize)slot_size * slot_size * 4;
+	u64 offset = sizeof(VirtualTextureHeader);
+	for (u32 level = 0; level < levels; ++level) {
+		m_level_offsets.push_back(offset);
+		offset += (u64)PagesX(level) * PagesY(level) * m_page_bytes;
+	}
+
+	//Sparse when the driver has a page size that tiles ours, commitments are whole pages of ours
+	GLint page_index = -1;
+	if (!force_atlas && GLEW_ARB_sparse_texture) {
+		GLint count = 0;
+		GLint sizes_x[8] = {};
+		GLint sizes_y[8] = {};
+		glGetInternalformativ(GL_TEXTURE_2D, m_header.m_format, GL_NUM_VIRTUAL_PAGE_SIZES_ARB, 1, &count);
+		count = std::min(count, 8);
+		if (count > 0) {
+			glGetInternalformativ(GL_TEXTURE_2D, m_header.m_format, GL_VIRTUAL_PAGE_SIZE_X_ARB, count, sizes_x);
+			glGetInternalformativ(GL_TEXTURE_2D, m_header.m_format, GL_VIRTUAL_PAGE_SIZE_Y_ARB, count, sizes_y);
+		}
+		for (GLint i = 0; i < count && page_index < 0; ++i) {
+			if (sizes_x[i] > 0 && sizes_y[i] > 0 && m_header.m_page_size % sizes_x[i] == 0 && m_header.m_page_size % sizes_y[i] == 0) page_index = i;
+		}
+	}
+	m_sparse = page_index >= 0;
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_pool);
+	glTextureParameteri(m_pool, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_pool, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_pool, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	if (m_sparse) {
+		glTextureParameteri(m_pool, GL_TEXTURE_SPARSE_ARB, GL_TRUE);
+		glTextureParameteri(m_pool, GL_VIRTUAL_PAGE_SIZE_INDEX_ARB, page_index);
+		glTextureParameteri(m_pool, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTextureStorage2D(m_pool, levels, m_header.m_format, m_header.m_width, m_header.m_height);
+
+		//Levels in the mip tail are committed as one, they stay with the coarsest level
+		GLint sparse_levels = levels;
+		glGetTextureParameteriv(m_pool, GL_NUM_SPARSE_LEVELS_ARB, &sparse_levels);
+		m_pinned_level = std::min((u32)std::max(sparse_levels, 0), levels - 1);
+	}
+	else {
+		m_pinned_level = levels - 1;
+	}
+
+	u32 pinned_pages = 0;
+	for (u32 level = m_pinned_level; level < levels; ++level) pinned_pages += PagesX(level) * PagesY(level);
+	const u32 capacity = pool_pages + pinned_pages;
+
+	if (!m_sparse) {
+		m_atlas_slots = (u32)ceil(sqrt((f64)capacity));
+		GLint max_size = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+		if (m_atlas_slots * slot_size > (u32)max_size || m_atlas_slots > 255) {
+			std::cerr << "Virtual texture pool of " << capacity << " pages doesn't fit in one atlas" << std::endl;
+			Destroy();
+			return false;
+		}
+		glTextureParameteri(m_pool, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureStorage2D(m_pool, 1, m_header.m_format, m_atlas_slots * slot_size, m_atlas_slots * slot_size);
+	}
+
+	m_slots.assign(capacity, Slot{ VT_NO_PAGE, 0, 0, false });
+	for (u32 i = capacity; i > 0; --i) m_free_slots.push_back(i - 1);
+
+	//One texel per page and level
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_table);
+	glTextureParameteri(m_table, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTextureParameteri(m_table, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTextureStorage2D(m_table, levels, GL_RGBA8UI, PagesX(0), PagesY(0));
+	m_table_levels.resize(levels);
+
+	glCreateBuffers(1, &m_uniforms);
+	glNamedBufferStorage(m_uniforms, sizeof(f32) * 12, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+	//Feedback target and the buffers it's read back into
+	m_feedback_scale = std::max(feedback_scale, 1u);
+	m_feedback_width = std::max(width / m_feedback_scale, 1u);
+	m_feedback_height = std::max(height / m_feedback_scale, 1u);
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_feedback_color);
+	glTextureStorage2D(m_feedback_color, 1, GL_R32UI, m_feedback_width, m_feedback_height);
+	glCreateRenderbuffers(1, &m_feedback_depth);
+	glNamedRenderbufferStorage(m_feedback_depth, GL_DEPTH_COMPONENT24, m_feedback_width, m_feedback_height);
+	glCreateFramebuffers(1, &m_feedback_fbo);
+	glNamedFramebufferTexture(m_feedback_fbo, GL_COLOR_ATTACHMENT0, m_feedback_color, 0);
+	glNamedFramebufferRenderbuffer(m_feedback_fbo, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_feedback_depth);
+	glNamedFramebufferReadBuffer(m_feedback_fbo, GL_COLOR_ATTACHMENT0);
+	for (Readback& readback : m_readbacks) {
+		glCreateBuffers(1, &readback.m_buffer);
+		glNamedBufferStorage(readback.m_buffer, (GLsizeiptr)m_feedback_width * m_feedback_height * sizeof(u32), nullptr, GL_MAP_READ_BIT | GL_CLIENT_STORAGE_BIT);
+		readback.m_fence = 0;
+	}
+
+	//Coarsest levels straight from the mapping, they're never evicted
+	for (u32 level = levels; level-- > m_pinned_level;) {
+		for (u32 y = 0; y < PagesY(level); ++y) {
+			for (u32 x = 0; x < PagesX(level); ++x) {
+				const u32 page = PageKey(level, x, y);
+				Place(page, PageData(page), true);
+			}
+		}
+	}
+
+	m_stats = {};
+	m_stats.m_capacity = capacity;
+	UploadTable();
+	return true;
+}
+
+void VirtualTexture::Destroy()
+{
+	//Loads in flight read the mapping and upload into the pool
+	if (!m_pending.empty() || m_analysing) AssetManager::WaitIdle();
+
+	for (Readback& readback : m_readbacks) {
+		if (readback.m_fence) glDeleteSync(readback.m_fence);
+		if (readback.m_buffer) glDeleteBuffers(1, &readback.m_buffer);
+		readback = {};
+	}
+	if (m_feedback_fbo) glDeleteFramebuffers(1, &m_feedback_fbo);
+	if (m_feedback_depth) glDeleteRenderbuffers(1, &m_feedback_depth);
+	if (m_feedback_color) glDeleteTextures(1, &m_feedback_color);
+	if (m_uniforms) glDeleteBuffers(1, &m_uniforms);
+	if (m_table) glDeleteTextures(1, &m_table);
+	if (m_pool) glDeleteTextures(1, &m_pool);
+	m_feedback_fbo = m_feedback_depth = m_feedback_color = m_uniforms = m_table = m_pool = 0;
+	m_readback_head = m_readback_count = 0;
+	m_analysing = false;
+
+	m_slots.clear();
+	m_free_slots.clear();
+	m_resident.clear();
+	m_pending.clear();
+	m_table_levels.clear();
+	m_level_offsets.clear();
+	m_table_dirty = true;
+	m_file.Close();
+	m_header = {};
+}
+
+u32 VirtualTexture::PagesX(u32 level) const
+{
+	return std::max((m_header.m_width / m_header.m_page_size) >> level, 1u);
+}
+
+u32 VirtualTexture::PagesY(u32 level) const
+{
+	return std::max((m_header.m_height / m_header.m_page_size) >> level, 1u);
+}
+
+const u8* VirtualTexture::PageData(u32 page) const
+{
+	const u32 level = PageLevel(page);
+	return m_file.Data() + m_level_offsets[level] + ((u64)PageY(page) * PagesX(level) + PageX(page)) * m_page_bytes;
+}
+
+void VirtualTexture::Load(u32 page)
+{
+	m_pending.insert(page);
+	const u8* source = PageData(page);
+	const usize size = m_page_bytes;
+	auto data = std::make_shared<std::vector<u8>>();
+	AssetManager::Submit(
+		[data, source, size]() {
+			//Copying out of the mapping faults the page in here rather than on the render thread
+			data->assign(source, source + size);
+			return true;
+		},
+		[this, data, page]() {
+			m_pending.erase(page);
+			if (m_resident.count(page)) return;
+			//Loads can finish out of order, a page whose parent isn't in yet is asked for again
+			if (PageLevel(page) + 1 < m_header.m_levels && !m_resident.count(ParentPage(page))) return;
+			Place(page, data->data(), false);
+		}
+	);
+}
+
+bool VirtualTexture::Place(u32 page, const u8* data, bool pinned)
+{
+	//Loads only place a page once its parent is in, and the coarsest level is pinned
+	const bool has_parent = PageLevel(page) + 1 < m_header.m_levels;
+	u32 parent = VT_NO_PAGE;
+	if (has_parent) {
+		auto it = m_resident.find(ParentPage(page));
+		assert(it != m_resident.end());
+		parent = it->second;
+	}
+
+	u32 slot = VT_NO_PAGE;
+	if (!m_free_slots.empty()) {
+		slot = m_free_slots.back();
+		m_free_slots.pop_back();
+	}
+	else {
+		//Least recently requested page that no finer page depends on and the current working set doesn't want.
+		//The parent of the page being placed is about to get a child, its m_used may be stale
+		u32 oldest = VT_NO_PAGE;
+		for (u32 i = 0; i < (u32)m_slots.size(); ++i) {
+			const Slot& candidate = m_slots[i];
+			if (i == parent || candidate.m_pinned || candidate.m_children || candidate.m_used == m_working_set) continue;
+			if (candidate.m_used < oldest) {
+				oldest = candidate.m_used;
+				slot = i;
+			}
+		}
+		if (slot == VT_NO_PAGE) {
+			m_stats.m_dropped++;
+			return false;
+		}
+		Evict(slot);
+	}
+
+	Commit(page, slot, data);
+	m_slots[slot] = Slot{ page, m_working_set, 0, pinned };
+	m_resident[page] = slot;
+	if (has_parent) m_slots[parent].m_children++;
+	m_stats.m_loaded++;
+	m_table_dirty = true;
+	return true;
+}
+
+void VirtualTexture::Evict(u32 slot)
+{
+	const u32 page = m_slots[slot].m_page;
+	if (m_sparse) PageCommitment(page, false);
+	m_resident.erase(page);
+	if (PageLevel(page) + 1 < m_header.m_levels) {
+		//A parent can't be evicted while it has children, so it's still resident
+		auto it = m_resident.find(ParentPage(page));
+		assert(it != m_resident.end());
+		m_slots[it->second].m_children--;
+	}
+	m_slots[slot].m_page = VT_NO_PAGE;
+	m_stats.m_evicted++;
+	m_table_dirty = true;
+}
+
+void VirtualTexture::Commit(u32 page, u32 slot, const u8* data)
+{
+	const u32 size = m_header.m_page_size;
+	const u32 border = m_header.m_border;
+	const u32 slot_size = size + 2 * border;
+	if (m_sparse) {
+		//Only the inside of the bordered page, the neighbours are committed pages of their own
+		PageCommitment(page, true);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, slot_size);
+		glPixelStorei(GL_UNPACK_SKIP_PIXELS, border);
+		glPixelStorei(GL_UNPACK_SKIP_ROWS, border);
+		glTextureSubImage2D(m_pool, PageLevel(page), PageX(page) * size, PageY(page) * size, size, size, GL_RGBA, GL_UNSIGNED_BYTE, data);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+		glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+	}
+	else {
+		glTextureSubImage2D(m_pool, 0, (slot % m_atlas_slots) * slot_size, (slot / m_atlas_slots) * slot_size, slot_size, slot_size, GL_RGBA, GL_UNSIGNED_BYTE, data);
+	}
+}
+
+void VirtualTexture::PageCommitment(u32 page, bool commit)
+{
+	//glTexPageCommitmentARB has no DSA form in the ARB extension, the caller's 2D binding is put back
+	GLint previous = 0;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+	const u32 size = m_header.m_page_size;
+	glBindTexture(GL_TEXTURE_2D, m_pool);
+	glTexPageCommitmentARB(GL_TEXTURE_2D, PageLevel(page), PageX(page) * size, PageY(page) * size, 0, size, size, 1, commit ? GL_TRUE : GL_FALSE);
+	glBindTexture(GL_TEXTURE_2D, previous);
+}
+
+void VirtualTexture::UploadTable()
+{
+	//Finest resident page over every page, the coarsest level is always resident so each entry
+	//falls back on the one above it
+	const u32 levels = m_header.m_levels;
+	for (u32 level = levels; level-- > 0;) {
+		const u32 pages_x = PagesX(level);
+		const u32 pages_y = PagesY(level);
+		std::vector<u8>& table = m_table_levels[level];
+		table.resize((usize)pages_x * pages_y * 4);
+		for (u32 y = 0; y < pages_y; ++y) {
+			for (u32 x = 0; x < pages_x; ++x) {
+				u8* entry = &table[((usize)y * pages_x + x) * 4];
+				auto it = m_resident.find(PageKey(level, x, y));
+				if (it != m_resident.end()) {
+					entry[0] = m_sparse ? 0 : (u8)(it->second % m_atlas_slots);
+					entry[1] = m_sparse ? 0 : (u8)(it->second / m_atlas_slots);
+					entry[2] = (u8)level;
+					entry[3] = 255;
+				}
+				else {
+					memcpy(entry, &m_table_levels[level + 1][((usize)(y >> 1) * PagesX(level + 1) + (x >> 1)) * 4], 4);
+				}
+			}
+		}
+	}
+
+	if (m_sparse) {
+		//Filter footprints reach half a texel into the neighbouring pages. Reading no finer than
+		//any page of the 3x3 around keeps every texel trilinear touches committed
+		std::vector<u8> own;
+		for (u32 level = 0; level < levels; ++level) {
+			const i32 pages_x = PagesX(level);
+			const i32 pages_y = PagesY(level);
+			own = m_table_levels[level];
+			for (i32 y = 0; y < pages_y; ++y) {
+				for (i32 x = 0; x < pages_x; ++x) {
+					u8 coarsest = 0;
+					for (i32 ny = std::max(y - 1, 0); ny <= std::min(y + 1, pages_y - 1); ++ny) {
+						for (i32 nx = std::max(x - 1, 0); nx <= std::min(x + 1, pages_x - 1); ++nx) {
+							coarsest = std::max(coarsest, own[((usize)ny * pages_x + nx) * 4 + 2]);
+						}
+					}
+					m_table_levels[level][((usize)y * pages_x + x) * 4 + 2] = coarsest;
+				}
+			}
+		}
+	}
+
+	for (u32 level = 0; level < levels; ++level) {
+		glTextureSubImage2D(m_table, level, 0, 0, PagesX(level), PagesY(level), GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, m_table_levels[level].data());
+	}
+	m_table_dirty = false;
+}
+
+//-------------------------------------------------------------------------------------------------
+// FEEDBACK
+//-------------------------------------------------------------------------------------------------
+
+void VirtualTexture::ApplyWorkingSet(const std::vector<u32>& pages, u32 frame)
+{
+	m_working_set++;
+	m_stats.m_feedback_latency = m_frame - frame;
+
+	//Every requested page and the levels above it, trilinear reads the next one too
+	std::unordered_set<u32> seen;
+	std::vector<u32> missing;
+	u32 not_resident = 0;
+	for (u32 page : pages) {
+		for (u32 key = page;; key = ParentPage(key)) {
+			if (!seen.insert(key).second) break;
+			auto it = m_resident.find(key);
+			if (it != m_resident.end()) {
+				m_slots[it->second].m_used = m_working_set;
+			}
+			else {
+				not_resident++;
+				if (!m_pending.count(key)) missing.push_back(key);
+			}
+			if (PageLevel(key) + 1 >= m_header.m_levels) break;
+		}
+	}
+	m_stats.m_requested = (u32)seen.size();
+	m_stats.m_missing = not_resident;
+
+	//Coarsest first, a page is only placed once the one above it is
+	std::sort(missing.begin(), missing.end(), [](u32 a, u32 b) {
+		return PageLevel(a) != PageLevel(b) ? PageLevel(a) > PageLevel(b) : a < b;
+	});
+	for (u32 page : missing) {
+		if (m_pending.size() >= m_max_in_flight) break;
+		Load(page);
+	}
+}
+
+void VirtualTexture::Update()
+{
+	if (!m_pool) return;
+	m_frame++;
+
+	//Release every readback that's done, only the newest one is worth reducing
+	i32 newest = -1;
+	while (m_readback_count > 0) {
+		const u32 index = (m_readback_head + VIRTUAL_TEXTURE_READBACKS - m_readback_count) % VIRTUAL_TEXTURE_READBACKS;
+		Readback& readback = m_readbacks[index];
+		const GLenum result = glClientWaitSync(readback.m_fence, 0, 0);
+		if (result == GL_TIMEOUT_EXPIRED) break;
+		glDeleteSync(readback.m_fence);
+		readback.m_fence = 0;
+		m_readback_count--;
+		if (result != GL_WAIT_FAILED) newest = index;
+	}
+
+	if (newest >= 0 && !m_analysing) {
+		const Readback& readback = m_readbacks[newest];
+		const usize count = (usize)readback.m_width * readback.m_height;
+		auto pages = std::make_shared<std::vector<u32>>(count);
+		const void* mapped = glMapNamedBufferRange(readback.m_buffer, 0, count * sizeof(u32), GL_MAP_READ_BIT);
+		if (mapped) {
+			memcpy(pages->data(), mapped, count * sizeof(u32));
+			glUnmapNamedBuffer(readback.m_buffer);
+
+			std::vector<u32> pages_x(m_header.m_levels);
+			std::vector<u32> pages_y(m_header.m_levels);
+			for (u32 level = 0; level < m_header.m_levels; ++level) {
+				pages_x[level] = PagesX(level);
+				pages_y[level] = PagesY(level);
+			}
+			const u32 frame = readback.m_frame;
+			m_analysing = true;
+			AssetManager::Submit(
+				[pages, pages_x, pages_y]() {
+					//Distinct pages, dropping cleared texels and anything out of range
+					std::sort(pages->begin(), pages->end());
+					pages->erase(std::unique(pages->begin(), pages->end()), pages->end());
+					pages->erase(std::remove_if(pages->begin(), pages->end(), [&](u32 page) {
+						const u32 level = PageLevel(page);
+						return page == VT_NO_PAGE || level >= pages_x.size() || PageX(page) >= pages_x[level] || PageY(page) >= pages_y[level];
+					}), pages->end());
+					return true;
+				},
+				[this, pages, frame]() {
+					m_analysing = false;
+					ApplyWorkingSet(*pages, frame);
+				}
+			);
+		}
+	}
+
+	if (m_table_dirty) UploadTable();
+
+	const f32 uniforms[12] = {
+		(f32)m_header.m_width, (f32)m_header.m_height, (f32)m_header.m_levels, m_sparse ? 0.0f : 1.0f,
+		(f32)PagesX(0), (f32)PagesY(0), (f32)m_header.m_page_size, (f32)m_header.m_border,
+		(f32)(m_atlas_slots * (m_header.m_page_size + 2 * m_header.m_border)), (f32)(m_atlas_slots * (m_header.m_page_size + 2 * m_header.m_border)),
+		m_lod_bias - log2f((f32)m_feedback_scale), 0.0f,
+	};
+	glNamedBufferSubData(m_uniforms, 0, sizeof(uniforms), uniforms);
+
+	m_stats.m_in_flight = (u32)m_pending.size();
+	m_stats.m_resident = (u32)m_resident.size();
+}
+
+void VirtualTexture::BeginFeedback()
+{
+	if (!m_pool) return;
+	glGetIntegerv(GL_VIEWPORT, m_saved_viewport);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_feedback_fbo);
+	glViewport(0, 0, m_feedback_width, m_feedback_height);
+
+	static const GLuint no_page[4] = { VT_NO_PAGE, VT_NO_PAGE, VT_NO_PAGE, VT_NO_PAGE };
+	static const GLfloat one = 1.0f;
+	glClearBufferuiv(GL_COLOR, 0, no_page);
+	glClearBufferfv(GL_DEPTH, 0, &one);
+	Bind();
+}
+
+void VirtualTexture::EndFeedback()
+{
+	if (!m_pool) return;
+	//Skipped while every buffer is still waiting on the GPU, Update catches up later
+	if (m_readback_count < VIRTUAL_TEXTURE_READBACKS) {
+		Readback& readback = m_readbacks[m_readback_head];
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.m_buffer);
+		glReadPixels(0, 0, m_feedback_width, m_feedback_height, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		readback.m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		readback.m_width = m_feedback_width;
+		readback.m_height = m_feedback_height;
+		readback.m_frame = m_frame;
+		m_readback_head = (m_readback_head + 1) % VIRTUAL_TEXTURE_READBACKS;
+		m_readback_count++;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(m_saved_viewport[0], m_saved_viewport[1], m_saved_viewport[2], m_saved_viewport[3]);
+}
+
+void VirtualTexture::Bind() const
+{
+	if (!m_pool) return;
+	glBindTextureUnit(VIRTUAL_TEXTURE_POOL_UNIT, m_pool);
+	glBindTextureUnit(VIRTUAL_TEXTURE_TABLE_UNIT, m_table);
+	glBindBufferBase(GL_UNIFORM_BUFFER, VIRTUAL_TEXTURE_UBO_BINDING, m_uniforms);
+}
+
+#undef VT_MAX_PAGES
+#undef VT_NO_PAGE
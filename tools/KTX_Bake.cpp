@@ -0,0 +1,374 @@
+#include <GL/glew.h>
+#include "BlockEncoder.h"
+#include "MappedFile.h"
+#include "MipGenerator.h"
+#include "Texture.h"
+
+//Defines.h asks for the stb_image implementation, this is the only file of the tool including it
+#include "stb_image.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+//Offline BCn baker. Reads uncompressed 8-bit KTX files or anything stb_image loads, encodes every
+//level with BlockEncoder and writes a KTX that Load_KTX uploads as it is.
+//
+//	KTX_Bake [-f bc1|bc3|bc5|bc7|rgba8] [-q fast|normal|high] [-m] [-k box|kaiser] [-n] [-t] [-s] [-o directory] files...
+//	KTX_Bake -b [files...]
+//
+//-m builds the mip chain of single level 2D images and arrays with MipGenerator, filtered by -k,
+//-n treats them as normal maps. rgba8 stores the levels uncompressed, so Load_KTX has nothing left
+//to generate. -t encodes on one thread, -s without SIMD.
+//-b encodes level 0 of each file with every format, tier and kernel, then builds its mip chain with
+//every filter and kernel, prints Mtexel/s and PSNR and writes nothing. Without files it bakes or
+//benchmarks the large KTX files the samples ship.
+
+static const char* default_files[] = {
+	"./resources/displacement.ktx",
+	"./resources/Skull/Skull.ktx",
+	"./resources/mountains3d.ktx",
+};
+
+//rgba8 isn't an EncodeFormat, it skips the encoder
+static const char* format_names[] = { "bc1", "bc3", "bc5", "bc7", "rgba8" };
+static const char* quality_names[] = { "fast", "normal", "high" };
+static const char* filter_names[] = { "box", "kaiser" };
+
+//Source texture expanded to RGBA8, layers of a level stored one after another
+struct BakeImage {
+	u32 m_width = 0;
+	u32 m_height = 0;
+	u32 m_layers = 1;
+	u32 m_array_elements = 0;
+	u32 m_depth = 0;
+	bool m_srgb = false;
+	std::vector<std::vector<u8>> m_levels;
+};
+
+static u32 LevelSize(u32 size, u32 level)
+{
+	return (size >> level) > 0 ? size >> level : 1;
+}
+
+static u32 LevelLayers(const BakeImage& image, u32 level)
+{
+	//3D textures halve their depth with each level, array layers stay
+	return image.m_depth ? LevelSize(image.m_depth, level) : image.m_layers;
+}
+
+static bool LoadKTXImage(const char* filename, BakeImage& image)
+{
+	MappedFile file(filename);
+	KTX_Raw ktx = Get_KTX_Raw(file);
+	if (ktx.m_data == nullptr) {
+		std::cerr << "Bad KTX file:" << filename << std::endl;
+		return false;
+	}
+	if (ktx.m_gltype != GL_UNSIGNED_BYTE) {
+		std::cerr << filename << ": only uncompressed 8-bit KTX files can be baked" << std::endl;
+		return false;
+	}
+	if (ktx.m_target != GL_TEXTURE_2D && ktx.m_target != GL_TEXTURE_2D_ARRAY && ktx.m_target != GL_TEXTURE_3D) {
+		std::cerr << filename << ": only 2D, 2D array and 3D textures can be baked" << std::endl;
+		return false;
+	}
+
+	u32 channels = 0;
+	bool bgr = false;
+	switch (ktx.m_glformat) {
+	case GL_RED: channels = 1; break;
+	case GL_RG: channels = 2; break;
+	case GL_RGB: channels = 3; break;
+	case GL_BGR: channels = 3; bgr = true; break;
+	case GL_RGBA: channels = 4; break;
+	case GL_BGRA: channels = 4; bgr = true; break;
+	default:
+		std::cerr << filename << ": unsupported pixel format 0x" << std::hex << ktx.m_glformat << std::dec << std::endl;
+		return false;
+	}
+
+	image.m_width = ktx.m_width;
+	image.m_height = ktx.m_height;
+	image.m_array_elements = ktx.m_array_elements;
+	image.m_layers = ktx.m_array_elements ? ktx.m_array_elements : 1;
+	image.m_depth = ktx.m_target == GL_TEXTURE_3D ? ktx.m_depth : 0;
+	//Upload_KTX stores 2D GL_SRGB8 as linear GL_RGBA8, keep what the samples see
+	image.m_srgb = ktx.m_glinternal_format == GL_SRGB8_ALPHA8 ||
+		(ktx.m_glinternal_format == GL_SRGB8 && ktx.m_target != GL_TEXTURE_2D);
+
+	for (int level = 0; level < ktx.m_miplevels; ++level) {
+		u32 size;
+		const unsigned char* data = Get_KTX_Level(ktx, level, &size);
+		const u32 width = LevelSize(image.m_width, level);
+		const u32 height = LevelSize(image.m_height, level);
+		const u32 layers = LevelLayers(image, level);
+		//KTX rows are padded to 4 bytes
+		const usize pitch = (width * channels + 3) & ~3u;
+		if (data == nullptr || size < pitch * height * layers) {
+			std::cerr << filename << ": truncated KTX file" << std::endl;
+			return false;
+		}
+
+		std::vector<u8> rgba((usize)width * height * layers * 4);
+		for (usize row = 0; row < (usize)height * layers; ++row) {
+			const u8* src = data + row * pitch;
+			u8* dst = rgba.data() + row * width * 4;
+			for (u32 x = 0; x < width; ++x, src += channels, dst += 4) {
+				dst[0] = src[0];
+				dst[1] = channels > 1 ? src[1] : 0;
+				dst[2] = channels > 2 ? src[2] : 0;
+				dst[3] = channels > 3 ? src[3] : 255;
+				if (bgr) std::swap(dst[0], dst[2]);
+			}
+		}
+		image.m_levels.push_back(std::move(rgba));
+	}
+	return true;
+}
+
+static bool LoadImage(const char* filename, BakeImage& image)
+{
+	const std::string extension = std::filesystem::path(filename).extension().string();
+	if (extension == ".ktx") return LoadKTXImage(filename, image);
+
+	int width, height, channels;
+	stbi_uc* pixels = stbi_load(filename, &width, &height, &channels, 4);
+	if (pixels == nullptr) {
+		std::cerr << "Couldn't load " << filename << ": " << stbi_failure_reason() << std::endl;
+		return false;
+	}
+	image.m_width = width;
+	image.m_height = height;
+	image.m_levels.emplace_back(pixels, pixels + (usize)width * height * 4);
+	stbi_image_free(pixels);
+	return true;
+}
+
+//Builds levels 1 onwards of a single level image, its layers side by side
+static void BuildMips(BakeImage& image, const MipSettings& settings)
+{
+	const usize layer_size = (usize)image.m_width * image.m_height * 4;
+	std::vector<MipChain> chains(image.m_layers);
+	for (u32 layer = 0; layer < image.m_layers; ++layer) {
+		chains[layer].m_source = image.m_levels[0].data() + layer * layer_size;
+		chains[layer].m_width = image.m_width;
+		chains[layer].m_height = image.m_height;
+	}
+	GenerateMipChains(chains.data(), image.m_layers, settings);
+
+	for (usize level = 0; level < chains[0].m_levels.size(); ++level) {
+		std::vector<u8> layers;
+		for (MipChain& chain : chains) layers.insert(layers.end(), chain.m_levels[level].begin(), chain.m_levels[level].end());
+		image.m_levels.push_back(std::move(layers));
+	}
+}
+
+//Encodes every layer of one level, one after another the way Upload_KTX reads them
+static void EncodeLevel(const BakeImage& image, u32 level, const EncodeSettings& settings, std::vector<u8>& out, EncodeStats* stats)
+{
+	const u32 width = LevelSize(image.m_width, level);
+	const u32 height = LevelSize(image.m_height, level);
+	const usize layer_size = (usize)width * height * 4;
+	out.clear();
+	std::vector<u8> encoded;
+	for (u32 layer = 0; layer < LevelLayers(image, level); ++layer) {
+		EncodeImage(image.m_levels[level].data() + layer * layer_size, width, height, settings, encoded, stats);
+		out.insert(out.end(), encoded.begin(), encoded.end());
+	}
+}
+
+static bool Bake(const char* filename, const EncodeSettings& base_settings, bool uncompressed, bool mips, MipSettings mip_settings, const char* output_directory)
+{
+	BakeImage image;
+	if (!LoadImage(filename, image)) return false;
+
+	if (mips && image.m_levels.size() == 1) {
+		if (image.m_depth) {
+			std::cout << filename << ": mips aren't built for 3D textures, baking the one level" << std::endl;
+		}
+		else {
+			//Normal maps keep their own content, sRGB only changes how color is weighed
+			if (mip_settings.m_content != MipContent::NormalMap) mip_settings.m_content = image.m_srgb ? MipContent::SRGB : MipContent::Linear;
+			BuildMips(image, mip_settings);
+		}
+	}
+
+	EncodeSettings settings = base_settings;
+	settings.m_srgb = image.m_srgb && settings.m_format != EncodeFormat::BC5;
+
+	EncodeStats stats = {};
+	std::vector<std::vector<u8>> levels(image.m_levels.size());
+	std::vector<const unsigned char*> pointers;
+	std::vector<u32> sizes;
+	for (u32 level = 0; level < levels.size(); ++level) {
+		//RGBA8 rows are always a multiple of 4 bytes, the levels are already laid out for KTX
+		if (uncompressed) levels[level] = image.m_levels[level];
+		else EncodeLevel(image, level, settings, levels[level], &stats);
+		pointers.push_back(levels[level].data());
+		sizes.push_back((u32)levels[level].size());
+	}
+
+	KTX_Raw ktx;
+	ktx.m_width = image.m_width;
+	ktx.m_height = image.m_height;
+	ktx.m_depth = image.m_depth;
+	ktx.m_array_elements = image.m_array_elements;
+	ktx.m_faces = 1;
+	ktx.m_glformat = uncompressed ? GL_RGBA : GL_NONE;
+	ktx.m_gltype = uncompressed ? GL_UNSIGNED_BYTE : GL_NONE;
+	ktx.m_gltypesize = 1;
+	ktx.m_glinternal_format = uncompressed ? (image.m_srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8) : EncodeFormatGL(settings);
+	ktx.m_miplevels = (int)levels.size();
+
+	//<name>.<format>.ktx next to the source unless a directory was given
+	std::filesystem::path output = filename;
+	output.replace_extension(std::string(".") + (uncompressed ? "rgba8" : format_names[(int)settings.m_format]) + ".ktx");
+	if (output_directory) output = std::filesystem::path(output_directory) / output.filename();
+	if (!Save_KTX(output.string().c_str(), ktx, pointers.data(), sizes.data())) return false;
+
+	usize source_bytes = 0, baked_bytes = 0;
+	for (const std::vector<u8>& level : image.m_levels) source_bytes += level.size();
+	for (const std::vector<u8>& level : levels) baked_bytes += level.size();
+	std::cout << filename << " -> " << output.string() << ": " << levels.size() << " levels, "
+		<< source_bytes / 1024 << " KB RGBA8 -> " << baked_bytes / 1024 << " KB";
+	if (!uncompressed) std::cout << ", " << stats.MTexelsPerSecond() << " Mtexel/s, PSNR " << stats.PSNR() << " dB";
+	std::cout << std::endl;
+	return true;
+}
+
+static int Benchmark(const std::vector<const char*>& files)
+{
+	std::cout << "threads: " << omp_get_max_threads() << std::endl;
+	std::cout << "file, format, quality, threads, simd, ms, Mtexel/s, PSNR" << std::endl;
+
+	struct Kernel {
+		bool threads;
+		bool simd;
+	};
+	const Kernel kernels[] = { { false, false }, { false, true }, { true, true } };
+
+	for (const char* filename : files) {
+		BakeImage image;
+		if (!LoadImage(filename, image)) continue;
+
+		//Warm up the threads and caches outside the timed runs
+		std::vector<u8> warm_up;
+		EncodeLevel(image, 0, EncodeSettings(), warm_up, nullptr);
+
+		for (u32 format = 0; format < 4; ++format) {
+			for (u32 quality = 0; quality < 3; ++quality) {
+				for (const Kernel& kernel : kernels) {
+					EncodeSettings settings;
+					settings.m_format = (EncodeFormat)format;
+					settings.m_quality = (EncodeQuality)quality;
+					settings.m_threads = kernel.threads;
+					settings.m_simd = kernel.simd;
+
+					EncodeStats stats = {};
+					std::vector<u8> out;
+					EncodeLevel(image, 0, settings, out, &stats);
+					std::cout << filename << ", " << format_names[format] << ", " << quality_names[quality] << ", "
+						<< (kernel.threads ? "yes" : "no") << ", " << (kernel.simd ? "yes" : "no") << ", "
+						<< stats.m_seconds * 1000.0 << ", " << stats.MTexelsPerSecond() << ", " << stats.PSNR() << std::endl;
+				}
+			}
+		}
+	}
+
+	//Mip chains of level 0, Mtexel/s counts the source texels
+	std::cout << "file, mips, filter, threads, simd, ms, Mtexel/s" << std::endl;
+	for (const char* filename : files) {
+		BakeImage image;
+		if (!LoadImage(filename, image) || image.m_depth) continue;
+		image.m_levels.resize(1);
+
+		for (u32 filter = 0; filter < 2; ++filter) {
+			for (const Kernel& kernel : kernels) {
+				MipSettings settings;
+				settings.m_filter = (MipFilter)filter;
+				settings.m_content = image.m_srgb ? MipContent::SRGB : MipContent::Linear;
+				settings.m_threads = kernel.threads;
+				settings.m_simd = kernel.simd;
+
+				BakeImage chain = image;
+				const auto start = std::chrono::steady_clock::now();
+				BuildMips(chain, settings);
+				const f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+				const f64 texels = (f64)image.m_width * image.m_height * image.m_layers;
+				std::cout << filename << ", " << chain.m_levels.size() << ", " << filter_names[filter] << ", "
+					<< (kernel.threads ? "yes" : "no") << ", " << (kernel.simd ? "yes" : "no") << ", "
+					<< seconds * 1000.0 << ", " << texels / seconds / 1.0e6 << std::endl;
+			}
+		}
+	}
+	return 0;
+}
+
+static int Usage()
+{
+	std::cerr << "Usage: KTX_Bake [-f bc1|bc3|bc5|bc7|rgba8] [-q fast|normal|high] [-m] [-k box|kaiser] [-n] [-t] [-s] [-o directory] files...\n"
+		"       KTX_Bake -b [files...]" << std::endl;
+	return 1;
+}
+
+static int FindName(const char* name, const char* const* names, int count)
+{
+	for (int i = 0; i < count; ++i) {
+		if (strcmp(name, names[i]) == 0) return i;
+	}
+	return -1;
+}
+
+int main(int argc, char** argv)
+{
+	EncodeSettings settings;
+	MipSettings mip_settings;
+	bool uncompressed = false;
+	bool mips = false;
+	bool benchmark = false;
+	const char* output_directory = nullptr;
+	std::vector<const char*> files;
+
+	for (int i = 1; i < argc; ++i) {
+		const char* arg = argv[i];
+		const bool has_value = i + 1 < argc;
+		if (strcmp(arg, "-f") == 0 && has_value) {
+			const int format = FindName(argv[++i], format_names, 5);
+			if (format < 0) return Usage();
+			uncompressed = format == 4;
+			if (!uncompressed) settings.m_format = (EncodeFormat)format;
+		}
+		else if (strcmp(arg, "-q") == 0 && has_value) {
+			const int quality = FindName(argv[++i], quality_names, 3);
+			if (quality < 0) return Usage();
+			settings.m_quality = (EncodeQuality)quality;
+		}
+		else if (strcmp(arg, "-k") == 0 && has_value) {
+			const int filter = FindName(argv[++i], filter_names, 2);
+			if (filter < 0) return Usage();
+			mip_settings.m_filter = (MipFilter)filter;
+		}
+		else if (strcmp(arg, "-o") == 0 && has_value) output_directory = argv[++i];
+		else if (strcmp(arg, "-m") == 0) mips = true;
+		else if (strcmp(arg, "-n") == 0) mip_settings.m_content = MipContent::NormalMap;
+		else if (strcmp(arg, "-t") == 0) settings.m_threads = mip_settings.m_threads = false;
+		else if (strcmp(arg, "-s") == 0) settings.m_simd = mip_settings.m_simd = false;
+		else if (strcmp(arg, "-b") == 0) benchmark = true;
+		else if (arg[0] == '-') return Usage();
+		else files.push_back(arg);
+	}
+	if (files.empty()) files.assign(std::begin(default_files), std::end(default_files));
+
+	if (benchmark) return Benchmark(files);
+
+	int failed = 0;
+	for (const char* filename : files) {
+		if (!Bake(filename, settings, uncompressed, mips, mip_settings, output_directory)) failed++;
+	}
+	return failed ? 1 : 0;
+}